@@ -49,6 +49,8 @@
  *   only incremment it to skip datas, in others cases use block_Realloc
  *   (don't duplicate yourself in a bigger buffer, block_Realloc is
  *   optimised for preheader/postdatas increase)
+ * - the datas of blocks sharing a memory mapping (block_mmap_Share) are
+ *   read-only: call block_MakeWritable before modifying them in place
  ****************************************************************************/
 
 /** The content doesn't follow the last block, or is probably broken */
@@ -81,6 +83,8 @@
 #define BLOCK_FLAG_TOP_FIELD_FIRST 0x2000
 /** This block contains an interlaced picture with bottom field first */
 #define BLOCK_FLAG_BOTTOM_FIELD_FIRST 0x4000
+/** This block contains a picture that no other picture refers to */
+#define BLOCK_FLAG_DISPOSABLE    0x8000
 
 /** This block contains an interlaced picture */
 #define BLOCK_FLAG_INTERLACED_MASK \
@@ -134,10 +138,13 @@ struct block_t
  *      with preheader and or body (increase
  *      and decrease are supported). Use it as it is optimised.
  * - block_Duplicate : create a copy of a block.
+ * - block_MakeWritable : return the block, or a copy of it if its data are
+ *      read-only (the original block is then released).
  ****************************************************************************/
 VLC_API void block_Init( block_t *, void *, size_t );
 VLC_API block_t *block_Alloc( size_t ) VLC_USED VLC_MALLOC;
 VLC_API block_t *block_Realloc( block_t *, ssize_t i_pre, size_t i_body ) VLC_USED;
+VLC_API block_t *block_MakeWritable( block_t * ) VLC_USED;
 
 static inline void block_CopyProperties( block_t *dst, block_t *src )
 {
@@ -168,6 +175,7 @@ static inline void block_Release( block_t *p_block )
 
 VLC_API block_t *block_heap_Alloc(void *, size_t) VLC_USED VLC_MALLOC;
 VLC_API block_t *block_mmap_Alloc(void *addr, size_t length) VLC_USED VLC_MALLOC;
+VLC_API block_t *block_mmap_Share(block_t *, size_t offset, size_t length) VLC_USED VLC_MALLOC;
 VLC_API block_t * block_shm_Alloc(void *addr, size_t length) VLC_USED VLC_MALLOC;
 VLC_API block_t *block_File(int fd) VLC_USED VLC_MALLOC;
 VLC_API block_t *block_FilePath(const char *) VLC_USED VLC_MALLOC;
@@ -296,6 +304,7 @@ static inline block_t *block_ChainGather( block_t *p_list )
  * Fifos of blocks.
  ****************************************************************************
  * - block_FifoNew : create and init a new fifo
+ * - block_FifoNewSPSC : create a fifo with a lock-free single producer ring
  * - block_FifoRelease : destroy a fifo and free all blocks in it.
  * - block_FifoEmpty : free all blocks in a fifo
  * - block_FifoPut : put a block
@@ -309,6 +318,7 @@ static inline block_t *block_ChainGather( block_t *p_list )
  ****************************************************************************/
 
 VLC_API block_fifo_t *block_FifoNew( void ) VLC_USED VLC_MALLOC;
+VLC_API block_fifo_t *block_FifoNewSPSC( size_t ) VLC_USED VLC_MALLOC;
 VLC_API void block_FifoRelease( block_fifo_t * );
 VLC_API void block_FifoEmpty( block_fifo_t * );
 VLC_API void block_FifoPut( block_fifo_t *, block_t * );
@@ -325,6 +335,7 @@ VLC_API void vlc_fifo_Signal(vlc_fifo_t *);
 VLC_API void vlc_fifo_Wait(vlc_fifo_t *);
 VLC_API void vlc_fifo_WaitCond(vlc_fifo_t *, vlc_cond_t *);
 VLC_API void vlc_fifo_QueueUnlocked(vlc_fifo_t *, block_t *);
+VLC_API void vlc_fifo_Push(vlc_fifo_t *, block_t *);
 VLC_API block_t *vlc_fifo_DequeueUnlocked(vlc_fifo_t *) VLC_USED;
 VLC_API block_t *vlc_fifo_DequeueAllUnlocked(vlc_fifo_t *) VLC_USED;
 VLC_API size_t vlc_fifo_GetCount(const vlc_fifo_t *) VLC_USED;
@@ -438,9 +438,24 @@ static inline int block_PeekOffsetBytes( block_bytestream_t *p_bytestream,
     return VLC_SUCCESS;
 }
 
+/**
+ * Optimized start code lookup within a single buffer. It returns the first
+ * occurrence of the start code in [p, end), or NULL if there is none.
+ */
+typedef const uint8_t * (*block_startcode_helper_t)( const uint8_t *p,
+                                                     const uint8_t *end );
+
+/**
+ * Looks up the start code from *pi_offset onward.
+ *
+ * If p_startcode_helper is not NULL, it must look up the same start code.
+ * It then scans the inside of each block, and this function only checks
+ * occurrences straddling two blocks.
+ */
 static inline int block_FindStartcodeFromOffset(
     block_bytestream_t *p_bytestream, size_t *pi_offset,
-    const uint8_t *p_startcode, int i_startcode_length )
+    const uint8_t *p_startcode, int i_startcode_length,
+    block_startcode_helper_t p_startcode_helper )
 {
     block_t *p_block, *p_block_backup = 0;
     int i_size = 0;
@@ -472,6 +487,23 @@ static inline int block_FindStartcodeFromOffset(
     {
         for( i_offset = i_size; i_offset < p_block->i_buffer; i_offset++ )
         {
+            if( p_startcode_helper != NULL && !i_match &&
+                p_block->i_buffer - i_offset >= (size_t)i_startcode_length )
+            {
+                const uint8_t *p_end = &p_block->p_buffer[p_block->i_buffer];
+                const uint8_t *p_res =
+                    p_startcode_helper( &p_block->p_buffer[i_offset], p_end );
+                if( p_res != NULL )
+                {
+                    *pi_offset += p_res - p_block->p_buffer;
+                    return VLC_SUCCESS;
+                }
+                /* Leave the block tail to the bytewise search */
+                i_offset = p_block->i_buffer - (i_startcode_length - 1);
+                if( i_offset >= p_block->i_buffer )
+                    break;
+            }
+
             if( p_block->p_buffer[i_offset] == p_startcode[i_match] )
             {
                 if( !i_match )
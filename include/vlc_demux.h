@@ -100,6 +100,12 @@ typedef struct demux_meta_t
     input_attachment_t **attachments;    /**< array of attachments */
 } demux_meta_t;
 
+typedef struct
+{
+    unsigned i_id; /**< stream identifier, as in the container */
+    uint64_t i_packets;
+} demux_packet_stats_t;
+
 enum demux_query_e
 {
     /* I. Common queries to access_demux and demux */
@@ -151,6 +157,11 @@ enum demux_query_e
     DEMUX_GET_SIGNAL, /* arg1=double *pf_quality, arg2=double *pf_strength
                          res=can fail */
 
+    /* Packets demuxed per elementary stream identifier (such as TS PIDs).
+     * The array is allocated by the demuxer and freed by the caller. */
+    DEMUX_GET_PACKET_STATS, /* arg1= demux_packet_stats_t **, arg2= size_t *
+                               res=can fail */
+
     /* II. Specific access_demux queries */
     /* PAUSE you are ensured that it is never called twice with the same state */
     DEMUX_CAN_PAUSE = 0x1000,   /* arg1= bool*    can fail (assume false)*/
@@ -243,6 +254,32 @@ VLC_API decoder_t * demux_PacketizerNew( demux_t *p_demux, es_format_t *p_fmt, c
  */
 VLC_API void demux_PacketizerDestroy( decoder_t *p_packetizer );
 
+/**
+ * Loads the seek index cached for the local file being demuxed.
+ *
+ * Demuxers that build their index by scanning the file can store it with
+ * demux_IndexStore() and get it back on the next opening, as long as the
+ * file size and modification time did not change. The records are mapped
+ * in memory when possible.
+ *
+ * @param psz_name name and version of the index format, chosen by the demuxer
+ * @param i_record size of a record in bytes
+ * @return a block holding the records (release it with block_Release()), or
+ * NULL if there is no valid cached index
+ */
+VLC_API block_t *demux_IndexLoad( demux_t *, const char *psz_name,
+                                  size_t i_record ) VLC_USED;
+
+/**
+ * Stores the seek index of the local file being demuxed.
+ *
+ * Records are plain data in native byte order, as demux_IndexLoad() returns
+ * them.
+ */
+VLC_API int demux_IndexStore( demux_t *, const char *psz_name,
+                              const void *p_records, size_t i_record,
+                              size_t i_count );
+
 /* */
 #define DEMUX_INIT_COMMON() do {            \
     p_demux->pf_control = Control;          \
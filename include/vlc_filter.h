@@ -210,6 +210,27 @@ static inline int filter_GetInputAttachments( filter_t *p_filter,
                                          ppp_attachment, pi_attachment );
 }
 
+/**
+ * Processes lines of a picture in horizontal bands, in parallel.
+ *
+ * The lines [0, lines) are split in bands, and cb is invoked once per band
+ * with its first line and the line after its last, possibly concurrently from
+ * several worker threads shared by all filters. The calling thread processes
+ * bands too. The function returns when all bands have been processed.
+ *
+ * If parallel processing is disabled or not worth it, cb is simply invoked
+ * once for all lines on the calling thread.
+ *
+ * \param lines number of lines to process
+ * \param grain band heights are multiple of grain lines, but the last one
+ * \param cb function processing a band
+ * \param opaque data for cb
+ */
+VLC_API void filter_Slice( filter_t *, unsigned lines, unsigned grain,
+                           void (*cb)( void *opaque, unsigned first,
+                                       unsigned last ),
+                           void *opaque );
+
 /**
  * It creates a blend filter.
  *
@@ -348,6 +348,11 @@ struct input_stats_t
     int64_t i_demux_corrupted;
     int64_t i_demux_discontinuity;
 
+    /* Stream read-ahead */
+    int64_t i_stream_hits;
+    int64_t i_stream_misses;
+    int64_t i_stream_stall; /* total time spent waiting for data */
+
     /* Decoders */
     int64_t i_decoded_audio;
     int64_t i_decoded_video;
@@ -360,10 +365,19 @@ struct input_stats_t
     int64_t i_sent_packets;
     int64_t i_sent_bytes;
     float f_send_bitrate;
+    int64_t i_sout_pipeline_depth; /* pictures queued in the transcoder */
+    int64_t i_sout_decode_time;
+    int64_t i_sout_filter_time;
+    int64_t i_sout_encode_time;
 
     /* Aout */
     int64_t i_played_abuffers;
     int64_t i_lost_abuffers;
+
+    /* Data blocks pool (process-wide) */
+    int64_t i_block_pool_hits;
+    int64_t i_block_pool_misses;
+    int64_t i_block_pool_retained;
 };
 
 #endif
@@ -43,6 +43,16 @@ extern "C" {
  * Stream output modules interface
  */
 
+/** Stream output statistics, exported through the input statistics */
+typedef enum sout_statistic_t
+{
+    SOUT_STATISTIC_PIPELINE_DEPTH, /**< pictures queued between stages */
+    SOUT_STATISTIC_DECODE_TIME,    /**< time spent decoding, cumulative */
+    SOUT_STATISTIC_FILTER_TIME,    /**< time spent filtering, cumulative */
+    SOUT_STATISTIC_ENCODE_TIME,    /**< time spent encoding, cumulative */
+    SOUT_STATISTIC_MAX
+} sout_statistic_t;
+
 /** Stream output instance (FIXME: should be private to src/ to avoid
  * invalid unsynchronized access) */
 struct sout_instance_t
@@ -56,8 +66,19 @@ struct sout_instance_t
 
     vlc_mutex_t         lock;
     sout_stream_t       *p_stream;
+
+    /* Statistics, see sout_UpdateStatistic() */
+    vlc_mutex_t         stats_lock;
+    int64_t             pi_stats[SOUT_STATISTIC_MAX];
 };
 
+/**
+ * Reports a statistic of a stream output. The pipeline depth is a current
+ * value and replaces the previous one, times are added up.
+ */
+VLC_API void sout_UpdateStatistic( sout_instance_t *, sout_statistic_t,
+                                   int64_t );
+
 /****************************************************************************
  * sout_stream_id_sys_t: opaque (private for all sout_stream_t)
  ****************************************************************************/
@@ -58,6 +58,9 @@ struct stream_t
 
     /* */
     ssize_t     (*pf_read)(stream_t *, void *, size_t);
+    /* Optional: returns a block referencing the next bytes without copying,
+     * or NULL (without reading anything) if that is not possible */
+    block_t    *(*pf_block)(stream_t *, size_t);
     input_item_t *(*pf_readdir)( stream_t * );
     int         (*pf_control)( stream_t *, int i_query, va_list );
 
@@ -64,6 +64,10 @@
 #include <vlc_fs.h>
 #include <vlc_url.h>
 #include <vlc_interrupt.h>
+#include <vlc_block.h>
+#ifdef HAVE_MMAP
+#   include <sys/mman.h>
+#endif
 
 struct access_sys_t
 {
@@ -71,8 +75,13 @@ struct access_sys_t
 
     bool b_pace_control;
     uint64_t size;
+
+    block_t *map; /* whole file mapping in zero-copy mode */
 };
 
+/* Size of the blocks referencing the file mapping */
+#define FILE_MMAP_CHUNK (4 << 20)
+
 #if !defined (_WIN32) && !defined (__OS2__)
 static bool IsRemote (int fd)
 {
@@ -134,6 +143,37 @@ static int FileSeek (access_t *, uint64_t);
 static ssize_t StreamRead (access_t *, uint8_t *, size_t);
 static int NoSeek (access_t *, uint64_t);
 static int FileControl (access_t *, int, va_list);
+#ifdef HAVE_MMAP
+static block_t *FileBlock (access_t *);
+
+/**
+ * Maps the whole file (again, if it has grown).
+ */
+static int FileMap (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    if (p_sys->size == 0 || p_sys->size >= SIZE_MAX)
+        return VLC_EGENERIC;
+
+    /* The blocks share the mapping: they are read-only (see
+     * block_MakeWritable()), and so is the mapping. */
+    void *addr = mmap (NULL, p_sys->size, PROT_READ, MAP_PRIVATE,
+                       p_sys->fd, 0);
+    block_t *map = block_mmap_Alloc (addr, p_sys->size);
+    if (map == NULL)
+    {
+        msg_Dbg (p_access, "cannot map file: %s", vlc_strerror_c(errno));
+        return VLC_EGENERIC;
+    }
+
+    /* Blocks still referencing the previous mapping keep it alive */
+    if (p_sys->map != NULL)
+        block_Release (p_sys->map);
+    p_sys->map = map;
+    return VLC_SUCCESS;
+}
+#endif
 
 /*****************************************************************************
  * FileOpen: open the file
@@ -220,6 +260,7 @@ int FileOpen( vlc_object_t *p_this )
     p_access->pf_control = FileControl;
     p_access->p_sys = p_sys;
     p_sys->fd = fd;
+    p_sys->map = NULL;
 
     if (S_ISREG (st.st_mode) || S_ISBLK (st.st_mode))
     {
@@ -240,6 +281,16 @@ int FileOpen( vlc_object_t *p_this )
             fcntl (fd, F_RDAHEAD, 0);
         else
             fcntl (fd, F_RDAHEAD, 1);
+#endif
+#ifdef HAVE_MMAP
+        /* A truncated remote file cannot be detected in time */
+        if (S_ISREG (st.st_mode) && var_InheritBool (p_access, "file-mmap")
+         && !IsRemote(fd, p_access->psz_filepath)
+         && FileMap (p_access) == VLC_SUCCESS)
+        {
+            msg_Dbg (p_access, "reading through a memory mapping");
+            p_access->pf_block = FileBlock;
+        }
 #endif
     }
     else
@@ -272,6 +323,8 @@ void FileClose (vlc_object_t * p_this)
 
     access_sys_t *p_sys = p_access->p_sys;
 
+    if (p_sys->map != NULL)
+        block_Release (p_sys->map);
     close (p_sys->fd);
     free (p_sys);
 }
@@ -298,6 +351,53 @@ static ssize_t FileRead (access_t *p_access, uint8_t *p_buffer, size_t i_len)
 }
 
 
+#ifdef HAVE_MMAP
+/**
+ * Reads from a regular file through its memory mapping.
+ * The blocks reference the mapping, so that no data is copied.
+ */
+static block_t *FileBlock (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint64_t pos = p_access->info.i_pos;
+    uint64_t size = p_sys->map->i_buffer;
+    struct stat st;
+
+    /* Never hand out pages past the current end of file */
+    if (fstat (p_sys->fd, &st) == 0)
+    {
+        if ((uint64_t)st.st_size < size)
+        {
+            msg_Warn (p_access, "file truncated to %"PRIu64" bytes",
+                      (uint64_t)st.st_size);
+            size = p_sys->size = st.st_size;
+        }
+        else
+        if (pos >= size && (uint64_t)st.st_size > pos)
+        {   /* The file has grown since it was mapped */
+            p_sys->size = st.st_size;
+            if (FileMap (p_access) == VLC_SUCCESS)
+                size = p_sys->map->i_buffer;
+        }
+    }
+
+    if (pos >= size)
+    {
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+
+    size_t len = size - pos;
+    if (len > FILE_MMAP_CHUNK)
+        len = FILE_MMAP_CHUNK;
+
+    block_t *block = block_mmap_Share (p_sys->map, pos, len);
+    if (likely(block != NULL))
+        p_access->info.i_pos += len;
+    return block;
+}
+#endif
+
 /*****************************************************************************
  * Seek: seek to a specific location in a file
  *****************************************************************************/
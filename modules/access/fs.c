@@ -30,12 +30,18 @@
 #include "fs.h"
 #include <vlc_plugin.h>
 
+#define MMAP_TEXT N_("Memory-mapped file reading")
+#define MMAP_LONGTEXT N_( \
+    "Read local files through a memory mapping, so that the data reach " \
+    "the demuxers without being copied." )
+
 vlc_module_begin ()
     set_description( N_("File input") )
     set_shortname( N_("File") )
     set_category( CAT_INPUT )
     set_subcategory( SUBCAT_INPUT_ACCESS )
     add_obsolete_string( "file-cat" )
+    add_bool( "file-mmap", false, MMAP_TEXT, MMAP_LONGTEXT, true )
     set_capability( "access", 50 )
     add_shortcut( "file", "fd", "stream" )
     set_callbacks( FileOpen, FileClose )
@@ -44,8 +44,15 @@
 #include <vlc_block.h>
 #include <vlc_interrupt.h>
 #include <fcntl.h>
+#ifdef HAVE_RECVMMSG
+# include <time.h>
+# include <sys/socket.h>
+#endif
 
 #define MTU 65535
+#define UDP_BATCH_MAX 64
+#define UDP_SLOT_MIN 1500 /* initial buffer size, grown as needed */
+#define UDP_STATS_PERIOD (10 * CLOCK_FREQ)
 
 /*****************************************************************************
  * Module descriptor
@@ -55,6 +62,9 @@ static void Close( vlc_object_t * );
 
 #define BUFFER_TEXT N_("Receive buffer")
 #define BUFFER_LONGTEXT N_("UDP receive buffer size (bytes)" )
+#define BATCH_TEXT N_("Receive batch")
+#define BATCH_LONGTEXT N_("Maximum number of datagrams read from the " \
+    "socket at once. 1 reads one datagram at a time." )
 
 vlc_module_begin ()
     set_shortname( N_("UDP" ) )
@@ -64,6 +74,10 @@ vlc_module_begin ()
 
     add_obsolete_integer( "server-port" ) /* since 2.0.0 */
     add_integer( "udp-buffer", 0x400000, BUFFER_TEXT, BUFFER_LONGTEXT, true )
+#ifdef HAVE_RECVMMSG
+    add_integer_with_range( "udp-batch", 32, 1, UDP_BATCH_MAX,
+                            BATCH_TEXT, BATCH_LONGTEXT, true )
+#endif
 
     set_capability( "access", 0 )
     add_shortcut( "udp", "udpstream", "udp4", "udp6" )
@@ -78,6 +92,26 @@ struct access_sys_t
     block_fifo_t *fifo;
     vlc_sem_t semaphore;
     vlc_thread_t thread;
+#ifdef HAVE_RECVMMSG
+    unsigned batch;
+    size_t slot; /* receive buffers size */
+    block_t *pkts[UDP_BATCH_MAX]; /* receive buffers, owned by the thread */
+    uint8_t *spill; /* tail of datagrams larger than the buffers */
+
+    struct
+    {
+        uint64_t packets;
+        uint64_t calls;
+        unsigned max_batch;
+        uint64_t fifo_drops; /* discarded on FIFO overflow */
+        uint32_t kernel_drops; /* discarded by the kernel, cumulated */
+        uint64_t truncated; /* larger than the buffers, lost */
+        mtime_t last; /* arrival date of the previous datagram */
+        mtime_t interval; /* smoothed inter-arrival time */
+        mtime_t jitter; /* smoothed inter-arrival deviation */
+        mtime_t report;
+    } stats;
+#endif
 };
 
 /*****************************************************************************
@@ -86,6 +120,9 @@ struct access_sys_t
 static block_t *BlockUDP( access_t * );
 static int Control( access_t *, int, va_list );
 static void* ThreadRead( void *data );
+#ifdef HAVE_RECVMMSG
+static void* ThreadReadBatch( void *data );
+#endif
 
 /*****************************************************************************
  * Open: open the socket
@@ -181,9 +218,38 @@ static int Open( vlc_object_t *p_this )
     sys->fifo_size = var_InheritInteger( p_access, "udp-buffer");
     vlc_sem_init( &sys->semaphore, 0 );
 
-    if( vlc_clone( &sys->thread, ThreadRead, p_access,
+    void *(*entry)( void * ) = ThreadRead;
+#ifdef HAVE_RECVMMSG
+    sys->batch = var_InheritInteger( p_access, "udp-batch" );
+    if( sys->batch > UDP_BATCH_MAX )
+        sys->batch = UDP_BATCH_MAX;
+    sys->slot = UDP_SLOT_MIN;
+    memset( sys->pkts, 0, sizeof (sys->pkts) );
+    memset( &sys->stats, 0, sizeof (sys->stats) );
+    sys->spill = NULL;
+    if( sys->batch > 1 )
+    {
+        sys->spill = malloc( MTU );
+        if( likely(sys->spill != NULL) )
+        {
+            entry = ThreadReadBatch;
+            /* Arrival dates from the kernel, rather than when we wake up */
+            setsockopt( sys->fd, SOL_SOCKET, SO_TIMESTAMPNS,
+                        &(int){ 1 }, sizeof (int) );
+# ifdef SO_RXQ_OVFL
+            setsockopt( sys->fd, SOL_SOCKET, SO_RXQ_OVFL,
+                        &(int){ 1 }, sizeof (int) );
+# endif
+        }
+    }
+#endif
+
+    if( vlc_clone( &sys->thread, entry, p_access,
                    VLC_THREAD_PRIORITY_INPUT ) )
     {
+#ifdef HAVE_RECVMMSG
+        free( sys->spill );
+#endif
         vlc_sem_destroy( &sys->semaphore );
         block_FifoRelease( sys->fifo );
         net_Close( sys->fd );
@@ -195,6 +261,20 @@ error:
     return VLC_SUCCESS;
 }
 
+#ifdef HAVE_RECVMMSG
+static void PrintStats( access_t *p_access )
+{
+    access_sys_t *sys = p_access->p_sys;
+
+    msg_Dbg( p_access, "received %"PRIu64" datagrams in %"PRIu64" batches "
+             "(max %u), dropped %"PRIu64" on overflow, %"PRIu32" by the kernel, "
+             "%"PRIu64" truncated, jitter %"PRId64" us",
+             sys->stats.packets, sys->stats.calls, sys->stats.max_batch,
+             sys->stats.fifo_drops, sys->stats.kernel_drops,
+             sys->stats.truncated, sys->stats.jitter );
+}
+#endif
+
 /*****************************************************************************
  * Close: free unused data structures
  *****************************************************************************/
@@ -205,6 +285,16 @@ static void Close( vlc_object_t *p_this )
 
     vlc_cancel( sys->thread );
     vlc_join( sys->thread, NULL );
+#ifdef HAVE_RECVMMSG
+    if( sys->spill != NULL )
+    {
+        PrintStats( p_access );
+        for( unsigned i = 0; i < sys->batch; i++ )
+            if( sys->pkts[i] != NULL )
+                block_Release( sys->pkts[i] );
+        free( sys->spill );
+    }
+#endif
     vlc_sem_destroy( &sys->semaphore );
     block_FifoRelease( sys->fifo );
     net_Close( sys->fd );
@@ -310,3 +400,214 @@ static void* ThreadRead( void *data )
 
     return NULL;
 }
+
+#ifdef HAVE_RECVMMSG
+/* Usable size of a receive buffer */
+static size_t BlockCapacity( const block_t *pkt )
+{
+    return pkt->p_start + pkt->i_size - pkt->p_buffer;
+}
+
+/* Arrival date of a datagram, in the mdate() time base */
+static mtime_t ArrivalDate( struct msghdr *msg, mtime_t now,
+                            const struct timespec *real, uint32_t *drops )
+{
+    mtime_t date = now;
+
+    for( struct cmsghdr *cmsg = CMSG_FIRSTHDR( msg ); cmsg != NULL;
+         cmsg = CMSG_NXTHDR( msg, cmsg ) )
+    {
+        if( cmsg->cmsg_level != SOL_SOCKET )
+            continue;
+
+        if( cmsg->cmsg_type == SCM_TIMESTAMPNS )
+        {
+            struct timespec ts;
+
+            memcpy( &ts, CMSG_DATA( cmsg ), sizeof (ts) );
+            mtime_t age = (real->tv_sec - ts.tv_sec) * CLOCK_FREQ
+                        + (real->tv_nsec - ts.tv_nsec) / 1000;
+            if( age > 0 )
+                date = now - age;
+        }
+# ifdef SO_RXQ_OVFL
+        else if( cmsg->cmsg_type == SO_RXQ_OVFL )
+            memcpy( drops, CMSG_DATA( cmsg ), sizeof (*drops) );
+# endif
+    }
+    (void) drops;
+    return date;
+}
+
+/*****************************************************************************
+ * ThreadReadBatch: Pull packets from socket, several at a time.
+ *
+ * Datagrams are received into buffers of the size seen so far, which return
+ * to the block pool once consumed. A larger datagram overflows into a spill
+ * buffer shared by the whole batch, and the buffers are enlarged for the
+ * next batches.
+ *****************************************************************************/
+static void* ThreadReadBatch( void *data )
+{
+    access_t *access = data;
+    access_sys_t *sys = access->p_sys;
+    struct mmsghdr msgs[UDP_BATCH_MAX];
+    struct iovec iovs[UDP_BATCH_MAX][2];
+    union
+    {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof (struct timespec))
+               + CMSG_SPACE(sizeof (uint32_t))];
+    } cmsgs[UDP_BATCH_MAX];
+
+    sys->stats.report = mdate() + UDP_STATS_PERIOD;
+
+    for(;;)
+    {
+        int canc = vlc_savecancel();
+        unsigned n = 0;
+
+        while (n < sys->batch)
+        {
+            block_t *pkt = sys->pkts[n];
+
+            if (pkt != NULL && BlockCapacity(pkt) < sys->slot)
+            {
+                block_Release(pkt);
+                pkt = NULL;
+            }
+            if (pkt == NULL)
+            {
+                pkt = block_Alloc(sys->slot);
+                if (unlikely(pkt == NULL))
+                    break;
+                sys->pkts[n] = pkt;
+            }
+
+            iovs[n][0].iov_base = pkt->p_buffer;
+            iovs[n][0].iov_len = BlockCapacity(pkt);
+            iovs[n][1].iov_base = sys->spill;
+            iovs[n][1].iov_len = MTU;
+            msgs[n].msg_hdr = (struct msghdr) {
+                .msg_iov = iovs[n],
+                .msg_iovlen = 2,
+                .msg_control = cmsgs[n].buf,
+                .msg_controllen = sizeof (cmsgs[n].buf),
+            };
+            n++;
+        }
+        vlc_restorecancel(canc);
+
+        if (unlikely(n == 0))
+        {   /* OOM - dequeue and discard one packet */
+            char dummy;
+            recv(sys->fd, &dummy, 1, 0);
+            continue;
+        }
+
+        int val = recvmmsg(sys->fd, msgs, n, MSG_WAITFORONE, NULL);
+        if (val <= 0)
+            continue;
+
+        canc = vlc_savecancel();
+
+        mtime_t now = mdate();
+        struct timespec real;
+        clock_gettime(CLOCK_REALTIME, &real);
+
+        /* Only the last datagram to overflow has its tail in the spill */
+        int spilled = -1;
+        for (int i = 0; i < val; i++)
+            if (msgs[i].msg_len > iovs[i][0].iov_len)
+                spilled = i;
+
+        block_t *chain = NULL, **pp_last = &chain;
+        size_t bytes = 0;
+        unsigned count = 0;
+
+        for (int i = 0; i < val; i++)
+        {
+            size_t len = msgs[i].msg_len;
+            size_t cap = iovs[i][0].iov_len;
+            block_t *pkt;
+
+            if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) || (len > cap && i != spilled))
+            {
+                sys->stats.truncated++;
+                if (len > sys->slot)
+                    sys->slot = len;
+                continue;
+            }
+
+            if (len > cap)
+            {
+                pkt = block_Alloc(len);
+                if (unlikely(pkt == NULL))
+                    continue;
+                memcpy(pkt->p_buffer, iovs[i][0].iov_base, cap);
+                memcpy(pkt->p_buffer + cap, sys->spill, len - cap);
+                if (len > sys->slot)
+                    sys->slot = len;
+            }
+            else
+            {
+                pkt = sys->pkts[i];
+                sys->pkts[i] = NULL;
+                pkt->i_buffer = len;
+            }
+
+            pkt->i_dts = ArrivalDate(&msgs[i].msg_hdr, now, &real,
+                                     &sys->stats.kernel_drops);
+
+            /* Inter-arrival jitter, smoothed as in RFC 3550 */
+            if (sys->stats.last != 0)
+            {
+                mtime_t interval = pkt->i_dts - sys->stats.last;
+                mtime_t deviation = interval - sys->stats.interval;
+
+                sys->stats.interval += deviation / 16;
+                if (deviation < 0)
+                    deviation = -deviation;
+                sys->stats.jitter += (deviation - sys->stats.jitter) / 16;
+            }
+            sys->stats.last = pkt->i_dts;
+
+            *pp_last = pkt;
+            pp_last = &pkt->p_next;
+            bytes += len;
+            count++;
+        }
+
+        sys->stats.calls++;
+        sys->stats.packets += val;
+        if ((unsigned)val > sys->stats.max_batch)
+            sys->stats.max_batch = val;
+
+        if (count > 0)
+        {
+            vlc_fifo_Lock(sys->fifo);
+            /* Discard old buffers on overflow */
+            while (vlc_fifo_GetBytes(sys->fifo) > 0
+                && vlc_fifo_GetBytes(sys->fifo) + bytes > sys->fifo_size)
+            {
+                block_Release(vlc_fifo_DequeueUnlocked(sys->fifo));
+                sys->stats.fifo_drops++;
+            }
+
+            vlc_fifo_QueueUnlocked(sys->fifo, chain);
+            vlc_fifo_Unlock(sys->fifo);
+            while (count-- > 0)
+                vlc_sem_post(&sys->semaphore);
+        }
+
+        if (now >= sys->stats.report)
+        {
+            PrintStats(access);
+            sys->stats.report = now + UDP_STATS_PERIOD;
+        }
+        vlc_restorecancel(canc);
+    }
+
+    return NULL;
+}
+#endif
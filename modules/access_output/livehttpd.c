@@ -0,0 +1,952 @@
+/*****************************************************************************
+ * livehttpd.c: HTTP Live Streaming and DASH packager served from memory
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_sout.h>
+#include <vlc_block.h>
+#include <vlc_httpd.h>
+#include <vlc_atomic.h>
+#include <vlc_arrays.h>
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+static int  Open ( vlc_object_t * );
+static void Close( vlc_object_t * );
+
+#define SOUT_CFG_PREFIX "sout-livehttpd-"
+
+#define SEGLEN_TEXT N_("Segment length")
+#define SEGLEN_LONGTEXT N_("Minimum length of the segments (seconds). " \
+    "Segments are only cut before a random access point.")
+#define NUMSEGS_TEXT N_("Number of segments")
+#define NUMSEGS_LONGTEXT N_("Number of complete segments kept in memory " \
+    "and listed in the index")
+#define PARTLEN_TEXT N_("Partial segment length")
+#define PARTLEN_LONGTEXT N_("Length of the low-latency partial segments " \
+    "(milliseconds). 0 disables partial segments.")
+#define INDEX_TEXT N_("Index name")
+#define INDEX_LONGTEXT N_("Name of the HLS playlist, relative to the " \
+    "destination path")
+#define MPD_TEXT N_("Publish a DASH manifest")
+#define MPD_LONGTEXT N_("Also publish manifest.mpd when the stream is " \
+    "fragmented MP4 (mp4frag muxer).")
+
+vlc_module_begin ()
+    set_description( N_("In-memory HTTP Live streaming server") )
+    set_shortname( N_("LiveHTTPd") )
+    add_shortcut( "livehttpd" )
+    set_capability( "sout access", 0 )
+    set_category( CAT_SOUT )
+    set_subcategory( SUBCAT_SOUT_ACO )
+    add_integer( SOUT_CFG_PREFIX "seglen", 4, SEGLEN_TEXT, SEGLEN_LONGTEXT,
+                 false )
+        change_integer_range( 1, 60 )
+    add_integer( SOUT_CFG_PREFIX "numsegs", 6, NUMSEGS_TEXT,
+                 NUMSEGS_LONGTEXT, false )
+        change_integer_range( 1, 1000 )
+    add_integer( SOUT_CFG_PREFIX "partlen", 0, PARTLEN_TEXT,
+                 PARTLEN_LONGTEXT, true )
+        change_integer_range( 0, 10000 )
+    add_string( SOUT_CFG_PREFIX "index", "index.m3u8",
+                INDEX_TEXT, INDEX_LONGTEXT, false )
+    add_bool( SOUT_CFG_PREFIX "mpd", false, MPD_TEXT, MPD_LONGTEXT, true )
+    set_callbacks( Open, Close )
+vlc_module_end ()
+
+
+/*****************************************************************************
+ * Exported prototypes
+ *****************************************************************************/
+static const char *const ppsz_sout_options[] = {
+    "seglen", "numsegs", "partlen", "index", "mpd", NULL
+};
+
+static ssize_t Write( sout_access_out_t *, block_t * );
+static int Seek ( sout_access_out_t *, off_t  );
+static int Control( sout_access_out_t *, int, va_list );
+
+#define LIVE_MAX_PARTS 64
+
+/* A media segment. Once published, its parts are never modified. The
+ * segment is referenced by the window and by the requests copying it. */
+typedef struct
+{
+    atomic_uint refs;
+    uint32_t    i_number;
+    mtime_t     i_start;        /* date of the first sample */
+    mtime_t     i_duration;
+    size_t      i_size;         /* published bytes */
+    bool        b_complete;
+
+    unsigned    i_parts;        /* published parts */
+    struct
+    {
+        block_t *p_data;
+        mtime_t  i_duration;
+        bool     b_independent;
+    } parts[LIVE_MAX_PARTS];
+} live_segment_t;
+
+static void SegmentRelease( live_segment_t *seg )
+{
+    if( atomic_fetch_sub( &seg->refs, 1 ) != 1 )
+        return;
+
+    for( unsigned i = 0; i < seg->i_parts; i++ )
+        block_Release( seg->parts[i].p_data );
+    free( seg );
+}
+
+struct sout_access_out_sys_t
+{
+    httpd_host_t *p_host;
+    char         *psz_base;     /* URL path, with a trailing slash */
+    char         *psz_index;
+    bool          b_mpd;
+
+    /* published URLs, registered once the format is known */
+    httpd_url_t  *p_url_index;
+    httpd_url_t  *p_url_mpd;
+    httpd_url_t  *p_url_init;
+    httpd_url_t  *p_url_segment;
+    httpd_url_t  *p_url_part;
+
+    mtime_t       i_seglen;
+    mtime_t       i_partlen;    /* 0 without partial segments */
+    unsigned      i_numsegs;
+
+    /* shared with the HTTP callbacks */
+    vlc_mutex_t   lock;
+    bool          b_fmp4;
+    block_t      *p_init;       /* fragmented MP4 initialization segment */
+    int           i_segments;
+    live_segment_t **pp_segments; /* the window, oldest first */
+    mtime_t       i_origin;     /* start of the first segment */
+    time_t        i_origin_wall;
+    mtime_t       i_max_duration;
+
+    /* writer state */
+    bool          b_format_known;
+    live_segment_t *p_current;  /* being filled, last of the window */
+    block_t      *p_part;       /* current part data */
+    block_t     **pp_part_last;
+    mtime_t       i_part_start;
+    bool          b_part_independent;
+    mtime_t       i_last_date;  /* end of the last dated block */
+    bool          b_pending;    /* a part is waiting for its end date */
+    mtime_t       i_pending_start;
+    block_t      *p_pending;
+    bool          b_pending_independent;
+    bool          b_pending_segment; /* ... and it ends the segment */
+    uint32_t      i_next_number;
+};
+
+/*****************************************************************************
+ * Segmenter
+ *****************************************************************************/
+
+static int OpenSegment( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    live_segment_t *seg = malloc( sizeof (*seg) );
+
+    if( unlikely(seg == NULL) )
+        return VLC_ENOMEM;
+
+    atomic_init( &seg->refs, 1 );
+    seg->i_number = p_sys->i_next_number++;
+    seg->i_start = VLC_TS_INVALID;
+    seg->i_duration = 0;
+    seg->i_size = 0;
+    seg->b_complete = false;
+    seg->i_parts = 0;
+
+    vlc_mutex_lock( &p_sys->lock );
+    TAB_APPEND( p_sys->i_segments, p_sys->pp_segments, seg );
+    vlc_mutex_unlock( &p_sys->lock );
+    p_sys->p_current = seg;
+    return VLC_SUCCESS;
+}
+
+/* Publishes the pending part, now that its end date is known. */
+static void PublishPending( sout_access_out_t *p_access, mtime_t i_end )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( !p_sys->b_pending )
+        return;
+    p_sys->b_pending = false;
+
+    /* segments are listed from their first part on */
+    if( p_sys->p_current == NULL && OpenSegment( p_access ) )
+    {
+        block_Release( p_sys->p_pending );
+        p_sys->p_pending = NULL;
+        return;
+    }
+
+    live_segment_t *seg = p_sys->p_current;
+
+    mtime_t i_duration = i_end - p_sys->i_pending_start;
+    if( i_duration < 0 )
+        i_duration = 0;
+
+    assert( seg->i_parts < LIVE_MAX_PARTS );
+    vlc_mutex_lock( &p_sys->lock );
+    if( seg->i_parts == 0 )
+        seg->i_start = p_sys->i_pending_start;
+    seg->parts[seg->i_parts].p_data = p_sys->p_pending;
+    seg->parts[seg->i_parts].i_duration = i_duration;
+    seg->parts[seg->i_parts].b_independent = p_sys->b_pending_independent;
+    seg->i_size += p_sys->p_pending->i_buffer;
+    seg->i_duration += i_duration;
+    seg->i_parts++;
+    p_sys->p_pending = NULL;
+
+    if( p_sys->b_pending_segment )
+    {
+        seg->b_complete = true;
+        if( seg->i_duration > p_sys->i_max_duration )
+            p_sys->i_max_duration = seg->i_duration;
+        p_sys->p_current = NULL;
+
+        /* Drop segments out of the window. Requests still copying them
+         * keep a reference. */
+        while( p_sys->i_segments > (int)p_sys->i_numsegs )
+        {
+            live_segment_t *old = p_sys->pp_segments[0];
+            TAB_REMOVE( p_sys->i_segments, p_sys->pp_segments, old );
+            SegmentRelease( old );
+        }
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+
+    if( p_sys->p_current == NULL )
+        msg_Dbg( p_access, "segment %"PRIu32" complete (%"PRId64" us, "
+                 "%zu bytes)", seg->i_number, seg->i_duration, seg->i_size );
+}
+
+/* Closes the current part. It is published when the next sample date is
+ * known, so that the durations add up to the timeline. */
+static void ClosePart( sout_access_out_t *p_access, bool b_segment )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( p_sys->p_part == NULL )
+        return;
+
+    block_t *p_data = block_ChainGather( p_sys->p_part );
+    p_sys->p_part = NULL;
+    p_sys->pp_part_last = &p_sys->p_part;
+    if( unlikely(p_data == NULL) )
+        return;
+
+    assert( !p_sys->b_pending );
+    p_sys->b_pending = true;
+    p_sys->p_pending = p_data;
+    p_sys->i_pending_start = p_sys->i_part_start;
+    p_sys->b_pending_independent = p_sys->b_part_independent;
+    p_sys->b_pending_segment = b_segment;
+    p_sys->i_part_start = VLC_TS_INVALID;
+}
+
+/*****************************************************************************
+ * HTTP callbacks
+ *****************************************************************************/
+static void Answer( httpd_message_t *answer, const httpd_message_t *query,
+                    int i_status, const char *psz_mime, const char *psz_cache,
+                    uint8_t *p_body, size_t i_body )
+{
+    answer->i_proto  = HTTPD_PROTO_HTTP;
+    answer->i_version= 1;
+    answer->i_type   = HTTPD_MSG_ANSWER;
+    answer->i_status = i_status;
+
+    if( psz_mime != NULL )
+        httpd_MsgAdd( answer, "Content-type", "%s", psz_mime );
+    httpd_MsgAdd( answer, "Cache-Control", "%s", psz_cache );
+    httpd_MsgAdd( answer, "Access-Control-Allow-Origin", "*" );
+    httpd_MsgAdd( answer, "Content-Length", "%zu", i_body );
+
+    if( query->i_type == HTTPD_MSG_HEAD )
+    {
+        free( p_body );
+        p_body = NULL;
+        i_body = 0;
+    }
+    answer->p_body = p_body;
+    answer->i_body = i_body;
+}
+
+/* In-memory text streams, see also str_format_meta() */
+static FILE *MemOpen( char **pp_buf, size_t *pi_len )
+{
+#ifdef HAVE_OPEN_MEMSTREAM
+    return open_memstream( pp_buf, pi_len );
+#else
+    (void) pp_buf; (void) pi_len;
+# ifdef _WIN32
+    return vlc_win32_tmpfile();
+# else
+    return tmpfile();
+# endif
+#endif
+}
+
+static char *MemClose( FILE *stream, char *p_buf, size_t *pi_len )
+{
+#ifdef HAVE_OPEN_MEMSTREAM
+    if( fclose( stream ) )
+        return NULL;
+    return p_buf;
+#else
+    (void) p_buf;
+    long i_len = ftell( stream );
+    char *psz = NULL;
+
+    if( i_len >= 0 )
+    {
+        rewind( stream );
+        psz = malloc( i_len + 1 );
+        if( psz != NULL )
+        {
+            if( fread( psz, 1, i_len, stream ) == (size_t)i_len )
+            {
+                psz[i_len] = '\0';
+                *pi_len = i_len;
+            }
+            else
+            {
+                free( psz );
+                psz = NULL;
+            }
+        }
+    }
+    fclose( stream );
+    return psz;
+#endif
+}
+
+/* Formats a duration in seconds, independently of the locale */
+static void PrintDuration( FILE *stream, mtime_t i_duration )
+{
+    i_duration /= 1000;
+    fprintf( stream, "%"PRId64".%03u", i_duration / 1000,
+             (unsigned)(i_duration % 1000) );
+}
+
+/* Segments listing their parts in the playlist */
+#define LIVE_PARTS_LISTED 3
+
+static char *Playlist( sout_access_out_sys_t *p_sys, size_t *pi_len )
+{
+    const char *ext = p_sys->b_fmp4 ? "m4s" : "ts";
+    char *psz;
+    FILE *stream = MemOpen( &psz, pi_len );
+    if( stream == NULL )
+        return NULL;
+
+    unsigned i_version = p_sys->i_partlen ? 9 : p_sys->b_fmp4 ? 7 : 3;
+    mtime_t i_target = __MAX( p_sys->i_max_duration, p_sys->i_seglen );
+    uint32_t i_first = p_sys->pp_segments[0]->i_number;
+
+    fprintf( stream, "#EXTM3U\n#EXT-X-VERSION:%u\n"
+             "#EXT-X-TARGETDURATION:%"PRId64"\n"
+             "#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n",
+             i_version, (i_target + CLOCK_FREQ - 1) / CLOCK_FREQ, i_first );
+    if( p_sys->i_partlen )
+    {
+        fputs( "#EXT-X-PART-INF:PART-TARGET=", stream );
+        PrintDuration( stream, p_sys->i_partlen );
+        fputs( "\n#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=", stream );
+        PrintDuration( stream, 3 * p_sys->i_partlen );
+        fputc( '\n', stream );
+    }
+    if( p_sys->b_fmp4 )
+        fputs( "#EXT-X-MAP:URI=\"init.mp4\"\n", stream );
+
+    for( int i = 0; i < p_sys->i_segments; i++ )
+    {
+        const live_segment_t *seg = p_sys->pp_segments[i];
+
+        if( p_sys->i_partlen && i + LIVE_PARTS_LISTED >= p_sys->i_segments )
+            for( unsigned j = 0; j < seg->i_parts; j++ )
+            {
+                fputs( "#EXT-X-PART:DURATION=", stream );
+                PrintDuration( stream, seg->parts[j].i_duration );
+                fprintf( stream, ",URI=\"part.%s?seq=%"PRIu32"&part=%u\"%s\n",
+                         ext, seg->i_number, j,
+                         seg->parts[j].b_independent ? ",INDEPENDENT=YES"
+                                                     : "" );
+            }
+
+        if( !seg->b_complete )
+            continue;
+
+        fputs( "#EXTINF:", stream );
+        PrintDuration( stream, seg->i_duration );
+        fprintf( stream, ",\nsegment.%s?seq=%"PRIu32"\n", ext, seg->i_number );
+    }
+
+    return MemClose( stream, psz, pi_len );
+}
+
+static void PrintDate( FILE *stream, time_t date )
+{
+    struct tm tm;
+    char buf[sizeof ("YYYY-MM-DDThh:mm:ssZ")];
+
+    gmtime_r( &date, &tm );
+    strftime( buf, sizeof (buf), "%Y-%m-%dT%H:%M:%SZ", &tm );
+    fputs( buf, stream );
+}
+
+static char *Manifest( sout_access_out_sys_t *p_sys, size_t *pi_len )
+{
+    char *psz;
+    FILE *stream = MemOpen( &psz, pi_len );
+    if( stream == NULL )
+        return NULL;
+
+    uint64_t i_bytes = 0;
+    mtime_t i_duration = 0;
+    uint32_t i_first = 0;
+    bool b_first = true;
+
+    for( int i = 0; i < p_sys->i_segments; i++ )
+    {
+        const live_segment_t *seg = p_sys->pp_segments[i];
+        if( !seg->b_complete )
+            continue;
+        if( b_first )
+            i_first = seg->i_number;
+        b_first = false;
+        i_bytes += seg->i_size;
+        i_duration += seg->i_duration;
+    }
+    if( b_first )
+    {   /* nothing to list yet */
+        free( MemClose( stream, psz, pi_len ) );
+        return NULL;
+    }
+
+    fputs( "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+           "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" "
+           "profiles=\"urn:mpeg:dash:profile:isoff-live:2011\" "
+           "type=\"dynamic\" availabilityStartTime=\"", stream );
+    PrintDate( stream, p_sys->i_origin_wall );
+    fputs( "\" publishTime=\"", stream );
+    PrintDate( stream, time( NULL ) );
+    fprintf( stream, "\" minimumUpdatePeriod=\"PT%"PRId64"S\" "
+             "minBufferTime=\"PT%"PRId64"S\" "
+             "timeShiftBufferDepth=\"PT%"PRId64"S\">\n"
+             " <Period id=\"0\" start=\"PT0S\">\n"
+             "  <AdaptationSet mimeType=\"video/mp4\" "
+             "segmentAlignment=\"true\" startWithSAP=\"1\">\n"
+             "   <Representation id=\"0\" bandwidth=\"%"PRIu64"\">\n"
+             "    <SegmentTemplate timescale=\"1000\" "
+             "initialization=\"init.mp4\" "
+             "media=\"segment.m4s?seq=$Number$\" "
+             "startNumber=\"%"PRIu32"\">\n"
+             "     <SegmentTimeline>\n",
+             p_sys->i_seglen / CLOCK_FREQ, p_sys->i_seglen / CLOCK_FREQ,
+             p_sys->i_numsegs * p_sys->i_seglen / CLOCK_FREQ,
+             i_duration > 0 ? i_bytes * 8 * CLOCK_FREQ / i_duration : 0,
+             i_first );
+
+    for( int i = 0; i < p_sys->i_segments; i++ )
+    {
+        const live_segment_t *seg = p_sys->pp_segments[i];
+        if( !seg->b_complete )
+            continue;
+
+        /* derive durations from rounded dates, so that they do not drift */
+        int64_t t = (seg->i_start - p_sys->i_origin) / 1000;
+        int64_t end = (seg->i_start + seg->i_duration - p_sys->i_origin) / 1000;
+        fprintf( stream, "      <S t=\"%"PRId64"\" d=\"%"PRId64"\"/>\n",
+                 t, end - t );
+    }
+
+    fputs( "     </SegmentTimeline>\n"
+           "    </SegmentTemplate>\n"
+           "   </Representation>\n"
+           "  </AdaptationSet>\n"
+           " </Period>\n"
+           "</MPD>\n", stream );
+
+    return MemClose( stream, psz, pi_len );
+}
+
+static int IndexCallback( httpd_callback_sys_t *p_data, httpd_client_t *cl,
+                          httpd_message_t *answer,
+                          const httpd_message_t *query, bool b_mpd )
+{
+    sout_access_out_t *p_access = (sout_access_out_t *)p_data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    char *psz = NULL;
+    size_t i_len = 0;
+    (void) cl;
+
+    if( answer == NULL || query == NULL )
+        return VLC_SUCCESS;
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( p_sys->i_segments > 0 && p_sys->pp_segments[0]->i_parts > 0 )
+        psz = b_mpd ? Manifest( p_sys, &i_len ) : Playlist( p_sys, &i_len );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    if( psz == NULL )
+        Answer( answer, query, 404, NULL, "no-cache", NULL, 0 );
+    else
+        Answer( answer, query, 200, b_mpd ? "application/dash+xml"
+                                          : "application/vnd.apple.mpegurl",
+                "no-cache", (uint8_t *)psz, i_len );
+    return VLC_SUCCESS;
+}
+
+static int PlaylistCallback( httpd_callback_sys_t *p_data, httpd_client_t *cl,
+                             httpd_message_t *answer,
+                             const httpd_message_t *query )
+{
+    return IndexCallback( p_data, cl, answer, query, false );
+}
+
+static int ManifestCallback( httpd_callback_sys_t *p_data, httpd_client_t *cl,
+                             httpd_message_t *answer,
+                             const httpd_message_t *query )
+{
+    return IndexCallback( p_data, cl, answer, query, true );
+}
+
+static int InitCallback( httpd_callback_sys_t *p_data, httpd_client_t *cl,
+                         httpd_message_t *answer, const httpd_message_t *query )
+{
+    sout_access_out_t *p_access = (sout_access_out_t *)p_data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    uint8_t *p_body = NULL;
+    size_t i_body = 0;
+    (void) cl;
+
+    if( answer == NULL || query == NULL )
+        return VLC_SUCCESS;
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( p_sys->p_init != NULL )
+    {
+        i_body = p_sys->p_init->i_buffer;
+        p_body = malloc( i_body );
+        if( p_body != NULL )
+            memcpy( p_body, p_sys->p_init->p_buffer, i_body );
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+
+    if( p_body == NULL )
+        Answer( answer, query, 404, NULL, "no-cache", NULL, 0 );
+    else
+        Answer( answer, query, 200, "video/mp4", "no-cache", p_body, i_body );
+    return VLC_SUCCESS;
+}
+
+static int DataCallback( httpd_callback_sys_t *p_data, httpd_client_t *cl,
+                         httpd_message_t *answer,
+                         const httpd_message_t *query, bool b_part )
+{
+    sout_access_out_t *p_access = (sout_access_out_t *)p_data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    live_segment_t *seg = NULL;
+    unsigned i_seq, i_part = 0, i_first = 0, i_last = 0;
+    (void) cl;
+
+    if( answer == NULL || query == NULL )
+        return VLC_SUCCESS;
+
+    const char *psz_args = (const char *)query->psz_args;
+    if( psz_args == NULL
+     || sscanf( psz_args, b_part ? "seq=%u&part=%u" : "seq=%u",
+                &i_seq, &i_part ) != (b_part ? 2 : 1) )
+    {
+        Answer( answer, query, 400, NULL, "no-cache", NULL, 0 );
+        return VLC_SUCCESS;
+    }
+
+    /* Take a reference and copy outside of the lock. Published parts are
+     * never modified. */
+    vlc_mutex_lock( &p_sys->lock );
+    for( int i = 0; i < p_sys->i_segments; i++ )
+    {
+        live_segment_t *s = p_sys->pp_segments[i];
+        if( s->i_number != i_seq )
+            continue;
+        if( b_part ? i_part < s->i_parts : s->b_complete )
+        {
+            seg = s;
+            atomic_fetch_add( &seg->refs, 1 );
+            i_first = b_part ? i_part : 0;
+            i_last = b_part ? i_part + 1 : s->i_parts;
+        }
+        break;
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+
+    if( seg == NULL )
+    {
+        Answer( answer, query, 404, NULL, "no-cache", NULL, 0 );
+        return VLC_SUCCESS;
+    }
+
+    size_t i_body = 0;
+    for( unsigned i = i_first; i < i_last; i++ )
+        i_body += seg->parts[i].p_data->i_buffer;
+
+    uint8_t *p_body = malloc( i_body );
+    if( p_body != NULL )
+    {
+        size_t i_offset = 0;
+        for( unsigned i = i_first; i < i_last; i++ )
+        {
+            const block_t *p_block = seg->parts[i].p_data;
+            memcpy( p_body + i_offset, p_block->p_buffer, p_block->i_buffer );
+            i_offset += p_block->i_buffer;
+        }
+    }
+    SegmentRelease( seg );
+
+    if( p_body == NULL )
+        Answer( answer, query, 500, NULL, "no-cache", NULL, 0 );
+    else
+        Answer( answer, query, 200, p_sys->b_fmp4 ? "video/iso.segment"
+                                                   : "video/MP2T",
+                "max-age=60", p_body, i_body );
+    return VLC_SUCCESS;
+}
+
+static int SegmentCallback( httpd_callback_sys_t *p_data, httpd_client_t *cl,
+                            httpd_message_t *answer,
+                            const httpd_message_t *query )
+{
+    return DataCallback( p_data, cl, answer, query, false );
+}
+
+static int PartCallback( httpd_callback_sys_t *p_data, httpd_client_t *cl,
+                         httpd_message_t *answer, const httpd_message_t *query )
+{
+    return DataCallback( p_data, cl, answer, query, true );
+}
+
+static httpd_url_t *UrlNew( sout_access_out_t *p_access, const char *psz_name,
+                            httpd_callback_t cb )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    char *psz_url;
+
+    if( asprintf( &psz_url, "%s%s", p_sys->psz_base, psz_name ) == -1 )
+        return NULL;
+
+    httpd_url_t *url = httpd_UrlNew( p_sys->p_host, psz_url, NULL, NULL );
+    if( url == NULL )
+        msg_Err( p_access, "cannot add URL %s", psz_url );
+    else
+    {
+        httpd_UrlCatch( url, HTTPD_MSG_HEAD, cb, (void *)p_access );
+        httpd_UrlCatch( url, HTTPD_MSG_GET, cb, (void *)p_access );
+        msg_Dbg( p_access, "publishing %s", psz_url );
+    }
+    free( psz_url );
+    return url;
+}
+
+/* Registers the URLs, once the stream format is known */
+static int Publish( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    const char *ext = p_sys->b_fmp4 ? "m4s" : "ts";
+    char name[sizeof ("segment.m4s")];
+
+    p_sys->p_url_index = UrlNew( p_access, p_sys->psz_index,
+                                 PlaylistCallback );
+    if( p_sys->p_url_index == NULL )
+        return VLC_EGENERIC;
+
+    snprintf( name, sizeof (name), "segment.%s", ext );
+    p_sys->p_url_segment = UrlNew( p_access, name, SegmentCallback );
+    if( p_sys->i_partlen )
+    {
+        snprintf( name, sizeof (name), "part.%s", ext );
+        p_sys->p_url_part = UrlNew( p_access, name, PartCallback );
+    }
+    if( p_sys->b_fmp4 )
+    {
+        p_sys->p_url_init = UrlNew( p_access, "init.mp4", InitCallback );
+        if( p_sys->b_mpd )
+            p_sys->p_url_mpd = UrlNew( p_access, "manifest.mpd",
+                                       ManifestCallback );
+    }
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Open:
+ *****************************************************************************/
+static int Open( vlc_object_t *p_this )
+{
+    sout_access_out_t       *p_access = (sout_access_out_t*)p_this;
+    sout_access_out_sys_t   *p_sys;
+
+    config_ChainParse( p_access, SOUT_CFG_PREFIX, ppsz_sout_options,
+                       p_access->p_cfg );
+
+    if( !( p_sys = p_access->p_sys = calloc( 1, sizeof( *p_sys ) ) ) )
+        return VLC_ENOMEM;
+
+    /* [host][:port]/path */
+    const char *path = p_access->psz_path;
+    path += strcspn( path, "/" );
+    if( path > p_access->psz_path )
+    {
+        const char *port = strrchr( p_access->psz_path, ':' );
+        if( port != NULL && strchr( port, ']' ) != NULL )
+            port = NULL; /* IPv6 numeral */
+        if( port != NULL && port < path )
+        {
+            int bind_port = atoi( port + 1 );
+            if( bind_port > 0 )
+            {
+                var_Create( p_access, "http-port", VLC_VAR_INTEGER );
+                var_SetInteger( p_access, "http-port", bind_port );
+            }
+        }
+    }
+
+    size_t len = strlen( path );
+    if( asprintf( &p_sys->psz_base, "%s%s%s", (len == 0) ? "/" : "",
+                  path, (len > 0 && path[len - 1] != '/') ? "/" : "" ) == -1 )
+    {
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+
+    p_sys->p_host = vlc_http_HostNew( VLC_OBJECT(p_access) );
+    if( p_sys->p_host == NULL )
+    {
+        msg_Err( p_access, "cannot start HTTP server" );
+        free( p_sys->psz_base );
+        free( p_sys );
+        return VLC_EGENERIC;
+    }
+
+    p_sys->psz_index = var_GetNonEmptyString( p_access,
+                                              SOUT_CFG_PREFIX "index" );
+    if( p_sys->psz_index == NULL )
+        p_sys->psz_index = strdup( "index.m3u8" );
+    p_sys->b_mpd = var_GetBool( p_access, SOUT_CFG_PREFIX "mpd" );
+    p_sys->i_seglen = CLOCK_FREQ
+                    * var_GetInteger( p_access, SOUT_CFG_PREFIX "seglen" );
+    p_sys->i_partlen = INT64_C(1000)
+                     * var_GetInteger( p_access, SOUT_CFG_PREFIX "partlen" );
+    if( p_sys->i_partlen >= p_sys->i_seglen )
+        p_sys->i_partlen = 0;
+    /* leave part slots for segments running past their length */
+    if( p_sys->i_partlen > 0
+     && p_sys->i_partlen < p_sys->i_seglen / (LIVE_MAX_PARTS / 2) )
+    {
+        p_sys->i_partlen = p_sys->i_seglen / (LIVE_MAX_PARTS / 2);
+        msg_Warn( p_access, "partial segments too short, using %"PRId64" ms",
+                  p_sys->i_partlen / 1000 );
+    }
+    p_sys->i_numsegs = var_GetInteger( p_access, SOUT_CFG_PREFIX "numsegs" );
+
+    vlc_mutex_init( &p_sys->lock );
+    p_sys->pp_part_last = &p_sys->p_part;
+    p_sys->i_part_start = VLC_TS_INVALID;
+    p_sys->i_last_date = VLC_TS_INVALID;
+    p_sys->i_origin = VLC_TS_INVALID;
+    p_sys->i_next_number = 1;
+
+    p_access->pf_write       = Write;
+    p_access->pf_seek        = Seek;
+    p_access->pf_control     = Control;
+
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Close:
+ *****************************************************************************/
+static void Close( vlc_object_t * p_this )
+{
+    sout_access_out_t       *p_access = (sout_access_out_t*)p_this;
+    sout_access_out_sys_t   *p_sys = p_access->p_sys;
+
+    /* No callbacks run once the URLs are deleted */
+    httpd_url_t *urls[] = { p_sys->p_url_index, p_sys->p_url_mpd,
+        p_sys->p_url_init, p_sys->p_url_segment, p_sys->p_url_part };
+    for( size_t i = 0; i < sizeof (urls) / sizeof (urls[0]); i++ )
+        if( urls[i] != NULL )
+            httpd_UrlDelete( urls[i] );
+    httpd_HostDelete( p_sys->p_host );
+
+    block_ChainRelease( p_sys->p_part );
+    if( p_sys->p_pending != NULL )
+        block_Release( p_sys->p_pending );
+    for( int i = 0; i < p_sys->i_segments; i++ )
+        SegmentRelease( p_sys->pp_segments[i] );
+    free( p_sys->pp_segments );
+    if( p_sys->p_init != NULL )
+        block_Release( p_sys->p_init );
+    vlc_mutex_destroy( &p_sys->lock );
+
+    free( p_sys->psz_index );
+    free( p_sys->psz_base );
+    free( p_sys );
+}
+
+static int Control( sout_access_out_t *p_access, int i_query, va_list args )
+{
+    (void)p_access;
+
+    switch( i_query )
+    {
+        case ACCESS_OUT_CONTROLS_PACE:
+            *va_arg( args, bool * ) = false;
+            break;
+
+        default:
+            return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Write:
+ *****************************************************************************/
+static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    ssize_t i_len = 0;
+
+    while( p_buffer )
+    {
+        block_t *p_next = p_buffer->p_next;
+        p_buffer->p_next = NULL;
+        i_len += p_buffer->i_buffer;
+
+        if( !p_sys->b_format_known )
+        {
+            p_sys->b_fmp4 = p_buffer->i_buffer >= 8
+                         && !memcmp( p_buffer->p_buffer + 4, "ftyp", 4 );
+            p_sys->b_format_known = true;
+            msg_Dbg( p_access, "packaging %s segments",
+                     p_sys->b_fmp4 ? "fragmented MP4" : "MPEG-TS" );
+            if( Publish( p_access ) )
+            {
+                block_ChainRelease( p_buffer );
+                return -1;
+            }
+        }
+
+        if( p_sys->b_fmp4 && (p_buffer->i_flags & BLOCK_FLAG_HEADER) )
+        {   /* initialization segment, served apart */
+            vlc_mutex_lock( &p_sys->lock );
+            if( p_sys->p_init != NULL )
+                block_Release( p_sys->p_init );
+            p_sys->p_init = p_buffer;
+            vlc_mutex_unlock( &p_sys->lock );
+            p_buffer = p_next;
+            continue;
+        }
+
+        /* Random access points: PAT/PMT before a key frame in MPEG-TS,
+         * fragment headers in MP4 */
+        bool b_rap = p_buffer->i_flags & (p_sys->b_fmp4 ? BLOCK_FLAG_TYPE_I
+                                                        : BLOCK_FLAG_HEADER);
+        /* MP4 fragments can only be split at their boundaries */
+        bool b_splittable = b_rap || !p_sys->b_fmp4;
+
+        if( p_sys->p_part != NULL && !p_sys->b_pending
+         && p_sys->i_part_start != VLC_TS_INVALID )
+        {
+            mtime_t i_seg_start = p_sys->p_current != NULL
+                                ? p_sys->p_current->i_start
+                                : p_sys->i_part_start;
+
+            if( b_rap
+             && p_sys->i_last_date - i_seg_start >= p_sys->i_seglen )
+                ClosePart( p_access, true );
+            /* Segments end on random access points only: the last part
+             * grows until then once the segment is out of part slots. */
+            else if( p_sys->i_partlen && b_splittable
+             && p_sys->i_last_date - p_sys->i_part_start >= p_sys->i_partlen
+             && (p_sys->p_current == NULL
+              || p_sys->p_current->i_parts + 2 <= LIVE_MAX_PARTS) )
+                ClosePart( p_access, false );
+        }
+
+        if( p_buffer->i_dts > VLC_TS_INVALID )
+        {
+            /* the previous part ends where this one starts */
+            PublishPending( p_access, p_buffer->i_dts );
+
+            if( p_sys->i_part_start == VLC_TS_INVALID )
+                p_sys->i_part_start = p_buffer->i_dts;
+            if( p_sys->i_origin == VLC_TS_INVALID )
+            {
+                p_sys->i_origin = p_buffer->i_dts;
+                p_sys->i_origin_wall = time( NULL );
+            }
+
+            mtime_t i_end = p_buffer->i_dts + __MAX( p_buffer->i_length, 0 );
+            if( i_end > p_sys->i_last_date )
+                p_sys->i_last_date = i_end;
+        }
+
+        if( p_sys->p_part == NULL )
+            p_sys->b_part_independent = b_rap;
+
+        *p_sys->pp_part_last = p_buffer;
+        p_sys->pp_part_last = &p_buffer->p_next;
+        p_buffer = p_next;
+    }
+
+    return i_len;
+}
+
+/*****************************************************************************
+ * Seek: seek to a specific location in a file
+ *****************************************************************************/
+static int Seek( sout_access_out_t *p_access, off_t i_pos )
+{
+    (void)i_pos;
+    msg_Warn( p_access, "livehttpd sout access cannot seek" );
+    return VLC_EGENERIC;
+}
@@ -49,6 +49,8 @@
 
 #include <vlc_network.h>
 
+#include "udp_pacer.h"
+
 #define MAX_EMPTY_BLOCKS 200
 
 /*****************************************************************************
@@ -70,6 +72,10 @@ static void Close( vlc_object_t * );
                           "of packets that will be sent at a time. It " \
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
+#define WINDOW_TEXT N_("Batching window (ms)")
+#define WINDOW_LONGTEXT N_("Packets due within this delay are sent " \
+                           "together, with as few system calls as " \
+                           "possible. With 0, only packets of a same date are grouped." )
 
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
@@ -79,6 +85,8 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+    add_integer( SOUT_CFG_PREFIX "window", UDP_PACER_WINDOW / 1000,
+                 WINDOW_TEXT, WINDOW_LONGTEXT, true )
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -92,6 +100,7 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+    "window",
     NULL
 };
 
@@ -121,6 +130,7 @@ struct sout_access_out_sys_t
     block_fifo_t *p_empty_blocks;
     block_t      *p_buffer;
 
+    udp_pacer_t   pacer;
     vlc_thread_t  thread;
 };
 
@@ -213,6 +223,10 @@ static int Open( vlc_object_t *p_this )
     p_sys->p_fifo = block_FifoNew();
     p_sys->p_empty_blocks = block_FifoNew();
     p_sys->p_buffer = NULL;
+    udp_pacer_Init( &p_sys->pacer, VLC_OBJECT(p_access),
+                    UINT64_C(1000)
+                    * var_GetInteger( p_access, SOUT_CFG_PREFIX "window" ),
+                    var_GetInteger( p_access, SOUT_CFG_PREFIX "group" ) );
 
     if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
                            VLC_THREAD_PRIORITY_HIGHEST ) )
@@ -242,6 +256,7 @@ static void Close( vlc_object_t * p_this )
 
     vlc_cancel( p_sys->thread );
     vlc_join( p_sys->thread, NULL );
+    udp_pacer_Clean( &p_sys->pacer );
     block_FifoRelease( p_sys->p_fifo );
     block_FifoRelease( p_sys->p_empty_blocks );
 
@@ -393,56 +408,65 @@ static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
 }
 
 /*****************************************************************************
- * ThreadWrite: Write a packet on the network at the good time.
+ * ThreadWrite: Write packets on the network at the good time.
  *****************************************************************************/
 static void* ThreadWrite( void *data )
 {
     sout_access_out_t *p_access = data;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
+    udp_pacer_t *p_pacer = &p_sys->pacer;
     mtime_t i_date_last = -1;
-    const unsigned i_group = var_GetInteger( p_access,
-                                             SOUT_CFG_PREFIX "group" );
-    mtime_t i_to_send = i_group;
     unsigned i_dropped_packets = 0;
 
     for (;;)
     {
-        block_t *p_pk = block_FifoGet( p_sys->p_fifo );
-        mtime_t       i_date, i_sent;
+        mtime_t i_due = udp_pacer_Collect( p_pacer, p_sys->p_fifo,
+                                           p_sys->i_caching );
+        int canc = vlc_savecancel();
+        unsigned i_count = 0;
 
-        i_date = p_sys->i_caching + p_pk->i_dts;
-        if( i_date_last > 0 )
+        for( unsigned i = 0; i < p_pacer->count; i++ )
         {
-            if( i_date - i_date_last > 2000000 )
+            block_t *p_pk = p_pacer->pkts[i];
+            mtime_t i_date = p_sys->i_caching + p_pk->i_dts;
+
+            if( i_date_last > 0 )
             {
-                if( !i_dropped_packets )
-                    msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
-                             i_date - i_date_last );
+                if( i_date - i_date_last > 2000000 )
+                {
+                    if( !i_dropped_packets )
+                        msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
+                                 i_date - i_date_last );
 
-                block_FifoPut( p_sys->p_empty_blocks, p_pk );
+                    block_FifoPut( p_sys->p_empty_blocks, p_pk );
 
-                i_date_last = i_date;
-                i_dropped_packets++;
-                continue;
-            }
-            else if( i_date - i_date_last < -1000 )
-            {
-                if( !i_dropped_packets )
-                    msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
-                             i_date_last - i_date );
+                    i_date_last = i_date;
+                    i_dropped_packets++;
+                    continue;
+                }
+                else if( i_date - i_date_last < -1000 )
+                {
+                    if( !i_dropped_packets )
+                        msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
+                                 i_date_last - i_date );
+                }
             }
-        }
 
-        block_cleanup_push( p_pk );
-        i_to_send--;
-        if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
-        {
-            mwait( i_date );
-            i_to_send = i_group;
+            if( i_count == 0 )
+                i_due = i_date;
+            p_pacer->pkts[i_count++] = p_pk;
+            i_date_last = i_date;
         }
-        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
-            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
-        vlc_cleanup_pop();
+        p_pacer->count = i_count;
+        vlc_restorecancel( canc );
+
+        if( i_count == 0 )
+            continue;
+
+        mwait( i_due );
+
+        canc = vlc_savecancel();
+        udp_pacer_Send( p_pacer, p_sys->i_handle, true );
 
         if( i_dropped_packets )
         {
@@ -450,18 +474,8 @@ static void* ThreadWrite( void *data )
             i_dropped_packets = 0;
         }
 
-#if 1
-        i_sent = mdate();
-        if ( i_sent > i_date + 20000 )
-        {
-            msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
-                     i_sent - i_date );
-        }
-#endif
-
-        block_FifoPut( p_sys->p_empty_blocks, p_pk );
-
-        i_date_last = i_date;
+        udp_pacer_Flush( p_pacer, i_due, p_sys->p_empty_blocks );
+        vlc_restorecancel( canc );
     }
     return NULL;
 }
@@ -0,0 +1,304 @@
+/*****************************************************************************
+ * udp_pacer.c: paced and batched datagram transmission
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_network.h>
+
+#ifdef _WIN32
+# include <winsock2.h>
+# define ENOBUFS      WSAENOBUFS
+# define EAGAIN       WSAEWOULDBLOCK
+# define EWOULDBLOCK  WSAEWOULDBLOCK
+#else
+# include <sys/socket.h>
+#endif
+#ifdef HAVE_SENDMMSG
+# include <netinet/udp.h>
+#endif
+
+#include "udp_pacer.h"
+
+#define UDP_PACER_REPORT (10 * CLOCK_FREQ)
+#define UDP_PACER_LATE   20000
+#define UDP_GSO_MAX      65000 /* bytes in a segmented datagram */
+
+#if defined (HAVE_SENDMMSG) && defined (UDP_SEGMENT)
+# define HAVE_GSO 1
+#endif
+
+void udp_pacer_Init(udp_pacer_t *p, vlc_object_t *obj, mtime_t window,
+                    unsigned group)
+{
+    p->obj = obj;
+    p->window = window;
+    p->group = group ? group : 1;
+#ifdef HAVE_GSO
+    p->gso = true;
+#else
+    p->gso = false;
+#endif
+    p->next = NULL;
+    p->count = 0;
+    memset(&p->stats, 0, sizeof (p->stats));
+    p->stats.start = mdate();
+}
+
+static void Report(udp_pacer_t *p, mtime_t now)
+{
+    mtime_t elapsed = now - p->stats.start;
+
+    if (elapsed <= 0 || p->stats.batches == 0)
+        return;
+
+    msg_Dbg(p->obj, "sent %"PRIu64" kb/s, %"PRIu64" packets in %"PRIu64
+            " batches and %"PRIu64" datagrams, %"PRIu64" errors, "
+            "pacing error %"PRId64" us (max %"PRId64" us)",
+            p->stats.bytes * 8 * CLOCK_FREQ / elapsed / 1000,
+            p->stats.packets, p->stats.batches, p->stats.datagrams,
+            p->stats.errors, p->stats.late_sum / (mtime_t)p->stats.batches,
+            p->stats.late_max);
+}
+
+void udp_pacer_Clean(udp_pacer_t *p)
+{
+    Report(p, mdate());
+
+    for (unsigned i = 0; i < p->count; i++)
+        block_Release(p->pkts[i]);
+    if (p->next != NULL)
+        block_Release(p->next);
+}
+
+mtime_t udp_pacer_Collect(udp_pacer_t *p, block_fifo_t *fifo, mtime_t delay)
+{
+    block_t *pkt = p->next;
+
+    assert(p->count == 0);
+    if (pkt == NULL)
+        pkt = block_FifoGet(fifo); /* cancellation point */
+    p->next = NULL;
+    p->pkts[p->count++] = pkt;
+
+    const mtime_t due = pkt->i_dts + delay;
+
+    vlc_fifo_Lock(fifo);
+    while (p->count < UDP_PACER_BATCH)
+    {
+        pkt = vlc_fifo_DequeueUnlocked(fifo);
+        if (pkt == NULL)
+            break;
+
+        /* Clock references are sent on time: they only start batches */
+        if ((pkt->i_flags & BLOCK_FLAG_CLOCK)
+         || (p->count >= p->group && pkt->i_dts + delay > due + p->window))
+        {
+            p->next = pkt;
+            break;
+        }
+        p->pkts[p->count++] = pkt;
+    }
+    vlc_fifo_Unlock(fifo);
+
+    return due;
+}
+
+/**
+ * Accounts a failure to send a datagram.
+ * @return -1 if the socket is broken, 1 if the datagram should be sent
+ * again, 0 if it should be dropped
+ */
+static int SendError(udp_pacer_t *p, bool dgram, int err)
+{
+    p->stats.errors++;
+
+    switch (err)
+    {
+        case EAGAIN:
+#if (EAGAIN != EWOULDBLOCK)
+        case EWOULDBLOCK:
+#endif
+        case ENOBUFS:
+        case ENOMEM:
+            return 0; /* congestion: drop */
+    }
+    if (!dgram)
+        return -1;
+
+    /* ICMP soft error: ignore and retry */
+    msg_Warn(p->obj, "send error: %s", vlc_strerror_c(err));
+    return 1;
+}
+
+int udp_pacer_Send(udp_pacer_t *p, int fd, bool dgram)
+{
+    unsigned i = 0;
+
+#ifdef HAVE_SENDMMSG
+    struct iovec iovs[UDP_PACER_BATCH];
+    struct mmsghdr msgs[UDP_PACER_BATCH];
+    unsigned first[UDP_PACER_BATCH + 1];
+# ifdef HAVE_GSO
+    union
+    {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof (uint16_t))];
+    } cmsgs[UDP_PACER_BATCH];
+# endif
+
+    for (unsigned j = 0; j < p->count; j++)
+    {
+        iovs[j].iov_base = p->pkts[j]->p_buffer;
+        iovs[j].iov_len = p->pkts[j]->i_buffer;
+    }
+
+    while (i < p->count)
+    {
+        unsigned n = 0;
+
+        /* Packets of equal sizes are sent as one segmented datagram, only
+         * the last segment may be shorter. */
+        for (unsigned j = i; j < p->count; n++)
+        {
+            size_t size = iovs[j].iov_len, total = size;
+            unsigned segs = 1;
+
+            if (p->gso && dgram && size > 0)
+                while (j + segs < p->count
+                    && iovs[j + segs - 1].iov_len == size
+                    && iovs[j + segs].iov_len <= size
+                    && total + iovs[j + segs].iov_len <= UDP_GSO_MAX)
+                    total += iovs[j + segs++].iov_len;
+
+            first[n] = j;
+            msgs[n].msg_hdr = (struct msghdr) {
+                .msg_iov = iovs + j,
+                .msg_iovlen = segs,
+            };
+# ifdef HAVE_GSO
+            if (segs > 1)
+            {
+                struct cmsghdr *cmsg = &cmsgs[n].hdr;
+
+                cmsg->cmsg_level = IPPROTO_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof (uint16_t));
+                memcpy(CMSG_DATA(cmsg), &(uint16_t){ size },
+                       sizeof (uint16_t));
+                msgs[n].msg_hdr.msg_control = cmsgs[n].buf;
+                msgs[n].msg_hdr.msg_controllen = sizeof (cmsgs[n].buf);
+            }
+# endif
+            j += segs;
+        }
+        first[n] = p->count;
+
+        int val = sendmmsg(fd, msgs, n, 0);
+        if (val > 0)
+        {
+            p->stats.datagrams += val;
+            i = first[val];
+            continue;
+        }
+
+        int err = errno;
+# ifdef HAVE_GSO
+        if (msgs[0].msg_hdr.msg_controllen > 0
+         && (err == EIO || err == EINVAL || err == ENOPROTOOPT))
+        {
+            msg_Dbg(p->obj, "segmentation offload unavailable: %s",
+                    vlc_strerror_c(err));
+            p->gso = false;
+            continue;
+        }
+# endif
+        val = SendError(p, dgram, err);
+        if (val < 0)
+            return -1;
+        if (val > 0 && sendmsg(fd, &msgs[0].msg_hdr, 0) != -1)
+            p->stats.datagrams++;
+        i = first[1];
+    }
+#else
+    for (; i < p->count; i++)
+    {
+        const block_t *pkt = p->pkts[i];
+
+        if (send(fd, pkt->p_buffer, pkt->i_buffer, 0) != -1)
+        {
+            p->stats.datagrams++;
+            continue;
+        }
+
+        int val = SendError(p, dgram, net_errno);
+        if (val < 0)
+            return -1;
+        if (val > 0 && send(fd, pkt->p_buffer, pkt->i_buffer, 0) != -1)
+            p->stats.datagrams++;
+    }
+#endif
+    return 0;
+}
+
+void udp_pacer_Flush(udp_pacer_t *p, mtime_t due, block_fifo_t *recycle)
+{
+    mtime_t now = mdate();
+    mtime_t late = now - due;
+
+    if (late > UDP_PACER_LATE)
+        msg_Dbg(p->obj, "packet has been sent too late (%"PRId64")", late);
+    if (late < 0)
+        late = 0;
+
+    p->stats.batches++;
+    p->stats.late_sum += late;
+    if (late > p->stats.late_max)
+        p->stats.late_max = late;
+
+    for (unsigned i = 0; i < p->count; i++)
+    {
+        block_t *pkt = p->pkts[i];
+
+        p->stats.packets++;
+        p->stats.bytes += pkt->i_buffer;
+        if (recycle != NULL)
+            block_FifoPut(recycle, pkt);
+        else
+            block_Release(pkt);
+    }
+    p->count = 0;
+
+    if (now - p->stats.start >= UDP_PACER_REPORT)
+    {
+        Report(p, now);
+        memset(&p->stats, 0, sizeof (p->stats));
+        p->stats.start = now;
+    }
+}
@@ -0,0 +1,85 @@
+/*****************************************************************************
+ * udp_pacer.h: paced and batched datagram transmission
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_UDP_PACER_H
+#define VLC_UDP_PACER_H 1
+
+#define UDP_PACER_BATCH  64
+#define UDP_PACER_WINDOW 0 /* default batching window (us): same date only */
+
+/**
+ * Sending thread state. The packets queued by the producer are dated with
+ * i_dts. Packets due at most window after the first one of a batch are sent
+ * together with a single system call when possible.
+ *
+ * The pacer is owned by the sending thread; packets it holds are released
+ * by udp_pacer_Clean() once the thread is joined.
+ */
+typedef struct udp_pacer
+{
+    vlc_object_t *obj;
+    mtime_t window;
+    unsigned group; /**< packets sent together regardless of their dates */
+    bool gso; /**< segmentation offload still usable */
+
+    block_t *next; /**< dequeued but not part of the batch */
+    unsigned count;
+    block_t *pkts[UDP_PACER_BATCH]; /**< current batch */
+
+    struct
+    {
+        uint64_t packets;
+        uint64_t bytes;
+        uint64_t batches;
+        uint64_t datagrams; /* system level messages, fewer with GSO */
+        uint64_t errors;
+        mtime_t late_sum;
+        mtime_t late_max;
+        mtime_t start;
+    } stats;
+} udp_pacer_t;
+
+void udp_pacer_Init(udp_pacer_t *, vlc_object_t *, mtime_t window,
+                    unsigned group);
+void udp_pacer_Clean(udp_pacer_t *);
+
+/**
+ * Waits for a packet and gathers the packets due with it into the batch.
+ * This is a cancellation point.
+ * @param delay added to the packets dates
+ * @return the date the batch is due
+ */
+mtime_t udp_pacer_Collect(udp_pacer_t *, block_fifo_t *, mtime_t delay);
+
+/**
+ * Sends the batch to a connected socket.
+ * Datagrams that could not be sent are accounted and dropped.
+ * @param dgram whether the socket is a datagram socket
+ * @return 0 on success, -1 if a stream socket is broken.
+ */
+int udp_pacer_Send(udp_pacer_t *, int fd, bool dgram);
+
+/**
+ * Accounts the batch as sent and empties it.
+ * @param recycle FIFO to put the packets back to, or NULL to release them
+ */
+void udp_pacer_Flush(udp_pacer_t *, mtime_t due, block_fifo_t *recycle);
+
+#endif
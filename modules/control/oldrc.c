@@ -1749,6 +1749,15 @@ static int updateStatistics( intf_thread_t *p_intf, input_item_t *p_item )
             p_item->p_stats->i_demux_corrupted );
     msg_rc(_("| discontinuities  :    %5"PRIi64),
             p_item->p_stats->i_demux_discontinuity );
+    if( p_item->p_stats->i_stream_hits + p_item->p_stats->i_stream_misses > 0 )
+    {
+        msg_rc(_("| read-ahead hits  :    %5"PRIi64),
+                p_item->p_stats->i_stream_hits );
+        msg_rc(_("| read-ahead miss  :    %5"PRIi64),
+                p_item->p_stats->i_stream_misses );
+        msg_rc(_("| read-ahead stall :    %5"PRIi64" ms"),
+                p_item->p_stats->i_stream_stall / 1000 );
+    }
     msg_rc("|");
     /* Video */
     msg_rc("%s", _("+-[Video Decoding]"));
@@ -1776,6 +1785,23 @@ static int updateStatistics( intf_thread_t *p_intf, input_item_t *p_item )
             (float)(p_item->p_stats->i_sent_bytes)/1024 );
     msg_rc(_("| sending bitrate  :   %6.0f kb/s"),
             (float)(p_item->p_stats->f_send_bitrate*8)*1000 );
+    msg_rc(_("| pictures queued  :    %5"PRIi64),
+           p_item->p_stats->i_sout_pipeline_depth );
+    msg_rc(_("| decoding time    : %8.3f s"),
+           (float)p_item->p_stats->i_sout_decode_time / CLOCK_FREQ );
+    msg_rc(_("| filtering time   : %8.3f s"),
+           (float)p_item->p_stats->i_sout_filter_time / CLOCK_FREQ );
+    msg_rc(_("| encoding time    : %8.3f s"),
+           (float)p_item->p_stats->i_sout_encode_time / CLOCK_FREQ );
+    msg_rc("|");
+    /* Memory */
+    msg_rc("%s", _("+-[Data blocks]"));
+    msg_rc(_("| pool hits        :    %5"PRIi64),
+           p_item->p_stats->i_block_pool_hits );
+    msg_rc(_("| pool misses      :    %5"PRIi64),
+           p_item->p_stats->i_block_pool_misses );
+    msg_rc(_("| pool retained    : %8.0f KiB"),
+            (float)(p_item->p_stats->i_block_pool_retained)/1024 );
     msg_rc("|");
     msg_rc( "+----[ end of statistical info ]" );
     vlc_mutex_unlock( &p_item->p_stats->lock );
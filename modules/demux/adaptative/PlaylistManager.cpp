@@ -33,6 +33,7 @@
 #include "logic/AlwaysBestAdaptationLogic.h"
 #include "logic/RateBasedAdaptationLogic.h"
 #include "logic/AlwaysLowestAdaptationLogic.hpp"
+#include "logic/BufferBasedAdaptationLogic.h"
 #include <vlc_stream.h>
 #include <vlc_demux.h>
 
@@ -59,9 +60,10 @@ PlaylistManager::PlaylistManager( demux_t *p_demux_,
 
 PlaylistManager::~PlaylistManager   ()
 {
+    /* streams release their chunks to the connections */
+    unsetPeriod();
     delete conManager;
     delete streamOutputFactory;
-    unsetPeriod();
 }
 
 void PlaylistManager::unsetPeriod()
@@ -408,6 +410,8 @@ AbstractAdaptationLogic *PlaylistManager::createLogic(AbstractAdaptationLogic::L
         case AbstractAdaptationLogic::Default:
         case AbstractAdaptationLogic::RateBased:
             return new (std::nothrow) RateBasedAdaptationLogic(0, 0);
+        case AbstractAdaptationLogic::BufferBased:
+            return new (std::nothrow) BufferBasedAdaptationLogic(0, 0);
         default:
             return NULL;
     }
@@ -21,6 +21,7 @@
 #include "StreamsType.hpp"
 #include "http/HTTPConnection.hpp"
 #include "http/HTTPConnectionManager.h"
+#include "http/Downloader.hpp"
 #include "logic/AbstractAdaptationLogic.h"
 #include "playlist/SegmentChunk.hpp"
 #include "SegmentTracker.hpp"
@@ -43,10 +44,19 @@ Stream::Stream(demux_t * demux_, const StreamFormat &format_)
     disabled = false;
     segmentTracker = NULL;
     streamOutputFactory = NULL;
+    prefetchedHead = false;
+    prefetchCount = var_InheritInteger(p_demux, "adaptative-prefetch");
+    prefetchDuration = CLOCK_FREQ *
+                       var_InheritInteger(p_demux, "adaptative-prefetch-buffer");
+    segmentDuration = 0;
+    downloader = NULL;
 }
 
 Stream::~Stream()
 {
+    dropPrefetched(false);
+    if(currentChunk && currentChunk->getConnection())
+        currentChunk->getConnection()->releaseChunk();
     delete currentChunk;
     delete adaptationLogic;
     delete output;
@@ -210,6 +220,14 @@ Stream::status Stream::demux(HTTPConnectionManager *connManager, mtime_t nz_dead
 
 size_t Stream::read(HTTPConnectionManager *connManager)
 {
+    if(prefetchCount > 0 && currentChunk == NULL)
+    {
+        if(downloader == NULL)
+            downloader = connManager->getDownloader();
+        if(downloader)
+            return readPrefetched();
+    }
+
     SegmentChunk *chunk = getChunk();
     if(!chunk)
         return 0;
@@ -290,6 +308,155 @@ size_t Stream::read(HTTPConnectionManager *connManager)
     return readsize;
 }
 
+/* Schedules the next chunks, up to prefetchCount of them, and not further
+ * than prefetchDuration ahead of what has been demuxed */
+void Stream::prefetch()
+{
+    while(prefetched.size() < prefetchCount)
+    {
+        const mtime_t pcr = output->getPCR();
+        const mtime_t start = segmentTracker->getSegmentStart();
+        if(!prefetched.empty() && pcr > VLC_TS_INVALID &&
+           start - (pcr - VLC_TS_0) > prefetchDuration)
+            break;
+
+        mtime_t target = prefetchCount * segmentDuration;
+        if(target > prefetchDuration)
+            target = prefetchDuration;
+        adaptationLogic->updateBufferLevel(getBufferLevel(), target);
+
+        SegmentChunk *chunk = segmentTracker->getNextChunk(output->switchAllowed());
+        if(chunk == NULL)
+        {
+            eof = true;
+            break;
+        }
+        /* the downloader serves the stream the least ahead first */
+        downloader->schedule(chunk, adaptationLogic, start);
+        prefetched.push_back(chunk);
+
+        const mtime_t end = segmentTracker->getSegmentStart();
+        prefetchedEnd.push_back(end);
+        if(end > start) /* not an init or index chunk */
+            segmentDuration = end - start;
+    }
+}
+
+/* Duration of the completely downloaded media ahead of the demuxer */
+mtime_t Stream::getBufferLevel() const
+{
+    const mtime_t pcr = output->getPCR();
+    if(pcr <= VLC_TS_INVALID)
+        return 0;
+
+    mtime_t level = 0;
+    std::list<SegmentChunk *>::const_iterator it = prefetched.begin();
+    std::list<mtime_t>::const_iterator endit = prefetchedEnd.begin();
+    for(; it != prefetched.end(); ++it, ++endit)
+    {
+        if(!downloader->isCompleted(*it))
+            break;
+        level = *endit - (pcr - VLC_TS_0);
+    }
+
+    return (level > 0) ? level : 0;
+}
+
+void Stream::dropPrefetched(bool b_keep_current)
+{
+    while(prefetched.size() > (b_keep_current ? 1 : 0))
+    {
+        SegmentChunk *chunk = prefetched.back();
+        prefetched.pop_back();
+        prefetchedEnd.pop_back();
+        downloader->cancel(chunk);
+        delete chunk;
+    }
+}
+
+void Stream::pushBlock(SegmentChunk *chunk, block_t *block, bool b_segment_head_chunk)
+{
+    /* as if the chunk was read synchronously */
+    chunk->setBytesRead(chunk->getBytesRead() + block->i_buffer);
+    chunk->onDownload(&block);
+
+    StreamFormat chunkStreamFormat = chunk->getStreamFormat();
+    if(output && chunkStreamFormat != output->getStreamFormat())
+    {
+        msg_Info(p_demux, "Changing stream format");
+        updateFormat(chunkStreamFormat);
+    }
+
+    if(output)
+        output->pushBlock(block, b_segment_head_chunk);
+    else
+        block_Release(block);
+}
+
+size_t Stream::readPrefetched()
+{
+    if(prefetched.empty())
+    {
+        if(output && esCount() && !isSelected())
+        {
+            disabled = true;
+            return 0;
+        }
+        prefetchedHead = true;
+    }
+
+    if(output)
+        prefetch();
+
+    while(!prefetched.empty())
+    {
+        SegmentChunk *chunk = prefetched.front();
+        bool b_done;
+
+        block_t *p_blocks = downloader->read(chunk, &b_done);
+        if(p_blocks)
+        {
+            size_t readsize = 0;
+            while(p_blocks)
+            {
+                block_t *block = p_blocks;
+                p_blocks = block->p_next;
+                block->p_next = NULL;
+
+                readsize += block->i_buffer;
+                pushBlock(chunk, block, prefetchedHead);
+                prefetchedHead = false;
+            }
+            return readsize;
+        }
+        else if(!b_done)
+        {
+            return 0; /* interrupted */
+        }
+
+        /* End of the chunk */
+        const bool b_complete = chunk->getLength() > 0 &&
+                                chunk->getBytesToRead() == 0;
+        prefetched.pop_front();
+        prefetchedEnd.pop_front();
+        delete chunk;
+        prefetchedHead = true;
+        if(!b_complete)
+            return 0;
+
+        if(output && esCount() && !isSelected())
+        {
+            disabled = true;
+            dropPrefetched(false);
+            return 0;
+        }
+        if(output)
+            prefetch();
+    }
+
+    return 0;
+}
+
 bool Stream::setPosition(mtime_t time, bool tryonly)
 {
     if(!output)
@@ -299,6 +466,7 @@ bool Stream::setPosition(mtime_t time, bool tryonly)
     if(!tryonly && ret)
     {
         output->setPosition(time);
+        dropPrefetched(!output->reinitsOnSeek());
         if(output->reinitsOnSeek())
         {
             if(currentChunk)
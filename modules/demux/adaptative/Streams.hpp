@@ -38,6 +38,7 @@ namespace adaptative
     namespace http
     {
         class HTTPConnectionManager;
+        class Downloader;
     }
 
     namespace logic
@@ -88,6 +89,11 @@ namespace adaptative
     private:
         SegmentChunk *getChunk();
         size_t read(HTTPConnectionManager *);
+        size_t readPrefetched();
+        void prefetch();
+        void dropPrefetched(bool);
+        mtime_t getBufferLevel() const;
+        void pushBlock(SegmentChunk *, block_t *, bool);
         demux_t *p_demux;
         StreamType type;
         StreamFormat format;
@@ -95,6 +101,13 @@ namespace adaptative
         AbstractAdaptationLogic *adaptationLogic;
         SegmentTracker *segmentTracker;
         SegmentChunk *currentChunk;
+        std::list<SegmentChunk *> prefetched; /* being downloaded, oldest first */
+        std::list<mtime_t> prefetchedEnd; /* playback time at the end of each */
+        bool prefetchedHead;
+        unsigned prefetchCount;
+        mtime_t prefetchDuration;
+        mtime_t segmentDuration;
+        Downloader *downloader;
         bool disabled;
         bool eof;
         std::string language;
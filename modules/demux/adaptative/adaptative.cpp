@@ -67,15 +67,26 @@ static void Close   (vlc_object_t *);
 
 #define ADAPT_LOGIC_TEXT N_("Adaptation Logic")
 
+#define ADAPT_PREFETCH_TEXT N_("Prefetched segments")
+#define ADAPT_PREFETCH_LONGTEXT N_("Number of segments downloaded ahead of " \
+    "playback in the background, per stream. 0 downloads each segment when " \
+    "it is needed.")
+
+#define ADAPT_PREFETCH_BUF_TEXT N_("Prefetch buffer (seconds)")
+#define ADAPT_PREFETCH_BUF_LONGTEXT N_("Segments are not prefetched further " \
+    "than this duration ahead of playback.")
+
 static const int pi_logics[] = {AbstractAdaptationLogic::RateBased,
                                 AbstractAdaptationLogic::FixedRate,
                                 AbstractAdaptationLogic::AlwaysLowest,
-                                AbstractAdaptationLogic::AlwaysBest};
+                                AbstractAdaptationLogic::AlwaysBest,
+                                AbstractAdaptationLogic::BufferBased};
 
 static const char *const ppsz_logics[] = { N_("Bandwidth Adaptive"),
                                            N_("Fixed Bandwidth"),
                                            N_("Lowest Bandwidth/Quality"),
-                                           N_("Highest Bandwith/Quality")};
+                                           N_("Highest Bandwith/Quality"),
+                                           N_("Buffer Based")};
 
 vlc_module_begin ()
         set_shortname( N_("Adaptative"))
@@ -89,6 +100,12 @@ vlc_module_begin ()
         add_integer( "adaptative-width",  480, ADAPT_WIDTH_TEXT,  ADAPT_WIDTH_TEXT,  true )
         add_integer( "adaptative-height", 360, ADAPT_HEIGHT_TEXT, ADAPT_HEIGHT_TEXT, true )
         add_integer( "adaptative-bw",     250, ADAPT_BW_TEXT,     ADAPT_BW_LONGTEXT,     false )
+        add_integer( "adaptative-prefetch", 3, ADAPT_PREFETCH_TEXT,
+                     ADAPT_PREFETCH_LONGTEXT, true )
+            change_integer_range( 0, 16 )
+        add_integer( "adaptative-prefetch-buffer", 30, ADAPT_PREFETCH_BUF_TEXT,
+                     ADAPT_PREFETCH_BUF_LONGTEXT, true )
+            change_integer_range( 1, 600 )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
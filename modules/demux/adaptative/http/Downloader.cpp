@@ -0,0 +1,343 @@
+/*
+ * Downloader.cpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Downloader.hpp"
+#include "HTTPConnectionManager.h"
+#include "HTTPConnection.hpp"
+#include "Chunk.h"
+#include "../logic/IDownloadRateObserver.h"
+
+#include <vlc_block.h>
+
+using namespace adaptative::http;
+
+Downloader::Job::Job(Chunk *chunk_, Chunk *dlchunk_,
+                     IDownloadRateObserver *observer_, mtime_t start_)
+{
+    chunk = chunk_;
+    dlchunk = dlchunk_;
+    observer = observer_;
+    start = start_;
+    length = 0;
+    p_data = NULL;
+    pp_last = &p_data;
+    done = false;
+    cancelled = false;
+}
+
+Downloader::Job::~Job()
+{
+    block_ChainRelease(p_data);
+    delete dlchunk;
+}
+
+Downloader::Downloader(vlc_object_t *obj_, HTTPConnectionManager *manager)
+{
+    obj = obj_;
+    connManager = manager;
+    current = NULL;
+    interrupt = NULL;
+    waiting = false;
+    started = false;
+    killed = false;
+    vlc_mutex_init(&lock);
+    vlc_cond_init(&updatecond);
+    vlc_sem_init(&datasem, 0);
+}
+
+Downloader::~Downloader()
+{
+    if(started)
+    {
+        vlc_mutex_lock(&lock);
+        killed = true;
+        vlc_cond_signal(&updatecond);
+        vlc_mutex_unlock(&lock);
+
+        vlc_interrupt_kill(interrupt);
+        vlc_join(thread, NULL);
+    }
+    if(interrupt)
+        vlc_interrupt_destroy(interrupt);
+
+    /* chunks belong to the callers */
+    std::list<Job *>::const_iterator it;
+    for(it = jobs.begin(); it != jobs.end(); ++it)
+        delete *it;
+
+    vlc_sem_destroy(&datasem);
+    vlc_cond_destroy(&updatecond);
+    vlc_mutex_destroy(&lock);
+}
+
+bool Downloader::start()
+{
+    if(started)
+        return true;
+
+    interrupt = vlc_interrupt_create();
+    if(!interrupt)
+        return false;
+
+    if(vlc_clone(&thread, downloaderThread, this, VLC_THREAD_PRIORITY_INPUT))
+    {
+        vlc_interrupt_destroy(interrupt);
+        interrupt = NULL;
+        return false;
+    }
+    started = true;
+    return true;
+}
+
+void Downloader::schedule(Chunk *chunk, IDownloadRateObserver *observer,
+                          mtime_t start)
+{
+    Chunk *dlchunk;
+    try
+    {
+        dlchunk = new Chunk(chunk->getUrl());
+    } catch (int) {
+        return;
+    }
+    dlchunk->setStartByte(chunk->getStartByte());
+    dlchunk->setEndByte(chunk->getEndByte());
+
+    Job *job = new (std::nothrow) Job(chunk, dlchunk, observer, start);
+    if(!job)
+    {
+        delete dlchunk;
+        return;
+    }
+
+    vlc_mutex_lock(&lock);
+    jobs.push_back(job);
+    vlc_cond_signal(&updatecond);
+    vlc_mutex_unlock(&lock);
+}
+
+block_t * Downloader::read(Chunk *chunk, bool *pb_done)
+{
+    block_t *p_block = NULL;
+
+    *pb_done = false;
+    vlc_mutex_lock(&lock);
+    Job *job = find(chunk);
+    if(job)
+    {
+        while(!job->p_data && !job->done)
+        {
+            if(!waitData())
+                break;
+        }
+
+        if(job->p_data)
+        {
+            chunk->setLength(job->length);
+            p_block = job->p_data;
+            job->p_data = NULL;
+            job->pp_last = &job->p_data;
+        }
+        else if(job->done)
+        {
+            jobs.remove(job);
+            delete job;
+            *pb_done = true;
+        }
+    }
+    else *pb_done = true; /* never scheduled or failed to */
+    vlc_mutex_unlock(&lock);
+
+    return p_block;
+}
+
+void Downloader::cancel(Chunk *chunk)
+{
+    vlc_mutex_lock(&lock);
+    Job *job = find(chunk);
+    if(job)
+    {
+        /* The thread stops after its current read */
+        job->cancelled = true;
+        while(current == job)
+            vlc_cond_wait(&updatecond, &lock);
+        jobs.remove(job);
+        delete job;
+    }
+    vlc_mutex_unlock(&lock);
+}
+
+bool Downloader::isCompleted(const Chunk *chunk) const
+{
+    vlc_mutex_lock(const_cast<vlc_mutex_t *>(&lock));
+    const Job *job = find(chunk);
+    bool b_completed = !job || job->done;
+    vlc_mutex_unlock(const_cast<vlc_mutex_t *>(&lock));
+    return b_completed;
+}
+
+Downloader::Job * Downloader::find(const Chunk *chunk) const
+{
+    std::list<Job *>::const_iterator it;
+    for(it = jobs.begin(); it != jobs.end(); ++it)
+    {
+        if((*it)->chunk == chunk)
+            return *it;
+    }
+    return NULL;
+}
+
+/* Waits for the thread, with the lock held. Returns false if interrupted. */
+bool Downloader::waitData()
+{
+    waiting = true;
+    vlc_mutex_unlock(&lock);
+    int val = vlc_sem_wait_i11e(&datasem);
+    vlc_mutex_lock(&lock);
+    waiting = false;
+    return val == 0;
+}
+
+void Downloader::append(Job *job, block_t *p_block)
+{
+    vlc_mutex_lock(&lock);
+    job->length = job->dlchunk->getLength();
+    block_ChainLastAppend(&job->pp_last, p_block);
+    if(waiting)
+    {
+        waiting = false;
+        vlc_sem_post(&datasem);
+    }
+    vlc_mutex_unlock(&lock);
+}
+
+/* Earliest pending job, in scheduling order on ties. Streams schedule
+ * their chunks in order, so they are also downloaded in order. */
+Downloader::Job * Downloader::next() const
+{
+    Job *job = NULL;
+    std::list<Job *>::const_iterator it;
+    for(it = jobs.begin(); it != jobs.end(); ++it)
+    {
+        if((*it)->done || (*it)->cancelled)
+            continue;
+        if(!job || (*it)->start < job->start)
+            job = *it;
+    }
+    return job;
+}
+
+void * Downloader::downloaderThread(void *opaque)
+{
+    Downloader *instance = static_cast<Downloader *>(opaque);
+    instance->run();
+    return NULL;
+}
+
+void Downloader::run()
+{
+    vlc_interrupt_set(interrupt);
+
+    vlc_mutex_lock(&lock);
+    for(;;)
+    {
+        Job *job = NULL;
+        while(!killed)
+        {
+            job = next();
+            if(job)
+                break;
+            vlc_cond_wait(&updatecond, &lock);
+        }
+        if(killed)
+            break;
+
+        current = job;
+        vlc_mutex_unlock(&lock);
+
+        download(job);
+
+        vlc_mutex_lock(&lock);
+        job->done = true;
+        current = NULL;
+        vlc_cond_broadcast(&updatecond);
+        if(waiting)
+        {
+            waiting = false;
+            vlc_sem_post(&datasem);
+        }
+    }
+    vlc_mutex_unlock(&lock);
+}
+
+void Downloader::download(Job *job)
+{
+    Chunk *chunk = job->dlchunk;
+
+    if(!connManager->connectChunk(chunk))
+    {
+        if(chunk->getConnection())
+            chunk->getConnection()->releaseChunk();
+        return;
+    }
+
+    HTTPConnection *conn = chunk->getConnection();
+    if(conn->query(chunk->getPath()) != VLC_SUCCESS)
+    {
+        conn->releaseChunk();
+        return;
+    }
+
+    while(chunk->getBytesToRead() > 0)
+    {
+        vlc_mutex_lock(&lock);
+        bool cancelled = job->cancelled || killed;
+        vlc_mutex_unlock(&lock);
+        if(cancelled)
+            break;
+
+        size_t readsize = chunk->getBytesToRead();
+        if(readsize > READ_SIZE)
+            readsize = READ_SIZE;
+
+        block_t *p_block = block_Alloc(readsize);
+        if(!p_block)
+            break;
+
+        mtime_t time = mdate();
+        ssize_t ret = conn->read(p_block->p_buffer, readsize);
+        time = mdate() - time;
+        if(ret < 0)
+        {
+            msg_Warn(obj, "download of %s interrupted", chunk->getUrl().c_str());
+            block_Release(p_block);
+            break;
+        }
+        p_block->i_buffer = ret;
+
+        if(job->observer)
+            job->observer->updateDownloadRate(p_block->i_buffer, time);
+        append(job, p_block);
+    }
+
+    conn->releaseChunk();
+}
@@ -0,0 +1,110 @@
+/*
+ * Downloader.hpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef DOWNLOADER_HPP
+#define DOWNLOADER_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_interrupt.h>
+#include <list>
+
+namespace adaptative
+{
+    namespace logic
+    {
+        class IDownloadRateObserver;
+    }
+
+    namespace http
+    {
+        class HTTPConnectionManager;
+        class Chunk;
+
+        using namespace logic;
+
+        /* Downloads scheduled chunks in the background, reusing the
+         * persistent connections of the manager. The chunk starting the
+         * earliest in media time goes first, so that the stream with the
+         * least data buffered is served before the others. Chunks stay
+         * owned by the caller, which consumes the data while it arrives.
+         * The thread works on a copy, so that the caller sees the chunk
+         * progress as if it was reading it synchronously. */
+        class Downloader
+        {
+            public:
+                Downloader(vlc_object_t *, HTTPConnectionManager *);
+                ~Downloader();
+
+                bool     start();
+                void     schedule(Chunk *, IDownloadRateObserver *, mtime_t);
+                /* Returns the data received so far, waiting if there is none,
+                 * and sets the chunk length. Returns NULL and sets the flag
+                 * once the download is over. */
+                block_t *read(Chunk *, bool *);
+                void     cancel(Chunk *);
+                bool     isCompleted(const Chunk *) const;
+
+                static const size_t READ_SIZE = 32768;
+
+            private:
+                class Job
+                {
+                    friend class Downloader;
+                    Job(Chunk *, Chunk *, IDownloadRateObserver *, mtime_t);
+                    ~Job();
+                    Chunk *chunk;    /* the caller's */
+                    Chunk *dlchunk;  /* the thread's */
+                    IDownloadRateObserver *observer;
+                    mtime_t  start;  /* media time of the chunk */
+                    uint64_t length;
+                    block_t  *p_data;
+                    block_t **pp_last;
+                    bool done;
+                    bool cancelled;
+                };
+
+                static void *downloaderThread(void *);
+                void run();
+                Job *next() const;
+                void download(Job *);
+                void append(Job *, block_t *);
+                Job *find(const Chunk *) const;
+                bool waitData();
+
+                vlc_object_t          *obj;
+                HTTPConnectionManager *connManager;
+                std::list<Job *>       jobs;
+                Job                   *current;
+                vlc_thread_t           thread;
+                vlc_interrupt_t       *interrupt;
+                vlc_mutex_t            lock;
+                vlc_cond_t             updatecond; /* new job or job done */
+                vlc_sem_t              datasem;    /* the reader waits for data */
+                bool                   waiting;
+                bool                   started;
+                bool                   killed;
+        };
+    }
+}
+
+#endif // DOWNLOADER_HPP
@@ -29,20 +29,38 @@
 #include "HTTPConnection.hpp"
 #include "Chunk.h"
 #include "Sockets.hpp"
+#include "Downloader.hpp"
 
 using namespace adaptative::http;
 
 const uint64_t  HTTPConnectionManager::CHUNKDEFAULTBITRATE    = 1;
 
 HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *stream) :
-                       stream                   (stream)
+                       stream                   (stream),
+                       downloader               (NULL)
 {
 }
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
+    delete downloader;
     this->closeAllConnections();
 }
 
+/* Once started, the downloader thread is the only user of the connections */
+Downloader * HTTPConnectionManager::getDownloader()
+{
+    if(!downloader)
+    {
+        downloader = new (std::nothrow) Downloader(stream, this);
+        if(downloader && !downloader->start())
+        {
+            delete downloader;
+            downloader = NULL;
+        }
+    }
+    return downloader;
+}
+
 void HTTPConnectionManager::closeAllConnections      ()
 {
     releaseAllConnections();
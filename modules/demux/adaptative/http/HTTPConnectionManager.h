@@ -39,6 +39,7 @@ namespace adaptative
     {
         class HTTPConnection;
         class Chunk;
+        class Downloader;
 
         class HTTPConnectionManager
         {
@@ -49,10 +50,12 @@ namespace adaptative
                 void    closeAllConnections ();
                 void    releaseAllConnections ();
                 bool    connectChunk        (Chunk *chunk);
+                Downloader * getDownloader  ();
 
             private:
                 std::vector<HTTPConnection *>                       connectionPool;
                 vlc_object_t                                       *stream;
+                Downloader                                         *downloader;
 
                 static const uint64_t   CHUNKDEFAULTBITRATE;
 
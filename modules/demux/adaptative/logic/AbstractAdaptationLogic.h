@@ -47,6 +47,9 @@ namespace adaptative
 
                 virtual BaseRepresentation* getCurrentRepresentation(BaseAdaptationSet *) const = 0;
                 virtual void                updateDownloadRate     (size_t, mtime_t);
+                /* Duration of the downloaded media ahead of playback, and
+                 * how much the stream tries to keep (0 if unknown) */
+                virtual void                updateBufferLevel      (mtime_t, mtime_t);
 
                 enum LogicType
                 {
@@ -54,7 +57,8 @@ namespace adaptative
                     AlwaysBest,
                     AlwaysLowest,
                     RateBased,
-                    FixedRate
+                    FixedRate,
+                    BufferBased
                 };
         };
     }
@@ -0,0 +1,195 @@
+/*
+ * BufferBasedAdaptationLogic.cpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "BufferBasedAdaptationLogic.h"
+#include "Representationselectors.hpp"
+
+#include "../playlist/BaseRepresentation.h"
+#include "../playlist/BaseAdaptationSet.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace adaptative::logic;
+
+ThroughputEstimator::MovingAverage::MovingAverage(mtime_t halflife_)
+{
+    halflife = halflife_;
+    average = 0.0;
+    weight = 0.0;
+}
+
+void ThroughputEstimator::MovingAverage::push(double value, mtime_t time)
+{
+    const double alpha = pow(0.5, (double) time / halflife);
+    average = alpha * average + (1.0 - alpha) * value;
+    weight = alpha * weight + (1.0 - alpha);
+}
+
+double ThroughputEstimator::MovingAverage::get() const
+{
+    /* unbias the first samples against the initial zero */
+    return (weight > 0.0) ? average / weight : 0.0;
+}
+
+ThroughputEstimator::ThroughputEstimator() :
+    fast(2 * CLOCK_FREQ), slow(8 * CLOCK_FREQ)
+{
+    sampleCount = 0;
+    pendingBytes = 0;
+    pendingTime = 0;
+}
+
+void ThroughputEstimator::update(size_t size, mtime_t time)
+{
+    /* single reads are too short to be meaningful on fast links */
+    pendingBytes += size;
+    pendingTime += time;
+    if(pendingTime < SAMPLE_MIN_TIME)
+        return;
+
+    const double bps = 8.0 * CLOCK_FREQ * pendingBytes / pendingTime;
+    fast.push(bps, pendingTime);
+    slow.push(bps, pendingTime);
+    samples[sampleCount++ % HARMONIC_SAMPLES] = bps;
+
+    pendingBytes = 0;
+    pendingTime = 0;
+}
+
+size_t ThroughputEstimator::getEstimate() const
+{
+    if(sampleCount == 0)
+        return 0;
+
+    const unsigned count = __MIN(sampleCount, HARMONIC_SAMPLES);
+    double inverses = 0.0;
+    for(unsigned i = 0; i < count; i++)
+        inverses += 1.0 / samples[i];
+
+    double estimate = count / inverses;
+    estimate = __MIN(estimate, fast.get());
+    estimate = __MIN(estimate, slow.get());
+    return estimate;
+}
+
+BufferBasedAdaptationLogic::BufferBasedAdaptationLogic  (int w, int h) :
+                            AbstractAdaptationLogic     ()
+{
+    width  = w;
+    height = h;
+    bufferLevel = 0;
+    bufferTarget = 0;
+    bufferMode = false;
+    vlc_mutex_init(&lock);
+}
+
+BufferBasedAdaptationLogic::~BufferBasedAdaptationLogic()
+{
+    vlc_mutex_destroy(&lock);
+}
+
+/* Linear mapping of the buffer level between the reservoir and the upper
+ * reservoir, to the lowest and highest bitrates */
+uint64_t BufferBasedAdaptationLogic::getBufferRate(BaseAdaptationSet *adaptSet,
+                                                   mtime_t level, mtime_t target) const
+{
+    const mtime_t reservoir = target / 4;
+    const mtime_t upper = target * 9 / 10;
+
+    uint64_t minrate = std::numeric_limits<uint64_t>::max();
+    uint64_t maxrate = 0;
+    std::vector<BaseRepresentation *> reps = adaptSet->getRepresentations();
+    std::vector<BaseRepresentation *>::const_iterator it;
+    for(it = reps.begin(); it != reps.end(); ++it)
+    {
+        minrate = __MIN(minrate, (*it)->getBandwidth());
+        maxrate = __MAX(maxrate, (*it)->getBandwidth());
+    }
+
+    /* the selector only picks bitrates strictly below the given one */
+    if(reps.empty() || level <= reservoir)
+        return 0;
+    if(level >= upper)
+        return maxrate + 1;
+    return minrate + 1 + (maxrate - minrate) * (level - reservoir) / (upper - reservoir);
+}
+
+BaseRepresentation *BufferBasedAdaptationLogic::getCurrentRepresentation(BaseAdaptationSet *adaptSet) const
+{
+    if(adaptSet == NULL)
+        return NULL;
+
+    vlc_mutex_lock(const_cast<vlc_mutex_t *>(&lock));
+    uint64_t bps;
+    const uint64_t throughput = estimator.getEstimate();
+    if(bufferMode)
+    {
+        /* never more than what could be downloaded before the buffer
+         * drains back to half the target */
+        bps = getBufferRate(adaptSet, bufferLevel, bufferTarget);
+        bps = __MIN(bps, throughput * bufferLevel / (bufferTarget / 2));
+    }
+    else
+        bps = throughput * 9 / 10;
+    vlc_mutex_unlock(const_cast<vlc_mutex_t *>(&lock));
+
+    RepresentationSelector selector;
+    BaseRepresentation *rep = selector.select(adaptSet, bps, width, height);
+    if ( rep == NULL )
+    {
+        rep = selector.select(adaptSet);
+        if ( rep == NULL )
+            return NULL;
+    }
+    return rep;
+}
+
+void BufferBasedAdaptationLogic::updateDownloadRate(size_t size, mtime_t time)
+{
+    if(unlikely(time == 0))
+        return;
+
+    vlc_mutex_lock(&lock);
+    estimator.update(size, time);
+    vlc_mutex_unlock(&lock);
+}
+
+void BufferBasedAdaptationLogic::updateBufferLevel(mtime_t level, mtime_t target)
+{
+    vlc_mutex_lock(&lock);
+    bufferLevel = level;
+    bufferTarget = target;
+    /* With hysteresis, so that a single late segment does not
+     * send us back to the throughput estimate */
+    if(target <= 0)
+        bufferMode = false;
+    else if(!bufferMode && level >= target / 2)
+        bufferMode = true;
+    else if(bufferMode && level < target / 4)
+        bufferMode = false;
+    vlc_mutex_unlock(&lock);
+}
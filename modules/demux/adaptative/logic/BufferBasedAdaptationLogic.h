@@ -0,0 +1,93 @@
+/*
+ * BufferBasedAdaptationLogic.h
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef BUFFERBASEDADAPTATIONLOGIC_H_
+#define BUFFERBASEDADAPTATIONLOGIC_H_
+
+#include "AbstractAdaptationLogic.h"
+
+namespace adaptative
+{
+    namespace logic
+    {
+        /* Conservative throughput estimate: the lowest of a fast and a slow
+         * moving average, weighted by download time, and of the harmonic
+         * mean of the last samples. */
+        class ThroughputEstimator
+        {
+            public:
+                ThroughputEstimator();
+
+                void    update(size_t, mtime_t);
+                size_t  getEstimate() const; /* bits per second, 0 if none */
+
+            private:
+                class MovingAverage
+                {
+                    public:
+                        MovingAverage(mtime_t);
+                        void    push(double, mtime_t);
+                        double  get() const;
+
+                    private:
+                        mtime_t halflife;
+                        double  average;
+                        double  weight;
+                };
+
+                static const mtime_t  SAMPLE_MIN_TIME = CLOCK_FREQ / 20;
+                static const unsigned HARMONIC_SAMPLES = 8;
+
+                MovingAverage   fast;
+                MovingAverage   slow;
+                double          samples[HARMONIC_SAMPLES];
+                unsigned        sampleCount;
+                size_t          pendingBytes;
+                mtime_t         pendingTime;
+        };
+
+        /* Selects on throughput while the buffer fills up, then maps the
+         * buffer occupancy to the bitrates range (BBA) so that throughput
+         * variations do not cause switches until the buffer reflects them. */
+        class BufferBasedAdaptationLogic : public AbstractAdaptationLogic
+        {
+            public:
+                BufferBasedAdaptationLogic          (int, int);
+                virtual ~BufferBasedAdaptationLogic ();
+
+                BaseRepresentation *getCurrentRepresentation(BaseAdaptationSet *) const;
+                virtual void updateDownloadRate(size_t, mtime_t);
+                virtual void updateBufferLevel(mtime_t, mtime_t);
+
+            private:
+                uint64_t                getBufferRate(BaseAdaptationSet *,
+                                                      mtime_t, mtime_t) const;
+                int                     width;
+                int                     height;
+                ThroughputEstimator     estimator;
+                mtime_t                 bufferLevel;
+                mtime_t                 bufferTarget;
+                bool                    bufferMode;
+                vlc_mutex_t             lock;
+        };
+    }
+}
+
+#endif /* BUFFERBASEDADAPTATIONLOGIC_H_ */
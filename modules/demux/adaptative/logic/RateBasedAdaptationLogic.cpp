@@ -45,6 +45,12 @@ RateBasedAdaptationLogic::RateBasedAdaptationLogic  (int w, int h) :
     height = h;
     cumulatedTime = 0;
     stabilizer = 16;
+    vlc_mutex_init(&lock);
+}
+
+RateBasedAdaptationLogic::~RateBasedAdaptationLogic()
+{
+    vlc_mutex_destroy(&lock);
 }
 
 BaseRepresentation *RateBasedAdaptationLogic::getCurrentRepresentation(BaseAdaptationSet *adaptSet) const
@@ -52,8 +58,12 @@ BaseRepresentation *RateBasedAdaptationLogic::getCurrentRepresentation(BaseAdapt
     if(adaptSet == NULL)
         return NULL;
 
+    vlc_mutex_lock(const_cast<vlc_mutex_t *>(&lock));
+    size_t bps = currentBps;
+    vlc_mutex_unlock(const_cast<vlc_mutex_t *>(&lock));
+
     RepresentationSelector selector;
-    BaseRepresentation *rep = selector.select(adaptSet, currentBps, width, height);
+    BaseRepresentation *rep = selector.select(adaptSet, bps, width, height);
     if ( rep == NULL )
     {
         rep = selector.select(adaptSet);
@@ -68,7 +78,8 @@ void RateBasedAdaptationLogic::updateDownloadRate(size_t size, mtime_t time)
     if(unlikely(time == 0))
         return;
 
-    size_t current = bpsRemainder + size * 8000 / time;
+    vlc_mutex_lock(&lock);
+    size_t current = bpsRemainder + CLOCK_FREQ * size * 8 / time;
 
     if (current >= bpsAvg)
     {
@@ -96,6 +107,7 @@ void RateBasedAdaptationLogic::updateDownloadRate(size_t size, mtime_t time)
         currentBps = bpsAvg * 3/4;
         cumulatedTime = 0;
     }
+    vlc_mutex_unlock(&lock);
 }
 
 FixedRateAdaptationLogic::FixedRateAdaptationLogic(size_t bps) :
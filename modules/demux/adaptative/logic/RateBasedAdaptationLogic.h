@@ -38,6 +38,7 @@ namespace adaptative
         {
             public:
                 RateBasedAdaptationLogic            (int, int);
+                virtual ~RateBasedAdaptationLogic   ();
 
                 BaseRepresentation *getCurrentRepresentation(BaseAdaptationSet *) const;
                 virtual void updateDownloadRate(size_t, mtime_t);
@@ -51,6 +52,7 @@ namespace adaptative
                 size_t                  currentBps;
                 mtime_t                 cumulatedTime;
                 int                     stabilizer;
+                vlc_mutex_t             lock; /* rate updates may come from the downloader */
         };
 
         class FixedRateAdaptationLogic : public AbstractAdaptationLogic
@@ -0,0 +1,420 @@
+/*
+ * Simulator.cpp: offline comparison of adaptation logics
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Replays a bandwidth trace against the representations of a playlist,
+ * and reports how each adaptation logic would have played it:
+ *
+ *   adaptative-sim <playlist> <trace> [buffer seconds]
+ *
+ * The trace is a text file with one "<seconds> <kbit/s>" pair per line,
+ * looped if shorter than the media. Nothing but the playlist is
+ * downloaded: segment sizes are derived from the advertised bandwidths. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+#include <vlc_url.h>
+
+#include "playlist/BasePeriod.h"
+#include "playlist/BaseAdaptationSet.h"
+#include "playlist/BaseRepresentation.h"
+#include "logic/AlwaysBestAdaptationLogic.h"
+#include "logic/AlwaysLowestAdaptationLogic.hpp"
+#include "logic/RateBasedAdaptationLogic.h"
+#include "logic/BufferBasedAdaptationLogic.h"
+
+#include "../dash/xml/DOMParser.h"
+#include "../dash/mpd/MPDFactory.h"
+#include "../dash/DASHManager.h"
+
+#include "../hls/HLSManager.hpp"
+#include "../hls/playlist/Parser.hpp"
+#include "../hls/playlist/M3U8.hpp"
+
+#include <cstdio>
+#include <vector>
+
+using namespace adaptative::logic;
+using namespace adaptative::playlist;
+using namespace dash::mpd;
+using namespace dash::xml;
+using namespace dash;
+using namespace hls;
+using namespace hls::playlist;
+
+#define READ_SIZE 32768
+
+class Trace
+{
+    public:
+        bool load(const char *);
+        void rewind();
+        mtime_t transfer(size_t);
+        void idle(mtime_t);
+
+    private:
+        struct Entry
+        {
+            mtime_t  duration;
+            uint64_t bps;
+        };
+        void next();
+
+        std::vector<Entry> entries;
+        size_t  index;
+        mtime_t offset; /* in the current entry */
+};
+
+bool Trace::load(const char *psz_path)
+{
+    FILE *file = fopen(psz_path, "r");
+    if(!file)
+        return false;
+
+    char line[256];
+    bool b_usable = false;
+    while(fgets(line, sizeof(line), file))
+    {
+        double seconds, kbps;
+        if(line[0] == '#' || sscanf(line, "%lf %lf", &seconds, &kbps) != 2 ||
+           seconds <= 0 || kbps < 0)
+            continue;
+
+        Entry entry;
+        entry.duration = seconds * CLOCK_FREQ;
+        entry.bps = kbps * 1000;
+        entries.push_back(entry);
+        if(entry.bps > 0)
+            b_usable = true;
+    }
+    fclose(file);
+    rewind();
+    return b_usable;
+}
+
+void Trace::rewind()
+{
+    index = 0;
+    offset = 0;
+}
+
+void Trace::next()
+{
+    offset = 0;
+    if(++index == entries.size())
+        index = 0;
+}
+
+/* Returns the time needed to receive the given amount of data */
+mtime_t Trace::transfer(size_t size)
+{
+    mtime_t time = 0;
+    double bits = size * 8.0;
+
+    while(bits > 0)
+    {
+        const Entry &entry = entries[index];
+        const mtime_t left = entry.duration - offset;
+        const double capacity = (double) entry.bps * left / CLOCK_FREQ;
+        if(capacity > bits)
+        {
+            const mtime_t needed = bits * CLOCK_FREQ / entry.bps + 1;
+            offset += needed;
+            time += needed;
+            break;
+        }
+        bits -= capacity;
+        time += left;
+        next();
+    }
+    return time;
+}
+
+void Trace::idle(mtime_t time)
+{
+    while(time > 0)
+    {
+        const mtime_t left = entries[index].duration - offset;
+        if(time < left)
+        {
+            offset += time;
+            break;
+        }
+        time -= left;
+        next();
+    }
+}
+
+class Player
+{
+    public:
+        Player(Trace *, mtime_t);
+        void run(AbstractAdaptationLogic *, BaseAdaptationSet *, mtime_t);
+        void print(const char *) const;
+
+    private:
+        void elapse(mtime_t);
+
+        Trace   *trace;
+        mtime_t  target;
+        mtime_t  now;
+        mtime_t  buffer;
+        bool     playing;
+        bool     started;
+        unsigned segments;
+        unsigned switches;
+        unsigned rebuffers;
+        uint64_t bitrates;
+        mtime_t  stalled;
+        mtime_t  startup;
+};
+
+Player::Player(Trace *trace_, mtime_t target_)
+{
+    trace = trace_;
+    target = target_;
+    now = buffer = 0;
+    playing = started = false;
+    segments = switches = rebuffers = 0;
+    bitrates = 0;
+    stalled = startup = 0;
+}
+
+/* Plays from the buffer while time passes */
+void Player::elapse(mtime_t time)
+{
+    now += time;
+    if(!playing)
+    {
+        if(started)
+            stalled += time;
+        return;
+    }
+
+    if(buffer >= time)
+    {
+        buffer -= time;
+        return;
+    }
+
+    stalled += time - buffer;
+    buffer = 0;
+    playing = false;
+    rebuffers++;
+}
+
+void Player::run(AbstractAdaptationLogic *logic, BaseAdaptationSet *adaptSet,
+                 mtime_t mediaduration)
+{
+    BaseRepresentation *prevrep = NULL;
+    mtime_t segmentduration = 0;
+
+    trace->rewind();
+    for(uint64_t number = 0; ; number++)
+    {
+        /* Wait for room in the buffer */
+        if(buffer + segmentduration > target)
+        {
+            const mtime_t wait = __MIN(buffer + segmentduration - target, buffer);
+            trace->idle(wait);
+            elapse(wait);
+        }
+
+        logic->updateBufferLevel(buffer, target);
+        BaseRepresentation *rep = logic->getCurrentRepresentation(adaptSet);
+        if(!rep || !rep->getSegment(BaseRepresentation::INFOTYPE_MEDIA, number))
+            break;
+
+        const mtime_t start = rep->getPlaybackTimeBySegmentNumber(number);
+        if(mediaduration > 0 && start >= mediaduration)
+            break;
+        const mtime_t end = rep->getPlaybackTimeBySegmentNumber(number + 1);
+        if(end > start)
+            segmentduration = end - start;
+        else if(segmentduration == 0) /* last of a list, or unknown */
+            break;
+        if(mediaduration > 0 && start + segmentduration > mediaduration)
+            segmentduration = mediaduration - start;
+
+        size_t size = rep->getBandwidth() * segmentduration / 8 / CLOCK_FREQ;
+        while(size > 0)
+        {
+            const size_t readsize = __MIN(size, READ_SIZE);
+            const mtime_t time = trace->transfer(readsize);
+            logic->updateDownloadRate(readsize, time);
+            elapse(time);
+            size -= readsize;
+        }
+
+        buffer += segmentduration;
+        if(!playing)
+        {
+            if(!started)
+                startup = now;
+            playing = started = true;
+        }
+
+        if(prevrep && prevrep != rep)
+            switches++;
+        prevrep = rep;
+        segments++;
+        bitrates += rep->getBandwidth();
+    }
+}
+
+void Player::print(const char *psz_name) const
+{
+    printf("%-14s %8u %10" PRIu64 " %8u %9u %11.1f %11.1f\n", psz_name,
+           segments, segments ? bitrates / segments / 1000 : 0, switches,
+           rebuffers, (double) stalled / CLOCK_FREQ, (double) startup / CLOCK_FREQ);
+}
+
+static AbstractPlaylist *Parse(stream_t *s, std::string &url)
+{
+    if(DASHManager::isDASH(s))
+    {
+        DOMParser parser(s);
+        if(!parser.parse())
+            return NULL;
+        return MPDFactory::create(parser.getRootNode(), s, url, parser.getProfile());
+    }
+    else if(HLSManager::isHTTPLiveStreaming(s))
+    {
+        Parser parser(s);
+        return parser.parse(url);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        fprintf(stderr, "usage: %s <playlist> <trace> [buffer seconds]\n", argv[0]);
+        return 1;
+    }
+
+    Trace trace;
+    if(!trace.load(argv[2]))
+    {
+        fprintf(stderr, "cannot load trace %s\n", argv[2]);
+        return 1;
+    }
+    const mtime_t target = CLOCK_FREQ * ((argc > 3) ? atoi(argv[3]) : 30);
+
+    const char *args[] = { "--ignore-config", "--quiet" };
+    libvlc_instance_t *vlc = libvlc_new(2, args);
+    if(!vlc)
+        return 1;
+
+    std::string url;
+    if(strstr(argv[1], "://"))
+    {
+        url = argv[1];
+    }
+    else
+    {
+        char *psz_uri = vlc_path2uri(argv[1], NULL);
+        if(psz_uri)
+            url = psz_uri;
+        free(psz_uri);
+    }
+
+    AbstractPlaylist *playlist = NULL;
+    stream_t *s = stream_UrlNew(vlc->p_libvlc_int, url.c_str());
+    if(s)
+    {
+        playlist = Parse(s, url);
+        stream_Delete(s);
+    }
+
+    /* The adaptation set with the most choices */
+    BaseAdaptationSet *adaptSet = NULL;
+    BasePeriod *period = playlist ? playlist->getFirstPeriod() : NULL;
+    if(period)
+    {
+        std::vector<BaseAdaptationSet *> sets = period->getAdaptationSets();
+        std::vector<BaseAdaptationSet *>::const_iterator it;
+        for(it = sets.begin(); it != sets.end(); ++it)
+        {
+            if(!adaptSet || (*it)->getRepresentations().size() >
+                            adaptSet->getRepresentations().size())
+                adaptSet = *it;
+        }
+    }
+
+    if(!adaptSet)
+    {
+        fprintf(stderr, "cannot parse playlist %s\n", argv[1]);
+        delete playlist;
+        libvlc_release(vlc);
+        return 1;
+    }
+
+    printf("%zu representations, %" PRId64 " s buffer\n",
+           adaptSet->getRepresentations().size(), target / CLOCK_FREQ);
+    printf("%-14s %8s %10s %8s %9s %11s %11s\n", "logic", "segments",
+           "avg kbit/s", "switches", "rebuffers", "stalled (s)", "startup (s)");
+
+    static const struct
+    {
+        const char *psz_name;
+        AbstractAdaptationLogic::LogicType type;
+    } logics[] = {
+        { "rate",          AbstractAdaptationLogic::RateBased },
+        { "buffer",        AbstractAdaptationLogic::BufferBased },
+        { "lowest",        AbstractAdaptationLogic::AlwaysLowest },
+        { "highest",       AbstractAdaptationLogic::AlwaysBest },
+    };
+
+    for(size_t i = 0; i < ARRAY_SIZE(logics); i++)
+    {
+        AbstractAdaptationLogic *logic;
+        switch(logics[i].type)
+        {
+            case AbstractAdaptationLogic::RateBased:
+                logic = new RateBasedAdaptationLogic(0, 0);
+                break;
+            case AbstractAdaptationLogic::BufferBased:
+                logic = new BufferBasedAdaptationLogic(0, 0);
+                break;
+            case AbstractAdaptationLogic::AlwaysLowest:
+                logic = new AlwaysLowestAdaptationLogic();
+                break;
+            default:
+                logic = new AlwaysBestAdaptationLogic();
+                break;
+        }
+
+        Player player(&trace, target);
+        player.run(logic, adaptSet, playlist->duration.Get());
+        player.print(logics[i].psz_name);
+        delete logic;
+    }
+
+    delete playlist;
+    libvlc_release(vlc);
+    return 0;
+}
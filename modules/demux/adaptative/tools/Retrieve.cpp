@@ -23,9 +23,44 @@
 #include "../http/HTTPConnection.hpp"
 #include "../http/Chunk.h"
 
+#include <vlc_stream.h>
+
 using namespace adaptative;
 using namespace adaptative::http;
 
+/* Local playlists */
+static uint64_t ReadStream(vlc_object_t *obj, const std::string &uri, void **pp_data)
+{
+    uint8_t *p_data = NULL;
+    size_t i_data = 0;
+
+    stream_t *s = stream_UrlNew(obj, uri.c_str());
+    if(s)
+    {
+        for(;;)
+        {
+            uint8_t *p_realloc = (uint8_t *) realloc(p_data, i_data + 4096);
+            if(!p_realloc)
+                break;
+            p_data = p_realloc;
+
+            int i_read = stream_Read(s, &p_data[i_data], 4096);
+            if(i_read <= 0)
+                break;
+            i_data += i_read;
+        }
+        stream_Delete(s);
+    }
+
+    if(i_data == 0)
+    {
+        free(p_data);
+        p_data = NULL;
+    }
+    *pp_data = p_data;
+    return i_data;
+}
+
 uint64_t Retrieve::HTTP(vlc_object_t *obj, const std::string &uri, void **pp_data)
 {
     HTTPConnectionManager connManager(obj);
@@ -34,8 +69,7 @@ uint64_t Retrieve::HTTP(vlc_object_t *obj, const std::string &uri, void **pp_dat
     {
         datachunk = new Chunk(uri);
     } catch (int) {
-        *pp_data = NULL;
-        return 0;
+        return ReadStream(obj, uri, pp_data);
     }
 
     if(!connManager.connectChunk(datachunk) ||
@@ -35,6 +35,7 @@
 #include <vlc_plugin.h>
 #include <vlc_demux.h>
 #include <vlc_input.h>
+#include <vlc_interrupt.h>
 
 #include <vlc_dialog.h>
 
@@ -137,6 +138,17 @@ static void avi_index_Init( avi_index_t * );
 static void avi_index_Clean( avi_index_t * );
 static void avi_index_Append( avi_index_t *, off_t *, avi_entry_t * );
 
+/* Entry of the index cached by AVI_IndexCreate() */
+typedef struct
+{
+    vlc_fourcc_t i_id;
+    uint32_t     i_flags;
+    uint32_t     i_length;
+    uint32_t     i_track;
+    int64_t      i_pos;
+} avi_index_record_t;
+#define AVI_INDEX_CACHE "avi-1"
+
 typedef struct
 {
     bool            b_activated;
@@ -2540,6 +2552,82 @@ static void AVI_IndexLoad( demux_t *p_demux )
     }
 }
 
+/* Loads the index that AVI_IndexCreate() built on a previous opening */
+static bool AVI_IndexCacheLoad( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    block_t *p_block = demux_IndexLoad( p_demux, AVI_INDEX_CACHE,
+                                        sizeof( avi_index_record_t ) );
+    if( !p_block )
+        return false;
+
+    const avi_index_record_t *p_rec = (const void *)p_block->p_buffer;
+    size_t i_count = p_block->i_buffer / sizeof( *p_rec );
+
+    for( size_t i = 0; i < i_count; i++ )
+    {
+        if( p_rec[i].i_track >= p_sys->i_track )
+            continue;
+
+        avi_entry_t index;
+        index.i_id      = p_rec[i].i_id;
+        index.i_flags   = p_rec[i].i_flags;
+        index.i_pos     = p_rec[i].i_pos;
+        index.i_length  = p_rec[i].i_length;
+        index.i_lengthtotal = p_rec[i].i_length;
+        avi_index_Append( &p_sys->track[p_rec[i].i_track]->idx,
+                          &p_sys->i_movi_lastchunk_pos, &index );
+    }
+    block_Release( p_block );
+    return true;
+}
+
+static void AVI_IndexCacheStore( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    size_t i_count = 0;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        i_count += p_sys->track[i]->idx.i_size;
+
+    avi_index_record_t *p_rec = malloc( __MAX( i_count, 1 ) * sizeof( *p_rec ) );
+    if( !p_rec )
+        return;
+
+    size_t i_rec = 0;
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        const avi_index_t *p_index = &p_sys->track[i]->idx;
+
+        for( unsigned j = 0; j < p_index->i_size; j++, i_rec++ )
+        {
+            p_rec[i_rec].i_id     = p_index->p_entry[j].i_id;
+            p_rec[i_rec].i_flags  = p_index->p_entry[j].i_flags;
+            p_rec[i_rec].i_length = p_index->p_entry[j].i_length;
+            p_rec[i_rec].i_track  = i;
+            p_rec[i_rec].i_pos    = p_index->p_entry[j].i_pos;
+        }
+    }
+    demux_IndexStore( p_demux, AVI_INDEX_CACHE, p_rec, sizeof( *p_rec ),
+                      i_count );
+    free( p_rec );
+}
+
+/* Tells whether the index scan stopped at the end of the data, rather than
+ * on an interruption or a read error, so that its result can be cached */
+static bool AVI_IndexScanEnded( demux_t *p_demux, off_t i_movi_end )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint64_t i_pos = stream_Tell( p_demux->s );
+
+    if( vlc_killed() )
+        return false;
+    if( !p_sys->b_odml && i_pos >= (uint64_t)i_movi_end )
+        return true;
+    /* AVI_PacketGetHeader() needs 16 bytes */
+    return i_pos + 16 > stream_Size( p_demux->s );
+}
+
 static void AVI_IndexCreate( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -2552,6 +2640,8 @@ static void AVI_IndexCreate( demux_t *p_demux )
 
     mtime_t i_dialog_update;
     dialog_progress_bar_t *p_dialog = NULL;
+    bool b_cancelled = false;
+    bool b_complete = false;
 
     p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0);
     p_movi = AVI_ChunkFind( p_riff, AVIFOURCC_movi, 0);
@@ -2565,6 +2655,9 @@ static void AVI_IndexCreate( demux_t *p_demux )
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
         avi_index_Init( &p_sys->track[i_stream]->idx );
 
+    if( AVI_IndexCacheLoad( p_demux ) )
+        goto print_stat;
+
     i_movi_end = __MIN( (off_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
                         stream_Size( p_demux->s ) );
 
@@ -2586,7 +2679,10 @@ static void AVI_IndexCreate( demux_t *p_demux )
         if( p_dialog && mdate() - i_dialog_update > 100000 )
         {
             if( dialog_ProgressCancelled( p_dialog ) )
+            {
+                b_cancelled = true;
                 break;
+            }
 
             double f_current = stream_Tell( p_demux->s );
             double f_size    = stream_Size( p_demux->s );
@@ -2597,7 +2693,10 @@ static void AVI_IndexCreate( demux_t *p_demux )
         }
 
         if( AVI_PacketGetHeader( p_demux, &pk ) )
+        {
+            b_complete = AVI_IndexScanEnded( p_demux, i_movi_end );
             break;
+        }
 
         if( pk.i_stream < p_sys->i_track &&
             pk.i_cat == p_sys->track[pk.i_stream]->i_cat )
@@ -2628,7 +2727,8 @@ static void AVI_IndexCreate( demux_t *p_demux )
                         goto print_stat;
                     break;
                 }
-                goto print_stat;
+                b_complete = true;
+                goto scan_end;
 
             case AVIFOURCC_RIFF:
                     msg_Dbg( p_demux, "new RIFF chunk found" );
@@ -2643,18 +2743,32 @@ static void AVI_IndexCreate( demux_t *p_demux )
                 if( AVI_PacketSearch( p_demux ) )
                 {
                     msg_Warn( p_demux, "lost sync, abord index creation" );
-                    goto print_stat;
+                    b_complete = AVI_IndexScanEnded( p_demux, i_movi_end );
+                    goto scan_end;
                 }
             }
         }
 
-        if( ( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end ) ||
-            AVI_PacketNext( p_demux ) )
+        if( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end )
         {
+            b_complete = true;
+            break;
+        }
+        if( AVI_PacketNext( p_demux ) )
+        {
+            b_complete = AVI_IndexScanEnded( p_demux, i_movi_end );
             break;
         }
     }
 
+scan_end:
+    /* Only cache an index that covers the whole movi list (or the file):
+     * a cancelled, interrupted or failed scan would be stored truncated.
+     * Losing the synchronization at the end of the data is deterministic
+     * and the resulting index is kept. */
+    if( b_complete && !b_cancelled && !vlc_killed() )
+        AVI_IndexCacheStore( p_demux );
+
 print_stat:
     if( p_dialog != NULL )
         dialog_ProgressDestroy( p_dialog );
@@ -34,6 +34,7 @@
 #include "mpd/ProgramInformation.h"
 #include "xml/DOMParser.h"
 #include "../adaptative/logic/RateBasedAdaptationLogic.h"
+#include "../adaptative/logic/BufferBasedAdaptationLogic.h"
 #include "../adaptative/tools/Helper.h"
 #include <vlc_stream.h>
 #include <vlc_demux.h>
@@ -230,6 +231,12 @@ AbstractAdaptationLogic *DASHManager::createLogic(AbstractAdaptationLogic::Logic
             int height = var_InheritInteger(p_demux, "adaptative-height");
             return new (std::nothrow) RateBasedAdaptationLogic(width, height);
         }
+        case AbstractAdaptationLogic::BufferBased:
+        {
+            int width = var_InheritInteger(p_demux, "adaptative-width");
+            int height = var_InheritInteger(p_demux, "adaptative-height");
+            return new (std::nothrow) BufferBasedAdaptationLogic(width, height);
+        }
         default:
             return PlaylistManager::createLogic(type);
     }
@@ -24,6 +24,7 @@
 
 #include "HLSManager.hpp"
 #include "../adaptative/logic/RateBasedAdaptationLogic.h"
+#include "../adaptative/logic/BufferBasedAdaptationLogic.h"
 #include "../adaptative/tools/Retrieve.hpp"
 #include "playlist/Parser.hpp"
 #include <vlc_stream.h>
@@ -118,6 +119,12 @@ AbstractAdaptationLogic *HLSManager::createLogic(AbstractAdaptationLogic::LogicT
             int height = var_InheritInteger(p_demux, "adaptative-height");
             return new (std::nothrow) RateBasedAdaptationLogic(width, height);
         }
+        case AbstractAdaptationLogic::BufferBased:
+        {
+            int width = var_InheritInteger(p_demux, "adaptative-width");
+            int height = var_InheritInteger(p_demux, "adaptative-height");
+            return new (std::nothrow) BufferBasedAdaptationLogic(width, height);
+        }
         default:
             return PlaylistManager::createLogic(type);
     }
@@ -28,6 +28,8 @@
 #include "util.hpp"
 #include "Ebml_parser.hpp"
 
+#include <climits>
+
 matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estream )
     :segment(NULL)
     ,es(estream)
@@ -52,6 +54,8 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,b_cues(false)
     ,i_index(0)
     ,i_index_max(1024)
+    ,psz_index_cache(NULL)
+    ,i_index_cached(0)
     ,psz_muxing_application(NULL)
     ,psz_writing_application(NULL)
     ,psz_segment_filename(NULL)
@@ -83,6 +87,8 @@ matroska_segment_c::~matroska_segment_c()
     free( psz_segment_filename );
     free( psz_title );
     free( psz_date_utc );
+    IndexCacheStore();
+    free( psz_index_cache );
     free( p_indexes );
 
     delete ep;
@@ -233,7 +239,7 @@ void matroska_segment_c::LoadCues( KaxCues *cues )
                 i_index++;
                 if( i_index >= i_index_max )
                 {
-                    i_index_max += 1024;
+                    i_index_max *= 2;
                     p_indexes = (mkv_index_t*)xrealloc( p_indexes,
                                                         sizeof( mkv_index_t ) * i_index_max );
                 }
@@ -604,13 +610,54 @@ void matroska_segment_c::IndexAppendCluster( KaxCluster *cluster )
     i_index++;
     if( i_index >= i_index_max )
     {
-        i_index_max += 1024;
+        i_index_max *= 2;
         p_indexes = (mkv_index_t*)xrealloc( p_indexes,
                                         sizeof( mkv_index_t ) * i_index_max );
     }
 #undef idx
 }
 
+/* Without cues, the clusters index is built while seeking and playing.
+ * Reuse the one built on a previous opening of the same file. */
+void matroska_segment_c::IndexCacheLoad( size_t i_segment )
+{
+    if( b_cues || psz_index_cache != NULL )
+        return;
+    if( asprintf( &psz_index_cache, "mkv-1-segment-%zu", i_segment ) == -1 )
+    {
+        psz_index_cache = NULL;
+        return;
+    }
+
+    block_t *p_block = demux_IndexLoad( &sys.demuxer, psz_index_cache,
+                                        sizeof( mkv_index_t ) );
+    if( p_block == NULL )
+        return;
+
+    size_t i_count = p_block->i_buffer / sizeof( mkv_index_t );
+    if( i_count > 0 && i_count < INT_MAX / 2 )
+    {
+        if( i_count >= (size_t)i_index_max )
+        {
+            i_index_max = 2 * i_count;
+            p_indexes = (mkv_index_t*)xrealloc( p_indexes,
+                                        sizeof( mkv_index_t ) * i_index_max );
+        }
+        memcpy( p_indexes, p_block->p_buffer, sizeof( mkv_index_t ) * i_count );
+        i_index = i_index_cached = i_count;
+    }
+    block_Release( p_block );
+}
+
+void matroska_segment_c::IndexCacheStore()
+{
+    if( psz_index_cache == NULL || b_cues || i_index <= i_index_cached )
+        return;
+
+    demux_IndexStore( &sys.demuxer, psz_index_cache, p_indexes,
+                      sizeof( mkv_index_t ), i_index );
+}
+
 bool matroska_segment_c::PreloadFamily( const matroska_segment_c & of_segment )
 {
     if ( b_preloaded )
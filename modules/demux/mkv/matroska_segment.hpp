@@ -110,6 +110,8 @@ public:
     int                     i_index;
     int                     i_index_max;
     mkv_index_t             *p_indexes;
+    char                    *psz_index_cache;
+    int                     i_index_cached;
 
     /* info */
     char                    *psz_muxing_application;
@@ -135,6 +137,7 @@ public:
 
     bool Preload();
     bool PreloadFamily( const matroska_segment_c & segment );
+    void IndexCacheLoad( size_t i_segment );
     void InformationCreate();
     void Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int64_t i_global_position );
     int BlockGet( KaxBlock * &, KaxSimpleBlock * &, bool *, bool *, int64_t *);
@@ -161,6 +164,7 @@ private:
     void ParseCluster( KaxCluster *cluster, bool b_update_start_time = true, ScopeMode read_fully = SCOPE_ALL_DATA );
     SimpleTag * ParseSimpleTags( KaxTagSimple *tag, int level = 50 );
     void IndexAppendCluster( KaxCluster *cluster );
+    void IndexCacheStore();
     int32_t TrackInit( mkv_track_t * p_tk );
     void ComputeTrackPriority();
     void EnsureDuration();
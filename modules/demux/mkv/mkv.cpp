@@ -135,6 +135,7 @@ static int Open( vlc_object_t * p_this )
     for (size_t i=0; i<p_stream->segments.size(); i++)
     {
         p_stream->segments[i]->Preload();
+        p_stream->segments[i]->IndexCacheLoad( i );
         b_need_preload |= p_stream->segments[i]->b_ref_external_segments;
     }
 
@@ -35,6 +35,7 @@
 
 #include <assert.h>
 #include <time.h>
+#include <sys/stat.h>
 
 #include <vlc_access.h>    /* DVB-specific things */
 #include <vlc_demux.h>
@@ -42,6 +43,7 @@
 #include <vlc_epg.h>
 #include <vlc_charset.h>   /* FromCharset, for EIT */
 #include <vlc_bits.h>
+#include <vlc_fs.h>         /* vlc_stat, for the seek index */
 
 #include "../../mux/mpeg/csa.h"
 
@@ -72,6 +74,7 @@
 
 #include "pes.h"
 #include "mpeg4_iod.h"
+#include "ts_index.h"
 
 #ifdef HAVE_ARIBB24
  #include <aribb24/aribb24.h>
@@ -134,6 +137,12 @@ static void Close ( vlc_object_t * );
     "Seek and position based on a percent byte position, not a PCR generated " \
     "time position. If seeking doesn't work property, turn on this option." )
 
+#define SEEK_INDEX_TEXT N_("Persistent seek index")
+#define SEEK_INDEX_LONGTEXT N_( \
+    "Store the time to position index built while playing local files in a " \
+    "side file (with the .vlcidx extension), so that next openings do not " \
+    "need to probe and search the file when seeking." )
+
 #define PCR_TEXT N_("Trust in-stream PCR")
 #define PCR_LONGTEXT N_("Use the stream PCR as a reference.")
 
@@ -169,6 +178,7 @@ vlc_module_begin ()
 
     add_bool( "ts-split-es", true, SPLIT_ES_TEXT, SPLIT_ES_LONGTEXT, false )
     add_bool( "ts-seek-percent", false, SEEK_PERCENT_TEXT, SEEK_PERCENT_LONGTEXT, true )
+    add_bool( "ts-seek-index", false, SEEK_INDEX_TEXT, SEEK_INDEX_LONGTEXT, true )
 
     add_integer( "ts-arib", ARIBMODE_AUTO, SUPPORT_ARIB_TEXT, SUPPORT_ARIB_LONGTEXT, false )
         change_integer_list( arib_mode_list, arib_mode_list_text )
@@ -332,6 +342,7 @@ struct ts_pid_t
         int i_pcr_count;
     } probed;
 
+    uint64_t    i_packets; /* packets demuxed on that pid */
 };
 
 typedef struct
@@ -344,6 +355,7 @@ typedef struct
 #define MIN_PAT_INTERVAL CLOCK_FREQ // DVB is 500ms
 
 #define PID_ALLOC_CHUNK 16
+#define TS_PID_COUNT 8192
 
 struct demux_sys_t
 {
@@ -361,6 +373,26 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
 
+    /* packets read ahead by chunks, walked in place */
+    struct
+    {
+        uint8_t *p_buffer;
+        size_t   i_alloc;
+        size_t   i_size;   /* bytes read from the stream */
+        size_t   i_offset; /* bytes already demuxed */
+        int64_t  i_base;   /* stream position of the buffer */
+        int64_t  i_pkt_pos; /* position of the current packet, -1 if none */
+    } batch;
+
+    /* time to position index, for seekable streams */
+    struct
+    {
+        ts_index_t *p_index;
+        char       *psz_path; /* side file, NULL if not persistent */
+        uint64_t    i_size;
+        int64_t     i_mtime;
+    } index;
+
     bool        b_force_seek_per_percent;
 
     struct
@@ -381,9 +413,8 @@ struct demux_sys_t
         ts_pid_t **pp_all;
         int        i_all;
         int        i_all_alloc;
-        /* last recently used */
-        uint16_t   i_last_pid;
-        ts_pid_t  *p_last;
+        /* direct lookup by pid value, including the common ones */
+        ts_pid_t  *p_index[TS_PID_COUNT];
     } pids;
 
     bool        b_user_pmt;
@@ -468,9 +499,9 @@ static bool ProgramIsSelected( demux_sys_t *, uint16_t i_pgrm );
 static void UpdatePESFilters( demux_t *p_demux, bool b_all );
 static inline void FlushESBuffer( ts_pes_t *p_pes );
 static void UpdateScrambledState( demux_t *p_demux, ts_pid_t *p_pid, bool );
-static inline int PIDGet( block_t *p )
+static inline int PIDGet( const uint8_t *p )
 {
-    return ( (p->p_buffer[1]&0x1f)<<8 )|p->p_buffer[2];
+    return ( (p[1]&0x1f)<<8 )|p[2];
 }
 
 static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk );
@@ -478,11 +509,18 @@ static void AddAndCreateES( demux_t *p_demux, ts_pid_t *pid, bool );
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static uint8_t *ReadTSPacketBatched( demux_t *p_demux );
+static inline void FlushTSBatch( demux_sys_t *p_sys )
+{
+    p_sys->batch.i_size = p_sys->batch.i_offset = 0;
+    p_sys->batch.i_pkt_pos = -1;
+}
+static void IndexProgramPosition( demux_t *, ts_pmt_t *, mtime_t i_pcr, bool b_rap );
 static int ProbeStart( demux_t *p_demux, int i_program );
 static int ProbeEnd( demux_t *p_demux, int i_program );
 static int SeekToTime( demux_t *p_demux, ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
-static void PCRHandle( demux_t *p_demux, ts_pid_t *, block_t * );
+static void PCRHandle( demux_t *p_demux, ts_pid_t *, const uint8_t * );
 static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 static int64_t TimeStampWrapAround( ts_pmt_t *, int64_t );
 
@@ -503,6 +541,9 @@ static int  SetPIDFilter( demux_sys_t *, ts_pid_t *, bool b_selected );
 #define TS_PACKET_SIZE_MAX 204
 #define TS_HEADER_SIZE 4
 
+/* Number of packets read from the stream at once by Demux() */
+#define TS_BATCH_PACKETS 256
+
 static int DetectPacketSize( demux_t *p_demux, unsigned *pi_header_size, int i_offset )
 {
     const uint8_t *p_peek;
@@ -999,10 +1040,15 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->pids.dummy.i_pid = 8191;
     p_sys->pids.dummy.i_flags = FLAG_SEEN;
+    p_sys->pids.p_index[0] = &p_sys->pids.pat;
+    p_sys->pids.p_index[0x1FFF] = &p_sys->pids.dummy;
 
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
+    p_sys->batch.p_buffer = NULL;
+    p_sys->batch.i_alloc = 0;
+    FlushTSBatch( p_sys );
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -1131,6 +1177,27 @@ static int Open( vlc_object_t *p_this )
     stream_Control( p_sys->stream, STREAM_CAN_SEEK, &p_sys->b_canseek );
     stream_Control( p_sys->stream, STREAM_CAN_FASTSEEK, &p_sys->b_canfastseek );
 
+    if( p_sys->b_canseek )
+    {
+        struct stat st;
+        if( p_demux->psz_file && var_InheritBool( p_demux, "ts-seek-index" ) &&
+            vlc_stat( p_demux->psz_file, &st ) == 0 &&
+            asprintf( &p_sys->index.psz_path, "%s.vlcidx", p_demux->psz_file ) != -1 )
+        {
+            p_sys->index.i_size = st.st_size;
+            p_sys->index.i_mtime = st.st_mtime;
+            p_sys->index.p_index = ts_index_Load( p_this, p_sys->index.psz_path,
+                                                  p_sys->index.i_size,
+                                                  p_sys->index.i_mtime,
+                                                  p_sys->i_packet_size );
+        }
+        else
+            p_sys->index.psz_path = NULL;
+
+        if( !p_sys->index.p_index )
+            p_sys->index.p_index = ts_index_New( p_sys->i_packet_size );
+    }
+
     /* Preparse time */
     if( p_sys->b_canseek )
     {
@@ -1154,6 +1221,24 @@ static void Close( vlc_object_t *p_this )
     demux_t     *p_demux = (demux_t*)p_this;
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    if( p_sys->index.p_index )
+    {
+        ts_index_t *p_index = p_sys->index.p_index;
+        ts_pmt_t *p_pmt = GetProgramByID( p_sys, p_index->i_program );
+        if( p_pmt && ( p_index->i_first_pcr != p_pmt->pcr.i_first ||
+                       p_index->i_last_dts != p_pmt->i_last_dts ) )
+        {
+            p_index->i_first_pcr = p_pmt->pcr.i_first;
+            p_index->i_last_dts = p_pmt->i_last_dts;
+            p_index->b_dirty = true;
+        }
+        if( p_sys->index.psz_path && p_index->b_dirty && p_index->i_program )
+            ts_index_Save( p_this, p_index, p_sys->index.psz_path,
+                           p_sys->index.i_size, p_sys->index.i_mtime );
+        ts_index_Delete( p_index );
+        free( p_sys->index.psz_path );
+    }
+
     PIDRelease( p_demux, GetPID(p_sys, 0) );
 
     if( p_sys->b_dvb_meta )
@@ -1187,6 +1272,14 @@ static void Close( vlc_object_t *p_this )
 
     vlc_mutex_destroy( &p_sys->csa_lock );
 
+    /* Per pid demux statistics */
+    for( unsigned i = 0; i < TS_PID_COUNT; i++ )
+    {
+        const ts_pid_t *pid = p_sys->pids.p_index[i];
+        if( pid && pid->i_packets )
+            msg_Dbg( p_demux, "pid[%u] demuxed %"PRIu64" packets", i, pid->i_packets );
+    }
+
     /* Release all non default pids */
     for( int i = 0; i < p_sys->pids.i_all; i++ )
     {
@@ -1198,6 +1291,7 @@ static void Close( vlc_object_t *p_this )
         free( pid );
     }
     free( p_sys->pids.pp_all );
+    free( p_sys->batch.p_buffer );
 
     free( p_sys );
 }
@@ -1236,28 +1330,42 @@ static int Demux( demux_t *p_demux )
     if( p_sys->i_pmt_es == 0 && !SEEN(GetPID(p_sys, 0)) && p_sys->patfix.b_pat_deadline )
         MissingPATPMTFixup( p_demux );
 
+    if( p_sys->b_start_record )
+    {
+        /* The recording gets the data read from the stream from now on: the
+         * packets already read ahead in the batch must be read again */
+        stream_Control( p_sys->stream, STREAM_SET_RECORD_STATE, true, "ts" );
+        p_sys->b_start_record = false;
+
+        const size_t i_avail = p_sys->batch.i_size - p_sys->batch.i_offset;
+        if( i_avail > 0 )
+        {
+            if( !stream_Seek( p_sys->stream,
+                              p_sys->batch.i_base + p_sys->batch.i_offset ) )
+                FlushTSBatch( p_sys );
+            else
+                msg_Warn( p_demux, "%zu bytes read ahead are not recorded",
+                          i_avail );
+        }
+    }
+
     /* We read at most 100 TS packet or until a frame is completed */
     for( unsigned i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
     {
         bool         b_frame = false;
-        block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
+        uint8_t     *p_pkt;
+        if( !(p_pkt = ReadTSPacketBatched( p_demux )) )
         {
             return VLC_DEMUXER_EOF;
         }
-
-        if( p_sys->b_start_record )
-        {
-            /* Enable recording once synchronized */
-            stream_Control( p_sys->stream, STREAM_SET_RECORD_STATE, true, "ts" );
-            p_sys->b_start_record = false;
-        }
+        const size_t i_pkt_size = p_sys->i_packet_size - p_sys->i_packet_header_size;
 
         /* Parse the TS packet */
         ts_pid_t *p_pid = GetPID( p_sys, PIDGet( p_pkt ) );
+        p_pid->i_packets++;
 
-        if( SCRAMBLED(*p_pid) != !!(p_pkt->p_buffer[3] & 0x80) )
-            UpdateScrambledState( p_demux, p_pid, p_pkt->p_buffer[3] & 0x80 );
+        if( SCRAMBLED(*p_pid) != !!(p_pkt[3] & 0x80) )
+            UpdateScrambledState( p_demux, p_pid, p_pkt[3] & 0x80 );
 
         if( !SEEN(p_pid) )
         {
@@ -1267,34 +1375,30 @@ static int Demux( demux_t *p_demux )
         }
 
         if ( SCRAMBLED(*p_pid) && !p_demux->p_sys->csa )
-        {
-            block_Release( p_pkt );
             continue;
-        }
 
         /* Probe streams to build PAT/PMT after MIN_PAT_INTERVAL in case we don't see any PAT */
         if( !SEEN( GetPID( p_sys, 0 ) ) &&
             (p_pid->probed.i_type == 0 || p_pid->i_pid == p_sys->patfix.i_timesourcepid) &&
-            (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
-            (p_pkt->p_buffer[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
+            (p_pkt[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
+            (p_pkt[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
         {
-            ProbePES( p_demux, p_pid, p_pkt->p_buffer + TS_HEADER_SIZE,
-                      p_pkt->i_buffer - TS_HEADER_SIZE, p_pkt->p_buffer[3] & 0x20 /* Adaptation field */);
+            ProbePES( p_demux, p_pid, p_pkt + TS_HEADER_SIZE,
+                      i_pkt_size - TS_HEADER_SIZE, p_pkt[3] & 0x20 /* Adaptation field */);
         }
 
         switch( p_pid->type )
         {
         case TYPE_PAT:
-            dvbpsi_packet_push( p_pid->u.p_pat->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+            dvbpsi_packet_push( p_pid->u.p_pat->handle, p_pkt );
             break;
 
         case TYPE_PMT:
-            dvbpsi_packet_push( p_pid->u.p_pmt->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+            dvbpsi_packet_push( p_pid->u.p_pmt->handle, p_pkt );
             break;
 
         case TYPE_PES:
+        {
             p_sys->b_end_preparse = true;
 
             if( p_sys->es_creation == DELAY_ES ) /* No longer delay ES since that pid's program sends data */
@@ -1306,25 +1410,37 @@ static int Demux( demux_t *p_demux )
             if( !p_sys->b_access_control && !(p_pid->i_flags & FLAG_FILTERED) )
             {
                 /* That packet is for an unselected ES, don't waste time/memory gathering its data */
-                block_Release( p_pkt );
                 continue;
             }
 
-            b_frame = GatherData( p_demux, p_pid, p_pkt );
+            /* Remember video random access points for seeking */
+            if( (p_pkt[3] & 0x20) && p_pkt[4] > 0 && (p_pkt[5] & 0x40) &&
+                p_pid->p_parent && p_pid->u.p_pes->es.fmt.i_cat == VIDEO_ES )
+            {
+                ts_pmt_t *p_pmt = p_pid->p_parent->u.p_pmt;
+                IndexProgramPosition( p_demux, p_pmt, p_pmt->pcr.i_current, true );
+            }
+
+            /* Only packets whose payload is gathered are copied into a block */
+            block_t *p_bk = block_Alloc( i_pkt_size );
+            if( unlikely(p_bk == NULL) )
+                continue;
+            memcpy( p_bk->p_buffer, p_pkt, i_pkt_size );
+
+            b_frame = GatherData( p_demux, p_pid, p_bk );
             break;
+        }
 
         case TYPE_SDT:
         case TYPE_TDT:
         case TYPE_EIT:
             if( p_sys->b_dvb_meta )
-                dvbpsi_packet_push( p_pid->u.p_psi->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+                dvbpsi_packet_push( p_pid->u.p_psi->handle, p_pkt );
             break;
 
         default:
             /* We have to handle PCR if present */
             PCRHandle( p_demux, p_pid, p_pkt );
-            block_Release( p_pkt );
             break;
         }
 
@@ -1483,7 +1599,9 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
-            int64_t offset = stream_Tell( p_sys->stream );
+            /* Packets read ahead but not demuxed yet */
+            int64_t offset = stream_Tell( p_sys->stream ) -
+                             (p_sys->batch.i_size - p_sys->batch.i_offset);
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -1676,6 +1794,39 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     case DEMUX_GET_SIGNAL:
         return stream_vaControl( p_sys->stream, STREAM_GET_SIGNAL, args );
 
+    case DEMUX_GET_PACKET_STATS:
+    {
+        demux_packet_stats_t **pp_stats = va_arg( args, demux_packet_stats_t ** );
+        size_t *pi_stats = va_arg( args, size_t * );
+        size_t i_count = 0;
+
+        for( unsigned i = 0; i < TS_PID_COUNT; i++ )
+        {
+            const ts_pid_t *pid = p_sys->pids.p_index[i];
+            if( pid && pid->i_packets )
+                i_count++;
+        }
+
+        demux_packet_stats_t *p_stats = malloc( i_count * sizeof(*p_stats) );
+        if( i_count > 0 && p_stats == NULL )
+            return VLC_ENOMEM;
+
+        i_count = 0;
+        for( unsigned i = 0; i < TS_PID_COUNT; i++ )
+        {
+            const ts_pid_t *pid = p_sys->pids.p_index[i];
+            if( pid && pid->i_packets )
+            {
+                p_stats[i_count].i_id = i;
+                p_stats[i_count].i_packets = pid->i_packets;
+                i_count++;
+            }
+        }
+        *pp_stats = p_stats;
+        *pi_stats = i_count;
+        return VLC_SUCCESS;
+    }
+
     default:
         break;
     }
@@ -2560,6 +2711,81 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     return p_pkt;
 }
 
+/* Returns the next TS packet (without its additional header) from a chunk
+ * read at once from the stream. The returned data is only valid until the
+ * next call or until FlushTSBatch() */
+static uint8_t *ReadTSPacketBatched( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_packet_size = p_sys->i_packet_size;
+    const size_t i_header_size = p_sys->i_packet_header_size;
+    bool b_synced = true;
+
+    if( unlikely(p_sys->batch.p_buffer == NULL) )
+    {
+        p_sys->batch.i_alloc = i_packet_size * TS_BATCH_PACKETS;
+        p_sys->batch.p_buffer = malloc( p_sys->batch.i_alloc );
+        if( !p_sys->batch.p_buffer )
+            return NULL;
+    }
+
+    for( ;; )
+    {
+        uint8_t *p_buffer = p_sys->batch.p_buffer;
+        size_t i_avail = p_sys->batch.i_size - p_sys->batch.i_offset;
+
+        /* Keep one extra byte available to check the next sync byte */
+        if( i_avail < i_packet_size + 1 )
+        {
+            memmove( p_buffer, &p_buffer[p_sys->batch.i_offset], i_avail );
+            p_sys->batch.i_offset = 0;
+            p_sys->batch.i_size = i_avail;
+            p_sys->batch.i_base = stream_Tell( p_sys->stream ) - i_avail;
+
+            ssize_t i_read = stream_Read( p_sys->stream, &p_buffer[i_avail],
+                                          p_sys->batch.i_alloc - i_avail );
+            if( i_read > 0 )
+            {
+                p_sys->batch.i_size += i_read;
+                i_avail += i_read;
+            }
+            if( i_avail < i_packet_size )
+            {
+                if( stream_Tell( p_sys->stream ) == stream_Size( p_sys->stream ) )
+                    msg_Dbg( p_demux, "EOF at %"PRId64, stream_Tell( p_sys->stream ) );
+                else
+                    msg_Dbg( p_demux, "Can't read TS packet at %"PRId64, stream_Tell(p_sys->stream) );
+                FlushTSBatch( p_sys );
+                return NULL;
+            }
+        }
+
+        uint8_t *p_pkt = &p_buffer[p_sys->batch.i_offset];
+        if( p_pkt[i_header_size] == 0x47 )
+        {
+            p_sys->batch.i_pkt_pos = p_sys->batch.i_base + p_sys->batch.i_offset;
+            p_sys->batch.i_offset += i_packet_size;
+            return &p_pkt[i_header_size];
+        }
+
+        /* Re-sync inside the chunk, requiring two consecutive sync bytes */
+        if( b_synced )
+        {
+            msg_Warn( p_demux, "lost synchro" );
+            b_synced = false;
+        }
+
+        size_t i_skip = 1;
+        while( i_skip + i_header_size + i_packet_size < i_avail &&
+               ( p_pkt[i_skip + i_header_size] != 0x47 ||
+                 p_pkt[i_skip + i_header_size + i_packet_size] != 0x47 ) )
+            i_skip++;
+
+        msg_Dbg( p_demux, "skipping %zu bytes of garbage", i_skip );
+        p_sys->batch.i_offset += i_skip;
+    }
+}
+
 static int64_t TimeStampWrapAround( ts_pmt_t *p_pmt, int64_t i_time )
 {
     int64_t i_adjust = 0;
@@ -2569,10 +2795,8 @@ static int64_t TimeStampWrapAround( ts_pmt_t *p_pmt, int64_t i_time )
     return i_time + i_adjust;
 }
 
-static mtime_t GetPCR( block_t *p_pkt )
+static mtime_t GetPCR( const uint8_t *p )
 {
-    const uint8_t *p = p_pkt->p_buffer;
-
     mtime_t i_pcr = -1;
 
     if( ( p[3]&0x20 ) && /* adaptation */
@@ -2637,6 +2861,10 @@ static void ReadyQueuesPostSeek( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    FlushTSBatch( p_sys );
+    if( p_sys->index.p_index )
+        ts_index_Break( p_sys->index.p_index );
+
     ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
     for( int i=0; i< p_pat->programs.i_size; i++ )
     {
@@ -2681,6 +2909,15 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
     if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
         return stream_Seek( p_sys->stream, 0 );
 
+    /* Use the positions seen while playing if they cover that time */
+    if( p_sys->index.p_index && p_sys->index.p_index->i_program == p_pmt->i_number )
+    {
+        const ts_index_entry_t *p_entry = ts_index_Lookup( p_sys->index.p_index,
+                                                           i_scaledtime );
+        if( p_entry && stream_Seek( p_sys->stream, p_entry->i_pos ) == VLC_SUCCESS )
+            return VLC_SUCCESS;
+    }
+
     if( !p_sys->b_canfastseek )
         return VLC_EGENERIC;
 
@@ -2716,7 +2953,7 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
             else
                 i_pos = stream_Tell( p_sys->stream );
 
-            int i_pid = PIDGet( p_pkt );
+            int i_pid = PIDGet( p_pkt->p_buffer );
             if( i_pid != 0x1FFF && GetPID(p_sys, i_pid)->type == TYPE_PES &&
                 GetPID(p_sys, i_pid)->p_parent->u.p_pmt == p_pmt &&
                (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
@@ -2728,7 +2965,7 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
                 {
                     if( p_pkt->i_buffer >= 4 + 2 + 5 )
                     {
-                        i_pcr = GetPCR( p_pkt );
+                        i_pcr = GetPCR( p_pkt->p_buffer );
                         i_skip += 1 + p_pkt->p_buffer[4];
                     }
                 }
@@ -2776,27 +3013,11 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
 
 static ts_pid_t *GetPID( demux_sys_t *p_sys, uint16_t i_pid )
 {
-    switch( i_pid )
-    {
-        case 0:
-            return &p_sys->pids.pat;
-        case 0x1FFF:
-            return &p_sys->pids.dummy;
-        default:
-            if( p_sys->pids.i_last_pid == i_pid )
-                return p_sys->pids.p_last;
-        break;
-    }
+    assert( i_pid < TS_PID_COUNT );
+    i_pid &= TS_PID_COUNT - 1;
 
-    for( int i=0; i < p_sys->pids.i_all; i++ )
-    {
-        if( p_sys->pids.pp_all[i]->i_pid == i_pid )
-        {
-            p_sys->pids.p_last = p_sys->pids.pp_all[i];
-            p_sys->pids.i_last_pid = i_pid;
-            return p_sys->pids.p_last;
-        }
-    }
+    if( likely(p_sys->pids.p_index[i_pid] != NULL) )
+        return p_sys->pids.p_index[i_pid];
 
     if( p_sys->pids.i_all >= p_sys->pids.i_all_alloc )
     {
@@ -2817,9 +3038,7 @@ static ts_pid_t *GetPID( demux_sys_t *p_sys, uint16_t i_pid )
 
     p_pid->i_pid = i_pid;
     p_sys->pids.pp_all[p_sys->pids.i_all++] = p_pid;
-
-    p_sys->pids.p_last = p_pid;
-    p_sys->pids.i_last_pid = i_pid;
+    p_sys->pids.p_index[i_pid] = p_pid;
 
     return p_pid;
 }
@@ -2857,7 +3076,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
             break;
         }
 
-        const int i_pid = PIDGet( p_pkt );
+        const int i_pid = PIDGet( p_pkt->p_buffer );
         ts_pid_t *p_pid = GetPID(p_sys, i_pid);
 
         p_pid->i_flags |= FLAG_SEEN;
@@ -2868,7 +3087,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
             bool b_adaptfield = p_pkt->p_buffer[3] & 0x20;
 
             if( b_adaptfield && p_pkt->i_buffer >= 4 + 2 + 5 )
-                *pi_pcr = GetPCR( p_pkt );
+                *pi_pcr = GetPCR( p_pkt->p_buffer );
 
             if( *pi_pcr == -1 &&
                 (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* payload start */
@@ -3039,11 +3258,11 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
     }
 }
 
-static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pkt )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
 
-    mtime_t i_pcr = GetPCR( p_bk );
+    mtime_t i_pcr = GetPCR( p_pkt );
     if( i_pcr < 0 )
         return;
 
@@ -3068,6 +3287,7 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             {
                 /* ? update PCR for the whole group program ? */
                 ProgramSetPCR( p_demux, p_pmt, i_program_pcr );
+                IndexProgramPosition( p_demux, p_pmt, i_program_pcr, false );
             }
         }
         else /* set PCR provided by current pid to program(s) referencing it */
@@ -3077,12 +3297,34 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             {
                 /* We've found a target group for update */
                 ProgramSetPCR( p_demux, p_pmt, i_program_pcr );
+                IndexProgramPosition( p_demux, p_pmt, i_program_pcr, false );
             }
         }
 
     }
 }
 
+static void IndexProgramPosition( demux_t *p_demux, ts_pmt_t *p_pmt,
+                                  mtime_t i_pcr, bool b_rap )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_index_t *p_index = p_sys->index.p_index;
+
+    if( !p_index || i_pcr < 0 || p_sys->batch.i_pkt_pos < 0 )
+        return;
+
+    if( p_index->i_program == 0 )
+    {
+        if( !ProgramIsSelected( p_sys, p_pmt->i_number ) )
+            return;
+        p_index->i_program = p_pmt->i_number;
+    }
+    else if( p_index->i_program != p_pmt->i_number )
+        return;
+
+    ts_index_Add( p_index, i_pcr, p_sys->batch.i_pkt_pos, b_rap );
+}
+
 static int FindPCRCandidate( ts_pmt_t *p_pmt )
 {
     ts_pid_t *p_cand = NULL;
@@ -3252,7 +3494,7 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         }
     }
 
-    PCRHandle( p_demux, pid, p_bk );
+    PCRHandle( p_demux, pid, p_bk->p_buffer );
 
     if( i_skip >= 188 )
     {
@@ -5411,9 +5653,20 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
     /* Probe Boundaries */
     if( p_sys->b_canfastseek && p_pmt->i_last_dts == -1 )
     {
-        p_pmt->i_last_dts = 0;
-        ProbeStart( p_demux, p_pmt->i_number );
-        ProbeEnd( p_demux, p_pmt->i_number );
+        const ts_index_t *p_index = p_sys->index.p_index;
+        if( p_index && p_index->i_program == p_pmt->i_number &&
+            p_index->i_first_pcr > -1 && p_index->i_last_dts > 0 )
+        {
+            /* Already probed during a previous opening */
+            p_pmt->pcr.i_first = p_index->i_first_pcr;
+            p_pmt->i_last_dts = p_index->i_last_dts;
+        }
+        else
+        {
+            p_pmt->i_last_dts = 0;
+            ProbeStart( p_demux, p_pmt->i_number );
+            ProbeEnd( p_demux, p_pmt->i_number );
+        }
     }
 }
 
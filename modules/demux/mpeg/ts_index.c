@@ -0,0 +1,315 @@
+/*****************************************************************************
+ * ts_index.c: MPEG-TS PCR to byte offset seek index
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "ts_index.h"
+
+#define TS_INDEX_INTERVAL     90000 /* minimum spacing between entries (1s) */
+#define TS_INDEX_RAP_DISTANCE (5 * 90000) /* how far back to look for a RAP */
+#define TS_INDEX_ALLOC_CHUNK  1024
+
+#define TS_INDEX_MAGIC        "VLCTSIX1"
+#define TS_INDEX_HEADER_SIZE  (8 + 8 + 8 + 4 + 4 + 8 + 8 + 4)
+#define TS_INDEX_ENTRY_SIZE   (8 + 8 + 4)
+
+ts_index_t *ts_index_New( unsigned i_packet_size )
+{
+    ts_index_t *p_index = malloc( sizeof(*p_index) );
+    if( !p_index )
+        return NULL;
+
+    p_index->i_program = 0;
+    p_index->i_packet_size = i_packet_size;
+    p_index->i_first_pcr = -1;
+    p_index->i_last_dts = -1;
+    p_index->p_entries = NULL;
+    p_index->i_entries = 0;
+    p_index->i_alloc = 0;
+    p_index->i_last = -1;
+    p_index->b_dirty = false;
+    return p_index;
+}
+
+void ts_index_Delete( ts_index_t *p_index )
+{
+    free( p_index->p_entries );
+    free( p_index );
+}
+
+/* Returns the number of entries with a timestamp lower or equal to i_pcr */
+static size_t ts_index_Bisect( const ts_index_t *p_index, int64_t i_pcr )
+{
+    size_t i_low = 0, i_high = p_index->i_entries;
+    while( i_low < i_high )
+    {
+        size_t i_mid = i_low + (i_high - i_low) / 2;
+        if( p_index->p_entries[i_mid].i_pcr <= i_pcr )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+void ts_index_Add( ts_index_t *p_index, int64_t i_pcr, uint64_t i_pos, bool b_rap )
+{
+    size_t i_count = ts_index_Bisect( p_index, i_pcr );
+
+    if( i_count > 0 &&
+        i_pcr - p_index->p_entries[i_count - 1].i_pcr < TS_INDEX_INTERVAL )
+    {
+        /* Close to an existing entry, only upgrade it to a RAP. The next
+         * entry is at least an interval away so the order is kept. */
+        ts_index_entry_t *p_prev = &p_index->p_entries[i_count - 1];
+        if( b_rap && !(p_prev->i_flags & TS_INDEX_RAP) )
+        {
+            p_prev->i_pcr = i_pcr;
+            p_prev->i_pos = i_pos;
+            p_prev->i_flags |= TS_INDEX_RAP;
+            p_index->b_dirty = true;
+        }
+        if( p_index->i_last >= 0 && (size_t)p_index->i_last + 2 == i_count &&
+            !(p_prev->i_flags & TS_INDEX_CONTINUOUS) )
+        {
+            p_prev->i_flags |= TS_INDEX_CONTINUOUS;
+            p_index->b_dirty = true;
+        }
+        p_index->i_last = i_count - 1;
+        return;
+    }
+
+    if( i_count < p_index->i_entries &&
+        p_index->p_entries[i_count].i_pcr - i_pcr < TS_INDEX_INTERVAL )
+    {
+        /* Already covered by the next entry */
+        ts_index_entry_t *p_next = &p_index->p_entries[i_count];
+        if( p_index->i_last >= 0 && (size_t)p_index->i_last + 1 == i_count &&
+            !(p_next->i_flags & TS_INDEX_CONTINUOUS) )
+        {
+            p_next->i_flags |= TS_INDEX_CONTINUOUS;
+            p_index->b_dirty = true;
+        }
+        p_index->i_last = i_count;
+        return;
+    }
+
+    if( p_index->i_entries == p_index->i_alloc )
+    {
+        ts_index_entry_t *p_realloc =
+            realloc( p_index->p_entries, (p_index->i_alloc + TS_INDEX_ALLOC_CHUNK)
+                                         * sizeof(ts_index_entry_t) );
+        if( !p_realloc )
+            return;
+        p_index->p_entries = p_realloc;
+        p_index->i_alloc += TS_INDEX_ALLOC_CHUNK;
+    }
+
+    memmove( &p_index->p_entries[i_count + 1], &p_index->p_entries[i_count],
+             (p_index->i_entries - i_count) * sizeof(ts_index_entry_t) );
+    p_index->i_entries++;
+
+    ts_index_entry_t *p_entry = &p_index->p_entries[i_count];
+    p_entry->i_pcr = i_pcr;
+    p_entry->i_pos = i_pos;
+    p_entry->i_flags = b_rap ? TS_INDEX_RAP : 0;
+    if( p_index->i_last >= 0 && (size_t)p_index->i_last + 1 == i_count )
+        p_entry->i_flags |= TS_INDEX_CONTINUOUS;
+
+    p_index->i_last = i_count;
+    p_index->b_dirty = true;
+}
+
+void ts_index_Break( ts_index_t *p_index )
+{
+    p_index->i_last = -1;
+}
+
+const ts_index_entry_t *ts_index_Lookup( const ts_index_t *p_index, int64_t i_pcr )
+{
+    size_t i_count = ts_index_Bisect( p_index, i_pcr );
+    if( i_count == 0 )
+        return NULL;
+
+    const ts_index_entry_t *p_entries = p_index->p_entries;
+    size_t i_entry = i_count - 1;
+
+    /* The target must lie between two entries read without gap */
+    if( i_pcr - p_entries[i_entry].i_pcr >= TS_INDEX_INTERVAL &&
+        ( i_count == p_index->i_entries ||
+          !(p_entries[i_count].i_flags & TS_INDEX_CONTINUOUS) ) )
+        return NULL;
+
+    /* Prefer starting from a close random access point */
+    for( size_t i = i_entry; ; i-- )
+    {
+        if( i_pcr - p_entries[i].i_pcr > TS_INDEX_RAP_DISTANCE )
+            break;
+        if( p_entries[i].i_flags & TS_INDEX_RAP )
+            return &p_entries[i];
+        if( i == 0 || !(p_entries[i].i_flags & TS_INDEX_CONTINUOUS) )
+            break;
+    }
+    return &p_entries[i_entry];
+}
+
+ts_index_t *ts_index_Load( vlc_object_t *p_obj, const char *psz_path,
+                           uint64_t i_size, int64_t i_mtime,
+                           unsigned i_packet_size )
+{
+    uint8_t header[TS_INDEX_HEADER_SIZE];
+    struct stat st;
+
+    FILE *p_file = vlc_fopen( psz_path, "rb" );
+    if( !p_file )
+        return NULL;
+
+    ts_index_t *p_index = NULL;
+    if( fstat( fileno( p_file ), &st ) ||
+        st.st_size < TS_INDEX_HEADER_SIZE ||
+        fread( header, 1, sizeof(header), p_file ) != sizeof(header) ||
+        memcmp( header, TS_INDEX_MAGIC, 8 ) ||
+        GetQWBE( &header[8] ) != i_size ||
+        (int64_t)GetQWBE( &header[16] ) != i_mtime ||
+        GetDWBE( &header[24] ) != i_packet_size )
+    {
+        msg_Dbg( p_obj, "ignoring stale or invalid seek index %s", psz_path );
+        goto end;
+    }
+
+    p_index = ts_index_New( i_packet_size );
+    if( !p_index )
+        goto end;
+
+    p_index->i_program = GetDWBE( &header[28] );
+    p_index->i_first_pcr = GetQWBE( &header[32] );
+    p_index->i_last_dts = GetQWBE( &header[40] );
+    /* Do not trust the count beyond what the file can hold */
+    uint32_t i_entries = GetDWBE( &header[48] );
+    const uint64_t i_max = ( (uint64_t)st.st_size - TS_INDEX_HEADER_SIZE )
+                           / TS_INDEX_ENTRY_SIZE;
+    if( i_entries > i_max )
+        i_entries = i_max;
+    if( (uint64_t)i_entries > SIZE_MAX / sizeof(ts_index_entry_t) )
+    {
+        ts_index_Delete( p_index );
+        p_index = NULL;
+        goto end;
+    }
+
+    p_index->p_entries = malloc( i_entries * sizeof(ts_index_entry_t) );
+    if( i_entries && !p_index->p_entries )
+    {
+        ts_index_Delete( p_index );
+        p_index = NULL;
+        goto end;
+    }
+    p_index->i_alloc = i_entries;
+
+    for( size_t i = 0; i < i_entries; i++ )
+    {
+        uint8_t entry[TS_INDEX_ENTRY_SIZE];
+        if( fread( entry, 1, sizeof(entry), p_file ) != sizeof(entry) )
+            break;
+
+        ts_index_entry_t *p_entry = &p_index->p_entries[i];
+        p_entry->i_pcr = GetQWBE( &entry[0] );
+        p_entry->i_pos = GetQWBE( &entry[8] );
+        p_entry->i_flags = GetDWBE( &entry[16] );
+        if( p_entry->i_pos >= i_size ||
+            ( i > 0 && p_entry->i_pcr <= p_entry[-1].i_pcr ) )
+            break;
+        p_index->i_entries++;
+    }
+
+    msg_Dbg( p_obj, "loaded %zu seek index entries for program %d",
+             p_index->i_entries, p_index->i_program );
+end:
+    fclose( p_file );
+    return p_index;
+}
+
+int ts_index_Save( vlc_object_t *p_obj, const ts_index_t *p_index,
+                   const char *psz_path, uint64_t i_size, int64_t i_mtime )
+{
+    uint8_t header[TS_INDEX_HEADER_SIZE];
+    char *psz_tmp;
+
+    if( asprintf( &psz_tmp, "%s.tmp", psz_path ) == -1 )
+        return VLC_ENOMEM;
+
+    FILE *p_file = vlc_fopen( psz_tmp, "wb" );
+    if( !p_file )
+    {
+        msg_Warn( p_obj, "cannot create seek index %s: %s", psz_tmp,
+                  vlc_strerror_c(errno) );
+        free( psz_tmp );
+        return VLC_EGENERIC;
+    }
+
+    memcpy( header, TS_INDEX_MAGIC, 8 );
+    SetQWBE( &header[8], i_size );
+    SetQWBE( &header[16], i_mtime );
+    SetDWBE( &header[24], p_index->i_packet_size );
+    SetDWBE( &header[28], p_index->i_program );
+    SetQWBE( &header[32], p_index->i_first_pcr );
+    SetQWBE( &header[40], p_index->i_last_dts );
+    SetDWBE( &header[48], p_index->i_entries );
+
+    bool b_error = fwrite( header, 1, sizeof(header), p_file ) != sizeof(header);
+    for( size_t i = 0; i < p_index->i_entries && !b_error; i++ )
+    {
+        const ts_index_entry_t *p_entry = &p_index->p_entries[i];
+        uint8_t entry[TS_INDEX_ENTRY_SIZE];
+
+        SetQWBE( &entry[0], p_entry->i_pcr );
+        SetQWBE( &entry[8], p_entry->i_pos );
+        SetDWBE( &entry[16], p_entry->i_flags );
+        b_error = fwrite( entry, 1, sizeof(entry), p_file ) != sizeof(entry);
+    }
+
+    if( fclose( p_file ) )
+        b_error = true;
+
+    if( b_error || vlc_rename( psz_tmp, psz_path ) )
+    {
+        msg_Warn( p_obj, "cannot write seek index %s", psz_path );
+        vlc_unlink( psz_tmp );
+        free( psz_tmp );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_obj, "saved %zu seek index entries", p_index->i_entries );
+    free( psz_tmp );
+    return VLC_SUCCESS;
+}
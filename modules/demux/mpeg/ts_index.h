@@ -0,0 +1,73 @@
+/*****************************************************************************
+ * ts_index.h: MPEG-TS PCR to byte offset seek index
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_INDEX_H
+#define VLC_TS_INDEX_H
+
+/* Timestamps are in 90kHz units, already corrected for wrap around */
+
+enum
+{
+    TS_INDEX_RAP        = 1, /* offset of a random access point */
+    TS_INDEX_CONTINUOUS = 2, /* no gap since the previous entry */
+};
+
+typedef struct
+{
+    int64_t  i_pcr;
+    uint64_t i_pos;
+    uint32_t i_flags;
+} ts_index_entry_t;
+
+typedef struct
+{
+    int i_program;      /* program the timestamps belong to, 0 if unset */
+    unsigned i_packet_size;
+
+    /* program boundaries, as probed at open, -1 if unknown */
+    int64_t i_first_pcr;
+    int64_t i_last_dts;
+
+    ts_index_entry_t *p_entries;
+    size_t i_entries;
+    size_t i_alloc;
+
+    ssize_t i_last;     /* last entry of the current run, -1 after a seek */
+    bool b_dirty;
+} ts_index_t;
+
+ts_index_t *ts_index_New( unsigned i_packet_size );
+void ts_index_Delete( ts_index_t * );
+
+/* Records a point read sequentially. Entries are kept sorted and spaced */
+void ts_index_Add( ts_index_t *, int64_t i_pcr, uint64_t i_pos, bool b_rap );
+/* Must be called after any discontinuous read (seek) */
+void ts_index_Break( ts_index_t * );
+/* Returns the entry to seek to for reaching i_pcr, or NULL if the index does
+ * not cover that time */
+const ts_index_entry_t *ts_index_Lookup( const ts_index_t *, int64_t i_pcr );
+
+/* Sidecar file persistence, keyed by the indexed file size and mtime */
+ts_index_t *ts_index_Load( vlc_object_t *, const char *psz_path,
+                           uint64_t i_size, int64_t i_mtime,
+                           unsigned i_packet_size );
+int ts_index_Save( vlc_object_t *, const ts_index_t *, const char *psz_path,
+                   uint64_t i_size, int64_t i_mtime );
+
+#endif
@@ -43,6 +43,7 @@
 #include "../codec/cc.h"
 #include "h264_nal.h"
 #include "packetizer_helper.h"
+#include "startcode_helper.h"
 #include "../demux/mpeg/mpeg_parser_helpers.h"
 
 /*****************************************************************************
@@ -193,6 +194,7 @@ static int Open( vlc_object_t *p_this )
 
     packetizer_Init( &p_sys->packetizer,
                      p_h264_startcode, sizeof(p_h264_startcode),
+                     startcode_FindAnnexB,
                      p_h264_startcode, 1, 5,
                      PacketizeReset, PacketizeParse, PacketizeValidate, p_dec );
 
@@ -786,6 +788,8 @@ static block_t *OutputPicture( decoder_t *p_dec )
     p_pic->i_dts = p_sys->i_frame_dts;
     p_pic->i_pts = p_sys->i_frame_pts;
     p_pic->i_flags |= p_sys->slice.i_frame_type;
+    if( p_sys->slice.i_nal_ref_idc == 0 )
+        p_pic->i_flags |= BLOCK_FLAG_DISPOSABLE;
     p_pic->i_flags &= ~BLOCK_FLAG_PRIVATE_AUD;
     if( !p_sys->b_header )
         p_pic->i_flags |= BLOCK_FLAG_PREROLL;
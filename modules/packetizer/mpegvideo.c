@@ -53,6 +53,7 @@
 #include <vlc_block_helper.h>
 #include "../codec/cc.h"
 #include "packetizer_helper.h"
+#include "startcode_helper.h"
 
 #define SYNC_INTRAFRAME_TEXT N_("Sync on Intra Frame")
 #define SYNC_INTRAFRAME_LONGTEXT N_("Normally the packetizer would " \
@@ -168,6 +169,7 @@ static int Open( vlc_object_t *p_this )
     /* Misc init */
     packetizer_Init( &p_sys->packetizer,
                      p_mp2v_startcode, sizeof(p_mp2v_startcode),
+                     startcode_FindAnnexB,
                      NULL, 0, 4,
                      PacketizeReset, PacketizeParse, PacketizeValidate, p_dec );
 
@@ -469,7 +471,8 @@ static block_t *ParseMPEGBlock( decoder_t *p_dec, block_t *p_frag )
             p_pic->i_flags |= BLOCK_FLAG_TYPE_P;
             break;
         case 0x03:
-            p_pic->i_flags |= BLOCK_FLAG_TYPE_B;
+            /* B pictures are never used as reference */
+            p_pic->i_flags |= BLOCK_FLAG_TYPE_B | BLOCK_FLAG_DISPOSABLE;
             break;
         }
 
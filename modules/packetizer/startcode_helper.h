@@ -0,0 +1,155 @@
+/*****************************************************************************
+ * startcode_helper.h: Annex B start code lookup
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_STARTCODE_HELPER_H_
+#define VLC_STARTCODE_HELPER_H_
+
+#include <vlc_cpu.h>
+
+/* All functions return the first 00 00 01 sequence within [p, end), or NULL.
+ * They can be passed to block_FindStartcodeFromOffset() along with the
+ * 3 bytes start code of H.264, HEVC, MPEG video and VC-1. */
+
+static inline const uint8_t *startcode_FindAnnexB_Bytes( const uint8_t *p,
+                                                         const uint8_t *end )
+{
+    for( ; end - p >= 3; p++ )
+        if( p[0] == 0 && p[1] == 0 && p[2] == 1 )
+            return p;
+    return NULL;
+}
+
+/* Tests 8 bytes at once for a null byte, see
+ * https://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord */
+static inline const uint8_t *startcode_FindAnnexB_Bits( const uint8_t *p,
+                                                        const uint8_t *end )
+{
+    for( ; end - p >= 10; p += 8 )
+    {
+        uint64_t x;
+
+        memcpy( &x, p, sizeof( x ) );
+        if( (x - UINT64_C(0x0101010101010101)) & ~x
+                                               & UINT64_C(0x8080808080808080) )
+        {
+            const uint8_t *p_res = startcode_FindAnnexB_Bytes( p, p + 10 );
+            if( p_res != NULL )
+                return p_res;
+        }
+    }
+    return startcode_FindAnnexB_Bytes( p, end );
+}
+
+#if defined(HAVE_SSE2_INTRINSICS) && (defined(__i386__) || defined(__x86_64__))
+# include <emmintrin.h>
+
+/* Compares 16 offsets at once, with unaligned loads of the 3 bytes */
+VLC_SSE2
+static inline const uint8_t *startcode_FindAnnexB_SSE2( const uint8_t *p,
+                                                        const uint8_t *end )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8( 1 );
+
+    for( ; end - p >= 18; p += 16 )
+    {
+        __m128i b0 = _mm_loadu_si128( (const __m128i *)p );
+        __m128i b1 = _mm_loadu_si128( (const __m128i *)(p + 1) );
+        __m128i b2 = _mm_loadu_si128( (const __m128i *)(p + 2) );
+        __m128i m = _mm_and_si128( _mm_cmpeq_epi8( _mm_or_si128( b0, b1 ), zero ),
+                                   _mm_cmpeq_epi8( b2, one ) );
+        unsigned mask = _mm_movemask_epi8( m );
+
+        if( mask )
+            return p + ctz( mask );
+    }
+    return startcode_FindAnnexB_Bytes( p, end );
+}
+#endif
+
+#if defined(HAVE_AVX2_INTRINSICS)
+# include <immintrin.h>
+
+VLC_AVX2
+static inline const uint8_t *startcode_FindAnnexB_AVX2( const uint8_t *p,
+                                                        const uint8_t *end )
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8( 1 );
+
+    for( ; end - p >= 34; p += 32 )
+    {
+        __m256i b0 = _mm256_loadu_si256( (const __m256i *)p );
+        __m256i b1 = _mm256_loadu_si256( (const __m256i *)(p + 1) );
+        __m256i b2 = _mm256_loadu_si256( (const __m256i *)(p + 2) );
+        __m256i m = _mm256_and_si256(
+                        _mm256_cmpeq_epi8( _mm256_or_si256( b0, b1 ), zero ),
+                        _mm256_cmpeq_epi8( b2, one ) );
+        unsigned mask = _mm256_movemask_epi8( m );
+
+        if( mask )
+            return p + ctz( mask );
+    }
+    return startcode_FindAnnexB_Bytes( p, end );
+}
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+
+static inline const uint8_t *startcode_FindAnnexB_NEON( const uint8_t *p,
+                                                        const uint8_t *end )
+{
+    const uint8x16_t zero = vdupq_n_u8( 0 );
+    const uint8x16_t one = vdupq_n_u8( 1 );
+
+    for( ; end - p >= 18; p += 16 )
+    {
+        uint8x16_t b01 = vorrq_u8( vld1q_u8( p ), vld1q_u8( p + 1 ) );
+        uint8x16_t m = vandq_u8( vceqq_u8( b01, zero ),
+                                 vceqq_u8( vld1q_u8( p + 2 ), one ) );
+        uint64x2_t m64 = vreinterpretq_u64_u8( m );
+
+        /* No movemask: locate the match with the byte loop */
+        if( vgetq_lane_u64( m64, 0 ) | vgetq_lane_u64( m64, 1 ) )
+            return startcode_FindAnnexB_Bytes( p, p + 18 );
+    }
+    return startcode_FindAnnexB_Bytes( p, end );
+}
+#endif
+
+static inline const uint8_t *startcode_FindAnnexB( const uint8_t *p,
+                                                   const uint8_t *end )
+{
+#if defined(HAVE_AVX2_INTRINSICS)
+    if( vlc_CPU_AVX2() )
+        return startcode_FindAnnexB_AVX2( p, end );
+#endif
+#if defined(HAVE_SSE2_INTRINSICS) && (defined(__i386__) || defined(__x86_64__))
+    if( vlc_CPU_SSE2() )
+        return startcode_FindAnnexB_SSE2( p, end );
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    return startcode_FindAnnexB_NEON( p, end );
+#else
+    return startcode_FindAnnexB_Bits( p, end );
+#endif
+}
+
+#endif
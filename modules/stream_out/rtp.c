@@ -48,6 +48,7 @@
 #endif
 
 #include "rtp.h"
+#include "../access_output/udp_pacer.h"
 
 #include <sys/types.h>
 #include <unistd.h>
@@ -350,6 +351,7 @@ typedef struct rtp_sink_t
 {
     int rtp_fd;
     rtcp_sender_t *rtcp;
+    bool dgram;
 } rtp_sink_t;
 
 struct sout_stream_id_sys_t
@@ -389,6 +391,7 @@ struct sout_stream_id_sys_t
 
     block_fifo_t     *p_fifo;
     int64_t           i_caching;
+    udp_pacer_t       pacer;
 };
 
 /*****************************************************************************
@@ -1187,6 +1190,7 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
     id->p_fifo = block_FifoNew();
     if( unlikely(id->p_fifo == NULL) )
         goto error;
+    udp_pacer_Init( &id->pacer, VLC_OBJECT(p_stream), UDP_PACER_WINDOW, 1 );
     if( vlc_clone( &id->thread, ThreadSend, id, VLC_THREAD_PRIORITY_HIGHEST ) )
     {
         block_FifoRelease( id->p_fifo );
@@ -1231,6 +1235,7 @@ static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
     {
         vlc_cancel( id->thread );
         vlc_join( id->thread, NULL );
+        udp_pacer_Clean( &id->pacer );
         block_FifoRelease( id->p_fifo );
     }
 
@@ -1396,51 +1401,46 @@ static int  HttpCallback( httpd_file_sys_t *p_args,
  ****************************************************************************/
 static void* ThreadSend( void *data )
 {
-#ifdef _WIN32
-# define ENOBUFS      WSAENOBUFS
-# define EAGAIN       WSAEWOULDBLOCK
-# define EWOULDBLOCK  WSAEWOULDBLOCK
-#endif
     sout_stream_id_sys_t *id = data;
-    unsigned i_caching = id->i_caching;
+    udp_pacer_t *pacer = &id->pacer;
 
     for (;;)
     {
-        block_t *out = block_FifoGet( id->p_fifo );
-        block_cleanup_push (out);
+        mtime_t due = udp_pacer_Collect( pacer, id->p_fifo, id->i_caching );
+        int canc = vlc_savecancel ();
 
 #ifdef HAVE_SRTP
         if( id->srtp )
         {   /* FIXME: this is awfully inefficient */
-            size_t len = out->i_buffer;
-            out = block_Realloc( out, 0, len + 10 );
-            out->i_buffer = len;
-
-            int canc = vlc_savecancel ();
-            int val = srtp_send( id->srtp, out->p_buffer, &len, len + 10 );
-            vlc_restorecancel (canc);
-            if( val )
+            unsigned count = 0;
+
+            for( unsigned i = 0; i < pacer->count; i++ )
             {
-                msg_Dbg( id->p_stream, "SRTP sending error: %s",
-                         vlc_strerror_c(val) );
-                block_Release( out );
-                out = NULL;
-            }
-            else
+                block_t *out = pacer->pkts[i];
+                size_t len = out->i_buffer;
+                out = block_Realloc( out, 0, len + 10 );
+                out->i_buffer = len;
+
+                int val = srtp_send( id->srtp, out->p_buffer, &len, len + 10 );
+                if( val )
+                {
+                    msg_Dbg( id->p_stream, "SRTP sending error: %s",
+                             vlc_strerror_c(val) );
+                    block_Release( out );
+                    continue;
+                }
                 out->i_buffer = len;
+                pacer->pkts[count++] = out;
+            }
+            pacer->count = count;
         }
-        if (out)
-            mwait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
-        if (out == NULL)
-            continue;
-#else
-        mwait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
 #endif
+        vlc_restorecancel (canc);
+        if( pacer->count == 0 )
+            continue;
 
-        ssize_t len = out->i_buffer;
-        int canc = vlc_savecancel ();
+        mwait (due);
+        canc = vlc_savecancel ();
 
         vlc_mutex_lock( &id->lock_sink );
         unsigned deadc = 0; /* How many dead sockets? */
@@ -1451,26 +1451,18 @@ static void* ThreadSend( void *data )
 #ifdef HAVE_SRTP
             if( !id->srtp ) /* FIXME: SRTCP support */
 #endif
-                SendRTCP( id->sinkv[i].rtcp, out );
+                for( unsigned j = 0; j < pacer->count; j++ )
+                    SendRTCP( id->sinkv[i].rtcp, pacer->pkts[j] );
 
-            if( send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 ) == -1
-             && net_errno != EAGAIN && net_errno != EWOULDBLOCK
-             && net_errno != ENOBUFS && net_errno != ENOMEM )
-            {
-                int type;
-                getsockopt( id->sinkv[i].rtp_fd, SOL_SOCKET, SO_TYPE,
-                            &type, &(socklen_t){ sizeof(type) });
-                if( type == SOCK_DGRAM )
-                    /* ICMP soft error: ignore and retry */
-                    send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 );
-                else
-                    /* Broken connection */
-                    deadv[deadc++] = id->sinkv[i].rtp_fd;
-            }
+            if( udp_pacer_Send( pacer, id->sinkv[i].rtp_fd,
+                                id->sinkv[i].dgram ) )
+                /* Broken connection */
+                deadv[deadc++] = id->sinkv[i].rtp_fd;
         }
-        id->i_seq_sent_next = ntohs(((uint16_t *) out->p_buffer)[1]) + 1;
+        block_t *last = pacer->pkts[pacer->count - 1];
+        id->i_seq_sent_next = ntohs(((uint16_t *) last->p_buffer)[1]) + 1;
         vlc_mutex_unlock( &id->lock_sink );
-        block_Release( out );
+        udp_pacer_Flush( pacer, due, NULL );
 
         for( unsigned i = 0; i < deadc; i++ )
         {
@@ -1506,7 +1498,12 @@ static void *rtp_listen_thread( void *data )
 
 int rtp_add_sink( sout_stream_id_sys_t *id, int fd, bool rtcp_mux, uint16_t *seq )
 {
-    rtp_sink_t sink = { fd, NULL };
+    rtp_sink_t sink = { fd, NULL, false };
+    int type;
+
+    if( getsockopt( fd, SOL_SOCKET, SO_TYPE,
+                    &type, &(socklen_t){ sizeof(type) } ) == 0 )
+        sink.dgram = type == SOCK_DGRAM;
     sink.rtcp = OpenRTCP( VLC_OBJECT( id->p_stream ), fd, IPPROTO_UDP,
                           rtcp_mux );
     if( sink.rtcp == NULL )
@@ -1522,7 +1519,7 @@ int rtp_add_sink( sout_stream_id_sys_t *id, int fd, bool rtcp_mux, uint16_t *seq
 
 void rtp_del_sink( sout_stream_id_sys_t *id, int fd )
 {
-    rtp_sink_t sink = { fd, NULL };
+    rtp_sink_t sink = { fd, NULL, false };
 
     /* NOTE: must be safe to use if fd is not included */
     vlc_mutex_lock( &id->lock_sink );
@@ -36,6 +36,7 @@
 #include <vlc_plugin.h>
 
 #include <vlc_spu.h>
+#include <vlc_charset.h>
 
 #include "transcode.h"
 
@@ -124,13 +125,28 @@
 #define OSD_LONGTEXT N_(\
     "Stream the On Screen Display menu (using the osdmenu subpicture module)." )
 
+#define RENDITION_TEXT N_("Video rendition")
+#define RENDITION_LONGTEXT N_( \
+    "Additional encoding of the video from the same decoded and " \
+    "deinterlaced pictures, such as " \
+    "rendition={vcodec=h264,vb=800,width=640,dst=std{...}}. It accepts " \
+    "the venc, vcodec, vb, scale, width, height, maxwidth and maxheight " \
+    "options, defaulting to those of the main encoding, and dst, the " \
+    "stream output chain of the rendition (the next one by default). " \
+    "Repeat the option to build a ladder of renditions. Renditions only " \
+    "carry video." )
+
 #define THREADS_TEXT N_("Number of threads")
 #define THREADS_LONGTEXT N_( \
     "Number of threads used for the transcoding." )
+#define DEPTH_TEXT N_("Pipeline depth")
+#define DEPTH_LONGTEXT N_( \
+    "Maximum number of pictures waiting between the video decoding, " \
+    "filtering and encoding stages, when threads are used." )
 #define HP_TEXT N_("High priority")
 #define HP_LONGTEXT N_( \
-    "Runs the optional encoder thread at the OUTPUT priority instead of " \
-    "VIDEO." )
+    "Runs the optional filter and encoder threads at the OUTPUT priority " \
+    "instead of VIDEO." )
 
 
 static const char *const ppsz_deinterlace_type[] =
@@ -179,6 +195,8 @@ vlc_module_begin ()
                  MAXHEIGHT_LONGTEXT, true )
     add_module_list( SOUT_CFG_PREFIX "vfilter", "video filter2",
                      NULL, VFILTER_TEXT, VFILTER_LONGTEXT, false )
+    add_string( SOUT_CFG_PREFIX "rendition", NULL, RENDITION_TEXT,
+                RENDITION_LONGTEXT, true )
 
     set_section( N_("Audio"), NULL )
     add_module( SOUT_CFG_PREFIX "aenc", "encoder", NULL, AENC_TEXT,
@@ -216,6 +234,8 @@ vlc_module_begin ()
     set_section( N_("Miscellaneous"), NULL )
     add_integer( SOUT_CFG_PREFIX "threads", 0, THREADS_TEXT,
                  THREADS_LONGTEXT, true )
+    add_integer_with_range( SOUT_CFG_PREFIX "pipeline-depth", 4, 1, 64,
+                            DEPTH_TEXT, DEPTH_LONGTEXT, true )
     add_bool( SOUT_CFG_PREFIX "high-priority", false, HP_TEXT, HP_LONGTEXT,
               true )
 
@@ -227,7 +247,7 @@ static const char *const ppsz_sout_options[] = {
     "deinterlace-module", "threads", "aenc", "acodec", "ab", "alang",
     "afilter", "samplerate", "channels", "senc", "scodec", "soverlay",
     "sfilter", "osd", "high-priority", "maxwidth", "maxheight",
-    NULL
+    "pipeline-depth", "rendition", NULL
 };
 
 /*****************************************************************************
@@ -237,6 +257,110 @@ static sout_stream_id_sys_t *Add( sout_stream_t *, const es_format_t * );
 static void              Del ( sout_stream_t *, sout_stream_id_sys_t * );
 static int               Send( sout_stream_t *, sout_stream_id_sys_t *, block_t* );
 
+/*****************************************************************************
+ * Renditions:
+ *****************************************************************************/
+static void RenditionDelete( transcode_rendition_t *p_rd )
+{
+    if( p_rd->p_out )
+        sout_StreamChainDelete( p_rd->p_out, p_rd->p_out_last );
+    config_ChainDestroy( p_rd->p_video_cfg );
+    free( p_rd->psz_venc );
+    free( p_rd );
+}
+
+static void RenditionAdd( sout_stream_t *p_stream, const char *psz_value )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    config_chain_t *p_cfg = NULL;
+    char *psz_opts;
+
+    /* rendition{...} keeps the brackets, rendition={...} does not */
+    if( *psz_value == '{' )
+        psz_opts = strdup( psz_value );
+    else if( asprintf( &psz_opts, "{%s}", psz_value ) == -1 )
+        psz_opts = NULL;
+    if( !psz_opts )
+        return;
+    config_ChainParseOptions( &p_cfg, psz_opts );
+    free( psz_opts );
+
+    transcode_rendition_t *p_rd = calloc( 1, sizeof( *p_rd ) );
+    if( !p_rd )
+    {
+        config_ChainDestroy( p_cfg );
+        return;
+    }
+    p_rd->i_vcodec = p_sys->i_vcodec;
+    p_rd->i_vbitrate = p_sys->i_vbitrate;
+
+    for( config_chain_t *p = p_cfg; p != NULL; p = p->p_next )
+    {
+        const char *psz = p->psz_value ? p->psz_value : "";
+
+        if( !strcmp( p->psz_name, "venc" ) )
+        {
+            free( p_rd->psz_venc );
+            config_ChainDestroy( p_rd->p_video_cfg );
+            free( config_ChainCreate( &p_rd->psz_venc, &p_rd->p_video_cfg,
+                                      psz ) );
+        }
+        else if( !strcmp( p->psz_name, "vcodec" ) )
+        {
+            char fcc[5] = "    \0";
+            memcpy( fcc, psz, __MIN( strlen( psz ), 4 ) );
+            p_rd->i_vcodec = vlc_fourcc_GetCodecFromString( VIDEO_ES, fcc );
+        }
+        else if( !strcmp( p->psz_name, "vb" ) )
+        {
+            p_rd->i_vbitrate = atoi( psz );
+            if( p_rd->i_vbitrate < 16000 ) p_rd->i_vbitrate *= 1000;
+        }
+        else if( !strcmp( p->psz_name, "scale" ) )
+            p_rd->f_scale = us_atof( psz );
+        else if( !strcmp( p->psz_name, "width" ) )
+            p_rd->i_width = atoi( psz );
+        else if( !strcmp( p->psz_name, "height" ) )
+            p_rd->i_height = atoi( psz );
+        else if( !strcmp( p->psz_name, "maxwidth" ) )
+            p_rd->i_maxwidth = atoi( psz );
+        else if( !strcmp( p->psz_name, "maxheight" ) )
+            p_rd->i_maxheight = atoi( psz );
+        else if( !strcmp( p->psz_name, "dst" ) && p->psz_value
+              && !p_rd->p_out )
+        {
+            p_rd->p_out = sout_StreamChainNew( p_stream->p_sout, p->psz_value,
+                                               p_stream->p_next,
+                                               &p_rd->p_out_last );
+            if( !p_rd->p_out )
+                msg_Err( p_stream, "cannot create rendition chain `%s'",
+                         psz );
+        }
+        else
+            msg_Warn( p_stream, "rendition option %s is unknown",
+                      p->psz_name );
+    }
+    config_ChainDestroy( p_cfg );
+
+    if( !p_rd->psz_venc && p_sys->psz_venc )
+    {
+        p_rd->psz_venc = strdup( p_sys->psz_venc );
+        p_rd->p_video_cfg = config_ChainDuplicate( p_sys->p_video_cfg );
+    }
+
+    if( !p_rd->i_vcodec )
+    {
+        msg_Err( p_stream, "rendition without video codec" );
+        RenditionDelete( p_rd );
+        return;
+    }
+
+    msg_Dbg( p_stream, "rendition video=%4.4s %ux%u scaling: %f %dkb/s",
+             (char *)&p_rd->i_vcodec, p_rd->i_width, p_rd->i_height,
+             p_rd->f_scale, p_rd->i_vbitrate / 1000 );
+    TAB_APPEND( p_sys->i_renditions, p_sys->pp_renditions, p_rd );
+}
+
 /*****************************************************************************
  * Open:
  *****************************************************************************/
@@ -375,6 +499,8 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->i_threads = var_GetInteger( p_stream, SOUT_CFG_PREFIX "threads" );
     p_sys->b_high_priority = var_GetBool( p_stream, SOUT_CFG_PREFIX "high-priority" );
+    p_sys->i_queue_depth = __MAX( 1, var_GetInteger( p_stream,
+                                  SOUT_CFG_PREFIX "pipeline-depth" ) );
 
     if( p_sys->i_vcodec )
     {
@@ -383,6 +509,16 @@ static int Open( vlc_object_t *p_this )
                  p_sys->f_scale, p_sys->i_vbitrate / 1000 );
     }
 
+    /* Renditions of the video, decoded once */
+    TAB_INIT( p_sys->i_renditions, p_sys->pp_renditions );
+    for( config_chain_t *p_cfg = p_stream->p_cfg; p_cfg != NULL;
+         p_cfg = p_cfg->p_next )
+    {
+        if( !strcmp( p_cfg->psz_name, "rendition" ) && p_cfg->psz_value
+         && p_sys->i_vcodec )
+            RenditionAdd( p_stream, p_cfg->psz_value );
+    }
+
     /* Subpictures transcoding parameters */
     p_sys->p_spu = NULL;
     p_sys->p_spu_blend = NULL;
@@ -483,6 +619,10 @@ static void Close( vlc_object_t * p_this )
     config_ChainDestroy( p_sys->p_video_cfg );
     free( p_sys->psz_venc );
 
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+        RenditionDelete( p_sys->pp_renditions[i] );
+    TAB_CLEAN( p_sys->i_renditions, p_sys->pp_renditions );
+
     config_ChainDestroy( p_sys->p_deinterlace_cfg );
     free( p_sys->psz_deinterlace );
 
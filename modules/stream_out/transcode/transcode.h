@@ -14,15 +14,84 @@
 /*100ms is around the limit where people are noticing lipsync issues*/
 #define MASTER_SYNC_MAX_DRIFT 100000
 
+/* Video pipeline stages */
+enum
+{
+    TRANSCODE_DECODE,
+    TRANSCODE_FILTER,
+    TRANSCODE_ENCODE,
+    TRANSCODE_RENDITIONS,
+    TRANSCODE_STAGES
+};
+
+typedef struct
+{
+    unsigned        i_frames;
+    mtime_t         i_time;      /* spent processing pictures */
+    mtime_t         i_time_max;
+    mtime_t         i_blocked;   /* spent waiting for room in the next queue */
+    unsigned        i_depth_max; /* of the queue feeding the stage */
+} transcode_stage_t;
+
+/* Another encoding of the transcoded video, from the same decoded and
+ * pre-filtered pictures */
+typedef struct
+{
+    vlc_fourcc_t    i_vcodec;
+    char            *psz_venc;
+    config_chain_t  *p_video_cfg;
+    int             i_vbitrate;
+    float           f_scale;
+    unsigned int    i_width, i_maxwidth;
+    unsigned int    i_height, i_maxheight;
+
+    /* Own stream output chain, or NULL for the next stream */
+    sout_stream_t   *p_out;
+    sout_stream_t   *p_out_last;
+} transcode_rendition_t;
+
+/* Rendition state of a video ES */
+typedef struct
+{
+    encoder_t       *p_encoder;
+    filter_chain_t  *p_chain; /**< Scaling and chroma conversion */
+    void            *id; /**< on the rendition output */
+    block_t         *p_buffers; /**< encoded, not yet sent */
+
+    /* With threads, each rendition is scaled and encoded by its own
+     * thread, fed by the filter thread */
+    sout_stream_t   *p_stream;
+    picture_fifo_t  *p_pics;
+    unsigned        i_pics;
+    vlc_thread_t    thread;
+    bool            b_running;
+} transcode_branch_t;
+
 struct sout_stream_sys_t
 {
+    /* Video pipeline: the sout thread decodes, the filter thread runs the
+     * filter chains and the encoder thread encodes. Stages are linked by
+     * bounded picture queues. */
     sout_stream_id_sys_t *id_video;
     block_t         *p_buffers;
     vlc_mutex_t     lock_out;
-    vlc_cond_t      cond;
-    bool            b_abort;
-    picture_fifo_t *pp_pics;
+    vlc_cond_t      cond;       /* pictures queued, or end of stream */
+    vlc_cond_t      cond_space; /* pictures dequeued or processed */
+    bool            b_abort;    /* no more decoded pictures */
+    bool            b_filtered; /* filter thread done */
+    bool            b_running;
+    picture_fifo_t *pp_decoded; /* to the filter thread */
+    picture_fifo_t *pp_pics;    /* to the encoder thread */
+    unsigned        i_decoded;
+    unsigned        i_pics;
+    unsigned        i_busy;     /* pictures being filtered or encoded,
+                                 * renditions included */
+    unsigned        i_queue_depth;
+    vlc_thread_t    filter_thread;
     vlc_thread_t    thread;
+    transcode_stage_t stages[TRANSCODE_STAGES];
+    mtime_t         pi_published[TRANSCODE_STAGES]; /* to the sout stats */
+    mtime_t         i_stats_start;
 
     /* Audio */
     vlc_fourcc_t    i_acodec;   /* codec audio (0 if not transcode) */
@@ -53,6 +122,9 @@ struct sout_stream_sys_t
 
     char            *psz_vf2;
 
+    int             i_renditions;
+    transcode_rendition_t **pp_renditions;
+
     /* SPU */
     vlc_fourcc_t    i_scodec;   /* codec spu (0 if not transcode) */
     char            *psz_senc;
@@ -92,6 +164,7 @@ struct sout_stream_id_sys_t
              filter_chain_t  *p_f_chain; /**< Video filters */
              filter_chain_t  *p_uf_chain; /**< User-specified video filters */
              video_format_t  fmt_input_video;
+             transcode_branch_t *p_branches; /**< One per rendition */
          };
          struct
          {
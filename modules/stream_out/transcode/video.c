@@ -30,6 +30,7 @@
 
 #include "transcode.h"
 
+#include <assert.h>
 #include <math.h>
 #include <vlc_meta.h>
 #include <vlc_spu.h>
@@ -66,6 +67,171 @@ static picture_t *transcode_video_filter_buffer_new( filter_t *p_filter )
     return picture_NewFromFormat( &p_filter->fmt_out.video );
 }
 
+#define TRANSCODE_REPORT (10 * CLOCK_FREQ)
+
+/* Accounts a pass of a stage. Lock must be held. */
+static void StageAdd( sout_stream_sys_t *p_sys, int i_stage, mtime_t i_time,
+                      bool b_picture )
+{
+    transcode_stage_t *p_stage = &p_sys->stages[i_stage];
+
+    if( b_picture )
+        p_stage->i_frames++;
+    p_stage->i_time += i_time;
+    if( i_time > p_stage->i_time_max )
+        p_stage->i_time_max = i_time;
+}
+
+/* Pictures queued for the rendition threads. Lock must be held. */
+static unsigned BranchesDepth( sout_stream_sys_t *p_sys )
+{
+    sout_stream_id_sys_t *id = p_sys->id_video;
+    unsigned i_depth = 0;
+
+    if( id != NULL && id->p_branches != NULL )
+        for( int i = 0; i < p_sys->i_renditions; i++ )
+            i_depth += id->p_branches[i].i_pics;
+    return i_depth;
+}
+
+/* Logs the load of each stage; the bottleneck is the busiest stage, with a
+ * full input queue and upstream stages blocked. Lock must be held. */
+static void Report( sout_stream_t *p_stream )
+{
+    static const char *const ppsz_stages[TRANSCODE_STAGES] = {
+        "decoder", "filters", "encoder", "renditions"
+    };
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    const unsigned pi_depth[TRANSCODE_STAGES] = {
+        0, p_sys->i_decoded, p_sys->i_pics, BranchesDepth( p_sys )
+    };
+
+    for( int i = 0; i < TRANSCODE_STAGES; i++ )
+    {
+        const transcode_stage_t *p_stage = &p_sys->stages[i];
+
+        if( p_stage->i_frames == 0 )
+            continue;
+        msg_Dbg( p_stream, "%s: %u pictures, %"PRId64" us/picture (max %"
+                 PRId64" us), blocked %"PRId64" ms, queue %u (max %u)",
+                 ppsz_stages[i], p_stage->i_frames,
+                 p_stage->i_time / p_stage->i_frames, p_stage->i_time_max,
+                 p_stage->i_blocked / 1000, pi_depth[i],
+                 p_stage->i_depth_max );
+    }
+}
+
+/* Exports the queue depth and the processing time of each stage since
+ * the last call through the stream output statistics. Lock must be held. */
+static void Publish( sout_stream_t *p_stream )
+{
+    static const sout_statistic_t pi_types[TRANSCODE_STAGES] = {
+        SOUT_STATISTIC_DECODE_TIME, SOUT_STATISTIC_FILTER_TIME,
+        SOUT_STATISTIC_ENCODE_TIME, SOUT_STATISTIC_ENCODE_TIME
+    };
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    for( int i = 0; i < TRANSCODE_STAGES; i++ )
+    {
+        mtime_t i_time = p_sys->stages[i].i_time;
+
+        if( i_time != p_sys->pi_published[i] )
+            sout_UpdateStatistic( p_stream->p_sout, pi_types[i],
+                                  i_time - p_sys->pi_published[i] );
+        p_sys->pi_published[i] = i_time;
+    }
+    sout_UpdateStatistic( p_stream->p_sout, SOUT_STATISTIC_PIPELINE_DEPTH,
+                          p_sys->i_decoded + p_sys->i_pics
+                          + BranchesDepth( p_sys ) );
+}
+
+/* Queues a picture for the next stage, waiting for room in the queue.
+ * Returns the time spent waiting. Lock must be held. */
+static mtime_t QueuePush( sout_stream_sys_t *p_sys, picture_fifo_t *p_fifo,
+                          unsigned *pi_depth, int i_from, int i_to,
+                          picture_t *p_pic )
+{
+    mtime_t i_blocked = 0;
+
+    if( *pi_depth >= p_sys->i_queue_depth )
+    {
+        int canc = vlc_savecancel();
+        mtime_t i_start = mdate();
+
+        do
+            vlc_cond_wait( &p_sys->cond_space, &p_sys->lock_out );
+        while( *pi_depth >= p_sys->i_queue_depth );
+
+        i_blocked = mdate() - i_start;
+        p_sys->stages[i_from].i_blocked += i_blocked;
+        vlc_restorecancel( canc );
+    }
+
+    picture_fifo_Push( p_fifo, p_pic );
+    if( ++*pi_depth > p_sys->stages[i_to].i_depth_max )
+        p_sys->stages[i_to].i_depth_max = *pi_depth;
+    vlc_cond_broadcast( &p_sys->cond );
+    return i_blocked;
+}
+
+/* Waits until the filter and encoder threads have processed every queued
+ * picture, so that the filters and the encoder format may be changed. */
+static void WaitIdle( sout_stream_sys_t *p_sys )
+{
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_sys->lock_out );
+    while( p_sys->i_decoded || p_sys->i_pics || p_sys->i_busy
+        || BranchesDepth( p_sys ) )
+        vlc_cond_wait( &p_sys->cond_space, &p_sys->lock_out );
+    vlc_mutex_unlock( &p_sys->lock_out );
+    vlc_restorecancel( canc );
+}
+
+static void FilterFrame( sout_stream_t *, sout_stream_id_sys_t *,
+                         picture_t *, block_t ** );
+
+static void* FilterThread( void *obj )
+{
+    sout_stream_t *p_stream = (sout_stream_t *)obj;
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    sout_stream_id_sys_t *id = p_sys->id_video;
+    picture_t *p_pic;
+    int canc = vlc_savecancel ();
+
+    vlc_mutex_lock( &p_sys->lock_out );
+
+    for( ;; )
+    {
+        while( (p_pic = picture_fifo_Pop( p_sys->pp_decoded )) == NULL &&
+               !p_sys->b_abort )
+            vlc_cond_wait( &p_sys->cond, &p_sys->lock_out );
+
+        /* Queued pictures are still filtered after the end of stream */
+        if( p_pic == NULL )
+            break;
+
+        p_sys->i_decoded--;
+        p_sys->i_busy++;
+        vlc_cond_broadcast( &p_sys->cond_space );
+        vlc_mutex_unlock( &p_sys->lock_out );
+
+        FilterFrame( p_stream, id, p_pic, NULL );
+
+        vlc_mutex_lock( &p_sys->lock_out );
+        p_sys->i_busy--;
+        vlc_cond_broadcast( &p_sys->cond_space );
+    }
+
+    p_sys->b_filtered = true;
+    vlc_cond_broadcast( &p_sys->cond );
+    vlc_mutex_unlock( &p_sys->lock_out );
+
+    vlc_restorecancel (canc);
+
+    return NULL;
+}
+
 static void* EncoderThread( void *obj )
 {
     sout_stream_sys_t *p_sys = (sout_stream_sys_t*)obj;
@@ -78,38 +244,38 @@ static void* EncoderThread( void *obj )
 
     for( ;; )
     {
-        while( !p_sys->b_abort &&
-               (p_pic = picture_fifo_Pop( p_sys->pp_pics )) == NULL )
+        while( (p_pic = picture_fifo_Pop( p_sys->pp_pics )) == NULL &&
+               !p_sys->b_filtered )
             vlc_cond_wait( &p_sys->cond, &p_sys->lock_out );
 
-        if( p_pic )
-        {
-            /* release lock while encoding */
-            vlc_mutex_unlock( &p_sys->lock_out );
-            p_block = id->p_encoder->pf_encode_video( id->p_encoder, p_pic );
-            picture_Release( p_pic );
-            vlc_mutex_lock( &p_sys->lock_out );
-
-            block_ChainAppend( &p_sys->p_buffers, p_block );
-        }
-
-        if( p_sys->b_abort )
+        /* Encode what we have in the buffer on closing */
+        if( p_pic == NULL )
             break;
-    }
 
-    /*Encode what we have in the buffer on closing*/
-    while( (p_pic = picture_fifo_Pop( p_sys->pp_pics )) != NULL )
-    {
+        p_sys->i_pics--;
+        p_sys->i_busy++;
+        vlc_cond_broadcast( &p_sys->cond_space );
+
+        /* release lock while encoding */
+        vlc_mutex_unlock( &p_sys->lock_out );
+        mtime_t i_start = mdate();
         p_block = id->p_encoder->pf_encode_video( id->p_encoder, p_pic );
+        mtime_t i_time = mdate() - i_start;
         picture_Release( p_pic );
+        vlc_mutex_lock( &p_sys->lock_out );
+
+        StageAdd( p_sys, TRANSCODE_ENCODE, i_time, true );
         block_ChainAppend( &p_sys->p_buffers, p_block );
+        p_sys->i_busy--;
+        vlc_cond_broadcast( &p_sys->cond_space );
     }
 
     /*Now flush encoder*/
-    do {
-        p_block = id->p_encoder->pf_encode_video(id->p_encoder, NULL );
-        block_ChainAppend( &p_sys->p_buffers, p_block );
-    } while( p_block );
+    if( id->p_encoder->p_module )
+        do {
+            p_block = id->p_encoder->pf_encode_video(id->p_encoder, NULL );
+            block_ChainAppend( &p_sys->p_buffers, p_block );
+        } while( p_block );
 
     vlc_mutex_unlock( &p_sys->lock_out );
 
@@ -118,6 +284,87 @@ static void* EncoderThread( void *obj )
     return NULL;
 }
 
+/* Scales and encodes a pre-filtered picture for a rendition */
+static block_t *transcode_branch_encode( transcode_branch_t *p_br,
+                                         picture_t *p_pic )
+{
+    picture_t *p_scaled = filter_chain_VideoFilter( p_br->p_chain, p_pic );
+    if( !p_scaled )
+        return NULL;
+
+    block_t *p_block = p_br->p_encoder->pf_encode_video( p_br->p_encoder,
+                                                         p_scaled );
+    picture_Release( p_scaled );
+    return p_block;
+}
+
+static void* BranchThread( void *obj )
+{
+    transcode_branch_t *p_br = obj;
+    sout_stream_sys_t *p_sys = p_br->p_stream->p_sys;
+    picture_t *p_pic;
+    int canc = vlc_savecancel ();
+
+    vlc_mutex_lock( &p_sys->lock_out );
+
+    for( ;; )
+    {
+        while( (p_pic = picture_fifo_Pop( p_br->p_pics )) == NULL &&
+               !p_sys->b_filtered )
+            vlc_cond_wait( &p_sys->cond, &p_sys->lock_out );
+
+        /* Encode what we have in the buffer on closing */
+        if( p_pic == NULL )
+            break;
+
+        p_br->i_pics--;
+        p_sys->i_busy++;
+        vlc_cond_broadcast( &p_sys->cond_space );
+
+        vlc_mutex_unlock( &p_sys->lock_out );
+        mtime_t i_start = mdate();
+        block_t *p_block = transcode_branch_encode( p_br, p_pic );
+        mtime_t i_time = mdate() - i_start;
+        vlc_mutex_lock( &p_sys->lock_out );
+
+        StageAdd( p_sys, TRANSCODE_RENDITIONS, i_time, true );
+        block_ChainAppend( &p_br->p_buffers, p_block );
+        p_sys->i_busy--;
+        vlc_cond_broadcast( &p_sys->cond_space );
+    }
+
+    vlc_mutex_unlock( &p_sys->lock_out );
+
+    vlc_restorecancel (canc);
+
+    return NULL;
+}
+
+/* Filters and encodes the pictures still queued, then stops the threads. */
+static void transcode_video_pipeline_stop( sout_stream_t *p_stream )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    sout_stream_id_sys_t *id = p_sys->id_video;
+
+    if( !p_sys->b_running )
+        return;
+
+    vlc_mutex_lock( &p_sys->lock_out );
+    p_sys->b_abort = true;
+    vlc_cond_broadcast( &p_sys->cond );
+    vlc_mutex_unlock( &p_sys->lock_out );
+
+    vlc_join( p_sys->filter_thread, NULL );
+    for( int i = 0; id->p_branches && i < p_sys->i_renditions; i++ )
+        if( id->p_branches[i].b_running )
+        {
+            vlc_join( id->p_branches[i].thread, NULL );
+            id->p_branches[i].b_running = false;
+        }
+    vlc_join( p_sys->thread, NULL );
+    p_sys->b_running = false;
+}
+
 int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
 {
     sout_stream_sys_t *p_sys = p_stream->p_sys;
@@ -211,37 +458,77 @@ int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
     }
     id->p_encoder->p_module = NULL;
 
+    id->p_branches = NULL;
+    if( p_sys->i_renditions > 0 )
+    {
+        id->p_branches = calloc( p_sys->i_renditions,
+                                 sizeof( *id->p_branches ) );
+        if( id->p_branches == NULL )
+        {
+            module_unneed( id->p_decoder, id->p_decoder->p_module );
+            id->p_decoder->p_module = NULL;
+            free( id->p_decoder->p_owner );
+            return VLC_ENOMEM;
+        }
+    }
+
+    vlc_mutex_init( &p_sys->lock_out );
+    vlc_cond_init( &p_sys->cond );
+    vlc_cond_init( &p_sys->cond_space );
+    p_sys->p_buffers = NULL;
+    p_sys->b_abort = false;
+    p_sys->b_filtered = false;
+    p_sys->b_running = false;
+    p_sys->i_decoded = p_sys->i_pics = p_sys->i_busy = 0;
+    memset( p_sys->stages, 0, sizeof (p_sys->stages) );
+    memset( p_sys->pi_published, 0, sizeof (p_sys->pi_published) );
+    p_sys->i_stats_start = mdate();
+
     if( p_sys->i_threads <= 0 )
         return VLC_SUCCESS;
 
     int i_priority = p_sys->b_high_priority ? VLC_THREAD_PRIORITY_OUTPUT :
                        VLC_THREAD_PRIORITY_VIDEO;
     p_sys->id_video = id;
+    p_sys->pp_decoded = picture_fifo_New();
     p_sys->pp_pics = picture_fifo_New();
-    if( p_sys->pp_pics == NULL )
+    if( p_sys->pp_decoded == NULL || p_sys->pp_pics == NULL )
     {
         msg_Err( p_stream, "cannot create picture fifo" );
-        module_unneed( id->p_decoder, id->p_decoder->p_module );
-        id->p_decoder->p_module = NULL;
-        free( id->p_decoder->p_owner );
-        return VLC_ENOMEM;
+        goto error;
     }
-    vlc_mutex_init( &p_sys->lock_out );
-    vlc_cond_init( &p_sys->cond );
-    p_sys->p_buffers = NULL;
-    p_sys->b_abort = false;
     if( vlc_clone( &p_sys->thread, EncoderThread, p_sys, i_priority ) )
     {
         msg_Err( p_stream, "cannot spawn encoder thread" );
-        vlc_mutex_destroy( &p_sys->lock_out );
-        vlc_cond_destroy( &p_sys->cond );
-        picture_fifo_Delete( p_sys->pp_pics );
-        module_unneed( id->p_decoder, id->p_decoder->p_module );
-        id->p_decoder->p_module = NULL;
-        free( id->p_decoder->p_owner );
-        return VLC_EGENERIC;
+        goto error;
+    }
+    if( vlc_clone( &p_sys->filter_thread, FilterThread, p_stream,
+                   i_priority ) )
+    {
+        msg_Err( p_stream, "cannot spawn filter thread" );
+        vlc_mutex_lock( &p_sys->lock_out );
+        p_sys->b_filtered = true;
+        vlc_cond_broadcast( &p_sys->cond );
+        vlc_mutex_unlock( &p_sys->lock_out );
+        vlc_join( p_sys->thread, NULL );
+        goto error;
     }
+    p_sys->b_running = true;
     return VLC_SUCCESS;
+
+error:
+    if( p_sys->pp_pics != NULL )
+        picture_fifo_Delete( p_sys->pp_pics );
+    if( p_sys->pp_decoded != NULL )
+        picture_fifo_Delete( p_sys->pp_decoded );
+    vlc_mutex_destroy( &p_sys->lock_out );
+    vlc_cond_destroy( &p_sys->cond );
+    vlc_cond_destroy( &p_sys->cond_space );
+    free( id->p_branches );
+    module_unneed( id->p_decoder, id->p_decoder->p_module );
+    id->p_decoder->p_module = NULL;
+    free( id->p_decoder->p_owner );
+    return VLC_EGENERIC;
 }
 
 static void transcode_video_filter_init( sout_stream_t *p_stream,
@@ -311,6 +598,13 @@ static void transcode_video_filter_init( sout_stream_t *p_stream,
         id->p_encoder->fmt_out.video.i_sar_den =
             id->p_encoder->fmt_in.video.i_sar_den;
     }
+    else if( id->p_branches )
+    {
+        /* Keep the scaling of the main encoding out of the pictures
+         * shared with the renditions */
+        id->p_uf_chain = filter_chain_NewVideo( p_stream, true, &owner );
+        filter_chain_Reset( id->p_uf_chain, p_fmt_out, p_fmt_out );
+    }
 
 }
 
@@ -335,18 +629,13 @@ static void conversion_video_filter_append( sout_stream_id_sys_t *id )
     }
 }
 
-static void transcode_video_encoder_init( sout_stream_t *p_stream,
-                                          sout_stream_id_sys_t *id )
+/* Sets the encoder dimensions, aspect ratio and frame rate from the format
+ * of the pictures to encode */
+static void video_encoder_init( sout_stream_t *p_stream,
+                                sout_stream_id_sys_t *id, encoder_t *p_enc,
+                                const es_format_t *p_fmt_out, float f_scale,
+                                unsigned i_maxwidth, unsigned i_maxheight )
 {
-    sout_stream_sys_t *p_sys = p_stream->p_sys;
-
-    const es_format_t *p_fmt_out = &id->p_decoder->fmt_out;
-    if( id->p_f_chain ) {
-        p_fmt_out = filter_chain_GetFmtOut( id->p_f_chain );
-    }
-    if( id->p_uf_chain ) {
-        p_fmt_out = filter_chain_GetFmtOut( id->p_uf_chain );
-    }
 
     /* Calculate scaling
      * width/height of source */
@@ -376,13 +665,13 @@ static void transcode_video_encoder_init( sout_stream_t *p_stream,
     msg_Dbg( p_stream, "source pixel aspect is %f:1", (double) f_aspect );
 
     /* Calculate scaling factor for specified parameters */
-    if( id->p_encoder->fmt_out.video.i_visible_width <= 0 &&
-        id->p_encoder->fmt_out.video.i_visible_height <= 0 && p_sys->f_scale )
+    if( p_enc->fmt_out.video.i_visible_width <= 0 &&
+        p_enc->fmt_out.video.i_visible_height <= 0 && f_scale )
     {
         /* Global scaling. Make sure width will remain a factor of 16 */
         float f_real_scale;
         int  i_new_height;
-        int i_new_width = i_src_visible_width * p_sys->f_scale;
+        int i_new_width = i_src_visible_width * f_scale;
 
         if( i_new_width % 16 <= 7 && i_new_width >= 16 )
             i_new_width -= i_new_width % 16;
@@ -396,39 +685,39 @@ static void transcode_video_encoder_init( sout_stream_t *p_stream,
         f_scale_width = f_real_scale;
         f_scale_height = (float) i_new_height / (float) i_src_visible_height;
     }
-    else if( id->p_encoder->fmt_out.video.i_visible_width > 0 &&
-             id->p_encoder->fmt_out.video.i_visible_height <= 0 )
+    else if( p_enc->fmt_out.video.i_visible_width > 0 &&
+             p_enc->fmt_out.video.i_visible_height <= 0 )
     {
         /* Only width specified */
-        f_scale_width = (float)id->p_encoder->fmt_out.video.i_visible_width/i_src_visible_width;
+        f_scale_width = (float)p_enc->fmt_out.video.i_visible_width/i_src_visible_width;
         f_scale_height = f_scale_width;
     }
-    else if( id->p_encoder->fmt_out.video.i_visible_width <= 0 &&
-             id->p_encoder->fmt_out.video.i_visible_height > 0 )
+    else if( p_enc->fmt_out.video.i_visible_width <= 0 &&
+             p_enc->fmt_out.video.i_visible_height > 0 )
     {
          /* Only height specified */
-         f_scale_height = (float)id->p_encoder->fmt_out.video.i_visible_height/i_src_visible_height;
+         f_scale_height = (float)p_enc->fmt_out.video.i_visible_height/i_src_visible_height;
          f_scale_width = f_scale_height;
      }
-     else if( id->p_encoder->fmt_out.video.i_visible_width > 0 &&
-              id->p_encoder->fmt_out.video.i_visible_height > 0 )
+     else if( p_enc->fmt_out.video.i_visible_width > 0 &&
+              p_enc->fmt_out.video.i_visible_height > 0 )
      {
          /* Width and height specified */
-         f_scale_width = (float)id->p_encoder->fmt_out.video.i_visible_width/i_src_visible_width;
-         f_scale_height = (float)id->p_encoder->fmt_out.video.i_visible_height/i_src_visible_height;
+         f_scale_width = (float)p_enc->fmt_out.video.i_visible_width/i_src_visible_width;
+         f_scale_height = (float)p_enc->fmt_out.video.i_visible_height/i_src_visible_height;
      }
 
      /* check maxwidth and maxheight */
-     if( p_sys->i_maxwidth && f_scale_width > (float)p_sys->i_maxwidth /
+     if( i_maxwidth && f_scale_width > (float)i_maxwidth /
                                                      i_src_visible_width )
      {
-         f_scale_width = (float)p_sys->i_maxwidth / i_src_visible_width;
+         f_scale_width = (float)i_maxwidth / i_src_visible_width;
      }
 
-     if( p_sys->i_maxheight && f_scale_height > (float)p_sys->i_maxheight /
+     if( i_maxheight && f_scale_height > (float)i_maxheight /
                                                        i_src_visible_height )
      {
-         f_scale_height = (float)p_sys->i_maxheight / i_src_visible_height;
+         f_scale_height = (float)i_maxheight / i_src_visible_height;
      }
 
 
@@ -450,15 +739,15 @@ static void transcode_video_encoder_init( sout_stream_t *p_stream,
      f_aspect = f_aspect * i_dst_visible_width / i_dst_visible_height;
 
      /* Store calculated values */
-     id->p_encoder->fmt_out.video.i_width = i_dst_width;
-     id->p_encoder->fmt_out.video.i_visible_width = i_dst_visible_width;
-     id->p_encoder->fmt_out.video.i_height = i_dst_height;
-     id->p_encoder->fmt_out.video.i_visible_height = i_dst_visible_height;
+     p_enc->fmt_out.video.i_width = i_dst_width;
+     p_enc->fmt_out.video.i_visible_width = i_dst_visible_width;
+     p_enc->fmt_out.video.i_height = i_dst_height;
+     p_enc->fmt_out.video.i_visible_height = i_dst_visible_height;
 
-     id->p_encoder->fmt_in.video.i_width = i_dst_width;
-     id->p_encoder->fmt_in.video.i_visible_width = i_dst_visible_width;
-     id->p_encoder->fmt_in.video.i_height = i_dst_height;
-     id->p_encoder->fmt_in.video.i_visible_height = i_dst_visible_height;
+     p_enc->fmt_in.video.i_width = i_dst_width;
+     p_enc->fmt_in.video.i_visible_width = i_dst_visible_width;
+     p_enc->fmt_in.video.i_height = i_dst_height;
+     p_enc->fmt_in.video.i_visible_height = i_dst_visible_height;
 
      msg_Dbg( p_stream, "source %ix%i, destination %ix%i",
          i_src_visible_width, i_src_visible_height,
@@ -466,76 +755,94 @@ static void transcode_video_encoder_init( sout_stream_t *p_stream,
      );
 
     /* Handle frame rate conversion */
-    if( !id->p_encoder->fmt_out.video.i_frame_rate ||
-        !id->p_encoder->fmt_out.video.i_frame_rate_base )
+    if( !p_enc->fmt_out.video.i_frame_rate ||
+        !p_enc->fmt_out.video.i_frame_rate_base )
     {
         if( p_fmt_out->video.i_frame_rate &&
             p_fmt_out->video.i_frame_rate_base )
         {
-            id->p_encoder->fmt_out.video.i_frame_rate =
+            p_enc->fmt_out.video.i_frame_rate =
                 p_fmt_out->video.i_frame_rate;
-            id->p_encoder->fmt_out.video.i_frame_rate_base =
+            p_enc->fmt_out.video.i_frame_rate_base =
                 p_fmt_out->video.i_frame_rate_base;
         }
         else
         {
             /* Pick a sensible default value */
-            id->p_encoder->fmt_out.video.i_frame_rate = ENC_FRAMERATE;
-            id->p_encoder->fmt_out.video.i_frame_rate_base = ENC_FRAMERATE_BASE;
+            p_enc->fmt_out.video.i_frame_rate = ENC_FRAMERATE;
+            p_enc->fmt_out.video.i_frame_rate_base = ENC_FRAMERATE_BASE;
         }
     }
 
-    id->p_encoder->fmt_in.video.orientation =
-        id->p_encoder->fmt_out.video.orientation =
+    p_enc->fmt_in.video.orientation =
+        p_enc->fmt_out.video.orientation =
         id->p_decoder->fmt_in.video.orientation;
 
-    id->p_encoder->fmt_in.video.i_frame_rate =
-        id->p_encoder->fmt_out.video.i_frame_rate;
-    id->p_encoder->fmt_in.video.i_frame_rate_base =
-        id->p_encoder->fmt_out.video.i_frame_rate_base;
+    p_enc->fmt_in.video.i_frame_rate =
+        p_enc->fmt_out.video.i_frame_rate;
+    p_enc->fmt_in.video.i_frame_rate_base =
+        p_enc->fmt_out.video.i_frame_rate_base;
 
-    vlc_ureduce( &id->p_encoder->fmt_in.video.i_frame_rate,
-        &id->p_encoder->fmt_in.video.i_frame_rate_base,
-        id->p_encoder->fmt_in.video.i_frame_rate,
-        id->p_encoder->fmt_in.video.i_frame_rate_base,
+    vlc_ureduce( &p_enc->fmt_in.video.i_frame_rate,
+        &p_enc->fmt_in.video.i_frame_rate_base,
+        p_enc->fmt_in.video.i_frame_rate,
+        p_enc->fmt_in.video.i_frame_rate_base,
         0 );
      msg_Dbg( p_stream, "source fps %d/%d, destination %d/%d",
         id->p_decoder->fmt_out.video.i_frame_rate,
         id->p_decoder->fmt_out.video.i_frame_rate_base,
-        id->p_encoder->fmt_in.video.i_frame_rate,
-        id->p_encoder->fmt_in.video.i_frame_rate_base );
+        p_enc->fmt_in.video.i_frame_rate,
+        p_enc->fmt_in.video.i_frame_rate_base );
 
 
     /* Check whether a particular aspect ratio was requested */
-    if( id->p_encoder->fmt_out.video.i_sar_num <= 0 ||
-        id->p_encoder->fmt_out.video.i_sar_den <= 0 )
+    if( p_enc->fmt_out.video.i_sar_num <= 0 ||
+        p_enc->fmt_out.video.i_sar_den <= 0 )
     {
-        vlc_ureduce( &id->p_encoder->fmt_out.video.i_sar_num,
-                     &id->p_encoder->fmt_out.video.i_sar_den,
+        vlc_ureduce( &p_enc->fmt_out.video.i_sar_num,
+                     &p_enc->fmt_out.video.i_sar_den,
                      (uint64_t)p_fmt_out->video.i_sar_num * i_src_visible_width  * i_dst_visible_height,
                      (uint64_t)p_fmt_out->video.i_sar_den * i_src_visible_height * i_dst_visible_width,
                      0 );
     }
     else
     {
-        vlc_ureduce( &id->p_encoder->fmt_out.video.i_sar_num,
-                     &id->p_encoder->fmt_out.video.i_sar_den,
-                     id->p_encoder->fmt_out.video.i_sar_num,
-                     id->p_encoder->fmt_out.video.i_sar_den,
+        vlc_ureduce( &p_enc->fmt_out.video.i_sar_num,
+                     &p_enc->fmt_out.video.i_sar_den,
+                     p_enc->fmt_out.video.i_sar_num,
+                     p_enc->fmt_out.video.i_sar_den,
                      0 );
     }
 
-    id->p_encoder->fmt_in.video.i_sar_num =
-        id->p_encoder->fmt_out.video.i_sar_num;
-    id->p_encoder->fmt_in.video.i_sar_den =
-        id->p_encoder->fmt_out.video.i_sar_den;
+    p_enc->fmt_in.video.i_sar_num =
+        p_enc->fmt_out.video.i_sar_num;
+    p_enc->fmt_in.video.i_sar_den =
+        p_enc->fmt_out.video.i_sar_den;
 
     msg_Dbg( p_stream, "encoder aspect is %i:%i",
-             id->p_encoder->fmt_out.video.i_sar_num * id->p_encoder->fmt_out.video.i_width,
-             id->p_encoder->fmt_out.video.i_sar_den * id->p_encoder->fmt_out.video.i_height );
+             p_enc->fmt_out.video.i_sar_num * p_enc->fmt_out.video.i_width,
+             p_enc->fmt_out.video.i_sar_den * p_enc->fmt_out.video.i_height );
 
 }
 
+static void transcode_video_encoder_init( sout_stream_t *p_stream,
+                                          sout_stream_id_sys_t *id )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    const es_format_t *p_fmt_out = &id->p_decoder->fmt_out;
+    if( id->p_f_chain ) {
+        p_fmt_out = filter_chain_GetFmtOut( id->p_f_chain );
+    }
+    if( id->p_uf_chain ) {
+        p_fmt_out = filter_chain_GetFmtOut( id->p_uf_chain );
+    }
+
+    video_encoder_init( p_stream, id, id->p_encoder, p_fmt_out,
+                        p_sys->f_scale, p_sys->i_maxwidth,
+                        p_sys->i_maxheight );
+}
+
 static int transcode_video_encoder_open( sout_stream_t *p_stream,
                                          sout_stream_id_sys_t *id )
 {
@@ -572,24 +879,262 @@ static int transcode_video_encoder_open( sout_stream_t *p_stream,
     return VLC_SUCCESS;
 }
 
+/* Pictures shared with the renditions, after the pre-filters
+ * (deinterlacing, frame rate conversion) */
+static const es_format_t *transcode_video_shared_fmt( sout_stream_id_sys_t *id )
+{
+    if( id->p_f_chain )
+        return filter_chain_GetFmtOut( id->p_f_chain );
+    return &id->p_decoder->fmt_out;
+}
+
+static sout_stream_t *transcode_rendition_out( sout_stream_t *p_stream,
+                                               const transcode_rendition_t *p_rd )
+{
+    return p_rd->p_out ? p_rd->p_out : p_stream->p_next;
+}
+
+/* (Re)builds the scaling and chroma conversion of a rendition */
+static void transcode_branch_chain( sout_stream_t *p_stream,
+                                    sout_stream_id_sys_t *id,
+                                    transcode_branch_t *p_br )
+{
+    filter_owner_t owner = {
+        .sys = p_stream->p_sys,
+        .video = {
+            .buffer_new = transcode_video_filter_buffer_new,
+        },
+    };
+    const es_format_t *p_fmt_in = transcode_video_shared_fmt( id );
+    const es_format_t *p_fmt_enc = &p_br->p_encoder->fmt_in;
+
+    if( p_br->p_chain )
+        filter_chain_Delete( p_br->p_chain );
+    p_br->p_chain = filter_chain_NewVideo( p_stream, false, &owner );
+    if( !p_br->p_chain )
+        return;
+    filter_chain_Reset( p_br->p_chain, p_fmt_in, p_fmt_enc );
+
+    if( p_fmt_in->video.i_chroma != p_fmt_enc->video.i_chroma ||
+        p_fmt_in->video.i_width != p_fmt_enc->video.i_width ||
+        p_fmt_in->video.i_height != p_fmt_enc->video.i_height )
+        filter_chain_AppendFilter( p_br->p_chain, NULL, NULL,
+                                   p_fmt_in, p_fmt_enc );
+}
+
+static void transcode_branch_close( sout_stream_t *p_stream,
+                                    const transcode_rendition_t *p_rd,
+                                    transcode_branch_t *p_br )
+{
+    encoder_t *p_enc = p_br->p_encoder;
+
+    if( p_br->id )
+        sout_StreamIdDel( transcode_rendition_out( p_stream, p_rd ),
+                          p_br->id );
+    if( p_enc )
+    {
+        if( p_enc->p_module )
+            module_unneed( p_enc, p_enc->p_module );
+        es_format_Clean( &p_enc->fmt_out );
+        vlc_object_release( p_enc );
+    }
+    if( p_br->p_chain )
+        filter_chain_Delete( p_br->p_chain );
+    block_ChainRelease( p_br->p_buffers );
+    assert( !p_br->b_running );
+    if( p_br->p_pics )
+        picture_fifo_Delete( p_br->p_pics );
+    memset( p_br, 0, sizeof( *p_br ) );
+}
+
+/* Opens the encoder of a rendition, once the main one is open */
+static int transcode_branch_open( sout_stream_t *p_stream,
+                                  sout_stream_id_sys_t *id,
+                                  const transcode_rendition_t *p_rd,
+                                  transcode_branch_t *p_br )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    const es_format_t *p_fmt_in = transcode_video_shared_fmt( id );
+    encoder_t *p_enc = sout_EncoderCreate( p_stream );
+
+    if( !p_enc )
+        return VLC_ENOMEM;
+    p_br->p_encoder = p_enc;
+    p_enc->p_module = NULL;
+
+    es_format_Init( &p_enc->fmt_out, VIDEO_ES, p_rd->i_vcodec );
+    p_enc->fmt_out.i_id    = id->p_encoder->fmt_out.i_id;
+    p_enc->fmt_out.i_group = id->p_encoder->fmt_out.i_group;
+    p_enc->fmt_out.i_bitrate = p_rd->i_vbitrate;
+    p_enc->fmt_out.video.i_visible_width  = p_rd->i_width & ~1;
+    p_enc->fmt_out.video.i_visible_height = p_rd->i_height & ~1;
+    p_enc->fmt_out.video.i_frame_rate =
+        id->p_encoder->fmt_out.video.i_frame_rate;
+    p_enc->fmt_out.video.i_frame_rate_base =
+        id->p_encoder->fmt_out.video.i_frame_rate_base;
+
+    es_format_Init( &p_enc->fmt_in, VIDEO_ES, p_fmt_in->video.i_chroma );
+    p_enc->fmt_in.video = p_fmt_in->video;
+    p_enc->i_threads = p_sys->i_threads;
+    p_enc->p_cfg = p_rd->p_video_cfg;
+
+    /* Probe the encoder for the chroma it wants, then size it */
+    p_enc->p_module = module_need( p_enc, "encoder", p_rd->psz_venc, true );
+    if( !p_enc->p_module )
+        goto error;
+    module_unneed( p_enc, p_enc->p_module );
+    p_enc->p_module = NULL;
+    free( p_enc->fmt_out.p_extra );
+    p_enc->fmt_out.p_extra = NULL;
+    p_enc->fmt_out.i_extra = 0;
+
+    video_encoder_init( p_stream, id, p_enc, p_fmt_in, p_rd->f_scale,
+                        p_rd->i_maxwidth, p_rd->i_maxheight );
+    p_enc->fmt_in.video.i_chroma = p_enc->fmt_in.i_codec;
+    transcode_branch_chain( p_stream, id, p_br );
+    if( !p_br->p_chain )
+        goto error;
+
+    p_enc->p_module = module_need( p_enc, "encoder", p_rd->psz_venc, true );
+    if( !p_enc->p_module )
+        goto error;
+    p_enc->fmt_in.video.i_chroma = p_enc->fmt_in.i_codec;
+    p_enc->fmt_out.i_codec =
+        vlc_fourcc_GetCodec( VIDEO_ES, p_enc->fmt_out.i_codec );
+
+    p_br->id = sout_StreamIdAdd( transcode_rendition_out( p_stream, p_rd ),
+                                 &p_enc->fmt_out );
+    if( !p_br->id )
+        goto error;
+
+    msg_Dbg( p_stream, "rendition %4.4s %ux%u opened",
+             (char *)&p_enc->fmt_out.i_codec,
+             p_enc->fmt_out.video.i_visible_width,
+             p_enc->fmt_out.video.i_visible_height );
+
+    /* Nothing is queued for the filter thread yet. Without a thread of its
+     * own, the rendition is encoded by the filter thread. */
+    if( p_sys->b_running )
+    {
+        int i_priority = p_sys->b_high_priority ? VLC_THREAD_PRIORITY_OUTPUT
+                                                : VLC_THREAD_PRIORITY_VIDEO;
+
+        p_br->p_stream = p_stream;
+        p_br->p_pics = picture_fifo_New();
+        if( p_br->p_pics != NULL
+         && vlc_clone( &p_br->thread, BranchThread, p_br, i_priority ) == 0 )
+            p_br->b_running = true;
+        else
+            msg_Warn( p_stream, "cannot spawn rendition thread" );
+    }
+    return VLC_SUCCESS;
+
+error:
+    msg_Err( p_stream, "cannot open video rendition (module:%s fourcc:%4.4s)",
+             p_rd->psz_venc ? p_rd->psz_venc : "any",
+             (char *)&p_rd->i_vcodec );
+    transcode_branch_close( p_stream, p_rd, p_br );
+    return VLC_EGENERIC;
+}
+
+/* Queues a pre-filtered picture for each rendition thread, or scales and
+ * encodes it here. Returns the time spent encoding, or waiting for room. */
+static mtime_t transcode_branches_output( sout_stream_t *p_stream,
+                                          sout_stream_id_sys_t *id,
+                                          picture_t *p_pic )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    mtime_t i_total = 0;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+    {
+        transcode_branch_t *p_br = &id->p_branches[i];
+
+        if( !p_br->id )
+            continue;
+
+        if( p_br->b_running )
+        {
+            vlc_mutex_lock( &p_sys->lock_out );
+            i_total += QueuePush( p_sys, p_br->p_pics, &p_br->i_pics,
+                                  TRANSCODE_FILTER, TRANSCODE_RENDITIONS,
+                                  picture_Hold( p_pic ) );
+            vlc_mutex_unlock( &p_sys->lock_out );
+            continue;
+        }
+
+        mtime_t i_start = mdate();
+        block_t *p_block = transcode_branch_encode( p_br,
+                                                    picture_Hold( p_pic ) );
+        mtime_t i_time = mdate() - i_start;
+
+        vlc_mutex_lock( &p_sys->lock_out );
+        StageAdd( p_sys, TRANSCODE_RENDITIONS, i_time, true );
+        block_ChainAppend( &p_br->p_buffers, p_block );
+        vlc_mutex_unlock( &p_sys->lock_out );
+        i_total += i_time;
+    }
+    return i_total;
+}
+
+/* Sends what the renditions encoded, from the sout thread */
+static void transcode_branches_send( sout_stream_t *p_stream,
+                                     sout_stream_id_sys_t *id, bool b_flush )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+    {
+        transcode_branch_t *p_br = &id->p_branches[i];
+        block_t *p_out;
+
+        if( !p_br->id )
+            continue;
+
+        vlc_mutex_lock( &p_sys->lock_out );
+        if( b_flush )
+        {
+            block_t *p_block;
+            do {
+                p_block = p_br->p_encoder->pf_encode_video( p_br->p_encoder,
+                                                            NULL );
+                block_ChainAppend( &p_br->p_buffers, p_block );
+            } while( p_block );
+        }
+        p_out = p_br->p_buffers;
+        p_br->p_buffers = NULL;
+        vlc_mutex_unlock( &p_sys->lock_out );
+
+        if( p_out )
+            sout_StreamIdSend( transcode_rendition_out( p_stream,
+                                                        p_sys->pp_renditions[i] ),
+                               p_br->id, p_out );
+    }
+}
+
 void transcode_video_close( sout_stream_t *p_stream,
                                    sout_stream_id_sys_t *id )
 {
-    if( p_stream->p_sys->i_threads >= 1 && !p_stream->p_sys->b_abort )
-    {
-        vlc_mutex_lock( &p_stream->p_sys->lock_out );
-        p_stream->p_sys->b_abort = true;
-        vlc_cond_signal( &p_stream->p_sys->cond );
-        vlc_mutex_unlock( &p_stream->p_sys->lock_out );
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
 
-        vlc_join( p_stream->p_sys->thread, NULL );
+    if( p_sys->i_threads >= 1 )
+    {
+        transcode_video_pipeline_stop( p_stream );
 
-        picture_fifo_Delete( p_stream->p_sys->pp_pics );
-        block_ChainRelease( p_stream->p_sys->p_buffers );
+        picture_fifo_Delete( p_sys->pp_decoded );
+        picture_fifo_Delete( p_sys->pp_pics );
+        block_ChainRelease( p_sys->p_buffers );
+        p_sys->p_buffers = NULL;
     }
 
-    vlc_mutex_destroy( &p_stream->p_sys->lock_out );
-    vlc_cond_destroy( &p_stream->p_sys->cond );
+    vlc_mutex_lock( &p_sys->lock_out );
+    Publish( p_stream );
+    Report( p_stream );
+    vlc_mutex_unlock( &p_sys->lock_out );
+
+    vlc_mutex_destroy( &p_sys->lock_out );
+    vlc_cond_destroy( &p_sys->cond );
+    vlc_cond_destroy( &p_sys->cond_space );
 
     /* Close decoder */
     if( id->p_decoder->p_module )
@@ -608,12 +1153,25 @@ void transcode_video_close( sout_stream_t *p_stream,
         filter_chain_Delete( id->p_f_chain );
     if( id->p_uf_chain )
         filter_chain_Delete( id->p_uf_chain );
+
+    /* Close renditions */
+    if( id->p_branches )
+    {
+        for( int i = 0; i < p_sys->i_renditions; i++ )
+            transcode_branch_close( p_stream, p_sys->pp_renditions[i],
+                                    &id->p_branches[i] );
+        free( id->p_branches );
+        id->p_branches = NULL;
+    }
 }
 
-static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_id_sys_t *id, block_t **out )
+/* Overlays the subpictures, then encodes the picture or queues it for the
+ * encoder thread. Returns the time spent in, or waiting for, the encoder. */
+static mtime_t OutputFrame( sout_stream_t *p_stream, picture_t *p_pic,
+                            sout_stream_id_sys_t *id, block_t **out )
 {
     sout_stream_sys_t *p_sys = p_stream->p_sys;
-    picture_t *p_pic2 = NULL;
+    mtime_t i_time;
 
     /*
      * Encoding
@@ -630,14 +1188,18 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
             fmt.i_y_offset       = 0;
         }
 
+        /* The decoder output format may already have changed if this runs
+         * in the filter thread; use the one the filters were set up for. */
         subpicture_t *p_subpic = spu_Render( p_sys->p_spu, NULL, &fmt,
-                                             &id->p_decoder->fmt_out.video,
+                                             &id->fmt_input_video,
                                              p_pic->date, p_pic->date, false );
 
         /* Overlay subpicture */
         if( p_subpic )
         {
-            if( picture_IsReferenced( p_pic ) && !filter_chain_GetLength( id->p_f_chain ) )
+            /* Renditions may still be reading a shared picture */
+            if( picture_IsReferenced( p_pic )
+             && ( !filter_chain_GetLength( id->p_f_chain ) || id->p_branches ) )
             {
                 /* We can't modify the picture, we need to duplicate it,
                  * in this point the picture is already p_encoder->fmt.in format*/
@@ -657,26 +1219,78 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
         }
     }
 
-    if( p_sys->i_threads == 0 )
+    if( !p_sys->b_running )
     {
         block_t *p_block;
+        mtime_t i_start = mdate();
 
         p_block = id->p_encoder->pf_encode_video( id->p_encoder, p_pic );
+        i_time = mdate() - i_start;
         block_ChainAppend( out, p_block );
-    }
+        picture_Release( p_pic );
 
-    if( p_sys->i_threads )
+        vlc_mutex_lock( &p_sys->lock_out );
+        StageAdd( p_sys, TRANSCODE_ENCODE, i_time, true );
+        vlc_mutex_unlock( &p_sys->lock_out );
+    }
+    else
     {
         vlc_mutex_lock( &p_sys->lock_out );
-        picture_fifo_Push( p_sys->pp_pics, p_pic );
-        vlc_cond_signal( &p_sys->cond );
+        i_time = QueuePush( p_sys, p_sys->pp_pics, &p_sys->i_pics,
+                            TRANSCODE_FILTER, TRANSCODE_ENCODE, p_pic );
         vlc_mutex_unlock( &p_sys->lock_out );
     }
+    return i_time;
+}
 
-    if( p_sys->i_threads && p_pic2 )
-        picture_Release( p_pic2 );
-    else if ( p_sys->i_threads == 0 )
-        picture_Release( p_pic );
+/* Runs the filter chains on a decoded picture and outputs their results,
+ * to the main encoding and to the renditions. */
+static void FilterFrame( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                         picture_t *p_pic, block_t **out )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    mtime_t i_start = mdate();
+    mtime_t i_output = 0;
+
+    /* Run the filter and output chains; first with the picture,
+     * and then with NULL as many times as we need until they
+     * stop outputting frames.
+     */
+    for ( ;; ) {
+        picture_t *p_filtered_pic = p_pic;
+
+        /* Run filter chain */
+        if( id->p_f_chain )
+            p_filtered_pic = filter_chain_VideoFilter( id->p_f_chain, p_filtered_pic );
+        if( !p_filtered_pic )
+            break;
+
+        if( id->p_branches )
+            i_output += transcode_branches_output( p_stream, id,
+                                                   p_filtered_pic );
+
+        for ( ;; ) {
+            picture_t *p_user_filtered_pic = p_filtered_pic;
+
+            /* Run user specified filter chain */
+            if( id->p_uf_chain )
+                p_user_filtered_pic = filter_chain_VideoFilter( id->p_uf_chain, p_user_filtered_pic );
+            if( !p_user_filtered_pic )
+                break;
+
+            i_output += OutputFrame( p_stream, p_user_filtered_pic, id, out );
+
+            p_filtered_pic = NULL;
+        }
+
+        p_pic = NULL;
+    }
+
+    mtime_t i_time = mdate() - i_start - i_output;
+
+    vlc_mutex_lock( &p_sys->lock_out );
+    StageAdd( p_sys, TRANSCODE_FILTER, i_time, true );
+    vlc_mutex_unlock( &p_sys->lock_out );
 }
 
 int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
@@ -699,12 +1313,8 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
         else
         {
             msg_Dbg( p_stream, "Flushing thread and waiting that");
-            vlc_mutex_lock( &p_stream->p_sys->lock_out );
-            p_stream->p_sys->b_abort = true;
-            vlc_cond_signal( &p_stream->p_sys->cond );
-            vlc_mutex_unlock( &p_stream->p_sys->lock_out );
+            transcode_video_pipeline_stop( p_stream );
 
-            vlc_join( p_stream->p_sys->thread, NULL );
             vlc_mutex_lock( &p_sys->lock_out );
             *out = p_sys->p_buffers;
             p_sys->p_buffers = NULL;
@@ -712,12 +1322,24 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
 
             msg_Dbg( p_stream, "Flushing done");
         }
+        if( id->p_branches )
+            transcode_branches_send( p_stream, id, true );
         return VLC_SUCCESS;
     }
 
 
-    while( (p_pic = id->p_decoder->pf_decode_video( id->p_decoder, &in )) )
+    for( ;; )
     {
+        mtime_t i_start = mdate();
+        p_pic = id->p_decoder->pf_decode_video( id->p_decoder, &in );
+        mtime_t i_time = mdate() - i_start;
+
+        vlc_mutex_lock( &p_sys->lock_out );
+        StageAdd( p_sys, TRANSCODE_DECODE, i_time, p_pic != NULL );
+        vlc_mutex_unlock( &p_sys->lock_out );
+
+        if( p_pic == NULL )
+            break;
 
         if( unlikely (
              id->p_encoder->p_module &&
@@ -729,6 +1351,10 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
                         id->fmt_input_video.i_sar_num, id->p_decoder->fmt_out.video.i_sar_num,
                         id->fmt_input_video.i_sar_den, id->p_decoder->fmt_out.video.i_sar_den
                     );
+            /* The filter and encoder threads must not see the change */
+            if( p_sys->b_running )
+                WaitIdle( p_sys );
+
             /* Close filters */
             if( id->p_f_chain )
                 filter_chain_Delete( id->p_f_chain );
@@ -746,6 +1372,11 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
             transcode_video_encoder_init( p_stream, id );
             conversion_video_filter_append( id );
             memcpy( &id->fmt_input_video, &id->p_decoder->fmt_out.video, sizeof(video_format_t));
+
+            /* Renditions keep their size, only their scaling changes */
+            for( int i = 0; id->p_branches && i < p_sys->i_renditions; i++ )
+                if( id->p_branches[i].id )
+                    transcode_branch_chain( p_stream, id, &id->p_branches[i] );
         }
 
 
@@ -769,48 +1400,46 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
                 id->b_transcode = false;
                 return VLC_EGENERIC;
             }
-        }
 
-        /* Run the filter and output chains; first with the picture,
-         * and then with NULL as many times as we need until they
-         * stop outputting frames.
-         */
-        for ( ;; ) {
-            picture_t *p_filtered_pic = p_pic;
-
-            /* Run filter chain */
-            if( id->p_f_chain )
-                p_filtered_pic = filter_chain_VideoFilter( id->p_f_chain, p_filtered_pic );
-            if( !p_filtered_pic )
-                break;
-
-            for ( ;; ) {
-                picture_t *p_user_filtered_pic = p_filtered_pic;
-
-                /* Run user specified filter chain */
-                if( id->p_uf_chain )
-                    p_user_filtered_pic = filter_chain_VideoFilter( id->p_uf_chain, p_user_filtered_pic );
-                if( !p_user_filtered_pic )
-                    break;
-
-                OutputFrame( p_stream, p_user_filtered_pic, id, out );
-
-                p_filtered_pic = NULL;
-            }
+            for( int i = 0; id->p_branches && i < p_sys->i_renditions; i++ )
+                transcode_branch_open( p_stream, id, p_sys->pp_renditions[i],
+                                       &id->p_branches[i] );
+        }
 
-            p_pic = NULL;
+        if( p_sys->b_running )
+        {
+            vlc_mutex_lock( &p_sys->lock_out );
+            QueuePush( p_sys, p_sys->pp_decoded, &p_sys->i_decoded,
+                       TRANSCODE_DECODE, TRANSCODE_FILTER, p_pic );
+            vlc_mutex_unlock( &p_sys->lock_out );
         }
+        else
+            FilterFrame( p_stream, id, p_pic, out );
     }
 
+    vlc_mutex_lock( &p_sys->lock_out );
     if( p_sys->i_threads >= 1 )
     {
         /* Pick up any return data the encoder thread wants to output. */
-        vlc_mutex_lock( &p_sys->lock_out );
         *out = p_sys->p_buffers;
         p_sys->p_buffers = NULL;
-        vlc_mutex_unlock( &p_sys->lock_out );
     }
 
+    Publish( p_stream );
+
+    mtime_t now = mdate();
+    if( now - p_sys->i_stats_start >= TRANSCODE_REPORT )
+    {
+        Report( p_stream );
+        memset( p_sys->stages, 0, sizeof (p_sys->stages) );
+        memset( p_sys->pi_published, 0, sizeof (p_sys->pi_published) );
+        p_sys->i_stats_start = now;
+    }
+    vlc_mutex_unlock( &p_sys->lock_out );
+
+    if( id->p_branches )
+        transcode_branches_send( p_stream, id, false );
+
     return VLC_SUCCESS;
 }
 
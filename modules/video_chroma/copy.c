@@ -78,6 +78,30 @@ void CopyCleanCache(copy_cache_t *cache)
         store " %%xmm4,   48(%[dst])\n" \
         : : [dst]"r"(dstp), [src]"r"(srcp) : "memory", "xmm1", "xmm2", "xmm3", "xmm4")
 
+#ifdef CAN_COMPILE_AVX2
+/* Same with 256-bit registers, the callers clear the upper halves with
+ * vzeroupper once done.
+ */
+#define COPY32(dstp, srcp, load, store) \
+    asm volatile (                      \
+        load "  0(%[src]), %%ymm1\n"    \
+        store " %%ymm1,    0(%[dst])\n" \
+        : : [dst]"r"(dstp), [src]"r"(srcp) : "memory", "xmm1")
+
+#define COPY64_AVX2(dstp, srcp, load, store) \
+    asm volatile (                      \
+        load "  0(%[src]), %%ymm1\n"    \
+        load " 32(%[src]), %%ymm2\n"    \
+        store " %%ymm1,    0(%[dst])\n" \
+        store " %%ymm2,   32(%[dst])\n" \
+        : : [dst]"r"(dstp), [src]"r"(srcp) : "memory", "xmm1", "xmm2")
+
+# ifndef __AVX2__
+#  undef vlc_CPU_AVX2
+#  define vlc_CPU_AVX2() ((cpu & VLC_CPU_AVX2) != 0)
+# endif
+#endif
+
 #ifndef __SSE4_1__
 # undef vlc_CPU_SSE4_1
 # define vlc_CPU_SSE4_1() ((cpu & VLC_CPU_SSE4_1) != 0)
@@ -95,7 +119,7 @@ void CopyCleanCache(copy_cache_t *cache)
 
 /* Optimized copy from "Uncacheable Speculative Write Combining" memory
  * as used by some video surface.
- * XXX It is really efficient only when SSE4.1 is available.
+ * XXX It is really efficient only when SSE4.1 or AVX2 is available.
  */
 VLC_SSE
 static void CopyFromUswc(uint8_t *dst, size_t dst_pitch,
@@ -114,6 +138,16 @@ static void CopyFromUswc(uint8_t *dst, size_t dst_pitch,
         const unsigned unaligned = (-(uintptr_t)src) & 0x0f;
         unsigned x = unaligned;
 
+#ifdef CAN_COMPILE_AVX2
+        if (vlc_CPU_AVX2() && width >= 32) {
+            /* 256-bit streaming loads must be 32-byte aligned */
+            x = (-(uintptr_t)src) & 0x1f;
+            if (x)
+                COPY32(dst, src, "vmovdqu", "vmovdqu");
+            for (; x+63 < width; x += 64)
+                COPY64_AVX2(&dst[x], &src[x], "vmovntdqa", "vmovdqu");
+        } else
+#endif
 #ifdef CAN_COMPILE_SSE4_1
         if (vlc_CPU_SSE4_1()) {
             if (!unaligned) {
@@ -143,20 +177,38 @@ static void CopyFromUswc(uint8_t *dst, size_t dst_pitch,
         src += src_pitch;
         dst += dst_pitch;
     }
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+        asm volatile ("vzeroupper");
+#endif
     asm volatile ("mfence");
 }
 
 VLC_SSE
 static void Copy2d(uint8_t *dst, size_t dst_pitch,
                    const uint8_t *src, size_t src_pitch,
-                   unsigned width, unsigned height)
+                   unsigned width, unsigned height, unsigned cpu)
 {
+#ifndef CAN_COMPILE_AVX2
+    VLC_UNUSED(cpu);
+#endif
     assert(((intptr_t)src & 0x0f) == 0 && (src_pitch & 0x0f) == 0);
 
     for (unsigned y = 0; y < height; y++) {
         unsigned x = 0;
 
         bool unaligned = ((intptr_t)dst & 0x0f) != 0;
+#ifdef CAN_COMPILE_AVX2
+        if (vlc_CPU_AVX2()) {
+            if (((intptr_t)dst & 0x1f) == 0) {
+                for (; x+63 < width; x += 64)
+                    COPY64_AVX2(&dst[x], &src[x], "vmovdqu", "vmovntdq");
+            } else {
+                for (; x+63 < width; x += 64)
+                    COPY64_AVX2(&dst[x], &src[x], "vmovdqu", "vmovdqu");
+            }
+        } else
+#endif
         if (!unaligned) {
             for (; x+63 < width; x += 64)
                 COPY64(&dst[x], &src[x], "movdqa", "movntdq");
@@ -171,6 +223,10 @@ static void Copy2d(uint8_t *dst, size_t dst_pitch,
         src += src_pitch;
         dst += dst_pitch;
     }
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+        asm volatile ("vzeroupper");
+#endif
 }
 
 VLC_SSE
@@ -208,6 +264,28 @@ static void SSE_SplitUV(uint8_t *dstu, size_t dstu_pitch,
     "movhpd %%xmm2,  16(%[dst2])\n" \
     "movhpd %%xmm3,  24(%[dst2])\n"
 
+#ifdef CAN_COMPILE_AVX2
+        if (vlc_CPU_AVX2())
+        {
+            /* Each lane is shuffled into 8 U then 8 V, the quadwords are
+             * reordered into U then V halves, which are finally joined */
+            for (x = 0; x < (width & ~31); x += 32) {
+                asm volatile (
+                    "vbroadcasti128 (%[shuffle]), %%ymm7\n"
+                    "vmovdqu  0(%[src]), %%ymm0\n"
+                    "vmovdqu 32(%[src]), %%ymm1\n"
+                    "vpshufb %%ymm7, %%ymm0, %%ymm0\n"
+                    "vpshufb %%ymm7, %%ymm1, %%ymm1\n"
+                    "vpermq $0xd8, %%ymm0, %%ymm0\n"
+                    "vpermq $0xd8, %%ymm1, %%ymm1\n"
+                    "vperm2i128 $0x20, %%ymm1, %%ymm0, %%ymm2\n"
+                    "vperm2i128 $0x31, %%ymm1, %%ymm0, %%ymm3\n"
+                    "vmovdqu %%ymm2, (%[dst1])\n"
+                    "vmovdqu %%ymm3, (%[dst2])\n"
+                    : : [dst1]"r"(&dstu[x]), [dst2]"r"(&dstv[x]), [src]"r"(&src[2*x]), [shuffle]"r"(shuffle) : "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm7");
+            }
+        } else
+#endif
 #ifdef CAN_COMPILE_SSSE3
         if (vlc_CPU_SSSE3())
         {
@@ -259,6 +337,10 @@ static void SSE_SplitUV(uint8_t *dstu, size_t dstu_pitch,
         dstu += dstu_pitch;
         dstv += dstv_pitch;
     }
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+        asm volatile ("vzeroupper");
+#endif
 }
 
 static void SSE_CopyPlane(uint8_t *dst, size_t dst_pitch,
@@ -281,7 +363,7 @@ static void SSE_CopyPlane(uint8_t *dst, size_t dst_pitch,
         /* Copy from our cache to the destination */
         Copy2d(dst, dst_pitch,
                cache, w16,
-               width, hblock);
+               width, hblock, cpu);
 
         /* */
         src += src_pitch * hblock;
@@ -366,6 +448,8 @@ static void SSE_CopyFromNv12ToNv12(picture_t *dst,
     asm volatile ("emms");
 }
 #undef COPY64
+#undef COPY64_AVX2
+#undef COPY32
 #endif /* CAN_COMPILE_SSE2 */
 
 static void CopyPlane(uint8_t *dst, size_t dst_pitch,
@@ -33,6 +33,7 @@
 #include "i420_rgb.h"
 #ifdef SSE2
 # include "i420_rgb_sse2.h"
+# include "i420_rgb_avx2.h"
 # define VLC_TARGET VLC_SSE
 #else
 # include "i420_rgb_mmx.h"
@@ -629,7 +630,9 @@ void I420_A8R8G8B8( filter_t *p_filter, picture_t *p_src,
         {
             p_pic_start = p_pic;
 
-            for ( i_x = p_filter->fmt_in.video.i_width / 16; i_x--; )
+            i_x = p_filter->fmt_in.video.i_width / 16;
+            AVX2_I420_32( ARGB, true );
+            for ( ; i_x--; )
             {
                 SSE2_CALL (
                     SSE2_INIT_32_ALIGNED
@@ -681,7 +684,9 @@ void I420_A8R8G8B8( filter_t *p_filter, picture_t *p_src,
             p_pic_start = p_pic;
             p_buffer = b_hscale ? p_buffer_start : p_pic;
 
-            for ( i_x = p_filter->fmt_in.video.i_width / 16; i_x--; )
+            i_x = p_filter->fmt_in.video.i_width / 16;
+            AVX2_I420_32( ARGB, false );
+            for ( ; i_x--; )
             {
                 SSE2_CALL (
                     SSE2_INIT_32_UNALIGNED
@@ -857,7 +862,9 @@ void I420_R8G8B8A8( filter_t *p_filter, picture_t *p_src, picture_t *p_dest )
         {
             p_pic_start = p_pic;
 
-            for ( i_x = p_filter->fmt_in.video.i_width / 16; i_x--; )
+            i_x = p_filter->fmt_in.video.i_width / 16;
+            AVX2_I420_32( RGBA, true );
+            for ( ; i_x--; )
             {
                 SSE2_CALL (
                     SSE2_INIT_32_ALIGNED
@@ -909,7 +916,9 @@ void I420_R8G8B8A8( filter_t *p_filter, picture_t *p_src, picture_t *p_dest )
             p_pic_start = p_pic;
             p_buffer = b_hscale ? p_buffer_start : p_pic;
 
-            for ( i_x = p_filter->fmt_in.video.i_width / 16; i_x--; )
+            i_x = p_filter->fmt_in.video.i_width / 16;
+            AVX2_I420_32( RGBA, false );
+            for ( ; i_x--; )
             {
                 SSE2_CALL (
                     SSE2_INIT_32_UNALIGNED
@@ -1085,7 +1094,9 @@ void I420_B8G8R8A8( filter_t *p_filter, picture_t *p_src, picture_t *p_dest )
         {
             p_pic_start = p_pic;
 
-            for ( i_x = p_filter->fmt_in.video.i_width / 16; i_x--; )
+            i_x = p_filter->fmt_in.video.i_width / 16;
+            AVX2_I420_32( BGRA, true );
+            for ( ; i_x--; )
             {
                 SSE2_CALL (
                     SSE2_INIT_32_ALIGNED
@@ -1137,7 +1148,9 @@ void I420_B8G8R8A8( filter_t *p_filter, picture_t *p_src, picture_t *p_dest )
             p_pic_start = p_pic;
             p_buffer = b_hscale ? p_buffer_start : p_pic;
 
-            for ( i_x = p_filter->fmt_in.video.i_width / 16; i_x--; )
+            i_x = p_filter->fmt_in.video.i_width / 16;
+            AVX2_I420_32( BGRA, false );
+            for ( ; i_x--; )
             {
                 SSE2_CALL (
                     SSE2_INIT_32_UNALIGNED
@@ -1310,7 +1323,9 @@ void I420_A8B8G8R8( filter_t *p_filter, picture_t *p_src, picture_t *p_dest )
         {
             p_pic_start = p_pic;
 
-            for ( i_x = p_filter->fmt_in.video.i_width / 16; i_x--; )
+            i_x = p_filter->fmt_in.video.i_width / 16;
+            AVX2_I420_32( ABGR, true );
+            for ( ; i_x--; )
             {
                 SSE2_CALL (
                     SSE2_INIT_32_ALIGNED
@@ -1362,7 +1377,9 @@ void I420_A8B8G8R8( filter_t *p_filter, picture_t *p_src, picture_t *p_dest )
             p_pic_start = p_pic;
             p_buffer = b_hscale ? p_buffer_start : p_pic;
 
-            for ( i_x = p_filter->fmt_in.video.i_width / 16; i_x--; )
+            i_x = p_filter->fmt_in.video.i_width / 16;
+            AVX2_I420_32( ABGR, false );
+            for ( ; i_x--; )
             {
                 SSE2_CALL (
                     SSE2_INIT_32_UNALIGNED
@@ -0,0 +1,137 @@
+/*****************************************************************************
+ * i420_rgb_avx2.h: AVX2 YUV transformation to 32-bit RGB
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#if defined(HAVE_AVX2_INTRINSICS)
+
+/* Same arithmetic as the SSE2 converters, on 32 pixels at once. Each 128-bit
+ * lane converts 16 pixels, as SSE2_YUV_MUL and SSE2_YUV_ADD do. */
+
+#include <immintrin.h>
+
+/* Computes the blue, green and red components of 32 pixels */
+VLC_AVX2
+static inline void AVX2_YuvToRgb( const uint8_t *p_y, const uint8_t *p_u,
+                                  const uint8_t *p_v, __m256i *b,
+                                  __m256i *g, __m256i *r )
+{
+    __m256i u = _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i *)p_u ) );
+    __m256i v = _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i *)p_v ) );
+    __m256i y = _mm256_loadu_si256( (__m256i *)p_y );
+
+    u = _mm256_slli_epi16( _mm256_subs_epi16( u, _mm256_set1_epi16( 0x80 ) ), 3 );
+    v = _mm256_slli_epi16( _mm256_subs_epi16( v, _mm256_set1_epi16( 0x80 ) ), 3 );
+
+    __m256i ug = _mm256_adds_epi16(
+        _mm256_mulhi_epi16( u, _mm256_set1_epi16( 0xf37d ) ),
+        _mm256_mulhi_epi16( v, _mm256_set1_epi16( 0xe5fc ) ) );
+    __m256i ub = _mm256_mulhi_epi16( u, _mm256_set1_epi16( 0x4093 ) );
+    __m256i vr = _mm256_mulhi_epi16( v, _mm256_set1_epi16( 0x3312 ) );
+
+    y = _mm256_subs_epu8( y, _mm256_set1_epi8( 0x10 ) );
+    __m256i y_even = _mm256_and_si256( y, _mm256_set1_epi16( 0x00ff ) );
+    __m256i y_odd = _mm256_srli_epi16( y, 8 );
+    y_even = _mm256_mulhi_epi16( _mm256_slli_epi16( y_even, 3 ),
+                                 _mm256_set1_epi16( 0x253f ) );
+    y_odd = _mm256_mulhi_epi16( _mm256_slli_epi16( y_odd, 3 ),
+                                _mm256_set1_epi16( 0x253f ) );
+
+#define AVX2_COMPONENT( c ) \
+    _mm256_unpacklo_epi8( \
+        _mm256_packus_epi16( _mm256_adds_epi16( c, y_even ), \
+                             _mm256_adds_epi16( c, y_even ) ), \
+        _mm256_packus_epi16( _mm256_adds_epi16( c, y_odd ), \
+                             _mm256_adds_epi16( c, y_odd ) ) )
+    *b = AVX2_COMPONENT( ub );
+    *g = AVX2_COMPONENT( ug );
+    *r = AVX2_COMPONENT( vr );
+#undef AVX2_COMPONENT
+}
+
+/* Interleaves the components of 32 pixels, c0 being the first byte */
+VLC_AVX2
+static inline void AVX2_Store32( uint32_t *p_buffer, __m256i c0, __m256i c1,
+                                 __m256i c2, __m256i c3, bool b_stream )
+{
+    __m256i lo01 = _mm256_unpacklo_epi8( c0, c1 );
+    __m256i lo23 = _mm256_unpacklo_epi8( c2, c3 );
+    __m256i hi01 = _mm256_unpackhi_epi8( c0, c1 );
+    __m256i hi23 = _mm256_unpackhi_epi8( c2, c3 );
+    /* Pixels 0-3 and 16-19, 4-7 and 20-23, 8-11 and 24-27, 12-15 and 28-31 */
+    __m256i p0 = _mm256_unpacklo_epi16( lo01, lo23 );
+    __m256i p1 = _mm256_unpackhi_epi16( lo01, lo23 );
+    __m256i p2 = _mm256_unpacklo_epi16( hi01, hi23 );
+    __m256i p3 = _mm256_unpackhi_epi16( hi01, hi23 );
+    __m256i out[4] = {
+        _mm256_permute2x128_si256( p0, p1, 0x20 ),
+        _mm256_permute2x128_si256( p2, p3, 0x20 ),
+        _mm256_permute2x128_si256( p0, p1, 0x31 ),
+        _mm256_permute2x128_si256( p2, p3, 0x31 ),
+    };
+
+    if( b_stream && ((uintptr_t)p_buffer & 31) == 0 )
+        for( int i = 0; i < 4; i++ )
+            _mm256_stream_si256( (__m256i *)(p_buffer + 8 * i), out[i] );
+    else
+        for( int i = 0; i < 4; i++ )
+            _mm256_storeu_si256( (__m256i *)(p_buffer + 8 * i), out[i] );
+}
+
+#define AVX2_I420_32_FUNC( name, c0, c1, c2, c3 ) \
+VLC_AVX2 \
+static void AVX2_I420_##name( uint32_t *p_buffer, const uint8_t *p_y, \
+                              const uint8_t *p_u, const uint8_t *p_v, \
+                              unsigned i_blocks, bool b_stream ) \
+{ \
+    const __m256i a = _mm256_setzero_si256(); \
+    while( i_blocks-- ) \
+    { \
+        __m256i b, g, r; \
+        AVX2_YuvToRgb( p_y, p_u, p_v, &b, &g, &r ); \
+        AVX2_Store32( p_buffer, c0, c1, c2, c3, b_stream ); \
+        p_y += 32; \
+        p_u += 16; \
+        p_v += 16; \
+        p_buffer += 32; \
+    } \
+}
+
+/* Byte order in memory */
+AVX2_I420_32_FUNC( ARGB, b, g, r, a )
+AVX2_I420_32_FUNC( RGBA, a, b, g, r )
+AVX2_I420_32_FUNC( BGRA, a, r, g, b )
+AVX2_I420_32_FUNC( ABGR, r, g, b, a )
+#undef AVX2_I420_32_FUNC
+
+/* Converts pairs of 16 pixels blocks, if AVX2 is available. This updates the
+ * pointers and the count of blocks (i_x) left to the SSE2 loop. */
+#define AVX2_I420_32( name, b_stream ) \
+    if( i_x >= 2 && vlc_CPU_AVX2() ) \
+    { \
+        unsigned i_blocks = i_x / 2; \
+        AVX2_I420_##name( p_buffer, p_y, p_u, p_v, i_blocks, b_stream ); \
+        p_y += 32 * i_blocks; \
+        p_u += 16 * i_blocks; \
+        p_v += 16 * i_blocks; \
+        p_buffer += 32 * i_blocks; \
+        i_x -= 2 * i_blocks; \
+    }
+
+#else
+# define AVX2_I420_32( name, b_stream ) (void)0
+#endif
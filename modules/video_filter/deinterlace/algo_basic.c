@@ -120,127 +120,130 @@ void RenderBob( picture_t *p_outpic, picture_t *p_pic, int i_field )
     }
 }
 
+/* Bands of a plane rendered by one of the merging algorithms below */
+struct merge_slice
+{
+    filter_t *p_filter; /* for Merge() */
+    const plane_t *in;
+    plane_t *out;
+    int i_field;
+};
+
 /*****************************************************************************
  * RenderLinear: BOB with linear interpolation
  *****************************************************************************/
 
-void RenderLinear( filter_t *p_filter,
-                   picture_t *p_outpic, picture_t *p_pic, int i_field )
+static void RenderLinearSlice( void *opaque, unsigned first, unsigned last )
 {
-    int i_plane;
+    const struct merge_slice *s = opaque;
+    filter_t *p_filter = s->p_filter;
+    const int i_pitch = s->in->i_pitch;
+    const int i_lines = s->out->i_visible_lines;
 
-    /* Copy image and skip lines */
-    for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+    for( unsigned y = first; y < last; y++ )
     {
-        uint8_t *p_in, *p_out_end, *p_out;
-
-        p_in = p_pic->p[i_plane].p_pixels;
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
-
-        /* For BOTTOM field we need to add the first line */
-        if( i_field == 1 )
-        {
-            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-            p_in += p_pic->p[i_plane].i_pitch;
-            p_out += p_outpic->p[i_plane].i_pitch;
-        }
-
-        p_out_end -= 2 * p_outpic->p[i_plane].i_pitch;
-
-        for( ; p_out < p_out_end ; )
-        {
-            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-
-            p_out += p_outpic->p[i_plane].i_pitch;
-
-            Merge( p_out, p_in, p_in + 2 * p_pic->p[i_plane].i_pitch,
-                   p_pic->p[i_plane].i_pitch );
-
-            p_in += 2 * p_pic->p[i_plane].i_pitch;
-            p_out += p_outpic->p[i_plane].i_pitch;
-        }
-
-        memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-
-        /* For TOP field we need to add the last line */
-        if( i_field == 0 )
-        {
-            p_in += p_pic->p[i_plane].i_pitch;
-            p_out += p_outpic->p[i_plane].i_pitch;
-            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-        }
+        const uint8_t *p_in = s->in->p_pixels + y * i_pitch;
+        uint8_t *p_out = s->out->p_pixels + y * s->out->i_pitch;
+
+        /* Lines of the field, and first and last lines: simple copy */
+        if( (int)(y % 2) == s->i_field || y == 0 || (int)y == i_lines - 1 )
+            memcpy( p_out, p_in, i_pitch );
+        else
+            Merge( p_out, p_in - i_pitch, p_in + i_pitch, i_pitch );
     }
     EndMerge();
 }
 
+void RenderLinear( filter_t *p_filter,
+                   picture_t *p_outpic, picture_t *p_pic, int i_field )
+{
+    for( int i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+    {
+        struct merge_slice slice = {
+            .p_filter = p_filter,
+            .in = &p_pic->p[i_plane],
+            .out = &p_outpic->p[i_plane],
+            .i_field = i_field,
+        };
+
+        filter_Slice( p_filter, slice.out->i_visible_lines, 2,
+                      RenderLinearSlice, &slice );
+    }
+}
+
 /*****************************************************************************
  * RenderMean: Half-resolution blender
  *****************************************************************************/
 
-void RenderMean( filter_t *p_filter,
-                 picture_t *p_outpic, picture_t *p_pic )
+static void RenderMeanSlice( void *opaque, unsigned first, unsigned last )
 {
-    int i_plane;
+    const struct merge_slice *s = opaque;
+    filter_t *p_filter = s->p_filter;
+    const int i_pitch = s->in->i_pitch;
 
-    /* Copy image and skip lines */
-    for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+    /* All lines: mean value */
+    for( unsigned y = first; y < last; y++ )
     {
-        uint8_t *p_in, *p_out_end, *p_out;
-
-        p_in = p_pic->p[i_plane].p_pixels;
-
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
-
-        /* All lines: mean value */
-        for( ; p_out < p_out_end ; )
-        {
-            Merge( p_out, p_in, p_in + p_pic->p[i_plane].i_pitch,
-                   p_pic->p[i_plane].i_pitch );
+        const uint8_t *p_in = s->in->p_pixels + 2 * y * i_pitch;
+        uint8_t *p_out = s->out->p_pixels + y * s->out->i_pitch;
 
-            p_out += p_outpic->p[i_plane].i_pitch;
-            p_in += 2 * p_pic->p[i_plane].i_pitch;
-        }
+        Merge( p_out, p_in, p_in + i_pitch, i_pitch );
     }
     EndMerge();
 }
 
+void RenderMean( filter_t *p_filter,
+                 picture_t *p_outpic, picture_t *p_pic )
+{
+    for( int i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+    {
+        struct merge_slice slice = {
+            .p_filter = p_filter,
+            .in = &p_pic->p[i_plane],
+            .out = &p_outpic->p[i_plane],
+        };
+
+        filter_Slice( p_filter, slice.out->i_visible_lines, 1,
+                      RenderMeanSlice, &slice );
+    }
+}
+
 /*****************************************************************************
  * RenderBlend: Full-resolution blender
  *****************************************************************************/
 
-void RenderBlend( filter_t *p_filter,
-                  picture_t *p_outpic, picture_t *p_pic )
+static void RenderBlendSlice( void *opaque, unsigned first, unsigned last )
 {
-    int i_plane;
+    const struct merge_slice *s = opaque;
+    filter_t *p_filter = s->p_filter;
+    const int i_pitch = s->in->i_pitch;
 
-    /* Copy image and skip lines */
-    for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+    for( unsigned y = first; y < last; y++ )
     {
-        uint8_t *p_in, *p_out_end, *p_out;
-
-        p_in = p_pic->p[i_plane].p_pixels;
-
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
-
-        /* First line: simple copy */
-        memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-        p_out += p_outpic->p[i_plane].i_pitch;
-
-        /* Remaining lines: mean value */
-        for( ; p_out < p_out_end ; )
-        {
-            Merge( p_out, p_in, p_in + p_pic->p[i_plane].i_pitch,
-                   p_pic->p[i_plane].i_pitch );
-
-            p_out += p_outpic->p[i_plane].i_pitch;
-            p_in  += p_pic->p[i_plane].i_pitch;
-        }
+        const uint8_t *p_in = s->in->p_pixels + y * i_pitch;
+        uint8_t *p_out = s->out->p_pixels + y * s->out->i_pitch;
+
+        /* First line: simple copy, remaining lines: mean value */
+        if( y == 0 )
+            memcpy( p_out, p_in, i_pitch );
+        else
+            Merge( p_out, p_in - i_pitch, p_in, i_pitch );
     }
     EndMerge();
 }
+
+void RenderBlend( filter_t *p_filter,
+                  picture_t *p_outpic, picture_t *p_pic )
+{
+    for( int i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+    {
+        struct merge_slice slice = {
+            .p_filter = p_filter,
+            .in = &p_pic->p[i_plane],
+            .out = &p_outpic->p[i_plane],
+        };
+
+        filter_Slice( p_filter, slice.out->i_visible_lines, 1,
+                      RenderBlendSlice, &slice );
+    }
+}
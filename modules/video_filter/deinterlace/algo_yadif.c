@@ -47,6 +47,64 @@
    Necessary preprocessor macros are defined in common.h. */
 #include "yadif.h"
 
+struct yadif_slice
+{
+    void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
+                   int w, int prefs, int mrefs, int parity, int mode);
+    const plane_t *prevp;
+    const plane_t *curp;
+    const plane_t *nextp;
+    plane_t *dstp;
+    int parity;
+    int field;
+};
+
+/* Renders the lines first + 1 to last of a plane. Lines only depend on the
+ * source pictures, so that bands can be rendered concurrently. */
+static void RenderYadifSlice( void *opaque, unsigned first, unsigned last )
+{
+    const struct yadif_slice *s = opaque;
+    const plane_t *prevp = s->prevp;
+    const plane_t *curp  = s->curp;
+    const plane_t *nextp = s->nextp;
+    plane_t *dstp        = s->dstp;
+
+    for( int y = first + 1; y < (int)last + 1; y++ )
+    {
+        if( (y % 2) == s->field  ||  s->parity == 2 )
+        {
+            memcpy( &dstp->p_pixels[y * dstp->i_pitch],
+                        &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
+        }
+        else
+        {
+            int mode;
+            /* Spatial checks only when enough data */
+            mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
+
+            s->filter( &dstp->p_pixels[y * dstp->i_pitch],
+                       &prevp->p_pixels[y * prevp->i_pitch],
+                       &curp->p_pixels[y * curp->i_pitch],
+                       &nextp->p_pixels[y * nextp->i_pitch],
+                       dstp->i_visible_pitch,
+                       y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
+                       y  - 1  ?  -curp->i_pitch : curp->i_pitch,
+                       s->parity,
+                       mode );
+        }
+
+        /* We duplicate the first and last lines */
+        if( y == 1 )
+            memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
+                       &dstp->p_pixels[ y    * dstp->i_pitch],
+                       dstp->i_pitch);
+        else if( y == dstp->i_visible_lines - 2 )
+            memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
+                       &dstp->p_pixels[ y    * dstp->i_pitch],
+                       dstp->i_pitch);
+    }
+}
+
 int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
                  int i_order, int i_field )
 {
@@ -108,6 +166,11 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
         void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
                        int w, int prefs, int mrefs, int parity, int mode);
 
+#if defined(HAVE_YADIF_AVX2)
+        if( vlc_CPU_AVX2() )
+            filter = yadif_filter_line_avx2;
+        else
+#endif
 #if defined(HAVE_YADIF_SSSE3)
         if( vlc_CPU_SSSE3() )
             filter = yadif_filter_line_ssse3;
@@ -130,46 +193,22 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
 
         for( int n = 0; n < p_dst->i_planes; n++ )
         {
-            const plane_t *prevp = &p_prev->p[n];
-            const plane_t *curp  = &p_cur->p[n];
-            const plane_t *nextp = &p_next->p[n];
-            plane_t *dstp        = &p_dst->p[n];
-
-            for( int y = 1; y < dstp->i_visible_lines - 1; y++ )
-            {
-                if( (y % 2) == i_field  ||  yadif_parity == 2 )
-                {
-                    memcpy( &dstp->p_pixels[y * dstp->i_pitch],
-                                &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
-                }
-                else
-                {
-                    int mode;
-                    /* Spatial checks only when enough data */
-                    mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
-
-                    assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
-                    filter( &dstp->p_pixels[y * dstp->i_pitch],
-                            &prevp->p_pixels[y * prevp->i_pitch],
-                            &curp->p_pixels[y * curp->i_pitch],
-                            &nextp->p_pixels[y * nextp->i_pitch],
-                            dstp->i_visible_pitch,
-                            y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
-                            y  - 1  ?  -curp->i_pitch : curp->i_pitch,
-                            yadif_parity,
-                            mode );
-                }
-
-                /* We duplicate the first and last lines */
-                if( y == 1 )
-                    memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-                else if( y == dstp->i_visible_lines - 2 )
-                    memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-            }
+            struct yadif_slice slice = {
+                .filter = filter,
+                .prevp = &p_prev->p[n],
+                .curp  = &p_cur->p[n],
+                .nextp = &p_next->p[n],
+                .dstp  = &p_dst->p[n],
+                .parity = yadif_parity,
+                .field = i_field,
+            };
+
+            assert( slice.prevp->i_pitch == slice.curp->i_pitch
+                 && slice.curp->i_pitch == slice.nextp->i_pitch );
+            /* Lines 1 to i_visible_lines - 2, in bands of line pairs */
+            if( slice.dstp->i_visible_lines > 2 )
+                filter_Slice( p_filter, slice.dstp->i_visible_lines - 2, 2,
+                              RenderYadifSlice, &slice );
         }
 
         p_sys->i_frame_offset = 1; /* p_cur will be rendered at next frame, too */
@@ -178,6 +178,66 @@ void Merge16BitSSE2( void *_p_dest, const void *_p_s1, const void *_p_s2,
 
 #endif
 
+#if defined(CAN_COMPILE_AVX2)
+VLC_AVX2
+void Merge8BitAVX2( void *_p_dest, const void *_p_s1, const void *_p_s2,
+                    size_t i_bytes )
+{
+    uint8_t *p_dest = _p_dest;
+    const uint8_t *p_s1 = _p_s1;
+    const uint8_t *p_s2 = _p_s2;
+
+    for( ; i_bytes > 0 && ((uintptr_t)p_s1 & 31); i_bytes-- )
+        *p_dest++ = ( *p_s1++ + *p_s2++ ) >> 1;
+
+    for( ; i_bytes >= 32; i_bytes -= 32 )
+    {
+        __asm__  __volatile__( "vmovdqu %2,%%ymm1;"
+                               "vpavgb %1, %%ymm1, %%ymm1;"
+                               "vmovdqu %%ymm1, %0" :"=m" (*(uint8_t (*)[32])p_dest):
+                                                 "m" (*(const uint8_t (*)[32])p_s1),
+                                                 "m" (*(const uint8_t (*)[32])p_s2) : "xmm1" );
+        p_dest += 32;
+        p_s1 += 32;
+        p_s2 += 32;
+    }
+    /* Avoid the SSE/AVX transition penalty in the caller */
+    __asm__ __volatile__( "vzeroupper" );
+
+    for( ; i_bytes > 0; i_bytes-- )
+        *p_dest++ = ( *p_s1++ + *p_s2++ ) >> 1;
+}
+
+VLC_AVX2
+void Merge16BitAVX2( void *_p_dest, const void *_p_s1, const void *_p_s2,
+                     size_t i_bytes )
+{
+    uint16_t *p_dest = _p_dest;
+    const uint16_t *p_s1 = _p_s1;
+    const uint16_t *p_s2 = _p_s2;
+
+    size_t i_words = i_bytes / 2;
+    for( ; i_words > 0 && ((uintptr_t)p_s1 & 31); i_words-- )
+        *p_dest++ = ( *p_s1++ + *p_s2++ ) >> 1;
+
+    for( ; i_words >= 16; i_words -= 16 )
+    {
+        __asm__  __volatile__( "vmovdqu %2,%%ymm1;"
+                               "vpavgw %1, %%ymm1, %%ymm1;"
+                               "vmovdqu %%ymm1, %0" :"=m" (*(uint16_t (*)[16])p_dest):
+                                                 "m" (*(const uint16_t (*)[16])p_s1),
+                                                 "m" (*(const uint16_t (*)[16])p_s2) : "xmm1" );
+        p_dest += 16;
+        p_s1 += 16;
+        p_s2 += 16;
+    }
+    __asm__ __volatile__( "vzeroupper" );
+
+    for( ; i_words > 0; i_words-- )
+        *p_dest++ = ( *p_s1++ + *p_s2++ ) >> 1;
+}
+#endif
+
 #ifdef CAN_COMPILE_C_ALTIVEC
 void MergeAltivec( void *_p_dest, const void *_p_s1,
                    const void *_p_s2, size_t i_bytes )
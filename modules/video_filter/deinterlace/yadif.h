@@ -147,3 +147,95 @@ static void yadif_filter_line_c_16bit(uint16_t *dst, uint16_t *prev, uint16_t *c
     prefs /= 2;
     FILTER
 }
+
+#if defined(HAVE_AVX2_INTRINSICS)
+#include <immintrin.h>
+// ================ AVX2 =================
+#define HAVE_YADIF_AVX2
+
+/* 16 pixels widened to 16 bits */
+#define LOAD16(p) _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p)))
+#define ABSDIFF(a,b) _mm256_abs_epi16(_mm256_sub_epi16(a, b))
+
+/* Same as FILTER on 16 pixels at once, the remaining ones are done in C */
+VLC_AVX2 static void yadif_filter_line_avx2(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int prefs, int mrefs, int parity, int mode) {
+    int x;
+    uint8_t *prev2= parity ? prev : cur ;
+    uint8_t *next2= parity ? cur  : next;
+    const __m256i one = _mm256_set1_epi16(1);
+
+    for (x = 0; x + 16 <= w; x += 16) {
+        __m256i c = LOAD16(&cur[x+mrefs]);
+        __m256i d = LOAD16(&prev2[x]);
+        __m256i e = LOAD16(&cur[x+prefs]);
+        __m256i n2 = LOAD16(&next2[x]);
+        __m256i temporal_diff0 = ABSDIFF(d, n2);
+        __m256i temporal_diff1 = _mm256_srli_epi16(_mm256_add_epi16(
+                                     ABSDIFF(LOAD16(&prev[x+mrefs]), c),
+                                     ABSDIFF(LOAD16(&prev[x+prefs]), e)), 1);
+        __m256i temporal_diff2 = _mm256_srli_epi16(_mm256_add_epi16(
+                                     ABSDIFF(LOAD16(&next[x+mrefs]), c),
+                                     ABSDIFF(LOAD16(&next[x+prefs]), e)), 1);
+        d = _mm256_srli_epi16(_mm256_add_epi16(d, n2), 1);
+
+        __m256i diff = _mm256_max_epi16(_mm256_max_epi16(
+                           _mm256_srli_epi16(temporal_diff0, 1),
+                           temporal_diff1), temporal_diff2);
+        __m256i spatial_pred = _mm256_srli_epi16(_mm256_add_epi16(c, e), 1);
+        __m256i spatial_score = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(
+                    ABSDIFF(LOAD16(&cur[x+mrefs-1]), LOAD16(&cur[x+prefs-1])),
+                    ABSDIFF(c, e)),
+                    ABSDIFF(LOAD16(&cur[x+mrefs+1]), LOAD16(&cur[x+prefs+1]))),
+                    one);
+
+        /* The second direction is only tried if the first one was better */
+        for (int dir = -1; dir <= 1; dir += 2) {
+            __m256i better = _mm256_set1_epi16(-1);
+
+            for (int k = dir; k >= -2 && k <= 2; k += dir) {
+                __m256i score = _mm256_add_epi16(_mm256_add_epi16(
+                    ABSDIFF(LOAD16(&cur[x+mrefs-1+k]), LOAD16(&cur[x+prefs-1-k])),
+                    ABSDIFF(LOAD16(&cur[x+mrefs  +k]), LOAD16(&cur[x+prefs  -k]))),
+                    ABSDIFF(LOAD16(&cur[x+mrefs+1+k]), LOAD16(&cur[x+prefs+1-k])));
+                __m256i pred = _mm256_srli_epi16(_mm256_add_epi16(
+                    LOAD16(&cur[x+mrefs+k]), LOAD16(&cur[x+prefs-k])), 1);
+
+                better = _mm256_and_si256(better,
+                                   _mm256_cmpgt_epi16(spatial_score, score));
+                spatial_score = _mm256_blendv_epi8(spatial_score, score, better);
+                spatial_pred = _mm256_blendv_epi8(spatial_pred, pred, better);
+            }
+        }
+
+        if (mode < 2) {
+            __m256i b = _mm256_srli_epi16(_mm256_add_epi16(
+                            LOAD16(&prev2[x+2*mrefs]), LOAD16(&next2[x+2*mrefs])), 1);
+            __m256i f = _mm256_srli_epi16(_mm256_add_epi16(
+                            LOAD16(&prev2[x+2*prefs]), LOAD16(&next2[x+2*prefs])), 1);
+            __m256i dc = _mm256_sub_epi16(d, c);
+            __m256i de = _mm256_sub_epi16(d, e);
+            __m256i bc = _mm256_sub_epi16(b, c);
+            __m256i fe = _mm256_sub_epi16(f, e);
+            __m256i max = _mm256_max_epi16(_mm256_max_epi16(de, dc),
+                                           _mm256_min_epi16(bc, fe));
+            __m256i min = _mm256_min_epi16(_mm256_min_epi16(de, dc),
+                                           _mm256_max_epi16(bc, fe));
+
+            diff = _mm256_max_epi16(_mm256_max_epi16(diff, min),
+                                    _mm256_sub_epi16(_mm256_setzero_si256(), max));
+        }
+
+        spatial_pred = _mm256_max_epi16(spatial_pred, _mm256_sub_epi16(d, diff));
+        spatial_pred = _mm256_min_epi16(spatial_pred, _mm256_add_epi16(d, diff));
+        spatial_pred = _mm256_permute4x64_epi64(
+                           _mm256_packus_epi16(spatial_pred, spatial_pred), 0x08);
+        _mm_storeu_si128((__m128i *)&dst[x], _mm256_castsi256_si128(spatial_pred));
+    }
+
+    if (x < w)
+        yadif_filter_line_c(dst + x, prev + x, cur + x, next + x, w - x,
+                            prefs, mrefs, parity, mode);
+}
+#undef ABSDIFF
+#undef LOAD16
+#endif
@@ -90,6 +90,7 @@ struct filter_sys_t
 {
     const vlc_chroma_description_t *chroma;
     int w[3], h[3];
+    int wmax;
 
     struct vf_priv_s cfg;
     bool   b_recalc_coefs;
@@ -137,7 +138,9 @@ static int Open(vlc_object_t *this)
         if (sys->w[i] > wmax) wmax = sys->w[i];
         sys->h[i] = fmt_out->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
     }
-    cfg->Line = malloc(wmax*sizeof(unsigned int));
+    /* One line buffer per plane, as planes are denoised concurrently */
+    sys->wmax = wmax;
+    cfg->Line = malloc(3*wmax*sizeof(unsigned int));
     if (!cfg->Line) {
         free(sys);
         return VLC_ENOMEM;
@@ -191,6 +194,33 @@ static void Close(vlc_object_t *this)
 /*****************************************************************************
  * Filter
  *****************************************************************************/
+struct denoise_slice
+{
+    filter_sys_t *sys;
+    picture_t *src;
+    picture_t *dst;
+};
+
+static void DenoisePlanes(void *opaque, unsigned first, unsigned last)
+{
+    const struct denoise_slice *slice = opaque;
+    filter_sys_t *sys = slice->sys;
+    struct vf_priv_s *cfg = &sys->cfg;
+
+    for (unsigned i = first; i < last; i++) {
+        /* Luma uses the first two sets of coefficients, chromas the others */
+        int *spat = cfg->Coefs[i ? 2 : 0];
+        int *temp = cfg->Coefs[i ? 3 : 1];
+
+        deNoise(slice->src->p[i].p_pixels, slice->dst->p[i].p_pixels,
+                cfg->Line + i * sys->wmax, &cfg->Frame[i], sys->w[i], sys->h[i],
+                slice->src->p[i].i_pitch, slice->dst->p[i].i_pitch,
+                spat,
+                spat,
+                temp);
+    }
+}
+
 static picture_t *Filter(filter_t *filter, picture_t *src)
 {
     picture_t *dst;
@@ -220,24 +250,11 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
     }
     vlc_mutex_unlock( &sys->coefs_mutex );
 
-    deNoise(src->p[0].p_pixels, dst->p[0].p_pixels,
-            cfg->Line, &cfg->Frame[0], sys->w[0], sys->h[0],
-            src->p[0].i_pitch, dst->p[0].i_pitch,
-            cfg->Coefs[0],
-            cfg->Coefs[0],
-            cfg->Coefs[1]);
-    deNoise(src->p[1].p_pixels, dst->p[1].p_pixels,
-            cfg->Line, &cfg->Frame[1], sys->w[1], sys->h[1],
-            src->p[1].i_pitch, dst->p[1].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
-    deNoise(src->p[2].p_pixels, dst->p[2].p_pixels,
-            cfg->Line, &cfg->Frame[2], sys->w[2], sys->h[2],
-            src->p[2].i_pitch, dst->p[2].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
+    struct denoise_slice slice = { sys, src, dst };
+
+    /* The filter is recursive in both directions: only the planes are
+     * independent from each other. */
+    filter_Slice(filter, 3, 1, DenoisePlanes, &slice);
 
     return CopyInfoAndRelease(dst, src);
 }
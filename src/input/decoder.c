@@ -84,6 +84,15 @@ struct decoder_owner_sys_t
 
     /* fifo */
     block_fifo_t *p_fifo;
+    bool          b_fifo_lockfree; /* fed with vlc_fifo_Push() */
+    unsigned      i_fifo_pushed;   /* blocks pushed since the last check */
+    struct
+    {
+        mtime_t   i_max;   /* duration limit, 0 if unlimited */
+        mtime_t   i_first; /* date of the oldest queued data (fifo lock) */
+        mtime_t   i_last;  /* date of the end of the newest queued data */
+        mtime_t   i_trim;  /* i_last when non-reference frames were dropped */
+    } fifo_time;
 
     /* Lock for communication with decoder thread */
     vlc_mutex_t lock;
@@ -135,6 +144,20 @@ struct decoder_owner_sys_t
 /* */
 #define DECODER_SPU_VOUT_WAIT_DURATION ((int)(0.200*CLOCK_FREQ))
 
+/* Lock-free decoder FIFO: ring size, and how often the producer takes the
+ * lock to check the FIFO size */
+#define DECODER_FIFO_SLOTS       1024
+#define DECODER_FIFO_CHECK_EVERY 64
+
+/* Hard limit on the decoder FIFO size, whatever its duration.
+ * 400 MiB, i.e. ~ 50mb/s for 60s */
+#define DECODER_FIFO_MAX_BYTES   (400*1024*1024)
+
+/* Paced mode: amount of data queued before waiting for the decoder */
+#define DECODER_PACE_DURATION    (CLOCK_FREQ/2)
+#define DECODER_PACE_BLOCKS      10 /* if the duration is unknown */
+#define DECODER_PACE_MAX_BLOCKS  1000
+
 static void DecoderUpdateFormatLocked( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
@@ -1394,6 +1417,10 @@ flush:
         DecoderProcessOnFlush( p_dec );
 }
 
+static inline mtime_t DecoderBlockDate( const block_t *p_block )
+{
+    return p_block->i_dts > VLC_TS_INVALID ? p_block->i_dts : p_block->i_pts;
+}
 
 /**
  * The decoding main loop
@@ -1435,6 +1462,12 @@ static void *DecoderThread( void *p_data )
         }
 
         p_block = vlc_fifo_DequeueUnlocked( p_owner->p_fifo );
+        if( p_block != NULL )
+        {
+            mtime_t i_date = DecoderBlockDate( p_block );
+            if( i_date > VLC_TS_INVALID )
+                p_owner->fifo_time.i_first = i_date;
+        }
         vlc_cleanup_pop();
         vlc_fifo_Unlock( p_owner->p_fifo );
 
@@ -1533,7 +1566,31 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     es_format_Init( &p_owner->fmt, UNKNOWN_ES, 0 );
 
     /* decoder fifo */
-    p_owner->p_fifo = block_FifoNew();
+    p_owner->b_fifo_lockfree = var_InheritBool( p_dec, "input-lockfree-fifo" );
+    p_owner->i_fifo_pushed = 0;
+    switch( fmt->i_cat )
+    {
+        case VIDEO_ES:
+            p_owner->fifo_time.i_max = var_InheritInteger( p_dec, "input-fifo-video" );
+            break;
+        case AUDIO_ES:
+            p_owner->fifo_time.i_max = var_InheritInteger( p_dec, "input-fifo-audio" );
+            break;
+        case SPU_ES:
+            p_owner->fifo_time.i_max = var_InheritInteger( p_dec, "input-fifo-spu" );
+            break;
+        default:
+            p_owner->fifo_time.i_max = 0;
+            break;
+    }
+    p_owner->fifo_time.i_max *= 1000;
+    p_owner->fifo_time.i_first = VLC_TS_INVALID;
+    p_owner->fifo_time.i_last = VLC_TS_INVALID;
+    p_owner->fifo_time.i_trim = VLC_TS_INVALID;
+    if( p_owner->b_fifo_lockfree )
+        p_owner->p_fifo = block_FifoNewSPSC( DECODER_FIFO_SLOTS );
+    else
+        p_owner->p_fifo = block_FifoNew();
     if( unlikely(p_owner->p_fifo == NULL) )
     {
         free( p_owner );
@@ -1844,6 +1901,136 @@ void input_DecoderDelete( decoder_t *p_dec )
     DeleteDecoder( p_dec );
 }
 
+/* Returns the duration of the data in the decoder FIFO, or -1 if unknown.
+ * FIFO lock must be held. */
+static mtime_t DecoderFifoDuration( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( p_owner->fifo_time.i_first <= VLC_TS_INVALID ||
+        p_owner->fifo_time.i_last <= VLC_TS_INVALID )
+        return -1;
+    return __MAX( p_owner->fifo_time.i_last - p_owner->fifo_time.i_first, 0 );
+}
+
+/* Updates the date of the newest queued data, from the producer side.
+ * Returns true if the dates restart (discontinuity), in which case
+ * fifo_time.i_first must be reset with the FIFO lock held. */
+static bool DecoderFifoUpdate( decoder_t *p_dec, const block_t *p_block )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    mtime_t i_date = DecoderBlockDate( p_block );
+
+    if( i_date <= VLC_TS_INVALID )
+        return false;
+
+    mtime_t i_last = p_owner->fifo_time.i_last;
+    p_owner->fifo_time.i_last = i_date + p_block->i_length;
+
+    return ( p_block->i_flags & BLOCK_FLAG_DISCONTINUITY ) ||
+           i_last <= VLC_TS_INVALID || i_date < i_last - CLOCK_FREQ ||
+           ( p_owner->fifo_time.i_max > 0 &&
+             i_date - i_last > p_owner->fifo_time.i_max );
+}
+
+/* Drops data from the decoder FIFO when it holds more than the configured
+ * duration. Frames flagged as disposable (no other frame refers to them) are
+ * dropped first, as that alone lets the decoder catch up. If the FIFO keeps
+ * growing, the oldest data are dropped up to a key frame, if any.
+ * FIFO lock must be held. */
+static void DecoderFifoTrim( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    block_fifo_t *p_fifo = p_owner->p_fifo;
+    const mtime_t i_max = p_owner->fifo_time.i_max;
+
+    if( vlc_fifo_GetBytes( p_fifo ) > DECODER_FIFO_MAX_BYTES )
+    {
+        msg_Warn( p_dec, "decoder/packetizer fifo full (data not "
+                  "consumed quickly enough), resetting fifo!" );
+        block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_fifo ) );
+        p_owner->fifo_time.i_first = VLC_TS_INVALID;
+        return;
+    }
+
+    mtime_t i_duration = DecoderFifoDuration( p_dec );
+    if( i_max <= 0 || i_duration <= i_max )
+        return;
+
+    const bool b_drop_nonref = p_owner->fifo_time.i_trim <= VLC_TS_INVALID ||
+        p_owner->fifo_time.i_last - p_owner->fifo_time.i_trim >= i_max / 8;
+    const bool b_drop_old = i_duration > i_max + i_max / 4;
+    if( !b_drop_nonref && !b_drop_old )
+        return;
+
+    block_t *p_chain = vlc_fifo_DequeueAllUnlocked( p_fifo );
+    block_t **pp_block = &p_chain;
+    unsigned i_dropped = 0;
+
+    if( b_drop_nonref )
+    {
+        p_owner->fifo_time.i_trim = p_owner->fifo_time.i_last;
+        while( *pp_block != NULL )
+        {
+            block_t *p_block = *pp_block;
+            /* B pictures may be references (H.264/HEVC B-pyramid) */
+            if( p_block->i_flags & BLOCK_FLAG_DISPOSABLE )
+            {
+                *pp_block = p_block->p_next;
+                p_block->p_next = NULL;
+                block_Release( p_block );
+                i_dropped++;
+            }
+            else
+                pp_block = &p_block->p_next;
+        }
+    }
+
+    if( b_drop_old )
+    {
+        /* Go back to 3/4 of the limit, starting on a video key frame, so
+         * that the decoder does not get pictures lacking their references */
+        const mtime_t i_target = p_owner->fifo_time.i_last - i_max * 3 / 4;
+        const bool b_video = p_dec->fmt_in.i_cat == VIDEO_ES;
+        block_t *p_cut = NULL;
+
+        for( block_t *p_block = p_chain; p_block != NULL;
+             p_block = p_block->p_next )
+        {
+            mtime_t i_date = DecoderBlockDate( p_block );
+            if( i_date <= VLC_TS_INVALID || i_date < i_target )
+                continue;
+            if( !b_video || ( p_block->i_flags & BLOCK_FLAG_TYPE_I ) )
+            {
+                p_cut = p_block;
+                break;
+            }
+        }
+
+        if( p_cut != NULL )
+        {
+            while( p_chain != p_cut )
+            {
+                block_t *p_next = p_chain->p_next;
+                p_chain->p_next = NULL;
+                block_Release( p_chain );
+                p_chain = p_next;
+                i_dropped++;
+            }
+            p_cut->i_flags |= BLOCK_FLAG_DISCONTINUITY;
+            p_owner->fifo_time.i_first = DecoderBlockDate( p_cut );
+        }
+    }
+
+    if( p_chain != NULL )
+        vlc_fifo_QueueUnlocked( p_fifo, p_chain );
+
+    if( i_dropped > 0 )
+        msg_Warn( p_dec, "decoder/packetizer fifo holds %"PRId64" ms (data "
+                  "not consumed quickly enough), dropped %u blocks",
+                  i_duration / 1000, i_dropped );
+}
+
 /**
  * Put a block_t in the decoder's fifo.
  * Thread-safe w.r.t. the decoder. May be a cancellation point.
@@ -1854,27 +2041,49 @@ void input_DecoderDelete( decoder_t *p_dec )
 void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    bool b_restart = DecoderFifoUpdate( p_dec, p_block );
 
-    vlc_fifo_Lock( p_owner->p_fifo );
-    if( !b_do_pace )
+    if( p_owner->b_fifo_lockfree && !b_do_pace )
     {
-        /* FIXME: ideally we would check the time amount of data
-         * in the FIFO instead of its size. */
-        /* 400 MiB, i.e. ~ 50mb/s for 60s */
-        if( vlc_fifo_GetBytes( p_owner->p_fifo ) > 400*1024*1024 )
+        /* Only lock once in a while to check the FIFO did not overflow */
+        if( ++p_owner->i_fifo_pushed >= DECODER_FIFO_CHECK_EVERY || b_restart )
         {
-            msg_Warn( p_dec, "decoder/packetizer fifo full (data not "
-                      "consumed quickly enough), resetting fifo!" );
-            block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+            p_owner->i_fifo_pushed = 0;
+            vlc_fifo_Lock( p_owner->p_fifo );
+            if( b_restart )
+                p_owner->fifo_time.i_first = DecoderBlockDate( p_block );
+            DecoderFifoTrim( p_dec );
+            vlc_fifo_Unlock( p_owner->p_fifo );
         }
+        vlc_fifo_Push( p_owner->p_fifo, p_block );
+        return;
     }
+
+    vlc_fifo_Lock( p_owner->p_fifo );
+    if( b_restart )
+        p_owner->fifo_time.i_first = DecoderBlockDate( p_block );
+
+    if( !b_do_pace )
+        DecoderFifoTrim( p_dec );
     else
     if( !p_owner->b_waiting )
     {   /* The FIFO is not consumed when waiting, so pacing would deadlock VLC.
          * Locking is not necessary as b_waiting is only read, not written by
          * the decoder thread. */
-        while( vlc_fifo_GetCount( p_owner->p_fifo ) >= 10 )
+        for( ;; )
+        {
+            size_t i_count = vlc_fifo_GetCount( p_owner->p_fifo );
+            mtime_t i_duration = DecoderFifoDuration( p_dec );
+
+            bool b_full = i_duration >= 0
+                        ? i_duration >= DECODER_PACE_DURATION
+                        : i_count >= DECODER_PACE_BLOCKS;
+
+            if( i_count == 0 ||
+                ( !b_full && i_count < DECODER_PACE_MAX_BLOCKS ) )
+                break;
             vlc_fifo_WaitCond( p_owner->p_fifo, &p_owner->wait_fifo );
+        }
     }
 
     vlc_fifo_QueueUnlocked( p_owner->p_fifo, p_block );
@@ -1931,6 +2140,8 @@ static void DecoderFlush( decoder_t *p_dec )
     vlc_fifo_Lock( p_owner->p_fifo );
     /* Empty the fifo */
     block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+    p_owner->fifo_time.i_first = VLC_TS_INVALID;
+    p_owner->fifo_time.i_last = VLC_TS_INVALID;
     p_owner->b_draining = false; /* flush supersedes drain */
     vlc_fifo_Unlock( p_owner->p_fifo );
 
@@ -0,0 +1,306 @@
+/*****************************************************************************
+ * demux_index.c: persistent cache of demuxer seek indexes
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_block.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+#include "config/configuration.h"
+
+/* A cached index is a header, the key (file path and index name, both nul
+ * terminated, padded to 8 bytes) and the records in native byte order. */
+#define INDEX_MAGIC "VLCINDX1"
+#define INDEX_DIR   "index"
+#define INDEX_MAX_SIZE (64 << 20) /* bytes, oldest indexes are removed */
+
+struct demux_index_header
+{
+    char     magic[8];
+    uint64_t file_size;
+    int64_t  file_mtime;
+    uint64_t count;
+    uint32_t record;
+    uint32_t key_length;
+};
+
+static size_t IndexKeyLength( const demux_t *p_demux, const char *psz_name )
+{
+    return strlen( p_demux->psz_file ) + 1 + strlen( psz_name ) + 1;
+}
+
+static size_t IndexHeaderLength( size_t i_key )
+{
+    return (sizeof( struct demux_index_header ) + i_key + 7) & ~(size_t)7;
+}
+
+/**
+ * Returns the path of the cached index, and the status of the indexed file,
+ * or NULL if the index of this input cannot be cached.
+ */
+static char *IndexPath( demux_t *p_demux, const char *psz_name,
+                        struct stat *p_st )
+{
+    if( p_demux->psz_file == NULL
+     || !var_InheritBool( p_demux, "demux-index-cache" ) )
+        return NULL;
+    if( vlc_stat( p_demux->psz_file, p_st ) || !S_ISREG( p_st->st_mode ) )
+        return NULL;
+
+    struct md5_s md5;
+    InitMD5( &md5 );
+    AddMD5( &md5, p_demux->psz_file, strlen( p_demux->psz_file ) + 1 );
+    AddMD5( &md5, psz_name, strlen( psz_name ) );
+    EndMD5( &md5 );
+
+    char *psz_hash = psz_md5_hash( &md5 );
+    char *psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    char *psz_path;
+
+    if( psz_hash == NULL || psz_dir == NULL
+     || asprintf( &psz_path, "%s"DIR_SEP INDEX_DIR DIR_SEP"%s",
+                  psz_dir, psz_hash ) == -1 )
+        psz_path = NULL;
+    free( psz_dir );
+    free( psz_hash );
+    return psz_path;
+}
+
+block_t *demux_IndexLoad( demux_t *p_demux, const char *psz_name,
+                          size_t i_record )
+{
+    struct stat st;
+    char *psz_path = IndexPath( p_demux, psz_name, &st );
+    if( psz_path == NULL )
+        return NULL;
+
+    block_t *p_block = block_FilePath( psz_path );
+    free( psz_path );
+    if( p_block == NULL )
+        return NULL;
+
+    const size_t i_key = IndexKeyLength( p_demux, psz_name );
+    const size_t i_header = IndexHeaderLength( i_key );
+    struct demux_index_header hdr;
+    const char *p_key = (const char *)p_block->p_buffer + sizeof( hdr );
+
+    if( p_block->i_buffer < i_header )
+        goto stale;
+    memcpy( &hdr, p_block->p_buffer, sizeof( hdr ) );
+    if( memcmp( hdr.magic, INDEX_MAGIC, sizeof( hdr.magic ) )
+     || hdr.file_size != (uint64_t)st.st_size
+     || hdr.file_mtime != (int64_t)st.st_mtime
+     || hdr.record != i_record || hdr.key_length != i_key
+     || strcmp( p_key, p_demux->psz_file )
+     || strcmp( p_key + strlen( p_key ) + 1, psz_name )
+     || hdr.count > (p_block->i_buffer - i_header) / i_record )
+        goto stale;
+
+    p_block->p_buffer += i_header;
+    p_block->i_buffer = hdr.count * i_record;
+    msg_Dbg( p_demux, "loaded %"PRIu64" %s index entries from cache",
+             hdr.count, psz_name );
+    return p_block;
+
+stale:
+    msg_Dbg( p_demux, "ignoring stale %s index cache", psz_name );
+    block_Release( p_block );
+    return NULL;
+}
+
+struct demux_index_entry
+{
+    char    *psz_path;
+    time_t   i_mtime;
+    uint64_t i_size;
+};
+
+static int IndexEntryCmp( const void *a, const void *b )
+{
+    const struct demux_index_entry *ea = a, *eb = b;
+
+    return (ea->i_mtime > eb->i_mtime) - (ea->i_mtime < eb->i_mtime);
+}
+
+/**
+ * Removes the least recently stored indexes until the cache directory fits
+ * in INDEX_MAX_SIZE. The index just stored is kept.
+ */
+static void IndexPrune( demux_t *p_demux, const char *psz_dir,
+                        const char *psz_keep )
+{
+    DIR *dir = vlc_opendir( psz_dir );
+    if( dir == NULL )
+        return;
+
+    struct demux_index_entry *p_entries = NULL;
+    size_t i_entries = 0, i_alloc = 0;
+    uint64_t i_total = 0;
+    const char *psz_name;
+
+    while( (psz_name = vlc_readdir( dir )) != NULL )
+    {
+        struct stat st;
+        char *psz_path;
+
+        /* Only complete indexes, named after their MD5 hash */
+        if( strlen( psz_name ) != 32 || strchr( psz_name, '.' ) != NULL )
+            continue;
+        if( asprintf( &psz_path, "%s"DIR_SEP"%s", psz_dir, psz_name ) == -1 )
+            break;
+        if( vlc_stat( psz_path, &st ) || !S_ISREG( st.st_mode ) )
+        {
+            free( psz_path );
+            continue;
+        }
+        i_total += st.st_size;
+        if( !strcmp( psz_name, psz_keep ) )
+        {
+            free( psz_path );
+            continue;
+        }
+
+        if( i_entries == i_alloc )
+        {
+            size_t i_new = i_alloc ? 2 * i_alloc : 16;
+            void *p = realloc( p_entries, i_new * sizeof( *p_entries ) );
+            if( p == NULL )
+            {
+                free( psz_path );
+                break;
+            }
+            p_entries = p;
+            i_alloc = i_new;
+        }
+        p_entries[i_entries].psz_path = psz_path;
+        p_entries[i_entries].i_mtime = st.st_mtime;
+        p_entries[i_entries].i_size = st.st_size;
+        i_entries++;
+    }
+    closedir( dir );
+
+    qsort( p_entries, i_entries, sizeof( *p_entries ), IndexEntryCmp );
+    for( size_t i = 0; i < i_entries; i++ )
+    {
+        if( i_total > INDEX_MAX_SIZE
+         && vlc_unlink( p_entries[i].psz_path ) == 0 )
+        {
+            msg_Dbg( p_demux, "removed index cache %s",
+                     p_entries[i].psz_path );
+            i_total -= p_entries[i].i_size;
+        }
+        free( p_entries[i].psz_path );
+    }
+    free( p_entries );
+}
+
+int demux_IndexStore( demux_t *p_demux, const char *psz_name,
+                      const void *p_records, size_t i_record, size_t i_count )
+{
+    struct stat st;
+    char *psz_path = IndexPath( p_demux, psz_name, &st );
+    if( psz_path == NULL )
+        return VLC_EGENERIC;
+
+    const size_t i_key = IndexKeyLength( p_demux, psz_name );
+    const size_t i_pad = IndexHeaderLength( i_key )
+                       - sizeof( struct demux_index_header );
+    int i_ret = VLC_EGENERIC;
+    char *psz_tmp = NULL;
+    char *psz_sep = strrchr( psz_path, DIR_SEP_CHAR );
+    char *key = calloc( 1, i_pad );
+
+    if( key == NULL )
+        goto out;
+    strcpy( key, p_demux->psz_file );
+    strcpy( key + strlen( key ) + 1, psz_name );
+
+    *psz_sep = '\0';
+    if( config_CreateDir( VLC_OBJECT(p_demux), psz_path ) )
+        goto out;
+    *psz_sep = DIR_SEP_CHAR;
+
+    if( asprintf( &psz_tmp, "%s.%"PRIu32, psz_path,
+                  (uint32_t)getpid() ) == -1 )
+    {
+        psz_tmp = NULL;
+        goto out;
+    }
+
+    FILE *file = vlc_fopen( psz_tmp, "wb" );
+    if( file == NULL )
+    {
+        msg_Warn( p_demux, "cannot create %s: %s", psz_tmp,
+                  vlc_strerror_c(errno) );
+        goto out;
+    }
+
+    struct demux_index_header hdr;
+
+    memset( &hdr, 0, sizeof( hdr ) );
+    memcpy( hdr.magic, INDEX_MAGIC, sizeof( hdr.magic ) );
+    hdr.file_size = st.st_size;
+    hdr.file_mtime = st.st_mtime;
+    hdr.count = i_count;
+    hdr.record = i_record;
+    hdr.key_length = i_key;
+
+    if( fwrite( &hdr, sizeof( hdr ), 1, file ) != 1
+     || fwrite( key, i_pad, 1, file ) != 1
+     || (i_count > 0 && fwrite( p_records, i_record, i_count, file ) != i_count)
+     || fflush( file ) )
+    {
+        msg_Warn( p_demux, "cannot write %s: %s", psz_tmp,
+                  vlc_strerror_c(errno) );
+        fclose( file );
+        vlc_unlink( psz_tmp );
+        goto out;
+    }
+
+#if !defined( _WIN32 ) && !defined( __OS2__ )
+    vlc_rename( psz_tmp, psz_path ); /* atomically replace old index */
+    fclose( file );
+#else
+    vlc_unlink( psz_path );
+    fclose( file );
+    vlc_rename( psz_tmp, psz_path );
+#endif
+    msg_Dbg( p_demux, "stored %zu %s index entries in cache", i_count,
+             psz_name );
+    i_ret = VLC_SUCCESS;
+
+    *psz_sep = '\0';
+    IndexPrune( p_demux, psz_path, psz_sep + 1 );
+    *psz_sep = DIR_SEP_CHAR;
+out:
+    free( key );
+    free( psz_tmp );
+    free( psz_path );
+    return i_ret;
+}
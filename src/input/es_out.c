@@ -1981,6 +1981,14 @@ static int EsOutSend( es_out_t *out, es_out_id_t *es, block_t *p_block )
         }
     }
 
+    /* Decoders and packetizers modify the data in place */
+    p_block = block_MakeWritable( p_block );
+    if( p_block == NULL )
+    {
+        vlc_mutex_unlock( &p_sys->lock );
+        return VLC_ENOMEM;
+    }
+
     /* Decode */
     if( es->p_dec_record )
     {
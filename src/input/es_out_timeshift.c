@@ -36,6 +36,9 @@
 #endif
 #include <sys/stat.h>
 #include <unistd.h>
+#ifdef HAVE_POSIX_FALLOCATE
+#  include <fcntl.h>
+#endif
 
 #include <vlc_common.h>
 #include <vlc_fs.h>
@@ -60,6 +63,9 @@
 #   define attribute_packed
 #endif
 
+/* Maximum number of blocks written at once by the writer thread */
+#define TS_WRITE_BATCH (64)
+
 enum
 {
     C_ADD,
@@ -82,7 +88,7 @@ typedef struct attribute_packed
 typedef struct attribute_packed
 {
     es_out_id_t *p_es;
-    block_t *p_block;
+    block_t *p_block;  /* Until written to the storage file */
     int     i_offset;  /* We do not use file > INT_MAX */
 } ts_cmd_send_t;
 
@@ -150,6 +156,29 @@ typedef struct attribute_packed
     } u;
 } ts_cmd_t;
 
+/* Header of a block in a storage file, followed by the block data */
+typedef struct
+{
+    mtime_t  i_dts;
+    mtime_t  i_pts;
+    mtime_t  i_length;
+    uint32_t i_flags;
+    uint32_t i_nb_samples;
+    uint32_t i_buffer;
+} ts_block_header_t;
+
+/* Seeks up to this much past the newest buffered time are accepted */
+#define TS_SEEK_TOLERANCE (CLOCK_FREQ)
+
+/* Command following an input time update, or a key frame sent after it,
+ * see TsSeek() */
+typedef struct
+{
+    mtime_t i_time;
+    int     i_cmd;
+    bool    b_key;
+} ts_index_t;
+
 typedef struct ts_storage_t ts_storage_t;
 struct ts_storage_t
 {
@@ -161,25 +190,36 @@ struct ts_storage_t
     int64_t i_file_size;/* Current size in bytes */
     FILE    *p_filew;   /* FILE handle for data writing */
     FILE    *p_filer;   /* FILE handle for data reading */
+    bool    b_allocated;/* Space of i_file_max bytes reserved */
 
     /* */
     int      i_cmd_r;
     int      i_cmd_w;
+    int      i_cmd_e;    /* Commands before this one were executed once */
+    int      i_cmd_sync; /* Commands before this one were written */
     int      i_cmd_max;
     ts_cmd_t *p_cmd;
+
+    /* */
+    int        i_index;
+    int        i_index_max;
+    ts_index_t *p_index;
 };
 
 typedef struct
 {
     vlc_thread_t   thread;
+    vlc_thread_t   writer;
     input_thread_t *p_input;
     es_out_t       *p_out;
     int64_t        i_tmp_size_max;
+    int64_t        i_window;
     const char     *psz_tmp_path;
 
     /* Lock for all following fields */
     vlc_mutex_t    lock;
     vlc_cond_t     wait;
+    vlc_cond_t     wait_write;
 
     /* */
     bool           b_paused;
@@ -194,11 +234,19 @@ typedef struct
     /* */
     mtime_t        i_buffering_delay;
 
-    /* */
+    /* From the oldest played storage kept to the one being written */
+    ts_storage_t   *p_storage_first;
     ts_storage_t   *p_storage_r;
     ts_storage_t   *p_storage_w;
+    ts_storage_t   *p_storage_spare; /* Next storage, prepared by the writer */
 
     mtime_t        i_cmd_delay;
+    unsigned       i_seek;
+    mtime_t        i_index_time; /* Last input time pushed */
+
+    /* Deleted ES still referenced by the played commands */
+    int            i_es_dead;
+    es_out_id_t    **pp_es_dead;
 
 } ts_thread_t;
 
@@ -214,6 +262,7 @@ struct es_out_sys_t
 
     /* Configuration */
     int64_t        i_tmp_size_max;    /* Maximal temporary file size in byte */
+    int64_t        i_window;          /* Played data kept to seek back, in byte */
     char           *psz_tmp_path;     /* Path for temporary files */
 
     /* Lock for all following fields */
@@ -245,24 +294,32 @@ static void         TsAutoStop( es_out_t * );
 
 static void         TsStop( ts_thread_t * );
 static void         TsPushCmd( ts_thread_t *, ts_cmd_t * );
-static int          TsPopCmdLocked( ts_thread_t *, ts_cmd_t *, bool b_flush );
+static int          TsPopCmdLocked( ts_thread_t *, ts_cmd_t * );
+static void         TsTrimLocked( ts_thread_t * );
+static int          TsSeek( ts_thread_t *, mtime_t i_time );
 static bool         TsHasCmd( ts_thread_t * );
 static bool         TsIsUnused( ts_thread_t * );
 static int          TsChangePause( ts_thread_t *, bool b_source_paused, bool b_paused, mtime_t i_date );
 static int          TsChangeRate( ts_thread_t *, int i_src_rate, int i_rate );
 
 static void         *TsRun( void * );
+static void         *TsRunWriter( void * );
 
 static ts_storage_t *TsStorageNew( const char *psz_path, int64_t i_tmp_size_max );
+static int          TsStorageReset( ts_storage_t * );
 static void         TsStorageDelete( ts_storage_t * );
 static void         TsStoragePack( ts_storage_t *p_storage );
 static bool         TsStorageIsFull( ts_storage_t *, const ts_cmd_t *p_cmd );
 static bool         TsStorageIsEmpty( ts_storage_t * );
-static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, bool b_flush );
-static void         TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
+static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd );
+static void         TsStorageIndex( ts_storage_t *, mtime_t i_time, bool b_key );
+static int          TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd );
+static void         TsStorageAllocate( ts_storage_t * );
+static int          TsStorageWriteBlock( ts_storage_t *, const block_t *, int i_offset );
 
 static void CmdClean( ts_cmd_t * );
 static void cmd_cleanup_routine( void *p ) { CmdClean( p ); }
+static bool CmdIsReplayable( const ts_cmd_t * );
 
 static int  CmdInitAdd    ( ts_cmd_t *, es_out_id_t *, const es_format_t *, bool b_copy );
 static void CmdInitSend   ( ts_cmd_t *, es_out_id_t *, block_t * );
@@ -333,8 +390,13 @@ es_out_t *input_EsOutTimeshiftNew( input_thread_t *p_input, es_out_t *p_next_out
     char *psz_tmp_path = var_CreateGetNonEmptyString( p_input, "input-timeshift-path" );
     p_sys->psz_tmp_path = GetTmpPath( psz_tmp_path );
 
+    const int i_window = var_CreateGetInteger( p_input, "input-timeshift-window" );
+    p_sys->i_window = (int64_t)__MAX( i_window, 0 ) * 1024 * 1024;
+
     msg_Dbg( p_input, "using timeshift granularity of %d MiB, in path '%s'",
              (int)p_sys->i_tmp_size_max/(1024*1024), p_sys->psz_tmp_path );
+    if( p_sys->i_window > 0 )
+        msg_Dbg( p_input, "keeping %d MiB of timeshift to seek back", i_window );
 
 #if 0
 #define S(t) msg_Err( p_input, "SIZEOF("#t")=%d", sizeof(t) )
@@ -413,6 +475,11 @@ static int Send( es_out_t *p_out, es_out_id_t *p_es, block_t *p_block )
 
     TsAutoStop( p_out );
 
+    /* Record live streams from the start, to be able to seek back */
+    if( !p_sys->b_delayed && p_sys->i_window > 0 &&
+        !p_sys->p_input->p->b_can_pace_control )
+        TsStart( p_out );
+
     CmdInitSend( &cmd, p_es, p_block );
     if( p_sys->b_delayed )
         TsPushCmd( p_sys->p_ts, &cmd );
@@ -556,8 +623,11 @@ static int ControlLockedSetTime( es_out_t *p_out, mtime_t i_date )
 {
     es_out_sys_t *p_sys = p_out->p_sys;
 
+    /* A positive date is a seek within the timeshift buffer */
     if( !p_sys->b_delayed )
-        return es_out_SetTime( p_sys->p_out, i_date );
+        return i_date < 0 ? es_out_SetTime( p_sys->p_out, i_date ) : VLC_EGENERIC;
+    if( i_date >= 0 )
+        return TsSeek( p_sys->p_ts, i_date );
 
     /* TODO */
     msg_Err( p_sys->p_input, "EsOutTimeshift does not yet support time change" );
@@ -725,6 +795,7 @@ static int Control( es_out_t *p_out, int i_query, va_list args )
  *****************************************************************************/
 static void TsDestroy( ts_thread_t *p_ts )
 {
+    vlc_cond_destroy( &p_ts->wait_write );
     vlc_cond_destroy( &p_ts->wait );
     vlc_mutex_destroy( &p_ts->lock );
     free( p_ts );
@@ -741,11 +812,13 @@ static int TsStart( es_out_t *p_out )
         return VLC_EGENERIC;
 
     p_ts->i_tmp_size_max = p_sys->i_tmp_size_max;
+    p_ts->i_window = p_sys->i_window;
     p_ts->psz_tmp_path = p_sys->psz_tmp_path;
     p_ts->p_input = p_sys->p_input;
     p_ts->p_out = p_sys->p_out;
     vlc_mutex_init( &p_ts->lock );
     vlc_cond_init( &p_ts->wait );
+    vlc_cond_init( &p_ts->wait_write );
     p_ts->b_paused = p_sys->b_input_paused && !p_sys->b_input_paused_source;
     p_ts->i_pause_date = p_ts->b_paused ? mdate() : -1;
     p_ts->i_rate_source = p_sys->i_input_rate_source;
@@ -754,8 +827,13 @@ static int TsStart( es_out_t *p_out )
     p_ts->i_rate_delay = 0;
     p_ts->i_buffering_delay = 0;
     p_ts->i_cmd_delay = 0;
+    p_ts->i_seek = 0;
+    p_ts->i_index_time = VLC_TS_INVALID;
+    p_ts->p_storage_first = NULL;
     p_ts->p_storage_r = NULL;
     p_ts->p_storage_w = NULL;
+    p_ts->p_storage_spare = NULL;
+    TAB_INIT( p_ts->i_es_dead, p_ts->pp_es_dead );
 
     p_sys->b_delayed = true;
     if( vlc_clone( &p_ts->thread, TsRun, p_ts, VLC_THREAD_PRIORITY_INPUT ) )
@@ -767,6 +845,17 @@ static int TsStart( es_out_t *p_out )
         p_sys->b_delayed = false;
         return VLC_EGENERIC;
     }
+    if( vlc_clone( &p_ts->writer, TsRunWriter, p_ts, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        msg_Err( p_sys->p_input, "cannot create timeshift writer thread" );
+
+        vlc_cancel( p_ts->thread );
+        vlc_join( p_ts->thread, NULL );
+        TsDestroy( p_ts );
+
+        p_sys->b_delayed = false;
+        return VLC_EGENERIC;
+    }
 
     return VLC_SUCCESS;
 }
@@ -786,20 +875,24 @@ static void TsStop( ts_thread_t *p_ts )
 {
     vlc_cancel( p_ts->thread );
     vlc_join( p_ts->thread, NULL );
+    vlc_cancel( p_ts->writer );
+    vlc_join( p_ts->writer, NULL );
 
+    /* Unplayed commands, and blocks not written yet, are released along */
     vlc_mutex_lock( &p_ts->lock );
-    for( ;; )
+    while( p_ts->p_storage_first )
     {
-        ts_cmd_t cmd;
-
-        if( TsPopCmdLocked( p_ts, &cmd, true ) )
-            break;
+        ts_storage_t *p_next = p_ts->p_storage_first->p_next;
 
-        CmdClean( &cmd );
+        TsStorageDelete( p_ts->p_storage_first );
+        p_ts->p_storage_first = p_next;
     }
-    assert( !p_ts->p_storage_r || !p_ts->p_storage_r->p_next );
-    if( p_ts->p_storage_r )
-        TsStorageDelete( p_ts->p_storage_r );
+    if( p_ts->p_storage_spare )
+        TsStorageDelete( p_ts->p_storage_spare );
+
+    for( int i = 0; i < p_ts->i_es_dead; i++ )
+        free( p_ts->pp_es_dead[i] );
+    TAB_CLEAN( p_ts->i_es_dead, p_ts->pp_es_dead );
     vlc_mutex_unlock( &p_ts->lock );
 
     TsDestroy( p_ts );
@@ -810,7 +903,13 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 
     if( !p_ts->p_storage_w || TsStorageIsFull( p_ts->p_storage_w, p_cmd ) )
     {
-        ts_storage_t *p_storage = TsStorageNew( p_ts->psz_tmp_path, p_ts->i_tmp_size_max );
+        /* The writer thread has usually prepared it */
+        ts_storage_t *p_storage = p_ts->p_storage_spare;
+
+        if( p_storage )
+            p_ts->p_storage_spare = NULL;
+        else
+            p_storage = TsStorageNew( p_ts->psz_tmp_path, p_ts->i_tmp_size_max );
 
         if( !p_storage )
         {
@@ -822,7 +921,7 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 
         if( !p_ts->p_storage_w )
         {
-            p_ts->p_storage_r = p_ts->p_storage_w = p_storage;
+            p_ts->p_storage_first = p_ts->p_storage_r = p_ts->p_storage_w = p_storage;
         }
         else
         {
@@ -832,32 +931,177 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
         }
     }
 
-    /* TODO return error and warn the user (but only once) */
-    TsStoragePushCmd( p_ts->p_storage_w, p_cmd, p_ts->p_storage_r == p_ts->p_storage_w );
+    /* Seek points: the input times, and the key frames that follow them */
+    if( p_cmd->i_type == C_CONTROL &&
+        p_cmd->u.control.i_query == ES_OUT_SET_TIMES &&
+        p_cmd->u.control.u.times.i_time > 0 )
+    {
+        p_ts->i_index_time = p_cmd->u.control.u.times.i_time;
+        TsStorageIndex( p_ts->p_storage_w, p_ts->i_index_time, false );
+    }
+    else if( p_cmd->i_type == C_SEND &&
+             ( p_cmd->u.send.p_block->i_flags & BLOCK_FLAG_TYPE_I ) &&
+             p_ts->i_index_time > VLC_TS_INVALID )
+    {
+        TsStorageIndex( p_ts->p_storage_w, p_ts->i_index_time, true );
+    }
+
+    TsStoragePushCmd( p_ts->p_storage_w, p_cmd );
 
     vlc_cond_signal( &p_ts->wait );
+    if( p_cmd->i_type == C_SEND || !p_ts->p_storage_spare )
+        vlc_cond_signal( &p_ts->wait_write );
 
     vlc_mutex_unlock( &p_ts->lock );
 }
-static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_flush )
+static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 {
     vlc_assert_locked( &p_ts->lock );
 
-    if( TsStorageIsEmpty( p_ts->p_storage_r ) )
-        return VLC_EGENERIC;
+    for( ;; )
+    {
+        if( TsStorageIsEmpty( p_ts->p_storage_r ) )
+            return VLC_EGENERIC;
+
+        const int i_ret = TsStoragePopCmd( p_ts->p_storage_r, p_cmd );
+
+        /* Played storages are kept for seeking back, up to the window */
+        if( TsStorageIsEmpty( p_ts->p_storage_r ) && p_ts->p_storage_r->p_next )
+        {
+            p_ts->p_storage_r = p_ts->p_storage_r->p_next;
+            TsTrimLocked( p_ts );
+        }
 
-    TsStoragePopCmd( p_ts->p_storage_r, p_cmd, b_flush );
+        if( !i_ret )
+            return VLC_SUCCESS;
+    }
+}
+static void TsTrimLocked( ts_thread_t *p_ts )
+{
+    int64_t i_played = 0;
 
-    while( p_ts->p_storage_r && TsStorageIsEmpty( p_ts->p_storage_r ) )
+    vlc_assert_locked( &p_ts->lock );
+
+    for( ts_storage_t *p = p_ts->p_storage_first; p != p_ts->p_storage_r; p = p->p_next )
+        i_played += p->i_file_size;
+
+    while( p_ts->p_storage_first != p_ts->p_storage_r &&
+           ( p_ts->i_window <= 0 || i_played > p_ts->i_window ) )
     {
-        ts_storage_t *p_next = p_ts->p_storage_r->p_next;
-        if( !p_next )
+        ts_storage_t *p_storage = p_ts->p_storage_first;
+
+        /* Blocks still referenced by the writer thread */
+        if( p_storage->i_cmd_sync < p_storage->i_cmd_w )
             break;
 
-        TsStorageDelete( p_ts->p_storage_r );
-        p_ts->p_storage_r = p_next;
+        p_ts->p_storage_first = p_storage->p_next;
+        i_played -= p_storage->i_file_size;
+
+        /* Reuse the file and its allocated space for the next storage */
+        if( !p_ts->p_storage_spare && !TsStorageReset( p_storage ) )
+            p_ts->p_storage_spare = p_storage;
+        else
+            TsStorageDelete( p_storage );
     }
+}
+static int TsSeek( ts_thread_t *p_ts, mtime_t i_time )
+{
+    ts_storage_t *p_target = NULL;
+    int i_target = 0;
+    mtime_t i_last = VLC_TS_INVALID;
+    bool b_key = false;
 
+    vlc_mutex_lock( &p_ts->lock );
+
+    /* Decoding can only restart cleanly at a key frame, when the demuxer
+     * flags them: otherwise any input time update will do */
+    for( ts_storage_t *p = p_ts->p_storage_first; p && !b_key; p = p->p_next )
+    {
+        for( int i = 0; i < p->i_index && !b_key; i++ )
+            b_key = p->p_index[i].b_key;
+    }
+
+    /* Last seek point not after the requested time */
+    for( ts_storage_t *p = p_ts->p_storage_first; p; p = p->p_next )
+    {
+        for( int i = 0; i < p->i_index; i++ )
+        {
+            i_last = __MAX( i_last, p->p_index[i].i_time );
+            if( p->p_index[i].i_time > i_time ||
+                ( b_key && !p->p_index[i].b_key ) )
+                continue;
+            p_target = p;
+            i_target = p->p_index[i].i_cmd;
+        }
+    }
+    /* Times past the newest buffered one are for the demuxer to reach */
+    if( i_time > i_last + TS_SEEK_TOLERANCE )
+        p_target = NULL;
+    if( !p_target )
+    {
+        vlc_mutex_unlock( &p_ts->lock );
+        msg_Dbg( p_ts->p_input, "es out timeshift: %"PRId64" is out of the window",
+                 i_time );
+        return VLC_EGENERIC;
+    }
+
+    const int canc = vlc_savecancel();
+
+    es_out_SetTime( p_ts->p_out, -1 );
+
+    /* Skip the commands up to the target. The ES state changes that were
+     * never executed still are, only the data and the clock are replayed. */
+    bool b_after = false;
+    for( ts_storage_t *p = p_ts->p_storage_first; p; p = p->p_next )
+    {
+        if( b_after )
+        {
+            p->i_cmd_r = 0;
+            continue;
+        }
+
+        const int i_end = p == p_target ? i_target : p->i_cmd_w;
+        for( int i = __MAX( p->i_cmd_r, p->i_cmd_e ); i < i_end; i++ )
+        {
+            ts_cmd_t cmd = p->p_cmd[i];
+
+            switch( cmd.i_type )
+            {
+            case C_ADD:
+                CmdExecuteAdd( p_ts->p_out, &cmd );
+                CmdCleanAdd( &cmd );
+                break;
+            case C_CONTROL:
+                if( !CmdIsReplayable( &cmd ) )
+                    CmdExecuteControl( p_ts->p_out, &cmd );
+                CmdCleanControl( &cmd );
+                break;
+            case C_DEL:
+                CmdExecuteDel( p_ts->p_out, &cmd );
+                TAB_APPEND( p_ts->i_es_dead, p_ts->pp_es_dead, cmd.u.del.p_es );
+                break;
+            default:
+                break;
+            }
+        }
+        p->i_cmd_e = __MAX( p->i_cmd_e, i_end );
+        p->i_cmd_r = i_end;
+        b_after = p == p_target;
+    }
+    p_ts->p_storage_r = p_target;
+
+    /* Play the target command now */
+    const mtime_t i_now = p_ts->b_paused ? p_ts->i_pause_date : mdate();
+
+    p_ts->i_cmd_delay = i_now - p_target->p_cmd[i_target].i_date - p_ts->i_buffering_delay;
+    p_ts->i_rate_date = -1;
+    p_ts->i_rate_delay = 0;
+    p_ts->i_seek++;
+
+    vlc_restorecancel( canc );
+
+    vlc_cond_signal( &p_ts->wait );
+    vlc_mutex_unlock( &p_ts->lock );
     return VLC_SUCCESS;
 }
 static bool TsHasCmd( ts_thread_t *p_ts )
@@ -874,8 +1118,10 @@ static bool TsIsUnused( ts_thread_t *p_ts )
 {
     bool b_unused;
 
+    /* With a window, the stream is kept for seeking back */
     vlc_mutex_lock( &p_ts->lock );
-    b_unused = !p_ts->b_paused &&
+    b_unused = p_ts->i_window <= 0 &&
+               !p_ts->b_paused &&
                p_ts->i_rate == p_ts->i_rate_source &&
                TsStorageIsEmpty( p_ts->p_storage_r );
     vlc_mutex_unlock( &p_ts->lock );
@@ -936,6 +1182,7 @@ static void *TsRun( void *p_data )
 {
     ts_thread_t *p_ts = p_data;
     mtime_t i_buffering_date = -1;
+    volatile unsigned i_seek = 0; /* across cleanup handlers */
 
     for( ;; )
     {
@@ -952,7 +1199,7 @@ static void *TsRun( void *p_data )
             const int canc = vlc_savecancel();
             b_buffering = es_out_GetBuffering( p_ts->p_out );
 
-            if( ( !p_ts->b_paused || b_buffering ) && !TsPopCmdLocked( p_ts, &cmd, false ) )
+            if( ( !p_ts->b_paused || b_buffering ) && !TsPopCmdLocked( p_ts, &cmd ) )
             {
                 vlc_restorecancel( canc );
                 break;
@@ -962,6 +1209,13 @@ static void *TsRun( void *p_data )
             vlc_cond_wait( &p_ts->wait, &p_ts->lock );
         }
 
+        /* The dates before a seek do not relate to the current ones */
+        if( i_seek != p_ts->i_seek )
+        {
+            i_seek = p_ts->i_seek;
+            i_buffering_date = -1;
+        }
+
         if( b_buffering && i_buffering_date < 0 )
         {
             i_buffering_date = cmd.i_date;
@@ -1024,6 +1278,18 @@ static void *TsRun( void *p_data )
 
         /* Execute the command  */
         const int canc = vlc_savecancel();
+
+        /* Drop the data and clock commands outdated by a seek */
+        vlc_mutex_lock( &p_ts->lock );
+        const bool b_outdated = i_seek != p_ts->i_seek && CmdIsReplayable( &cmd );
+        vlc_mutex_unlock( &p_ts->lock );
+        if( b_outdated )
+        {
+            CmdClean( &cmd );
+            vlc_restorecancel( canc );
+            continue;
+        }
+
         switch( cmd.i_type )
         {
         case C_ADD:
@@ -1040,6 +1306,9 @@ static void *TsRun( void *p_data )
             break;
         case C_DEL:
             CmdExecuteDel( p_ts->p_out, &cmd );
+            vlc_mutex_lock( &p_ts->lock );
+            TAB_APPEND( p_ts->i_es_dead, p_ts->pp_es_dead, cmd.u.del.p_es );
+            vlc_mutex_unlock( &p_ts->lock );
             break;
         default:
             vlc_assert_unreachable();
@@ -1051,6 +1320,136 @@ static void *TsRun( void *p_data )
     return NULL;
 }
 
+/* Returns the first storage with commands not yet written */
+static ts_storage_t *TsWriterGetStorageLocked( ts_thread_t *p_ts )
+{
+    for( ts_storage_t *p = p_ts->p_storage_first; p; p = p->p_next )
+    {
+        if( p->i_cmd_sync < p->i_cmd_w )
+            return p;
+    }
+    return NULL;
+}
+static void TsWriteLocked( ts_thread_t *p_ts, ts_storage_t *p_storage )
+{
+    struct
+    {
+        block_t *p_block;
+        int     i_offset;
+        int     i_cmd;
+    } batch[TS_WRITE_BATCH];
+    int i_batch = 0;
+    int i_sync;
+
+    for( i_sync = p_storage->i_cmd_sync;
+         i_sync < p_storage->i_cmd_w && i_batch < TS_WRITE_BATCH; i_sync++ )
+    {
+        const ts_cmd_t *p_cmd = &p_storage->p_cmd[i_sync];
+
+        if( p_cmd->i_type != C_SEND || !p_cmd->u.send.p_block )
+            continue;
+
+        batch[i_batch].p_block = p_cmd->u.send.p_block;
+        batch[i_batch].i_offset = p_cmd->u.send.i_offset;
+        batch[i_batch].i_cmd = i_sync;
+        i_batch++;
+    }
+
+    const bool b_allocate = !p_storage->b_allocated;
+    p_storage->b_allocated = true;
+
+    /* The blocks stay readable from memory meanwhile */
+    vlc_mutex_unlock( &p_ts->lock );
+
+    if( b_allocate )
+        TsStorageAllocate( p_storage );
+
+    bool b_error = false;
+    for( int i = 0; i < i_batch; i++ )
+    {
+        if( TsStorageWriteBlock( p_storage, batch[i].p_block, batch[i].i_offset ) )
+        {
+            batch[i].i_offset = -1;
+            b_error = true;
+        }
+    }
+    if( i_batch > 0 && fflush( p_storage->p_filew ) )
+    {
+        for( int i = 0; i < i_batch; i++ )
+            batch[i].i_offset = -1;
+        b_error = true;
+    }
+    if( b_error )
+        msg_Err( p_ts->p_input, "es out timeshift: cannot write to %s",
+                 p_storage->psz_file );
+
+    vlc_mutex_lock( &p_ts->lock );
+
+    for( int i = 0; i < i_batch; i++ )
+    {
+        ts_cmd_t *p_cmd = &p_storage->p_cmd[batch[i].i_cmd];
+
+        p_cmd->u.send.p_block = NULL;
+        p_cmd->u.send.i_offset = batch[i].i_offset;
+        block_Release( batch[i].p_block );
+    }
+    p_storage->i_cmd_sync = i_sync;
+
+    TsTrimLocked( p_ts );
+}
+static void *TsRunWriter( void *p_data )
+{
+    ts_thread_t *p_ts = p_data;
+    volatile bool b_spare_error = false; /* across cleanup handlers */
+
+    vlc_mutex_lock( &p_ts->lock );
+    mutex_cleanup_push( &p_ts->lock );
+
+    for( ;; )
+    {
+        ts_storage_t *p_storage = TsWriterGetStorageLocked( p_ts );
+
+        if( !p_storage && ( p_ts->p_storage_spare || b_spare_error ) )
+        {
+            vlc_cond_wait( &p_ts->wait_write, &p_ts->lock );
+            b_spare_error = false;
+            continue;
+        }
+
+        const int canc = vlc_savecancel();
+        if( p_storage )
+        {
+            TsWriteLocked( p_ts, p_storage );
+        }
+        else
+        {
+            /* Prepare the next storage, so that the input does not wait for
+             * the file creation */
+            vlc_mutex_unlock( &p_ts->lock );
+
+            p_storage = TsStorageNew( p_ts->psz_tmp_path, p_ts->i_tmp_size_max );
+            if( p_storage )
+            {
+                TsStorageAllocate( p_storage );
+                p_storage->b_allocated = true;
+            }
+
+            vlc_mutex_lock( &p_ts->lock );
+
+            b_spare_error = !p_storage;
+            if( p_storage && p_ts->p_storage_spare )
+                TsStorageDelete( p_storage );
+            else if( p_storage )
+                p_ts->p_storage_spare = p_storage;
+        }
+        vlc_restorecancel( canc );
+    }
+
+    vlc_cleanup_pop();
+    vlc_mutex_unlock( &p_ts->lock );
+    return NULL;
+}
+
 /*****************************************************************************
  *
  *****************************************************************************/
@@ -1066,6 +1465,7 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
     /* */
     p_storage->i_file_max = i_tmp_size_max;
     p_storage->i_file_size = 0;
+    p_storage->b_allocated = false;
     p_storage->p_filew = GetTmpFile( &p_storage->psz_file, psz_tmp_path );
     if( p_storage->psz_file )
         p_storage->p_filer = vlc_fopen( p_storage->psz_file, "rb" );
@@ -1073,9 +1473,15 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
     /* */
     p_storage->i_cmd_w = 0;
     p_storage->i_cmd_r = 0;
+    p_storage->i_cmd_e = 0;
+    p_storage->i_cmd_sync = 0;
     p_storage->i_cmd_max = 30000;
     p_storage->p_cmd = malloc( p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) );
-    //fprintf( stderr, "\nSTORAGE name=%s size=%d KiB\n", p_storage->psz_file, p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) /1024 );
+
+    /* */
+    p_storage->i_index = 0;
+    p_storage->i_index_max = 0;
+    p_storage->p_index = NULL;
 
     if( !p_storage->p_cmd || !p_storage->p_filew || !p_storage->p_filer )
     {
@@ -1084,17 +1490,47 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
     }
     return p_storage;
 }
-static void TsStorageDelete( ts_storage_t *p_storage )
+static void TsStorageClean( ts_storage_t *p_storage )
 {
-    while( p_storage->i_cmd_r < p_storage->i_cmd_w )
+    /* Release the blocks not yet written, and the commands never executed */
+    for( int i = 0; i < p_storage->i_cmd_w; i++ )
     {
-        ts_cmd_t cmd;
+        ts_cmd_t *p_cmd = &p_storage->p_cmd[i];
 
-        TsStoragePopCmd( p_storage, &cmd, true );
+        if( p_cmd->i_type == C_SEND )
+            CmdCleanSend( p_cmd );
+        else if( i >= p_storage->i_cmd_e )
+            CmdClean( p_cmd );
+    }
+}
+static int TsStorageReset( ts_storage_t *p_storage )
+{
+    TsStorageClean( p_storage );
 
-        CmdClean( &cmd );
+    if( p_storage->i_cmd_max < 30000 )
+    {
+        ts_cmd_t *p_new = realloc( p_storage->p_cmd, 30000 * sizeof(*p_storage->p_cmd) );
+        if( !p_new )
+            return VLC_ENOMEM;
+        p_storage->p_cmd = p_new;
+        p_storage->i_cmd_max = 30000;
     }
+
+    p_storage->p_next = NULL;
+    p_storage->i_file_size = 0;
+    p_storage->i_cmd_w = 0;
+    p_storage->i_cmd_r = 0;
+    p_storage->i_cmd_e = 0;
+    p_storage->i_cmd_sync = 0;
+    p_storage->i_index = 0;
+    return VLC_SUCCESS;
+}
+static void TsStorageDelete( ts_storage_t *p_storage )
+{
+    if( p_storage->p_cmd )
+        TsStorageClean( p_storage );
     free( p_storage->p_cmd );
+    free( p_storage->p_index );
 
     if( p_storage->p_filer )
         fclose( p_storage->p_filer );
@@ -1125,7 +1561,7 @@ static bool TsStorageIsFull( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
     if( p_cmd && p_cmd->i_type == C_SEND && p_storage->i_cmd_w > 0 )
     {
-        size_t i_size = sizeof(*p_cmd->u.send.p_block) + p_cmd->u.send.p_block->i_buffer;
+        size_t i_size = sizeof(ts_block_header_t) + p_cmd->u.send.p_block->i_buffer;
 
         if( p_storage->i_file_size + i_size >= p_storage->i_file_max )
             return true;
@@ -1136,72 +1572,123 @@ static bool TsStorageIsEmpty( ts_storage_t *p_storage )
 {
     return !p_storage || p_storage->i_cmd_r >= p_storage->i_cmd_w;
 }
-static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bool b_flush )
+static void TsStorageAllocate( ts_storage_t *p_storage )
 {
-    ts_cmd_t cmd = *p_cmd;
+#ifdef HAVE_POSIX_FALLOCATE
+    /* Reserve the whole file at once, it limits the fragmentation and the
+     * file system updates while writing */
+    posix_fallocate( fileno( p_storage->p_filew ), 0, p_storage->i_file_max );
+#else
+    VLC_UNUSED( p_storage );
+#endif
+}
+static int TsStorageWriteBlock( ts_storage_t *p_storage, const block_t *p_block, int i_offset )
+{
+    const ts_block_header_t hdr = {
+        .i_dts        = p_block->i_dts,
+        .i_pts        = p_block->i_pts,
+        .i_length     = p_block->i_length,
+        .i_flags      = p_block->i_flags,
+        .i_nb_samples = p_block->i_nb_samples,
+        .i_buffer     = p_block->i_buffer,
+    };
+    FILE *p_file = p_storage->p_filew;
+
+    /* Blocks are written in order, do not flush the stream buffer */
+    if( ftell( p_file ) != i_offset && fseek( p_file, i_offset, SEEK_SET ) )
+        return VLC_EGENERIC;
+    if( fwrite( &hdr, sizeof(hdr), 1, p_file ) != 1 )
+        return VLC_EGENERIC;
+    if( p_block->i_buffer > 0 &&
+        fwrite( p_block->p_buffer, p_block->i_buffer, 1, p_file ) != 1 )
+        return VLC_EGENERIC;
+    return VLC_SUCCESS;
+}
+static block_t *TsStorageReadBlock( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
+{
+    /* Not written yet */
+    if( p_cmd->u.send.p_block )
+        return block_Duplicate( p_cmd->u.send.p_block );
 
-    assert( !TsStorageIsFull( p_storage, p_cmd ) );
+    ts_block_header_t hdr;
 
-    if( cmd.i_type == C_SEND )
-    {
-        block_t *p_block = cmd.u.send.p_block;
+    if( p_cmd->u.send.i_offset < 0 ||
+        fseek( p_storage->p_filer, p_cmd->u.send.i_offset, SEEK_SET ) ||
+        fread( &hdr, sizeof(hdr), 1, p_storage->p_filer ) != 1 )
+        return NULL;
 
-        cmd.u.send.p_block = NULL;
-        cmd.u.send.i_offset = ftell( p_storage->p_filew );
+    block_t *p_block = block_Alloc( hdr.i_buffer );
+    if( !p_block )
+        return NULL;
 
-        if( fwrite( p_block, sizeof(*p_block), 1, p_storage->p_filew ) != 1 )
-        {
-            block_Release( p_block );
-            return;
-        }
-        p_storage->i_file_size += sizeof(*p_block);
-        if( p_block->i_buffer > 0 )
-        {
-            if( fwrite( p_block->p_buffer, p_block->i_buffer, 1, p_storage->p_filew ) != 1 )
-            {
-                block_Release( p_block );
-                return;
-            }
-        }
-        p_storage->i_file_size += p_block->i_buffer;
+    p_block->i_dts      = hdr.i_dts;
+    p_block->i_pts      = hdr.i_pts;
+    p_block->i_flags    = hdr.i_flags;
+    p_block->i_length   = hdr.i_length;
+    p_block->i_nb_samples = hdr.i_nb_samples;
+    if( hdr.i_buffer > 0 &&
+        fread( p_block->p_buffer, hdr.i_buffer, 1, p_storage->p_filer ) != 1 )
+    {
         block_Release( p_block );
+        return NULL;
+    }
+    return p_block;
+}
+static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
+{
+    ts_cmd_t cmd = *p_cmd;
+
+    assert( !TsStorageIsFull( p_storage, p_cmd ) );
 
-        if( b_flush )
-            fflush( p_storage->p_filew );
+    if( cmd.i_type == C_SEND )
+    {
+        /* The block is written by the writer thread, keep its room */
+        cmd.u.send.i_offset = p_storage->i_file_size;
+        p_storage->i_file_size += sizeof(ts_block_header_t) + cmd.u.send.p_block->i_buffer;
     }
     p_storage->p_cmd[p_storage->i_cmd_w++] = cmd;
 }
-static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
+/* Makes the next command pushed a seek point */
+static void TsStorageIndex( ts_storage_t *p_storage, mtime_t i_time, bool b_key )
+{
+    if( p_storage->i_index >= p_storage->i_index_max )
+    {
+        const int i_max = __MAX( 2 * p_storage->i_index_max, 64 );
+        ts_index_t *p_new = realloc( p_storage->p_index, i_max * sizeof(*p_new) );
+        if( !p_new )
+            return;
+        p_storage->p_index = p_new;
+        p_storage->i_index_max = i_max;
+    }
+
+    ts_index_t *p_index = &p_storage->p_index[p_storage->i_index++];
+
+    p_index->i_time = i_time;
+    p_index->i_cmd = p_storage->i_cmd_w;
+    p_index->b_key = b_key;
+}
+static int TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd )
 {
     assert( !TsStorageIsEmpty( p_storage ) );
 
-    *p_cmd = p_storage->p_cmd[p_storage->i_cmd_r++];
-    if( p_cmd->i_type == C_SEND )
-    {
-        block_t block;
+    const int i_cmd = p_storage->i_cmd_r++;
 
-        if( !b_flush &&
-            !fseek( p_storage->p_filer, p_cmd->u.send.i_offset, SEEK_SET ) &&
-            fread( &block, sizeof(block), 1, p_storage->p_filer ) == 1 )
-        {
-            block_t *p_block = block_Alloc( block.i_buffer );
-            if( p_block )
-            {
-                p_block->i_dts      = block.i_dts;
-                p_block->i_pts      = block.i_pts;
-                p_block->i_flags    = block.i_flags;
-                p_block->i_length   = block.i_length;
-                p_block->i_nb_samples = block.i_nb_samples;
-                p_block->i_buffer = fread( p_block->p_buffer, 1, block.i_buffer, p_storage->p_filer );
-            }
-            p_cmd->u.send.p_block = p_block;
-        }
-        else
-        {
-            //perror( "TsStoragePopCmd" );
-            p_cmd->u.send.p_block = block_Alloc( 1 );
-        }
+    *p_cmd = p_storage->p_cmd[i_cmd];
+
+    /* Replayed after a seek back: the ES state changes were already done */
+    if( i_cmd < p_storage->i_cmd_e )
+    {
+        if( !CmdIsReplayable( p_cmd ) )
+            return VLC_EGENERIC;
     }
+    else
+    {
+        p_storage->i_cmd_e = i_cmd + 1;
+    }
+
+    if( p_cmd->i_type == C_SEND )
+        p_cmd->u.send.p_block = TsStorageReadBlock( p_storage, &p_storage->p_cmd[i_cmd] );
+    return VLC_SUCCESS;
 }
 
 /*****************************************************************************
@@ -1227,6 +1714,25 @@ static void CmdClean( ts_cmd_t *p_cmd )
         break;
     }
 }
+/* Data and clock commands, the only ones played again after a seek back */
+static bool CmdIsReplayable( const ts_cmd_t *p_cmd )
+{
+    if( p_cmd->i_type == C_SEND )
+        return true;
+    if( p_cmd->i_type != C_CONTROL )
+        return false;
+
+    switch( p_cmd->u.control.i_query )
+    {
+    case ES_OUT_SET_PCR:
+    case ES_OUT_SET_GROUP_PCR:
+    case ES_OUT_RESET_PCR:
+    case ES_OUT_SET_TIMES:
+        return true;
+    default:
+        return false;
+    }
+}
 
 static int CmdInitAdd( ts_cmd_t *p_cmd, es_out_id_t *p_es, const es_format_t *p_fmt, bool b_copy )
 {
@@ -1292,9 +1798,10 @@ static int CmdInitDel( ts_cmd_t *p_cmd, es_out_id_t *p_es )
 }
 static void CmdExecuteDel( es_out_t *p_out, ts_cmd_t *p_cmd )
 {
+    /* The played commands may still reference it, it is freed by TsStop() */
     if( p_cmd->u.del.p_es->p_es )
         es_out_Del( p_out, p_cmd->u.del.p_es->p_es );
-    free( p_cmd->u.del.p_es );
+    p_cmd->u.del.p_es->p_es = NULL;
 }
 
 static int CmdInitControl( ts_cmd_t *p_cmd, int i_query, va_list args, bool b_copy )
@@ -803,6 +803,9 @@ static void InitStatistics( input_thread_t * p_input )
         INIT_COUNTER( demux_bitrate, DERIVATIVE );
         INIT_COUNTER( demux_corrupted, COUNTER );
         INIT_COUNTER( demux_discontinuity, COUNTER );
+        INIT_COUNTER( stream_hits, COUNTER );
+        INIT_COUNTER( stream_misses, COUNTER );
+        INIT_COUNTER( stream_stall, COUNTER );
         INIT_COUNTER( played_abuffers, COUNTER );
         INIT_COUNTER( lost_abuffers, COUNTER );
         INIT_COUNTER( displayed_pictures, COUNTER );
@@ -1276,6 +1279,9 @@ error:
         EXIT_COUNTER( demux_bitrate );
         EXIT_COUNTER( demux_corrupted );
         EXIT_COUNTER( demux_discontinuity );
+        EXIT_COUNTER( stream_hits );
+        EXIT_COUNTER( stream_misses );
+        EXIT_COUNTER( stream_stall );
         EXIT_COUNTER( played_abuffers );
         EXIT_COUNTER( lost_abuffers );
         EXIT_COUNTER( displayed_pictures );
@@ -1347,6 +1353,9 @@ static void End( input_thread_t * p_input )
             CL_CO( demux_bitrate );
             CL_CO( demux_corrupted );
             CL_CO( demux_discontinuity );
+            CL_CO( stream_hits );
+            CL_CO( stream_misses );
+            CL_CO( stream_stall );
             CL_CO( played_abuffers );
             CL_CO( lost_abuffers );
             CL_CO( displayed_pictures );
@@ -1620,6 +1629,20 @@ static bool Control( input_thread_t *p_input,
                 f_pos = 0.f;
             else if( f_pos > 1.f )
                 f_pos = 1.f;
+
+            /* Seek within the timeshift window first, if any */
+            int64_t i_length;
+            if( !demux_Control( p_input->p->input.p_demux,
+                                DEMUX_GET_LENGTH, &i_length ) && i_length > 0
+             && !es_out_SetTime( p_input->p->p_es_out,
+                                 (int64_t)((double)f_pos * i_length) ) )
+            {
+                if( p_input->p->i_slave > 0 )
+                    SlaveSeek( p_input );
+                b_force_update = true;
+                break;
+            }
+
             /* Reset the decoders states and clock sync (before calling the demuxer */
             es_out_SetTime( p_input->p->p_es_out, -1 );
             if( demux_Control( p_input->p->input.p_demux, DEMUX_SET_POSITION,
@@ -1654,6 +1677,17 @@ static bool Control( input_thread_t *p_input,
             if( i_time < 0 )
                 i_time = 0;
 
+            /* Seek within the timeshift window first, if any */
+            if( !es_out_SetTime( p_input->p->p_es_out, i_time ) )
+            {
+                /* The slaves feed the same buffer as the master demuxer,
+                 * keep them aligned with its reading point */
+                if( p_input->p->i_slave > 0 )
+                    SlaveSeek( p_input );
+                b_force_update = true;
+                break;
+            }
+
             /* Reset the decoders states and clock sync (before calling the demuxer */
             es_out_SetTime( p_input->p->p_es_out, -1 );
 
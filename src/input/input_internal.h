@@ -145,6 +145,9 @@ struct input_thread_private_t
         counter_t *p_demux_bitrate;
         counter_t *p_demux_corrupted;
         counter_t *p_demux_discontinuity;
+        counter_t *p_stream_hits;
+        counter_t *p_stream_misses;
+        counter_t *p_stream_stall;
         counter_t *p_decoded_audio;
         counter_t *p_decoded_video;
         counter_t *p_decoded_sub;
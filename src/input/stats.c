@@ -27,6 +27,7 @@
 
 #include <vlc_common.h>
 #include "input/input_internal.h"
+#include "stream_output/stream_output.h"
 
 /**
  * Create a statistics counter
@@ -94,6 +95,9 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     st->f_demux_bitrate = stats_GetRate(input->p->counters.p_demux_bitrate);
     st->i_demux_corrupted = stats_GetTotal(input->p->counters.p_demux_corrupted);
     st->i_demux_discontinuity = stats_GetTotal(input->p->counters.p_demux_discontinuity);
+    st->i_stream_hits = stats_GetTotal(input->p->counters.p_stream_hits);
+    st->i_stream_misses = stats_GetTotal(input->p->counters.p_stream_misses);
+    st->i_stream_stall = stats_GetTotal(input->p->counters.p_stream_stall);
 
     /* Decoders */
     st->i_decoded_video = stats_GetTotal(input->p->counters.p_decoded_video);
@@ -106,6 +110,18 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
         st->i_sent_bytes = stats_GetTotal(input->p->counters.p_sout_sent_bytes);
         st->f_send_bitrate = stats_GetRate(input->p->counters.p_sout_send_bitrate);
     }
+#ifdef ENABLE_SOUT
+    if (input->p->p_sout != NULL)
+    {
+        int64_t sout[SOUT_STATISTIC_MAX];
+
+        sout_GetStatistics(input->p->p_sout, sout);
+        st->i_sout_pipeline_depth = sout[SOUT_STATISTIC_PIPELINE_DEPTH];
+        st->i_sout_decode_time = sout[SOUT_STATISTIC_DECODE_TIME];
+        st->i_sout_filter_time = sout[SOUT_STATISTIC_FILTER_TIME];
+        st->i_sout_encode_time = sout[SOUT_STATISTIC_ENCODE_TIME];
+    }
+#endif
 
     /* Aout */
     st->i_played_abuffers = stats_GetTotal(input->p->counters.p_played_abuffers);
@@ -115,6 +131,14 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     st->i_displayed_pictures = stats_GetTotal(input->p->counters.p_displayed_pictures);
     st->i_lost_pictures = stats_GetTotal(input->p->counters.p_lost_pictures);
 
+    /* Data blocks pool */
+    uint64_t hits, misses;
+    size_t retained;
+    block_PoolGetStats(&hits, &misses, &retained);
+    st->i_block_pool_hits = hits;
+    st->i_block_pool_misses = misses;
+    st->i_block_pool_retained = retained;
+
     vlc_mutex_unlock(&st->lock);
     vlc_mutex_unlock(&input->p->counters.counters_lock);
 }
@@ -127,11 +151,16 @@ void stats_ReinitInputStats( input_stats_t *p_stats )
     p_stats->i_demux_read_packets = p_stats->i_demux_read_bytes =
     p_stats->f_demux_bitrate = p_stats->f_average_demux_bitrate =
     p_stats->i_demux_corrupted = p_stats->i_demux_discontinuity =
+    p_stats->i_stream_hits = p_stats->i_stream_misses =
+    p_stats->i_stream_stall =
     p_stats->i_displayed_pictures = p_stats->i_lost_pictures =
     p_stats->i_played_abuffers = p_stats->i_lost_abuffers =
     p_stats->i_decoded_video = p_stats->i_decoded_audio =
-    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate
-     = 0;
+    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate =
+    p_stats->i_sout_pipeline_depth = p_stats->i_sout_decode_time =
+    p_stats->i_sout_filter_time = p_stats->i_sout_encode_time =
+    p_stats->i_block_pool_hits = p_stats->i_block_pool_misses =
+    p_stats->i_block_pool_retained = 0;
     vlc_mutex_unlock( &p_stats->lock );
 }
 
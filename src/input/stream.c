@@ -64,6 +64,7 @@ stream_t *stream_CommonNew(vlc_object_t *parent)
     stream_t *s = &priv->stream;
 
     s->psz_url = NULL;
+    s->pf_block = NULL;
     priv->peek = NULL;
 
     /* UTF16 and UTF32 text file conversion */
@@ -373,6 +374,17 @@ ssize_t stream_Peek(stream_t *s, const uint8_t **restrict bufp, size_t len)
     stream_priv_t *priv = (stream_priv_t *)s;
     block_t *peek = priv->peek;
 
+    if (peek == NULL && len > 0 && s->pf_block != NULL)
+    {   /* Zero-copy peek */
+        peek = s->pf_block(s, len);
+        if (peek != NULL)
+        {
+            *bufp = peek->p_buffer;
+            priv->peek = peek;
+            return peek->i_buffer;
+        }
+    }
+
     if (peek == NULL)
     {
         peek = block_Alloc(len);
@@ -503,8 +515,34 @@ int stream_Control( stream_t *s, int i_query, ... )
  */
 block_t *stream_Block( stream_t *s, int i_size )
 {
+    stream_priv_t *priv = (stream_priv_t *)s;
+
     if( i_size <= 0 ) return NULL;
 
+    /* Reference the data directly if the stream supports it */
+    block_t *peek = priv->peek;
+    if( peek != NULL && peek->i_buffer >= (size_t)i_size )
+    {
+        block_t *p_bk = block_mmap_Share( peek, 0, i_size );
+        if( p_bk != NULL )
+        {
+            peek->p_buffer += i_size;
+            peek->i_buffer -= i_size;
+            if( peek->i_buffer == 0 )
+            {
+                block_Release( peek );
+                priv->peek = NULL;
+            }
+            return p_bk;
+        }
+    }
+    else if( peek == NULL && s->pf_block != NULL )
+    {
+        block_t *p_bk = s->pf_block( s, i_size );
+        if( p_bk != NULL )
+            return p_bk;
+    }
+
     /* emulate block read */
     block_t *p_bk = block_Alloc( i_size );
     if( p_bk )
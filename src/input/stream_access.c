@@ -30,6 +30,7 @@
 #include <string.h>
 
 #include <vlc_common.h>
+#include <vlc_interrupt.h>
 
 #include <libvlc.h>
 #include "stream.h"
@@ -44,11 +45,13 @@
  *  - ...
  */
 
-/* Two methods:
+/* Three methods:
  *  - using pf_block
  *      One linked list of data read
  *  - using pf_read
  *      More complex scheme using mutliple track to avoid seeking
+ *  - using pf_read from a read-ahead thread (stream-readahead)
+ *      One ring filled asynchronously, slow reads do not block the demuxer
  *  - using directly the access (only indirection for peeking).
  *      This method is known to introduce much less latency.
  *      It should probably defaulted (instead of the stream method (2)).
@@ -91,6 +94,24 @@
 #define STREAM_READ_ATONCE 1024
 #define STREAM_CACHE_TRACK_SIZE (STREAM_CACHE_SIZE/STREAM_CACHE_TRACK)
 
+/* Method3: read-ahead thread, for pf_read
+ *  - A single ring of STREAM_CACHE_SIZE bytes is filled by a thread, at most
+ *    STREAM_ASYNC_AHEAD bytes in front of the reader. The remaining space
+ *    keeps data already read for backward seeks.
+ *  - Reads are sized from the measured throughput so that one access read
+ *    lasts about STREAM_ASYNC_READ_TIME, or twice the shortest recent read
+ *    duration when the access has a high per-read latency (network shares).
+ *  - Seeks outside of the ring are done by the thread, the reader waits.
+ */
+#define STREAM_ASYNC_AHEAD      (STREAM_CACHE_SIZE - STREAM_CACHE_SIZE/4)
+#define STREAM_ASYNC_READ_MAX   (STREAM_CACHE_SIZE/8)
+#define STREAM_ASYNC_READ_TIME  (CLOCK_FREQ/100)
+#define STREAM_ASYNC_WINDOW     64  /* reads per latency measurement */
+#define STREAM_ASYNC_STATS      64  /* reads per input statistics update */
+#define STREAM_ASYNC_RETRY_MIN  (CLOCK_FREQ/100) /* after a failed read */
+#define STREAM_ASYNC_RETRY_MAX  (CLOCK_FREQ)
+#define STREAM_ASYNC_RETRIES    30  /* failed reads in a row before giving up */
+
 typedef struct
 {
     int64_t i_date;
@@ -106,6 +127,7 @@ typedef enum
 {
     STREAM_METHOD_BLOCK,
     STREAM_METHOD_STREAM,
+    STREAM_METHOD_ASYNC,
     STREAM_METHOD_READDIR
 } stream_read_method_t;
 
@@ -146,7 +168,47 @@ struct stream_sys_t
 
     } stream;
 
-    /* Stat for both method */
+    /* Method 3: for pf_read, from a thread */
+    struct
+    {
+        vlc_thread_t     thread;
+        vlc_interrupt_t *interrupt;  /* of the thread */
+        vlc_mutex_t      lock;
+        vlc_cond_t       wait_space; /* the thread waits for work */
+        vlc_cond_t       wait_idle;  /* the thread left the access */
+        vlc_sem_t        data;       /* the reader waits for the thread */
+
+        uint8_t *p_buffer;
+        uint64_t i_start;    /* Offset of the oldest data in the ring */
+        uint64_t i_end;      /* Offset of the end of the data in the ring */
+        unsigned i_seek_req; /* Access seek to i_end requested... */
+        unsigned i_seek_done;/* ...and done */
+        bool     b_seek_error;
+
+        bool     b_eof;
+        bool     b_paused;
+        bool     b_hold;     /* the access is reserved by the reader */
+        bool     b_busy;     /* the thread uses the access */
+        bool     b_waiting;  /* the reader waits on data */
+        bool     b_exit;
+
+        size_t   i_read_size;
+        uint64_t i_rate;     /* bytes per second */
+        mtime_t  i_latency;  /* shortest read duration of the last window */
+        mtime_t  i_latency_next;
+        unsigned i_window;
+
+        /* Reader side, not sent to the input statistics yet */
+        unsigned i_hits;
+        unsigned i_misses;
+        mtime_t  i_stall;
+        /* Totals */
+        uint64_t i_total_hits;
+        uint64_t i_total_misses;
+        mtime_t  i_total_stall;
+    } async;
+
+    /* Stat for all methods */
     struct
     {
         /* Stat about reading data */
@@ -158,6 +220,7 @@ struct stream_sys_t
 
 /* Method 1: */
 static ssize_t AStreamReadBlock( stream_t *, void *, size_t );
+static block_t *AStreamBlockBlock( stream_t *, size_t );
 static int  AStreamSeekBlock( stream_t *s, uint64_t i_pos );
 static void AStreamPrebufferBlock( stream_t *s );
 static block_t *AReadBlock( stream_t *s, bool *pb_eof );
@@ -168,6 +231,14 @@ static int  AStreamSeekStream( stream_t *s, uint64_t i_pos );
 static void AStreamPrebufferStream( stream_t *s );
 static ssize_t AReadStream( stream_t *s, void *p_read, size_t i_read );
 
+/* Method 3 */
+static ssize_t AStreamReadAsync( stream_t *, void *, size_t );
+static int  AStreamSeekAsync( stream_t *s, uint64_t i_pos );
+static int  AStreamAsyncStart( stream_t *s );
+static void AStreamAsyncStop( stream_t *s );
+static void AStreamAsyncHold( stream_t *s );
+static void AStreamAsyncRelease( stream_t *s, bool b_reset );
+
 /* ReadDir */
 static input_item_t *AStreamReadDir( stream_t *s );
 
@@ -215,7 +286,8 @@ stream_t *stream_AccessNew( access_t *p_access )
     if( p_access->pf_block )
         p_sys->method = STREAM_METHOD_BLOCK;
     else if( p_access->pf_read )
-        p_sys->method = STREAM_METHOD_STREAM;
+        p_sys->method = var_InheritBool( s, "stream-readahead" )
+                      ? STREAM_METHOD_ASYNC : STREAM_METHOD_STREAM;
     else
         p_sys->method = STREAM_METHOD_READDIR;
 
@@ -230,6 +302,7 @@ stream_t *stream_AccessNew( access_t *p_access )
     {
         msg_Dbg( s, "Using block method for AStream*" );
         s->pf_read = AStreamReadBlock;
+        s->pf_block = AStreamBlockBlock;
 
         /* Init all fields of p_sys->block */
         p_sys->block.i_start = p_sys->i_pos;
@@ -286,6 +359,19 @@ stream_t *stream_AccessNew( access_t *p_access )
             goto error;
         }
     }
+    else if( p_sys->method == STREAM_METHOD_ASYNC )
+    {
+        msg_Dbg( s, "Using read-ahead method for AStream*" );
+
+        s->pf_read = AStreamReadAsync;
+
+        /* Start the thread and wait for the first data */
+        if( AStreamAsyncStart( s ) )
+        {
+            msg_Err( s, "cannot pre fill buffer" );
+            goto error;
+        }
+    }
     else
     {
         msg_Dbg( s, "Using readdir method for AStream*" );
@@ -322,6 +408,8 @@ static void AStreamDestroy( stream_t *s )
         block_ChainRelease( p_sys->block.p_first );
     else if( p_sys->method == STREAM_METHOD_STREAM )
         free( p_sys->stream.p_buffer );
+    else if( p_sys->method == STREAM_METHOD_ASYNC )
+        AStreamAsyncStop( s );
 
     stream_CommonDelete( s );
     vlc_access_Delete( p_sys->p_access );
@@ -423,7 +511,26 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
         case STREAM_SET_PRIVATE_ID_STATE:
         case STREAM_SET_PRIVATE_ID_CA:
         case STREAM_GET_PRIVATE_ID_STATE:
-            return access_vaControl( p_access, i_query, args );
+        {
+            if( p_sys->method != STREAM_METHOD_ASYNC )
+                return access_vaControl( p_access, i_query, args );
+
+            /* The access is not reentrant: never query nor change it while
+             * the read-ahead thread reads from it */
+            va_list ap;
+            va_copy( ap, args );
+            AStreamAsyncHold( s );
+            int ret = access_vaControl( p_access, i_query, ap );
+            if( ret == VLC_SUCCESS && i_query == STREAM_SET_PAUSE_STATE )
+            {
+                vlc_mutex_lock( &p_sys->async.lock );
+                p_sys->async.b_paused = (bool)va_arg( args, int );
+                vlc_mutex_unlock( &p_sys->async.lock );
+            }
+            AStreamAsyncRelease( s, false );
+            va_end( ap );
+            return ret;
+        }
 
         case STREAM_GET_POSITION:
             *va_arg( args, uint64_t * ) = p_sys->i_pos;
@@ -438,6 +545,8 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
                 return AStreamSeekBlock( s, offset );
             case STREAM_METHOD_STREAM:
                 return AStreamSeekStream( s, offset );
+            case STREAM_METHOD_ASYNC:
+                return AStreamSeekAsync( s, offset );
             default:
                 vlc_assert_unreachable();
                 return VLC_EGENERIC;
@@ -447,6 +556,14 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
         case STREAM_SET_TITLE:
         case STREAM_SET_SEEKPOINT:
         {
+            if( p_sys->method == STREAM_METHOD_ASYNC )
+            {
+                AStreamAsyncHold( s );
+                int ret = access_vaControl( p_access, i_query, args );
+                AStreamAsyncRelease( s, ret == VLC_SUCCESS );
+                return ret;
+            }
+
             int ret = access_vaControl( p_access, i_query, args );
             if( ret == VLC_SUCCESS )
                 AStreamControlReset( s );
@@ -598,6 +715,34 @@ static ssize_t AStreamReadBlock( stream_t *s, void *p_read, size_t i_read )
     return i_data;
 }
 
+/* Returns the next i_read bytes without copying, when the access delivers
+ * blocks of a memory mapping and they do not span two of those blocks. */
+static block_t *AStreamBlockBlock( stream_t *s, size_t i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    block_t *p_current = p_sys->block.p_current;
+
+    if( p_current == NULL ||
+        p_current->i_buffer - p_sys->block.i_offset < i_read )
+        return NULL;
+
+    block_t *b = block_mmap_Share( p_current, p_sys->block.i_offset, i_read );
+    if( b == NULL )
+        return NULL;
+
+    p_sys->block.i_offset += i_read;
+    p_sys->i_pos += i_read;
+    if( p_sys->block.i_offset >= p_current->i_buffer )
+    {
+        /* Current block is now empty, switch to next */
+        p_sys->block.i_offset = 0;
+        p_sys->block.p_current = p_current->p_next;
+        if( !p_sys->block.p_current )
+            AStreamRefillBlock( s );
+    }
+    return b;
+}
+
 static int AStreamSeekBlock( stream_t *s, uint64_t i_pos )
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -1150,6 +1295,463 @@ static void AStreamPrebufferStream( stream_t *s )
     }
 }
 
+/****************************************************************************
+ * Method 3:
+ ****************************************************************************/
+static bool AStreamAsyncCanRun( const stream_sys_t *p_sys )
+{
+    if( p_sys->async.b_hold )
+        return false;
+    if( p_sys->async.i_seek_req != p_sys->async.i_seek_done )
+        return true;
+    /* Keep reading while paused only if the reader needs data */
+    return ( !p_sys->async.b_paused || p_sys->async.b_waiting ) &&
+           !p_sys->async.b_eof &&
+           p_sys->async.i_end < p_sys->i_pos + STREAM_ASYNC_AHEAD;
+}
+
+/* Wakes the reader up, with the lock held */
+static void AStreamAsyncWake( stream_sys_t *p_sys )
+{
+    if( p_sys->async.b_waiting )
+    {
+        p_sys->async.b_waiting = false;
+        vlc_sem_post( &p_sys->async.data );
+    }
+}
+
+/* Waits for the thread, with the lock held. Returns false if interrupted. */
+static bool AStreamAsyncWait( stream_sys_t *p_sys )
+{
+    p_sys->async.b_waiting = true;
+    vlc_cond_signal( &p_sys->async.wait_space );
+    vlc_mutex_unlock( &p_sys->async.lock );
+
+    int val = vlc_sem_wait_i11e( &p_sys->async.data );
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    p_sys->async.b_waiting = false;
+    return val == 0;
+}
+
+static void AStreamAsyncAdapt( stream_sys_t *p_sys, size_t i_read,
+                               mtime_t i_duration )
+{
+    uint64_t i_rate = i_read * CLOCK_FREQ / ( i_duration + 1 );
+
+    if( p_sys->async.i_rate == 0 )
+        p_sys->async.i_rate = i_rate;
+    else
+        p_sys->async.i_rate = ( 7 * p_sys->async.i_rate + i_rate ) / 8;
+
+    /* The shortest read duration approximates the per read latency */
+    if( i_duration < p_sys->async.i_latency )
+        p_sys->async.i_latency = i_duration;
+    if( i_duration < p_sys->async.i_latency_next )
+        p_sys->async.i_latency_next = i_duration;
+    if( ++p_sys->async.i_window >= STREAM_ASYNC_WINDOW )
+    {
+        p_sys->async.i_latency = p_sys->async.i_latency_next;
+        p_sys->async.i_latency_next = INT64_MAX;
+        p_sys->async.i_window = 0;
+    }
+
+    const mtime_t i_target = __MAX( STREAM_ASYNC_READ_TIME,
+                                    2 * p_sys->async.i_latency );
+    uint64_t i_size = p_sys->async.i_rate * i_target / CLOCK_FREQ;
+
+    p_sys->async.i_read_size = VLC_CLIP( i_size, STREAM_READ_ATONCE,
+                                         STREAM_ASYNC_READ_MAX );
+}
+
+static void *AStreamAsyncThread( void *data )
+{
+    stream_t *s = data;
+    stream_sys_t *p_sys = s->p_sys;
+    mtime_t i_retry = 0;
+    unsigned i_errors = 0;
+
+    vlc_interrupt_set( p_sys->async.interrupt );
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    for( ;; )
+    {
+        while( !p_sys->async.b_exit && !AStreamAsyncCanRun( p_sys ) )
+            vlc_cond_wait( &p_sys->async.wait_space, &p_sys->async.lock );
+        if( p_sys->async.b_exit )
+            break;
+
+        const unsigned i_seek = p_sys->async.i_seek_req;
+        const uint64_t i_end = p_sys->async.i_end;
+
+        p_sys->async.b_busy = true;
+        if( i_seek != p_sys->async.i_seek_done )
+        {
+            vlc_mutex_unlock( &p_sys->async.lock );
+            int val = vlc_access_Seek( p_sys->p_access, i_end );
+            vlc_mutex_lock( &p_sys->async.lock );
+
+            p_sys->async.b_busy = false;
+            vlc_cond_signal( &p_sys->async.wait_idle );
+            if( i_seek == p_sys->async.i_seek_req )
+            {
+                p_sys->async.i_seek_done = i_seek;
+                p_sys->async.b_seek_error = val != 0;
+                p_sys->async.b_eof = val != 0;
+                AStreamAsyncWake( p_sys );
+            }
+            continue;
+        }
+
+        /* Never overwrite data not read yet */
+        const size_t i_off = i_end % STREAM_CACHE_SIZE;
+        size_t i_len = __MIN( p_sys->async.i_read_size,
+                              STREAM_CACHE_SIZE - i_off );
+        i_len = __MIN( i_len, p_sys->i_pos + STREAM_CACHE_SIZE - i_end );
+
+        /* The oldest data are lost */
+        if( i_end + i_len > p_sys->async.i_start + STREAM_CACHE_SIZE )
+            p_sys->async.i_start = i_end + i_len - STREAM_CACHE_SIZE;
+        vlc_mutex_unlock( &p_sys->async.lock );
+
+        const mtime_t i_date = mdate();
+        ssize_t i_read = AReadStream( s, &p_sys->async.p_buffer[i_off], i_len );
+        const mtime_t i_duration = mdate() - i_date;
+
+        vlc_mutex_lock( &p_sys->async.lock );
+        p_sys->async.b_busy = false;
+        vlc_cond_signal( &p_sys->async.wait_idle );
+
+        /* The reader seeked meanwhile, the data are useless */
+        if( i_seek != p_sys->async.i_seek_req || i_end != p_sys->async.i_end )
+            continue;
+
+        if( i_read > 0 )
+        {
+            p_sys->async.i_end += i_read;
+            AStreamAsyncAdapt( p_sys, i_read, i_duration );
+
+            p_sys->stat.i_bytes += i_read;
+            p_sys->stat.i_read_count++;
+            p_sys->stat.i_read_time += i_duration;
+            i_retry = 0;
+            i_errors = 0;
+        }
+        else if( i_read == 0 || p_sys->p_access->info.b_eof || vlc_killed()
+              || ++i_errors >= STREAM_ASYNC_RETRIES )
+        {   /* End of stream or fatal error: stop until the reader asks */
+            if( i_errors >= STREAM_ASYNC_RETRIES )
+                msg_Err( s, "read-ahead failed %u times, giving up",
+                         i_errors );
+            p_sys->async.b_eof = true;
+            i_retry = 0;
+            i_errors = 0;
+        }
+        else
+        {   /* Transient error: back off, unless the reader seeks or quits */
+            i_retry = i_retry ? __MIN( 2 * i_retry, STREAM_ASYNC_RETRY_MAX )
+                              : STREAM_ASYNC_RETRY_MIN;
+
+            const mtime_t i_deadline = mdate() + i_retry;
+            while( !p_sys->async.b_exit
+                && i_seek == p_sys->async.i_seek_req
+                && vlc_cond_timedwait( &p_sys->async.wait_space,
+                                       &p_sys->async.lock, i_deadline ) == 0 );
+        }
+        AStreamAsyncWake( p_sys );
+    }
+    vlc_mutex_unlock( &p_sys->async.lock );
+    return NULL;
+}
+
+/* Sends the reader statistics to the input */
+static void AStreamAsyncStats( stream_t *s, bool b_force )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    input_thread_t *p_input = s->p_input;
+    const unsigned i_count = p_sys->async.i_hits + p_sys->async.i_misses;
+
+    if( i_count == 0 || ( !b_force && i_count < STREAM_ASYNC_STATS ) )
+        return;
+
+    if( p_input != NULL )
+    {
+        vlc_mutex_lock( &p_input->p->counters.counters_lock );
+        stats_Update( p_input->p->counters.p_stream_hits,
+                      p_sys->async.i_hits, NULL );
+        stats_Update( p_input->p->counters.p_stream_misses,
+                      p_sys->async.i_misses, NULL );
+        stats_Update( p_input->p->counters.p_stream_stall,
+                      p_sys->async.i_stall, NULL );
+        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+    }
+
+    p_sys->async.i_total_hits += p_sys->async.i_hits;
+    p_sys->async.i_total_misses += p_sys->async.i_misses;
+    p_sys->async.i_total_stall += p_sys->async.i_stall;
+    p_sys->async.i_hits = p_sys->async.i_misses = 0;
+    p_sys->async.i_stall = 0;
+}
+
+static int AStreamAsyncStart( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    p_sys->async.p_buffer = malloc( STREAM_CACHE_SIZE );
+    if( p_sys->async.p_buffer == NULL )
+        return VLC_ENOMEM;
+    p_sys->async.interrupt = vlc_interrupt_create();
+    if( p_sys->async.interrupt == NULL )
+    {
+        free( p_sys->async.p_buffer );
+        return VLC_ENOMEM;
+    }
+
+    vlc_mutex_init( &p_sys->async.lock );
+    vlc_cond_init( &p_sys->async.wait_space );
+    vlc_cond_init( &p_sys->async.wait_idle );
+    vlc_sem_init( &p_sys->async.data, 0 );
+
+    p_sys->async.i_start = p_sys->async.i_end = p_sys->i_pos;
+    p_sys->async.i_seek_req = p_sys->async.i_seek_done = 0;
+    p_sys->async.b_seek_error = false;
+    p_sys->async.b_eof = false;
+    p_sys->async.b_paused = false;
+    p_sys->async.b_hold = false;
+    p_sys->async.b_busy = false;
+    p_sys->async.b_waiting = false;
+    p_sys->async.b_exit = false;
+    p_sys->async.i_read_size = STREAM_READ_ATONCE;
+    p_sys->async.i_rate = 0;
+    p_sys->async.i_latency = p_sys->async.i_latency_next = INT64_MAX;
+    p_sys->async.i_window = 0;
+    p_sys->async.i_hits = p_sys->async.i_misses = 0;
+    p_sys->async.i_stall = 0;
+    p_sys->async.i_total_hits = p_sys->async.i_total_misses = 0;
+    p_sys->async.i_total_stall = 0;
+
+    if( vlc_clone( &p_sys->async.thread, AStreamAsyncThread, s,
+                   VLC_THREAD_PRIORITY_INPUT ) )
+    {
+        vlc_sem_destroy( &p_sys->async.data );
+        vlc_cond_destroy( &p_sys->async.wait_idle );
+        vlc_cond_destroy( &p_sys->async.wait_space );
+        vlc_mutex_destroy( &p_sys->async.lock );
+        vlc_interrupt_destroy( p_sys->async.interrupt );
+        free( p_sys->async.p_buffer );
+        return VLC_EGENERIC;
+    }
+
+    /* Wait for the first data, as the other methods prebuffer */
+    const mtime_t i_start = mdate();
+    bool b_empty;
+
+    msg_Dbg( s, "starting pre-buffering" );
+    vlc_mutex_lock( &p_sys->async.lock );
+    while( p_sys->async.i_end == p_sys->i_pos && !p_sys->async.b_eof )
+        if( !AStreamAsyncWait( p_sys ) )
+            break;
+    b_empty = p_sys->async.i_end == p_sys->i_pos;
+    vlc_mutex_unlock( &p_sys->async.lock );
+
+    if( b_empty )
+    {
+        AStreamAsyncStop( s );
+        return VLC_EGENERIC;
+    }
+    msg_Dbg( s, "received first data after %d ms",
+             (int)((mdate() - i_start)/1000) );
+    return VLC_SUCCESS;
+}
+
+static void AStreamAsyncStop( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    p_sys->async.b_exit = true;
+    vlc_cond_signal( &p_sys->async.wait_space );
+    vlc_mutex_unlock( &p_sys->async.lock );
+
+    vlc_interrupt_kill( p_sys->async.interrupt );
+    vlc_join( p_sys->async.thread, NULL );
+    vlc_interrupt_destroy( p_sys->async.interrupt );
+
+    AStreamAsyncStats( s, true );
+    msg_Dbg( s, "read-ahead: %"PRIu64" hits, %"PRIu64" misses, "
+             "%"PRId64" ms stalled, %"PRIu64" KiB/s, read size %zu",
+             p_sys->async.i_total_hits, p_sys->async.i_total_misses,
+             p_sys->async.i_total_stall / 1000, p_sys->async.i_rate / 1024,
+             p_sys->async.i_read_size );
+
+    vlc_sem_destroy( &p_sys->async.data );
+    vlc_cond_destroy( &p_sys->async.wait_idle );
+    vlc_cond_destroy( &p_sys->async.wait_space );
+    vlc_mutex_destroy( &p_sys->async.lock );
+    free( p_sys->async.p_buffer );
+}
+
+/* Waits until the thread does not use the access anymore */
+static void AStreamAsyncHold( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    p_sys->async.b_hold = true;
+    while( p_sys->async.b_busy )
+        vlc_cond_wait( &p_sys->async.wait_idle, &p_sys->async.lock );
+    vlc_mutex_unlock( &p_sys->async.lock );
+}
+
+static void AStreamAsyncRelease( stream_t *s, bool b_reset )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    if( b_reset )
+    {
+        /* The access moved (title or seekpoint change) */
+        p_sys->i_pos = p_sys->p_access->info.i_pos;
+        p_sys->async.i_start = p_sys->async.i_end = p_sys->i_pos;
+        p_sys->async.b_eof = false;
+    }
+    p_sys->async.b_hold = false;
+    vlc_cond_signal( &p_sys->async.wait_space );
+    vlc_mutex_unlock( &p_sys->async.lock );
+}
+
+static ssize_t AStreamReadAsync( stream_t *s, void *p_read, size_t i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    uint8_t *p_data = p_read;
+    size_t i_data = 0;
+    mtime_t i_stall = 0;
+    bool b_intr = false;
+
+    if( p_data == NULL )
+    {
+        if( AStreamSeekAsync( s, p_sys->i_pos + i_read ) )
+            return 0;
+        return i_read;
+    }
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    while( i_data < i_read )
+    {
+        const uint64_t i_pos = p_sys->i_pos;
+
+        if( i_pos < p_sys->async.i_end )
+        {
+            const size_t i_off = i_pos % STREAM_CACHE_SIZE;
+            size_t i_copy = __MIN( p_sys->async.i_end - i_pos,
+                                   STREAM_CACHE_SIZE - i_off );
+            i_copy = __MIN( i_copy, i_read - i_data );
+
+            /* The thread does not write over unread data */
+            vlc_mutex_unlock( &p_sys->async.lock );
+            memcpy( &p_data[i_data], &p_sys->async.p_buffer[i_off], i_copy );
+            vlc_mutex_lock( &p_sys->async.lock );
+
+            i_data += i_copy;
+            p_sys->i_pos += i_copy;
+            vlc_cond_signal( &p_sys->async.wait_space );
+            continue;
+        }
+
+        if( p_sys->async.b_eof )
+        {
+            /* Let the thread try again, in case the file grows */
+            if( i_data == 0 )
+            {
+                p_sys->async.b_eof = false;
+                vlc_cond_signal( &p_sys->async.wait_space );
+            }
+            break;
+        }
+
+        if( i_stall == 0 )
+            i_stall = mdate();
+        if( !AStreamAsyncWait( p_sys ) )
+        {
+            b_intr = true;
+            break;
+        }
+    }
+    vlc_mutex_unlock( &p_sys->async.lock );
+
+    if( i_stall != 0 )
+    {
+        p_sys->async.i_misses++;
+        p_sys->async.i_stall += mdate() - i_stall;
+    }
+    else
+        p_sys->async.i_hits++;
+    AStreamAsyncStats( s, i_stall != 0 );
+
+    if( i_data == 0 && b_intr )
+        return -1;
+    return i_data;
+}
+
+static int AStreamSeekAsync( stream_t *s, uint64_t i_pos )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    bool b_aseek;
+
+    /* Data in the ring: the access is not involved */
+    vlc_mutex_lock( &p_sys->async.lock );
+    if( i_pos >= p_sys->async.i_start && i_pos <= p_sys->async.i_end )
+    {
+        p_sys->i_pos = i_pos;
+        vlc_cond_signal( &p_sys->async.wait_space );
+        vlc_mutex_unlock( &p_sys->async.lock );
+        return VLC_SUCCESS;
+    }
+    vlc_mutex_unlock( &p_sys->async.lock );
+
+    AStreamAsyncHold( s );
+    if( access_Control( p_sys->p_access, ACCESS_CAN_SEEK, &b_aseek ) )
+        b_aseek = false;
+    AStreamAsyncRelease( s, false );
+
+    vlc_mutex_lock( &p_sys->async.lock );
+
+    /* Data in the ring or about to be read: no access seek */
+    if( i_pos >= p_sys->async.i_start &&
+        ( !b_aseek || i_pos <= p_sys->async.i_end + p_sys->async.i_read_size ) )
+    {
+        p_sys->i_pos = i_pos;
+        vlc_cond_signal( &p_sys->async.wait_space );
+        vlc_mutex_unlock( &p_sys->async.lock );
+        return VLC_SUCCESS;
+    }
+
+    if( !b_aseek )
+    {
+        vlc_mutex_unlock( &p_sys->async.lock );
+        msg_Warn( s, "AStreamSeekAsync: can't seek" );
+        return VLC_EGENERIC;
+    }
+
+    /* Hard seek, done by the thread */
+    p_sys->i_pos = p_sys->async.i_start = p_sys->async.i_end = i_pos;
+    p_sys->async.b_eof = false;
+    p_sys->async.b_seek_error = false;
+    p_sys->async.i_seek_req++;
+
+    int ret = VLC_SUCCESS;
+    while( p_sys->async.i_seek_done != p_sys->async.i_seek_req )
+        if( !AStreamAsyncWait( p_sys ) )
+        {
+            ret = VLC_EGENERIC;
+            break;
+        }
+    if( p_sys->async.b_seek_error )
+        ret = VLC_EGENERIC;
+    vlc_mutex_unlock( &p_sys->async.lock );
+    return ret;
+}
+
 /****************************************************************************
  * Access reading/seeking wrappers to handle concatenated streams.
  ****************************************************************************/
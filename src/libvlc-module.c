@@ -85,6 +85,13 @@ static const char *const ppsz_snap_formats[] =
     "This is the verbosity level (0=only errors and " \
     "standard messages, 1=warnings, 2=debug).")
 
+#define LOG_ASYNC_TEXT N_("Asynchronous logging")
+#define LOG_ASYNC_LONGTEXT N_( \
+    "Messages are formatted and written by a dedicated thread, so that " \
+    "logging does not slow the other threads down. Messages are dropped " \
+    "if they are emitted faster than they can be written, and truncated " \
+    "beyond 4 KiB. Logging callbacks receive the formatted messages only.")
+
 #define OPEN_TEXT N_("Default stream")
 #define OPEN_LONGTEXT N_( \
     "This stream will always be opened at VLC startup." )
@@ -379,6 +386,11 @@ static const char *const ppsz_pos_descriptions[] =
     "picture quality, for instance deinterlacing, or distort " \
     "the video.")
 
+#define FILTER_THREADS_TEXT N_("Video filter threads")
+#define FILTER_THREADS_LONGTEXT N_( \
+    "Number of threads used by the video filters which can process " \
+    "pictures in parallel (0 = one per CPU, 1 = disabled).")
+
 #define SNAP_PATH_TEXT N_("Video snapshot directory (or filename)")
 #define SNAP_PATH_LONGTEXT N_( \
     "Directory where the video snapshots will be stored.")
@@ -523,6 +535,37 @@ static const char *const ppsz_pos_descriptions[] =
     "This defines the maximum input delay jitter that the synchronization " \
     "algorithms should try to compensate (in milliseconds)." )
 
+#define INPUT_LOCKFREE_FIFO_TEXT N_("Lock-free decoder queues")
+#define INPUT_LOCKFREE_FIFO_LONGTEXT N_( \
+    "Pass data from the demuxer to the decoders through lock-free queues. " \
+    "This reduces the synchronization overhead with many small packets." )
+
+#define INPUT_FIFO_VIDEO_TEXT N_("Video decoder queue duration (ms)")
+#define INPUT_FIFO_AUDIO_TEXT N_("Audio decoder queue duration (ms)")
+#define INPUT_FIFO_SPU_TEXT N_("Subtitles decoder queue duration (ms)")
+#define INPUT_FIFO_LONGTEXT N_( \
+    "Maximum duration of data waiting to be decoded. When the decoder " \
+    "cannot keep up, frames known not to be used as reference are " \
+    "dropped first, then the oldest data up to a key frame. 0 only limits " \
+    "the queue size." )
+
+#define BLOCK_POOL_SIZE_TEXT N_("Data block pool size (MiB)")
+#define BLOCK_POOL_SIZE_LONGTEXT N_( \
+    "Maximum amount of memory kept for reuse after data blocks are released. " \
+    "0 disables the pool." )
+
+#define STREAM_READAHEAD_TEXT N_("Read-ahead thread")
+#define STREAM_READAHEAD_LONGTEXT N_( \
+    "Read from byte stream inputs (files, network shares) in a separate " \
+    "thread, so that slow reads do not stall the demuxer." )
+
+#define DEMUX_INDEX_CACHE_TEXT N_("Cache demuxer indexes")
+#define DEMUX_INDEX_CACHE_LONGTEXT N_( \
+    "Keep the seek indexes that demuxers build by scanning local files " \
+    "(such as broken AVI or Matroska files without cues) in the cache " \
+    "directory, so that the next opening does not scan again. The least " \
+    "recently stored indexes are removed beyond 64 MiB." )
+
 #define NETSYNC_TEXT N_("Network synchronisation" )
 #define NETSYNC_LONGTEXT N_( "This allows you to remotely " \
         "synchronise clocks for server and client. The detailed settings " \
@@ -675,6 +718,11 @@ static const char *const ppsz_prefres[] = {
     "This is the maximum size in bytes of the temporary files " \
     "that will be used to store the timeshifted streams." )
 
+#define INPUT_TIMESHIFT_WINDOW_TEXT N_("Timeshift window")
+#define INPUT_TIMESHIFT_WINDOW_LONGTEXT N_( \
+    "Amount of already played data (in MiB) kept on disk, to seek back " \
+    "in live streams. If not 0, live streams are always timeshifted." )
+
 #define INPUT_TITLE_FORMAT_TEXT N_( "Change title according to current media" )
 #define INPUT_TITLE_FORMAT_LONGTEXT N_( "This option allows you to set the title according to what's being played<br>"  \
     "$a: Artist<br>$b: Album<br>$c: Copyright<br>$t: Title<br>$g: Genre<br>"  \
@@ -822,6 +870,17 @@ static const char *const ppsz_prefres[] = {
     "However allocation of port numbers below 1025 is usually restricted " \
     "by the operating system." )
 
+#define HTTP_THREADS_TEXT N_( "HTTP server threads" )
+#define HTTP_THREADS_LONGTEXT N_( \
+    "The clients of each HTTP and RTSP server are shared among this " \
+    "number of threads. Use more threads to serve many streaming clients " \
+    "at once. This is only supported on Linux." )
+
+#define HTTP_STREAM_BUFFER_TEXT N_( "HTTP stream buffer (seconds)" )
+#define HTTP_STREAM_BUFFER_LONGTEXT N_( \
+    "Duration of the data kept for each HTTP stream. Clients lagging " \
+    "further behind skip to the live position." )
+
 #define HTTP_CERT_TEXT N_("HTTP/TLS server certificate")
 #define CERT_LONGTEXT N_( \
    "This X.509 certicate file (PEM format) is used for server-side TLS. " \
@@ -1592,6 +1651,9 @@ vlc_module_begin ()
                 VIDEO_FILTER_TEXT, VIDEO_FILTER_LONGTEXT, false )
     add_module_list( "video-splitter", "video splitter", NULL,
                      VIDEO_SPLITTER_TEXT, VIDEO_SPLITTER_LONGTEXT, false )
+    add_integer( "filter-threads", 0, FILTER_THREADS_TEXT,
+                 FILTER_THREADS_LONGTEXT, true )
+        change_integer_range( 0, 64 )
     add_obsolete_string( "vout-filter" ) /* since 2.0.0 */
 #if 0
     add_string( "pixel-ratio", "1", PIXEL_RATIO_TEXT, PIXEL_RATIO_TEXT )
@@ -1725,6 +1787,12 @@ vlc_module_begin ()
     add_string( "rtsp-host", NULL, RTSP_HOST_TEXT, RTSP_HOST_LONGTEXT, true )
     add_integer( "rtsp-port", 554, RTSP_PORT_TEXT, RTSP_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
+    add_integer( "http-threads", 1, HTTP_THREADS_TEXT, HTTP_THREADS_LONGTEXT,
+                 true )
+        change_integer_range( 1, 64 )
+    add_integer( "http-stream-buffer", 10, HTTP_STREAM_BUFFER_TEXT,
+                 HTTP_STREAM_BUFFER_LONGTEXT, true )
+        change_integer_range( 1, 600 )
     add_loadfile( "http-cert", NULL, HTTP_CERT_TEXT, CERT_LONGTEXT, true )
     add_obsolete_string( "sout-http-cert" ) /* since 2.0.0 */
     add_loadfile( "http-key", NULL, HTTP_KEY_TEXT, KEY_LONGTEXT, true )
@@ -1825,6 +1893,21 @@ vlc_module_begin ()
     add_integer( "clock-jitter", 5 * CLOCK_FREQ/1000, CLOCK_JITTER_TEXT,
               CLOCK_JITTER_LONGTEXT, true )
         change_safe()
+    add_bool( "input-lockfree-fifo", false, INPUT_LOCKFREE_FIFO_TEXT,
+              INPUT_LOCKFREE_FIFO_LONGTEXT, true )
+    add_integer( "input-fifo-video", 0, INPUT_FIFO_VIDEO_TEXT,
+                 INPUT_FIFO_LONGTEXT, true )
+    add_integer( "input-fifo-audio", 0, INPUT_FIFO_AUDIO_TEXT,
+                 INPUT_FIFO_LONGTEXT, true )
+    add_integer( "input-fifo-spu", 0, INPUT_FIFO_SPU_TEXT,
+                 INPUT_FIFO_LONGTEXT, true )
+    add_integer( "block-pool-size", 16, BLOCK_POOL_SIZE_TEXT,
+                 BLOCK_POOL_SIZE_LONGTEXT, true )
+        change_integer_range( 0, 4096 )
+    add_bool( "stream-readahead", false, STREAM_READAHEAD_TEXT,
+              STREAM_READAHEAD_LONGTEXT, true )
+    add_bool( "demux-index-cache", false, DEMUX_INDEX_CACHE_TEXT,
+              DEMUX_INDEX_CACHE_LONGTEXT, true )
 
     add_bool( "network-synchronisation", false, NETSYNC_TEXT,
               NETSYNC_LONGTEXT, true )
@@ -1838,6 +1921,8 @@ vlc_module_begin ()
                 INPUT_TIMESHIFT_PATH_LONGTEXT, true )
     add_integer( "input-timeshift-granularity", -1, INPUT_TIMESHIFT_GRANULARITY_TEXT,
                  INPUT_TIMESHIFT_GRANULARITY_LONGTEXT, true )
+    add_integer( "input-timeshift-window", 0, INPUT_TIMESHIFT_WINDOW_TEXT,
+                 INPUT_TIMESHIFT_WINDOW_LONGTEXT, true )
 
     add_string( "input-title-format", "$Z", INPUT_TITLE_FORMAT_TEXT, INPUT_TITLE_FORMAT_LONGTEXT, false );
 
@@ -2025,6 +2110,7 @@ vlc_module_begin ()
         change_short('v')
         change_volatile ()
     add_obsolete_string( "verbose-objects" ) /* since 2.1.0 */
+    add_bool( "log-async", false, LOG_ASYNC_TEXT, LOG_ASYNC_LONGTEXT, true )
 #if !defined(_WIN32) && !defined(__OS2__)
     add_bool( "daemon", 0, DAEMON_TEXT, DAEMON_LONGTEXT, true )
         change_short('d')
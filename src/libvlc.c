@@ -352,6 +352,9 @@ dbus_out:
     vlc_CPU_dump( VLC_OBJECT(p_libvlc) );
 
     priv->b_stats = var_InheritBool( p_libvlc, "stats" );
+    block_PoolSetLimit( (size_t)var_InheritInteger( p_libvlc,
+                                                    "block-pool-size" ) << 20 );
+    vlc_slice_Init( var_InheritInteger( p_libvlc, "filter-threads" ) );
 
     /*
      * Initialize hotkey handling
@@ -532,6 +535,8 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
     if( !var_InheritBool( p_libvlc, "ignore-config" ) )
         config_AutoSaveConfigFile( VLC_OBJECT(p_libvlc) );
 
+    vlc_slice_Deinit();
+
     /* Free module bank. It is refcounted, so we call this each time  */
     vlc_LogDeinit (p_libvlc);
     module_EndBank (true);
@@ -50,6 +50,18 @@ size_t EnumClockSource( vlc_object_t *, const char *, char ***, char *** );
 void vlc_CPU_init(void);
 void vlc_CPU_dump(vlc_object_t *);
 
+/*
+ * Data blocks pool
+ */
+void block_PoolSetLimit(size_t);
+void block_PoolGetStats(uint64_t *hits, uint64_t *misses, size_t *retained);
+
+/*
+ * Video filters slice worker threads
+ */
+void vlc_slice_Init(unsigned threads);
+void vlc_slice_Deinit(void);
+
 /*
  * Threads subsystem
  */
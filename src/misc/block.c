@@ -37,6 +37,8 @@
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
+#include "../libvlc.h"
 
 /**
  * @section Block handling functions.
@@ -97,11 +99,374 @@ void block_Init( block_t *restrict b, void *buf, size_t size )
 #endif
 }
 
+/**
+ * @section Block pool
+ *
+ * Blocks allocated by block_Alloc() are rounded up to size classes, four
+ * per power of two, so that the rounding wastes at most a fifth of a block.
+ * Released blocks are kept in a small per-thread cache, and beyond that in a
+ * global depot, so that they can be reused without going through the heap.
+ * The total retained memory is capped (see block_PoolSetLimit()).
+ */
+
+#define BLOCK_POOL_MIN_SHIFT 9  /* 512 bytes */
+#define BLOCK_POOL_MAX_SHIFT 20 /* 1 MiB */
+#define BLOCK_POOL_STEP_BITS 2  /* classes per power of two, log2 */
+#define BLOCK_POOL_CLASSES \
+    (((BLOCK_POOL_MAX_SHIFT - BLOCK_POOL_MIN_SHIFT) << BLOCK_POOL_STEP_BITS) + 1)
+
+/* Per-thread cache bounds, per size class */
+#define BLOCK_CACHE_COUNT    16
+#define BLOCK_CACHE_BYTES    (256 * 1024)
+
+/* Thread-local statistics are published every so many operations */
+#define BLOCK_CACHE_PUBLISH  64
+
+/* Default cap on retained memory, until LibVLC configures it */
+#define BLOCK_POOL_LIMIT     (16 << 20)
+
+struct block_cache
+{
+    block_t *lists[BLOCK_POOL_CLASSES];
+    unsigned counts[BLOCK_POOL_CLASSES];
+
+    /* Not yet published statistics */
+    unsigned hits;
+    unsigned misses;
+    unsigned ops;
+    ssize_t retained;
+};
+
+static struct
+{
+    vlc_mutex_t lock;
+    block_t *lists[BLOCK_POOL_CLASSES]; /* depot, protected by lock */
+
+    vlc_threadvar_t cache;
+    atomic_bool cache_ready;
+
+    atomic_size_t limit;
+    atomic_size_t retained;
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t misses;
+} block_pool = {
+    .lock = VLC_STATIC_MUTEX,
+    .cache_ready = ATOMIC_VAR_INIT(false),
+    .limit = ATOMIC_VAR_INIT(BLOCK_POOL_LIMIT),
+    .retained = ATOMIC_VAR_INIT(0),
+    .hits = ATOMIC_VAR_INIT(0),
+    .misses = ATOMIC_VAR_INIT(0),
+};
+
+/* Class sizes are (4 + step) << (shift - 2), for each shift and step */
+static inline size_t block_pool_ClassSize (unsigned c)
+{
+    const unsigned steps = 1 << BLOCK_POOL_STEP_BITS;
+    const unsigned shift = (c >> BLOCK_POOL_STEP_BITS) + BLOCK_POOL_MIN_SHIFT;
+
+    return ((size_t)(steps + (c & (steps - 1))))
+           << (shift - BLOCK_POOL_STEP_BITS);
+}
+
+/* Returns the size class of an allocation, or -1 if it is too large. */
+static int block_pool_Class (size_t alloc)
+{
+    if (alloc > block_pool_ClassSize (BLOCK_POOL_CLASSES - 1))
+        return -1;
+    if (alloc <= block_pool_ClassSize (0))
+        return 0;
+
+    /* alloc - 1 is less than 1 MiB so that it fits in an unsigned */
+    unsigned n = alloc - 1;
+    unsigned shift = sizeof (unsigned) * 8 - 1 - clz (n);
+    /* leading bits, from 4 to 7: the class is the next step up */
+    unsigned lead = n >> (shift - BLOCK_POOL_STEP_BITS);
+
+    return ((shift - BLOCK_POOL_MIN_SHIFT) << BLOCK_POOL_STEP_BITS)
+           + lead + 1 - (1 << BLOCK_POOL_STEP_BITS);
+}
+
+static unsigned block_cache_Max (unsigned c)
+{
+    size_t max = BLOCK_CACHE_BYTES / block_pool_ClassSize (c);
+    if (max > BLOCK_CACHE_COUNT)
+        max = BLOCK_CACHE_COUNT;
+    return max ? max : 1;
+}
+
+static void block_cache_Publish (struct block_cache *cache)
+{
+    atomic_fetch_add_explicit (&block_pool.hits, cache->hits,
+                               memory_order_relaxed);
+    atomic_fetch_add_explicit (&block_pool.misses, cache->misses,
+                               memory_order_relaxed);
+    if (cache->retained >= 0)
+        atomic_fetch_add_explicit (&block_pool.retained, cache->retained,
+                                   memory_order_relaxed);
+    else
+        atomic_fetch_sub_explicit (&block_pool.retained, -cache->retained,
+                                   memory_order_relaxed);
+    cache->hits = cache->misses = cache->ops = 0;
+    cache->retained = 0;
+}
+
+static void block_cache_Count (struct block_cache *cache)
+{
+    if (++cache->ops >= BLOCK_CACHE_PUBLISH)
+        block_cache_Publish (cache);
+}
+
+/* Moves a list of blocks to the depot, as long as the pool limit allows,
+ * and accounts for them. Lock must be held. Returns the blocks in excess,
+ * which must be freed. */
+static block_t *block_pool_Deposit (unsigned c, block_t *list)
+{
+    const size_t size = block_pool_ClassSize (c);
+    const size_t limit = atomic_load_explicit (&block_pool.limit,
+                                               memory_order_relaxed);
+
+    while (list != NULL
+        && atomic_load_explicit (&block_pool.retained,
+                                 memory_order_relaxed) + size <= limit)
+    {
+        block_t *b = list;
+
+        list = b->p_next;
+        b->p_next = block_pool.lists[c];
+        block_pool.lists[c] = b;
+        atomic_fetch_add_explicit (&block_pool.retained, size,
+                                   memory_order_relaxed);
+    }
+    return list;
+}
+
+static void block_pool_Free (block_t *list)
+{
+    while (list != NULL)
+    {
+        block_t *next = list->p_next;
+        free (list);
+        list = next;
+    }
+}
+
+static void block_cache_Destroy (void *data)
+{
+    struct block_cache *cache = data;
+    block_t *garbage[BLOCK_POOL_CLASSES];
+
+    vlc_mutex_lock (&block_pool.lock);
+    for (unsigned c = 0; c < BLOCK_POOL_CLASSES; c++)
+    {
+        garbage[c] = block_pool_Deposit (c, cache->lists[c]);
+        cache->retained -= cache->counts[c] * block_pool_ClassSize (c);
+    }
+    vlc_mutex_unlock (&block_pool.lock);
+
+    for (unsigned c = 0; c < BLOCK_POOL_CLASSES; c++)
+        block_pool_Free (garbage[c]);
+    block_cache_Publish (cache);
+    free (cache);
+}
+
+static struct block_cache *block_cache_Get (void)
+{
+    if (!atomic_load_explicit (&block_pool.cache_ready, memory_order_acquire))
+    {
+        /* The thread variable is never deleted: blocks may be released
+         * until the very end of the process. */
+        vlc_mutex_lock (&block_pool.lock);
+        if (!atomic_load_explicit (&block_pool.cache_ready,
+                                   memory_order_relaxed)
+         && vlc_threadvar_create (&block_pool.cache, block_cache_Destroy) == 0)
+            atomic_store_explicit (&block_pool.cache_ready, true,
+                                   memory_order_release);
+        vlc_mutex_unlock (&block_pool.lock);
+
+        if (!atomic_load_explicit (&block_pool.cache_ready,
+                                   memory_order_acquire))
+            return NULL;
+    }
+
+    struct block_cache *cache = vlc_threadvar_get (block_pool.cache);
+    if (unlikely(cache == NULL))
+    {
+        cache = calloc (1, sizeof (*cache));
+        if (cache != NULL && vlc_threadvar_set (block_pool.cache, cache))
+        {
+            free (cache);
+            cache = NULL;
+        }
+    }
+    return cache;
+}
+
+/* Takes a block of the given class from the pool, NULL if none is left. */
+static block_t *block_pool_Get (unsigned c)
+{
+    const size_t size = block_pool_ClassSize (c);
+    struct block_cache *cache = block_cache_Get ();
+    unsigned count = 0;
+    block_t *b;
+
+    if (cache != NULL && (b = cache->lists[c]) != NULL)
+    {
+        cache->lists[c] = b->p_next;
+        cache->counts[c]--;
+        cache->retained -= size;
+        cache->hits++;
+        block_cache_Count (cache);
+        return b;
+    }
+
+    /* Refill the thread cache from the depot by batch */
+    unsigned n = (cache != NULL) ? block_cache_Max (c) : 1;
+
+    vlc_mutex_lock (&block_pool.lock);
+    b = block_pool.lists[c];
+    if (b != NULL)
+    {
+        block_t *last = b;
+
+        count = 1;
+        while (count < n && last->p_next != NULL)
+        {
+            last = last->p_next;
+            count++;
+        }
+        block_pool.lists[c] = last->p_next;
+        last->p_next = NULL;
+
+        if (cache != NULL)
+        {
+            cache->lists[c] = b->p_next;
+            cache->counts[c] = count - 1;
+            cache->retained += (count - 1) * size;
+        }
+    }
+    vlc_mutex_unlock (&block_pool.lock);
+
+    if (b != NULL)
+    {
+        /* Refilled blocks are accounted by the thread until published */
+        atomic_fetch_sub_explicit (&block_pool.retained, count * size,
+                                   memory_order_relaxed);
+        if (cache != NULL)
+            cache->hits++;
+        else
+            atomic_fetch_add_explicit (&block_pool.hits, 1,
+                                       memory_order_relaxed);
+    }
+    else
+    {
+        if (cache != NULL)
+            cache->misses++;
+        else
+            atomic_fetch_add_explicit (&block_pool.misses, 1,
+                                       memory_order_relaxed);
+    }
+
+    if (cache != NULL)
+        block_cache_Count (cache);
+    return b;
+}
+
+/* Gives a released block back to the pool. Returns false if the pool is full
+ * and the block must be freed. */
+static bool block_pool_Put (block_t *b, unsigned c)
+{
+    const size_t size = block_pool_ClassSize (c);
+    struct block_cache *cache = block_cache_Get ();
+    ssize_t pending = (cache != NULL) ? cache->retained : 0;
+
+    if (atomic_load_explicit (&block_pool.retained, memory_order_relaxed)
+        + pending + size
+        > atomic_load_explicit (&block_pool.limit, memory_order_relaxed))
+        return false;
+
+    if (cache == NULL)
+    {
+        b->p_next = NULL;
+        vlc_mutex_lock (&block_pool.lock);
+        b = block_pool_Deposit (c, b);
+        vlc_mutex_unlock (&block_pool.lock);
+        return b == NULL;
+    }
+
+    if (cache->counts[c] >= block_cache_Max (c))
+    {   /* Thread cache is full: flush it to the depot at once */
+        vlc_mutex_lock (&block_pool.lock);
+        block_t *garbage = block_pool_Deposit (c, cache->lists[c]);
+        vlc_mutex_unlock (&block_pool.lock);
+        block_pool_Free (garbage);
+        cache->retained -= cache->counts[c] * size;
+        cache->lists[c] = NULL;
+        cache->counts[c] = 0;
+    }
+
+    b->p_next = cache->lists[c];
+    cache->lists[c] = b;
+    cache->counts[c]++;
+    cache->retained += size;
+    block_cache_Count (cache);
+    return true;
+}
+
+/**
+ * Sets the maximum amount of memory retained by the block pool.
+ * Blocks in excess are released to the heap.
+ */
+void block_PoolSetLimit (size_t limit)
+{
+    block_t *garbage = NULL;
+    size_t freed = 0;
+
+    atomic_store_explicit (&block_pool.limit, limit, memory_order_relaxed);
+
+    vlc_mutex_lock (&block_pool.lock);
+    for (unsigned c = BLOCK_POOL_CLASSES; c-- > 0;)
+        while (block_pool.lists[c] != NULL
+            && atomic_load_explicit (&block_pool.retained,
+                                     memory_order_relaxed) - freed > limit)
+        {
+            block_t *b = block_pool.lists[c];
+
+            block_pool.lists[c] = b->p_next;
+            b->p_next = garbage;
+            garbage = b;
+            freed += block_pool_ClassSize (c);
+        }
+    vlc_mutex_unlock (&block_pool.lock);
+
+    atomic_fetch_sub_explicit (&block_pool.retained, freed,
+                               memory_order_relaxed);
+    block_pool_Free (garbage);
+}
+
+/**
+ * Reads the block pool statistics.
+ * Thread-local statistics are published lazily, so that they are not exact.
+ */
+void block_PoolGetStats (uint64_t *hits, uint64_t *misses, size_t *retained)
+{
+    *hits = atomic_load_explicit (&block_pool.hits, memory_order_relaxed);
+    *misses = atomic_load_explicit (&block_pool.misses, memory_order_relaxed);
+    *retained = atomic_load_explicit (&block_pool.retained,
+                                      memory_order_relaxed);
+}
+
 static void block_generic_Release (block_t *block)
 {
     /* That is always true for blocks allocated with block_Alloc(). */
     assert (block->p_start == (unsigned char *)(block + 1));
     block_Invalidate (block);
+
+    /* Pooled blocks fill their size class exactly */
+    const size_t alloc = sizeof (*block) + block->i_size;
+    int c = block_pool_Class (alloc);
+    if (c >= 0 && block_pool_ClassSize (c) == alloc
+     && block_pool_Put (block, c))
+        return;
     free (block);
 }
 
@@ -126,15 +491,33 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /* Maximum size of reserved footer before shrinking with realloc(). */
 #define BLOCK_WASTE_SIZE   2048
 
+/* Actual allocation size of block_Alloc(size), including the pool rounding */
+static size_t block_AllocSize (size_t size)
+{
+    size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING) + size;
+    int c = block_pool_Class (alloc);
+
+    return (c >= 0) ? block_pool_ClassSize (c) : alloc;
+}
+
 block_t *block_Alloc (size_t size)
 {
     /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
+    size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING) + size;
     if (unlikely(alloc <= size))
         return NULL;
 
-    block_t *b = malloc (alloc);
+    block_t *b;
+    int c = block_pool_Class (alloc);
+    if (c >= 0)
+    {
+        alloc = block_pool_ClassSize (c);
+        b = block_pool_Get (c);
+        if (b == NULL)
+            b = malloc (alloc);
+    }
+    else
+        b = malloc (alloc);
     if (unlikely(b == NULL))
         return NULL;
 
@@ -148,12 +531,35 @@ block_t *block_Alloc (size_t size)
     return b;
 }
 
+static bool block_IsReadOnly (const block_t *);
+
+block_t *block_MakeWritable (block_t *block)
+{
+    if (!block_IsReadOnly (block))
+        return block;
+
+    block_t *dup = block_Duplicate (block);
+    if (likely(dup != NULL))
+        dup->p_next = block->p_next;
+    block_Release (block);
+    return dup;
+}
+
 block_t *block_Realloc( block_t *p_block, ssize_t i_prebody, size_t i_body )
 {
     size_t requested = i_prebody + i_body;
 
     block_Check( p_block );
 
+    /* Read-only data can be trimmed, but anything else needs a copy */
+    if( block_IsReadOnly( p_block )
+     && ( i_prebody > 0 || i_body > p_block->i_buffer ) )
+    {
+        p_block = block_MakeWritable( p_block );
+        if( p_block == NULL )
+            return NULL;
+    }
+
     /* Corner case: empty block requested */
     if( i_prebody <= 0 && i_body <= (size_t)(-i_prebody) )
     {
@@ -225,9 +631,11 @@ block_t *block_Realloc( block_t *p_block, ssize_t i_prebody, size_t i_body )
         p_block = p_rea;
     }
     else
-    /* We have a very large reserved footer now? Release some of it.
+    /* We have a very large reserved footer now? Release some of it,
+     * unless a new block would end up in the same pool size class.
      * XXX it might not preserve the alignment of p_buffer */
-    if( p_end - (p_block->p_buffer + i_body) > BLOCK_WASTE_SIZE )
+    if( p_end - (p_block->p_buffer + i_body) > BLOCK_WASTE_SIZE
+     && block_AllocSize( requested ) < sizeof( *p_block ) + p_block->i_size )
     {
         block_t *p_rea = block_Alloc( requested );
         if( p_rea )
@@ -297,11 +705,28 @@ block_t *block_heap_Alloc (void *addr, size_t length)
 #ifdef HAVE_MMAP
 # include <sys/mman.h>
 
+typedef struct block_mmap_t
+{
+    block_t     self;
+    struct block_mmap_t *map; /* owner of the mapping, self if none */
+    void       *base_addr;
+    size_t      length;
+    atomic_uintptr_t refs; /* only meaningful for the owner */
+} block_mmap_t;
+
 static void block_mmap_Release (block_t *block)
 {
+    block_mmap_t *sys = (block_mmap_t *)block;
+    block_mmap_t *map = sys->map;
+
     block_Invalidate (block);
-    munmap (block->p_start, block->i_size);
-    free (block);
+    if (sys != map)
+        free (sys);
+    if (atomic_fetch_sub_explicit (&map->refs, 1, memory_order_acq_rel) == 1)
+    {
+        munmap (map->base_addr, map->length);
+        free (map);
+    }
 }
 
 /**
@@ -319,22 +744,76 @@ block_t *block_mmap_Alloc (void *addr, size_t length)
     if (addr == MAP_FAILED)
         return NULL;
 
-    block_t *block = malloc (sizeof (*block));
+    block_mmap_t *block = malloc (sizeof (*block));
     if (block == NULL)
     {
         munmap (addr, length);
         return NULL;
     }
 
-    block_Init (block, addr, length);
-    block->pf_release = block_mmap_Release;
-    return block;
+    block_Init (&block->self, addr, length);
+    block->self.pf_release = block_mmap_Release;
+    block->map = block;
+    block->base_addr = addr;
+    block->length = length;
+    atomic_init (&block->refs, 1);
+    return &block->self;
+}
+
+/* Blocks sharing a mapping may overlap: none of them owns its data */
+static bool block_IsReadOnly (const block_t *block)
+{
+    const block_mmap_t *sys = (const block_mmap_t *)block;
+
+    return block->pf_release == block_mmap_Release && sys->map != sys;
+}
+
+/**
+ * Creates a block referencing part of the payload of a memory mapping block,
+ * without copying. The mapping is unmapped only once all the blocks sharing
+ * it have been released. The data of the new block are read-only, see
+ * block_MakeWritable().
+ *
+ * @param block block created by block_mmap_Alloc() or block_mmap_Share()
+ * @param offset offset (bytes) from the payload start of the block
+ * @param length length (bytes) of the new block
+ * @return NULL if the block is not a memory mapping, or on error.
+ */
+block_t *block_mmap_Share (block_t *block, size_t offset, size_t length)
+{
+    if (block->pf_release != block_mmap_Release)
+        return NULL;
+
+    assert (offset + length <= block->i_buffer);
+
+    block_mmap_t *map = ((block_mmap_t *)block)->map;
+    block_mmap_t *share = malloc (sizeof (*share));
+    if (unlikely(share == NULL))
+        return NULL;
+
+    block_Init (&share->self, block->p_buffer + offset, length);
+    share->self.pf_release = block_mmap_Release;
+    share->map = map;
+    share->base_addr = NULL;
+    share->length = 0;
+    atomic_fetch_add_explicit (&map->refs, 1, memory_order_relaxed);
+    return &share->self;
 }
 #else
+static bool block_IsReadOnly (const block_t *block)
+{
+    (void)block; return false;
+}
+
 block_t *block_mmap_Alloc (void *addr, size_t length)
 {
     (void)addr; (void)length; return NULL;
 }
+
+block_t *block_mmap_Share (block_t *block, size_t offset, size_t length)
+{
+    (void)block; (void)offset; (void)length; return NULL;
+}
 #endif
 
 #ifdef HAVE_SYS_SHM_H
@@ -125,7 +125,7 @@ void vlc_CPU_init (void)
     uint32_t i_capabilities = 0;
 
 #if defined( __i386__ ) || defined( __x86_64__ )
-     unsigned int i_eax, i_ebx, i_ecx, i_edx;
+     unsigned int i_eax, i_ebx, i_ecx, i_edx, i_max;
      bool b_amd;
 
     /* Needed for x86 CPU capabilities detection */
@@ -135,15 +135,20 @@ void vlc_CPU_init (void)
                    "cpuid\n\t" \
                    "xchgl %%ebx,%1\n\t" \
                    : "=a" (i_eax), "=r" (i_ebx), "=c" (i_ecx), "=d" (i_edx) \
-                   : "a" (reg) \
+                   : "a" (reg), "c" (0) \
                    : "cc");
 # else
 #  define cpuid(reg) \
      asm volatile ("cpuid\n\t" \
                    : "=a" (i_eax), "=b" (i_ebx), "=c" (i_ecx), "=d" (i_edx) \
-                   : "a" (reg) \
+                   : "a" (reg), "c" (0) \
                    : "cc");
 # endif
+     /* Read an extended control register, XCR0 tells which register states
+      * the OS saves on context switches. (xgetbv opcode for old assemblers) */
+# define xgetbv(xcr, lo) \
+     asm volatile (".byte 0x0f, 0x01, 0xd0\n\t" \
+                   : "=a" (lo), "=d" (i_edx) : "c" (xcr))
      /* Check if the OS really supports the requested instructions */
 # if defined (__i386__) && !defined (__i486__) && !defined (__i586__) \
   && !defined (__i686__) && !defined (__pentium4__) \
@@ -171,6 +176,7 @@ void vlc_CPU_init (void)
 
     /* the CPU supports the CPUID instruction - get its level */
     cpuid( 0x00000000 );
+    i_max = i_eax;
 
 # if defined (__i386__) && !defined (__i586__) \
   && !defined (__i686__) && !defined (__pentium4__) \
@@ -209,6 +215,28 @@ void vlc_CPU_init (void)
             i_capabilities |= VLC_CPU_SSE4_1;
         if (i_ecx & 0x00100000)
             i_capabilities |= VLC_CPU_SSE4_2;
+
+        /* AVX needs OS support (OSXSAVE) to save the YMM registers */
+        if ((i_ecx & 0x18000000) == 0x18000000)
+        {
+            unsigned xcr0;
+
+            xgetbv(0, xcr0);
+            if ((xcr0 & 0x06) == 0x06) /* XMM and YMM states */
+            {
+                i_capabilities |= VLC_CPU_AVX;
+                if (i_max >= 7)
+                {
+                    cpuid( 0x00000007 );
+                    if (i_ebx & 0x00000020)
+                        i_capabilities |= VLC_CPU_AVX2;
+                    /* AVX-512 F and BW, with opmask and ZMM states */
+                    if ((i_ebx & 0x40010000) == 0x40010000
+                     && (xcr0 & 0xE0) == 0xE0)
+                        i_capabilities |= VLC_CPU_AVX512;
+                }
+            }
+        }
     }
 
     /* test for additional capabilities */
@@ -292,7 +320,8 @@ void vlc_CPU_dump (vlc_object_t *obj)
     if (vlc_CPU_SSE4_2()) p += sprintf (p, "SSE4.2 ");
     if (vlc_CPU_SSE4A()) p += sprintf (p, "SSE4A ");
     if (vlc_CPU_AVX()) p += sprintf (p, "AVX ");
-    if (vlc_CPU_AVX2()) p += sprintf (p, "AVX ");
+    if (vlc_CPU_AVX2()) p += sprintf (p, "AVX2 ");
+    if (vlc_CPU_AVX512()) p += sprintf (p, "AVX-512 ");
     if (vlc_CPU_3dNOW()) p += sprintf (p, "3DNow! ");
     if (vlc_CPU_XOP()) p += sprintf (p, "XOP ");
     if (vlc_CPU_FMA4()) p += sprintf (p, "FMA4 ");
@@ -30,6 +30,7 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "libvlc.h"
 
 /**
@@ -48,8 +49,53 @@ struct block_fifo_t
     block_t             **pp_last;
     size_t              i_depth;
     size_t              i_size;
+
+    /* Single producer/single consumer ring, NULL for regular FIFOs.
+     * Blocks pushed with vlc_fifo_Push() are appended to the ring without
+     * locking, then moved to the list above by the consumer (with the lock
+     * held). The list thus always contains the oldest blocks. */
+    struct
+    {
+        block_t       **pp_slots;
+        size_t          i_mask;
+        atomic_size_t   i_head; /**< next slot to write (producer) */
+        atomic_size_t   i_tail; /**< next slot to read (locked consumer) */
+        atomic_size_t   i_size; /**< bytes in the ring */
+        atomic_bool     b_sleeping; /**< consumer waits for a signal */
+    } ring;
 };
 
+/**
+ * Moves all blocks of the ring to the list. The FIFO must be locked.
+ */
+static void vlc_fifo_Collect(vlc_fifo_t *fifo)
+{
+    if (fifo->ring.pp_slots == NULL)
+        return;
+
+    size_t tail = atomic_load(&fifo->ring.i_tail);
+    size_t head = atomic_load(&fifo->ring.i_head);
+    size_t size = 0;
+
+    if (tail == head)
+        return;
+
+    for (; tail != head; tail++)
+    {
+        block_t *block = fifo->ring.pp_slots[tail & fifo->ring.i_mask];
+
+        assert(block->p_next == NULL);
+        *(fifo->pp_last) = block;
+        fifo->pp_last = &block->p_next;
+        fifo->i_depth++;
+        fifo->i_size += block->i_buffer;
+        size += block->i_buffer;
+    }
+
+    atomic_fetch_sub(&fifo->ring.i_size, size);
+    atomic_store(&fifo->ring.i_tail, tail);
+}
+
 /**
  * Locks a block FIFO. No more than one thread can lock the FIFO at any given
  * time, and no other thread can modify the FIFO while it is locked.
@@ -102,6 +148,16 @@ void vlc_fifo_Signal(vlc_fifo_t *fifo)
  */
 void vlc_fifo_Wait(vlc_fifo_t *fifo)
 {
+    if (fifo->ring.pp_slots != NULL)
+    {
+        /* The producer only signals if it sees the flag, so check the ring
+         * again after setting it. */
+        atomic_store(&fifo->ring.b_sleeping, true);
+        if (atomic_load(&fifo->ring.i_head) == atomic_load(&fifo->ring.i_tail))
+            vlc_fifo_WaitCond(fifo, &fifo->wait);
+        atomic_store(&fifo->ring.b_sleeping, false);
+        return;
+    }
     vlc_fifo_WaitCond(fifo, &fifo->wait);
 }
 
@@ -122,7 +178,15 @@ void vlc_fifo_WaitCond(vlc_fifo_t *fifo, vlc_cond_t *condvar)
  */
 size_t vlc_fifo_GetCount(const vlc_fifo_t *fifo)
 {
-    return fifo->i_depth;
+    size_t depth = fifo->i_depth;
+
+    if (fifo->ring.pp_slots != NULL)
+    {
+        vlc_fifo_t *f = (vlc_fifo_t *)fifo;
+        size_t tail = atomic_load(&f->ring.i_tail);
+        depth += atomic_load(&f->ring.i_head) - tail;
+    }
+    return depth;
 }
 
 /**
@@ -141,7 +205,11 @@ size_t vlc_fifo_GetCount(const vlc_fifo_t *fifo)
  */
 size_t vlc_fifo_GetBytes(const vlc_fifo_t *fifo)
 {
-    return fifo->i_size;
+    size_t size = fifo->i_size;
+
+    if (fifo->ring.pp_slots != NULL)
+        size += atomic_load(&((vlc_fifo_t *)fifo)->ring.i_size);
+    return size;
 }
 
 /**
@@ -160,6 +228,8 @@ void vlc_fifo_QueueUnlocked(block_fifo_t *fifo, block_t *block)
     vlc_assert_locked(&fifo->lock);
     assert(*(fifo->pp_last) == NULL);
 
+    vlc_fifo_Collect(fifo); /* keep blocks ordered */
+
     *(fifo->pp_last) = block;
 
     while (block != NULL)
@@ -188,6 +258,9 @@ block_t *vlc_fifo_DequeueUnlocked(block_fifo_t *fifo)
 {
     vlc_assert_locked(&fifo->lock);
 
+    if (fifo->p_first == NULL)
+        vlc_fifo_Collect(fifo);
+
     block_t *block = fifo->p_first;
 
     if (block == NULL)
@@ -222,6 +295,8 @@ block_t *vlc_fifo_DequeueAllUnlocked(block_fifo_t *fifo)
 {
     vlc_assert_locked(&fifo->lock);
 
+    vlc_fifo_Collect(fifo);
+
     block_t *block = fifo->p_first;
 
     fifo->p_first = NULL;
@@ -249,6 +324,46 @@ block_fifo_t *block_FifoNew( void )
     p_fifo->p_first = NULL;
     p_fifo->pp_last = &p_fifo->p_first;
     p_fifo->i_depth = p_fifo->i_size = 0;
+    p_fifo->ring.pp_slots = NULL;
+
+    return p_fifo;
+}
+
+/**
+ * Creates a FIFO queue of blocks backed by a lock-free ring of (at least)
+ * the given number of slots for a single producer.
+ *
+ * Blocks queued with vlc_fifo_Push() by one (and only one) producer thread
+ * do not take the FIFO lock, and the consumer is only signaled if it waits
+ * in vlc_fifo_Wait(). All other functions can be used as with a FIFO created
+ * by block_FifoNew(). If the ring is full, vlc_fifo_Push() falls back to
+ * locking.
+ *
+ * @return the FIFO or NULL on memory error
+ */
+block_fifo_t *block_FifoNewSPSC( size_t slots )
+{
+    size_t count = 1;
+    while( count < slots )
+        count <<= 1;
+
+    block_t **pp_slots = malloc( count * sizeof( *pp_slots ) );
+    if( unlikely(pp_slots == NULL) )
+        return NULL;
+
+    block_fifo_t *p_fifo = block_FifoNew();
+    if( unlikely(p_fifo == NULL) )
+    {
+        free( pp_slots );
+        return NULL;
+    }
+
+    p_fifo->ring.pp_slots = pp_slots;
+    p_fifo->ring.i_mask = count - 1;
+    atomic_init( &p_fifo->ring.i_head, 0 );
+    atomic_init( &p_fifo->ring.i_tail, 0 );
+    atomic_init( &p_fifo->ring.i_size, 0 );
+    atomic_init( &p_fifo->ring.b_sleeping, false );
 
     return p_fifo;
 }
@@ -259,6 +374,8 @@ block_fifo_t *block_FifoNew( void )
  */
 void block_FifoRelease( block_fifo_t *p_fifo )
 {
+    vlc_fifo_Collect( p_fifo );
+    free( p_fifo->ring.pp_slots );
     block_ChainRelease( p_fifo->p_first );
     vlc_cond_destroy( &p_fifo->wait );
     vlc_mutex_destroy( &p_fifo->lock );
@@ -290,6 +407,54 @@ void block_FifoPut(block_fifo_t *fifo, block_t *block)
     vlc_fifo_Unlock(fifo);
 }
 
+/**
+ * Queues a linked-list of blocks into an unlocked FIFO.
+ *
+ * With a FIFO created by block_FifoNewSPSC(), this does not take the lock
+ * unless the ring is full or the consumer is waiting for data. This function
+ * must then only ever be called by a single thread. With other FIFOs, this is
+ * equivalent to block_FifoPut().
+ *
+ * @note This function is not a cancellation point.
+ */
+void vlc_fifo_Push(vlc_fifo_t *fifo, block_t *block)
+{
+    if (fifo->ring.pp_slots == NULL)
+    {
+        block_FifoPut(fifo, block);
+        return;
+    }
+
+    size_t head = atomic_load_explicit(&fifo->ring.i_head,
+                                       memory_order_relaxed);
+
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+
+        if (head - atomic_load(&fifo->ring.i_tail) > fifo->ring.i_mask)
+        {   /* Ring full: queue the rest under the lock (this also empties
+             * the ring). */
+            block_FifoPut(fifo, block);
+            return;
+        }
+
+        block->p_next = NULL;
+        fifo->ring.pp_slots[head & fifo->ring.i_mask] = block;
+        atomic_fetch_add(&fifo->ring.i_size, block->i_buffer);
+        atomic_store(&fifo->ring.i_head, ++head);
+        block = next;
+    }
+
+    /* Only wake the consumer up if it is (about to go) sleeping */
+    if (atomic_load(&fifo->ring.b_sleeping))
+    {
+        vlc_fifo_Lock(fifo);
+        vlc_fifo_Signal(fifo);
+        vlc_fifo_Unlock(fifo);
+    }
+}
+
 /**
  * Dequeue the first block from the FIFO. If necessary, wait until there is
  * one block in the queue. This function is (always) cancellation point.
@@ -331,6 +496,7 @@ block_t *block_FifoShow( block_fifo_t *p_fifo )
     block_t *b;
 
     vlc_mutex_lock( &p_fifo->lock );
+    vlc_fifo_Collect( p_fifo );
     assert(p_fifo->p_first != NULL);
     b = p_fifo->p_first;
     vlc_mutex_unlock( &p_fifo->lock );
@@ -344,7 +510,7 @@ size_t block_FifoSize (block_fifo_t *fifo)
     size_t size;
 
     vlc_mutex_lock (&fifo->lock);
-    size = fifo->i_size;
+    size = vlc_fifo_GetBytes(fifo);
     vlc_mutex_unlock (&fifo->lock);
     return size;
 }
@@ -355,7 +521,7 @@ size_t block_FifoCount (block_fifo_t *fifo)
     size_t depth;
 
     vlc_mutex_lock (&fifo->lock);
-    depth = fifo->i_depth;
+    depth = vlc_fifo_GetCount(fifo);
     vlc_mutex_unlock (&fifo->lock);
     return depth;
 }
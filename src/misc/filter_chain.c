@@ -39,6 +39,10 @@ typedef struct chained_filter_t
     struct chained_filter_t *prev, *next;
     vlc_mouse_t *mouse;
     picture_t *pending;
+    /* Processing time statistics */
+    unsigned pictures;
+    mtime_t time_sum;
+    mtime_t time_max;
 } chained_filter_t;
 
 /* Only use this with filter objects from _this_ C module */
@@ -236,6 +240,9 @@ filter_t *filter_chain_AppendFilter( filter_chain_t *chain, const char *name,
         vlc_mouse_Init( mouse );
     chained->mouse = mouse;
     chained->pending = NULL;
+    chained->pictures = 0;
+    chained->time_sum = 0;
+    chained->time_max = 0;
 
     msg_Dbg( parent, "Filter '%s' (%p) appended to chain",
              (name != NULL) ? name : module_get_name(filter->p_module, false),
@@ -279,6 +286,13 @@ void filter_chain_DeleteFilter( filter_chain_t *chain, filter_t *filter )
     assert( chain->length > 0 );
     chain->length--;
 
+    if( chained->pictures > 0 )
+        msg_Dbg( obj, "Filter '%s' (%p) processed %u pictures in %"PRId64
+                 " us on average (max %"PRId64" us)",
+                 module_get_name( filter->p_module, false ), filter,
+                 chained->pictures, chained->time_sum / chained->pictures,
+                 chained->time_max );
+
     module_unneed( filter, filter->p_module );
 
     msg_Dbg( obj, "Filter %p removed from chain", filter );
@@ -371,7 +385,15 @@ static picture_t *FilterChainVideoFilter( chained_filter_t *f, picture_t *p_pic
     for( ; f != NULL; f = f->next )
     {
         filter_t *p_filter = &f->filter;
+        mtime_t start = mdate();
+
         p_pic = p_filter->pf_video_filter( p_filter, p_pic );
+
+        mtime_t duration = mdate() - start;
+        f->pictures++;
+        f->time_sum += duration;
+        if( duration > f->time_max )
+            f->time_max = duration;
         if( !p_pic )
             break;
         if( f->pending )
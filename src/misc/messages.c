@@ -34,6 +34,7 @@
 
 #include <stdlib.h>
 #include <stdarg.h>                                       /* va_list for BSD */
+#include <stddef.h>
 #include <unistd.h>
 #include <assert.h>
 
@@ -41,8 +42,11 @@
 #include <vlc_interface.h>
 #include <vlc_charset.h>
 #include <vlc_modules.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
+typedef struct vlc_log_ring_t vlc_log_ring_t;
+
 struct vlc_logger_t
 {
     VLC_COMMON_MEMBERS
@@ -50,6 +54,18 @@ struct vlc_logger_t
     vlc_log_cb log;
     void *sys;
     module_t *module;
+
+    /* Asynchronous logging, see vlc_LogAsync() */
+    atomic_bool async;
+    vlc_threadvar_t ring_key;
+    vlc_mutex_t rings_lock; /* protects the rings table */
+    vlc_log_ring_t **rings;
+    int ring_count;
+    vlc_mutex_t drain_lock; /* serializes the consumers of the rings */
+    vlc_sem_t wait;
+    atomic_bool sleeping;
+    atomic_bool stop;
+    vlc_thread_t thread;
 };
 
 static void vlc_vaLogCallback(libvlc_int_t *vlc, int type,
@@ -81,6 +97,8 @@ static void vlc_LogCallback(libvlc_int_t *vlc, int type, const vlc_log_t *item,
 static void Win32DebugOutputMsg (void *, int , const vlc_log_t *,
                                  const char *, va_list);
 #endif
+static bool vlc_LogAsync(vlc_logger_t *, int, const vlc_log_t *,
+                         const char *, va_list);
 
 /**
  * Emit a log message. This function is the variable argument list equivalent
@@ -136,7 +154,13 @@ void vlc_vaLog (vlc_object_t *obj, int type, const char *module,
 
     /* Pass message to the callback */
     if (obj != NULL)
-        vlc_vaLogCallback(obj->p_libvlc, type, &msg, format, args);
+    {
+        vlc_logger_t *logger = libvlc_priv(obj->p_libvlc)->logger;
+
+        if (logger == NULL || !atomic_load(&logger->async)
+         || !vlc_LogAsync(logger, type, &msg, format, args))
+            vlc_vaLogCallback(obj->p_libvlc, type, &msg, format, args);
+    }
 }
 
 /**
@@ -285,6 +309,823 @@ static void vlc_LogEarlyClose(vlc_logger_t *logger, void *d)
     free(sys);
 }
 
+/*** Asynchronous logging ***/
+
+/* Each emitting thread has a ring buffer of binary records: a copy of the
+ * message format and of its arguments, without formatting. The logging thread
+ * drains the rings, then formats and passes the messages to the callback.
+ * A thread only writes its own ring, and the rings are read by one consumer
+ * at a time, so that neither side needs a lock. Messages that do not fit in
+ * the ring are dropped and counted. */
+#define LOG_RING_SIZE   (1 << 16) /* bytes per emitting thread */
+#define LOG_RECORD_MAX  4096      /* bytes per message */
+#define LOG_TEXT_MAX    8192      /* characters per formatted message */
+
+typedef struct
+{
+    uint32_t size; /* of the record with padding, 0 for the end of the ring */
+    int type;
+    mtime_t date;
+    uintptr_t object_id;
+    const char *object_type;
+    const char *file;
+    int line;
+    const char *func;
+    bool has_header;
+    bool formatted; /* the message was formatted by the emitter */
+    /* The module name, the header if any, then the format string and its
+     * arguments, or the formatted message follow. */
+} vlc_log_record_t;
+
+struct vlc_log_ring_t
+{
+    atomic_size_t head; /* written by the emitting thread only */
+    atomic_size_t tail; /* written by the consumer only */
+    atomic_uint dropped;
+    atomic_bool orphan; /* the emitting thread has exited */
+    union
+    {
+        vlc_log_record_t align;
+        uint8_t bytes[LOG_RING_SIZE];
+    } buf;
+};
+
+enum log_length
+{
+    LOG_LEN_NONE, LOG_LEN_HH, LOG_LEN_H, LOG_LEN_L, LOG_LEN_LL, LOG_LEN_J,
+    LOG_LEN_Z, LOG_LEN_T, LOG_LEN_BIG_L,
+};
+
+typedef struct
+{
+    const char *flags;
+    size_t flags_len;
+    const char *width; /* literal width, or "*" */
+    size_t width_len;
+    const char *precision; /* literal precision, "*", or NULL */
+    size_t precision_len;
+    enum log_length length;
+    char conversion;
+} vlc_log_spec_t;
+
+/**
+ * Parses a printf() conversion specification, after its percent sign.
+ * \return the end of the specification, or NULL if it is not supported
+ * (positional and errno arguments, wide characters, output counters...).
+ */
+static const char *vlc_LogParseSpec(const char *p, vlc_log_spec_t *spec)
+{
+    spec->flags = p;
+    p += strspn(p, "-+ #0'");
+    spec->flags_len = p - spec->flags;
+
+    spec->width = p;
+    if (*p == '*')
+        p++;
+    else
+        p += strspn(p, "0123456789");
+    spec->width_len = p - spec->width;
+    if (*p == '$')
+        return NULL;
+
+    spec->precision = NULL;
+    spec->precision_len = 0;
+    if (*p == '.')
+    {
+        spec->precision = ++p;
+        if (*p == '*')
+            p++;
+        else
+            p += strspn(p, "0123456789");
+        spec->precision_len = p - spec->precision;
+    }
+
+    switch (*p)
+    {
+        case 'h':
+            spec->length = (p[1] == 'h') ? LOG_LEN_HH : LOG_LEN_H;
+            p += (p[1] == 'h') ? 2 : 1;
+            break;
+        case 'l':
+            spec->length = (p[1] == 'l') ? LOG_LEN_LL : LOG_LEN_L;
+            p += (p[1] == 'l') ? 2 : 1;
+            break;
+        case 'q':
+            spec->length = LOG_LEN_LL;
+            p++;
+            break;
+        case 'j':
+            spec->length = LOG_LEN_J;
+            p++;
+            break;
+        case 'z':
+            spec->length = LOG_LEN_Z;
+            p++;
+            break;
+        case 't':
+            spec->length = LOG_LEN_T;
+            p++;
+            break;
+        case 'L':
+            spec->length = LOG_LEN_BIG_L;
+            p++;
+            break;
+        default:
+            spec->length = LOG_LEN_NONE;
+    }
+
+    spec->conversion = *p;
+    switch (*p)
+    {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+            if (spec->length == LOG_LEN_BIG_L)
+                return NULL;
+            break;
+        case 'c': case 's':
+            if (spec->length != LOG_LEN_NONE)
+                return NULL; /* wide characters */
+            break;
+        case 'p': case '%':
+            break;
+        case 'e': case 'E': case 'f': case 'F':
+        case 'g': case 'G': case 'a': case 'A':
+            break;
+        default:
+            return NULL;
+    }
+    return p + 1;
+}
+
+typedef struct
+{
+    uint8_t *p;
+    uint8_t *end;
+} vlc_log_writer_t;
+
+static bool vlc_LogPut(vlc_log_writer_t *w, const void *data, size_t len)
+{
+    if ((size_t)(w->end - w->p) < len)
+        return false;
+    memcpy(w->p, data, len);
+    w->p += len;
+    return true;
+}
+
+/* Strings are truncated to the room left in the record. */
+static bool vlc_LogPutString(vlc_log_writer_t *w, const char *str, size_t len)
+{
+    uint32_t n = (str != NULL) ? len : UINT32_MAX;
+    size_t room = w->end - w->p;
+
+    if (room < sizeof (n) + 1)
+        return false;
+    room -= sizeof (n) + 1;
+    if (str != NULL && n > room)
+        n = room;
+    vlc_LogPut(w, &n, sizeof (n));
+    if (str != NULL)
+    {
+        vlc_LogPut(w, str, n);
+        *(w->p++) = '\0';
+    }
+    return true;
+}
+
+/**
+ * Copies the arguments of a format string in a record.
+ * \return false if the format is not supported or does not fit.
+ */
+static bool vlc_LogPutArgs(vlc_log_writer_t *w, const char *format,
+                           va_list ap)
+{
+    vlc_log_spec_t spec;
+
+    while ((format = strchr(format, '%')) != NULL)
+    {
+        format = vlc_LogParseSpec(format + 1, &spec);
+        if (format == NULL)
+            return false;
+
+        int precision = -1;
+
+        if (spec.width_len == 1 && spec.width[0] == '*')
+        {
+            int width = va_arg(ap, int);
+            if (!vlc_LogPut(w, &width, sizeof (width)))
+                return false;
+        }
+        if (spec.precision_len == 1 && spec.precision[0] == '*')
+        {
+            precision = va_arg(ap, int);
+            if (!vlc_LogPut(w, &precision, sizeof (precision)))
+                return false;
+        }
+        else if (spec.precision != NULL)
+            precision = atoi(spec.precision);
+
+        bool ok = true;
+
+        switch (spec.conversion)
+        {
+            case 'd': case 'i':
+            {
+                intmax_t v;
+
+                switch (spec.length)
+                {
+                    case LOG_LEN_HH: v = (signed char)va_arg(ap, int); break;
+                    case LOG_LEN_H:  v = (short)va_arg(ap, int); break;
+                    case LOG_LEN_L:  v = va_arg(ap, long); break;
+                    case LOG_LEN_LL: v = va_arg(ap, long long); break;
+                    case LOG_LEN_J:  v = va_arg(ap, intmax_t); break;
+                    case LOG_LEN_Z:  v = va_arg(ap, ssize_t); break;
+                    case LOG_LEN_T:  v = va_arg(ap, ptrdiff_t); break;
+                    default:         v = va_arg(ap, int); break;
+                }
+                ok = vlc_LogPut(w, &v, sizeof (v));
+                break;
+            }
+            case 'o': case 'u': case 'x': case 'X':
+            {
+                uintmax_t v;
+
+                switch (spec.length)
+                {
+                    case LOG_LEN_HH:
+                        v = (unsigned char)va_arg(ap, unsigned); break;
+                    case LOG_LEN_H:
+                        v = (unsigned short)va_arg(ap, unsigned); break;
+                    case LOG_LEN_L:  v = va_arg(ap, unsigned long); break;
+                    case LOG_LEN_LL: v = va_arg(ap, unsigned long long); break;
+                    case LOG_LEN_J:  v = va_arg(ap, uintmax_t); break;
+                    case LOG_LEN_Z:  v = va_arg(ap, size_t); break;
+                    case LOG_LEN_T:  v = (size_t)va_arg(ap, ptrdiff_t); break;
+                    default:         v = va_arg(ap, unsigned); break;
+                }
+                ok = vlc_LogPut(w, &v, sizeof (v));
+                break;
+            }
+            case 'c':
+            {
+                int v = va_arg(ap, int);
+                ok = vlc_LogPut(w, &v, sizeof (v));
+                break;
+            }
+            case 's':
+            {
+                /* With a precision, the string need not be nul-terminated */
+                const char *v = va_arg(ap, const char *);
+                size_t len = 0;
+
+                if (v != NULL)
+                    len = (precision >= 0) ? strnlen(v, precision)
+                                           : strlen(v);
+                ok = vlc_LogPutString(w, v, len);
+                break;
+            }
+            case 'p':
+            {
+                void *v = va_arg(ap, void *);
+                ok = vlc_LogPut(w, &v, sizeof (v));
+                break;
+            }
+            case '%':
+                break;
+            default:
+                if (spec.length == LOG_LEN_BIG_L)
+                {
+                    long double v = va_arg(ap, long double);
+                    ok = vlc_LogPut(w, &v, sizeof (v));
+                }
+                else
+                {
+                    double v = va_arg(ap, double);
+                    ok = vlc_LogPut(w, &v, sizeof (v));
+                }
+        }
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+typedef struct
+{
+    const uint8_t *p;
+} vlc_log_reader_t;
+
+static void vlc_LogGet(vlc_log_reader_t *r, void *data, size_t len)
+{
+    memcpy(data, r->p, len);
+    r->p += len;
+}
+
+static const char *vlc_LogGetString(vlc_log_reader_t *r)
+{
+    uint32_t n;
+    const char *str;
+
+    vlc_LogGet(r, &n, sizeof (n));
+    if (n == UINT32_MAX)
+        return NULL;
+    str = (const char *)r->p;
+    r->p += n + 1;
+    return str;
+}
+
+/**
+ * Formats a message from its format string and recorded arguments.
+ */
+static void vlc_LogFormat(char *buf, size_t size, const char *format,
+                          vlc_log_reader_t *r)
+{
+    char *out = buf, *end = buf + size - 1;
+    vlc_log_spec_t spec;
+
+    while (*format && out < end)
+    {
+        const char *pct = strchr(format, '%');
+        size_t len = (pct != NULL) ? (size_t)(pct - format) : strlen(format);
+
+        if (len > (size_t)(end - out))
+            len = end - out;
+        memcpy(out, format, len);
+        out += len;
+        if (pct == NULL || out >= end)
+            break;
+
+        format = vlc_LogParseSpec(pct + 1, &spec);
+        assert(format != NULL); /* checked when recording */
+
+        /* Rebuild the specification with the recorded width and precision,
+         * and the length of the recorded arguments. */
+        char fmt[64], *f = fmt;
+        int width = 0, precision = -1;
+
+        *(f++) = '%';
+        memcpy(f, spec.flags, __MIN(spec.flags_len, 8));
+        f += __MIN(spec.flags_len, 8);
+        if (spec.width_len == 1 && spec.width[0] == '*')
+        {
+            vlc_LogGet(r, &width, sizeof (width));
+            f += sprintf(f, "%d", width);
+        }
+        else
+        {
+            memcpy(f, spec.width, __MIN(spec.width_len, 10));
+            f += __MIN(spec.width_len, 10);
+        }
+        if (spec.precision_len == 1 && spec.precision[0] == '*')
+        {
+            vlc_LogGet(r, &precision, sizeof (precision));
+            if (precision >= 0)
+                f += sprintf(f, ".%d", precision);
+        }
+        else if (spec.precision != NULL)
+        {
+            *(f++) = '.';
+            memcpy(f, spec.precision, __MIN(spec.precision_len, 10));
+            f += __MIN(spec.precision_len, 10);
+        }
+
+        int n = 0;
+        size_t room = end - out + 1;
+
+        switch (spec.conversion)
+        {
+            case 'd': case 'i':
+            {
+                intmax_t v;
+
+                vlc_LogGet(r, &v, sizeof (v));
+                strcpy(f, (char[]){ 'j', spec.conversion, '\0' });
+                n = snprintf(out, room, fmt, v);
+                break;
+            }
+            case 'o': case 'u': case 'x': case 'X':
+            {
+                uintmax_t v;
+
+                vlc_LogGet(r, &v, sizeof (v));
+                strcpy(f, (char[]){ 'j', spec.conversion, '\0' });
+                n = snprintf(out, room, fmt, v);
+                break;
+            }
+            case 'c':
+            {
+                int v;
+
+                vlc_LogGet(r, &v, sizeof (v));
+                strcpy(f, "c");
+                n = snprintf(out, room, fmt, v);
+                break;
+            }
+            case 's':
+            {
+                const char *v = vlc_LogGetString(r);
+
+                strcpy(f, "s");
+                n = snprintf(out, room, fmt, (v != NULL) ? v : "(null)");
+                break;
+            }
+            case 'p':
+            {
+                void *v;
+
+                vlc_LogGet(r, &v, sizeof (v));
+                strcpy(f, "p");
+                n = snprintf(out, room, fmt, v);
+                break;
+            }
+            case '%':
+                *out = '%';
+                n = 1;
+                break;
+            default:
+                if (spec.length == LOG_LEN_BIG_L)
+                {
+                    long double v;
+
+                    vlc_LogGet(r, &v, sizeof (v));
+                    strcpy(f, (char[]){ 'L', spec.conversion, '\0' });
+                    n = snprintf(out, room, fmt, v);
+                }
+                else
+                {
+                    double v;
+
+                    vlc_LogGet(r, &v, sizeof (v));
+                    strcpy(f, (char[]){ spec.conversion, '\0' });
+                    n = snprintf(out, room, fmt, v);
+                }
+        }
+        if (n > 0)
+            out += __MIN((size_t)n, room - 1);
+    }
+    *out = '\0';
+}
+
+static void vlc_LogRingOrphan(void *data)
+{
+    vlc_log_ring_t *ring = data;
+
+    atomic_store(&ring->orphan, true);
+}
+
+static vlc_log_ring_t *vlc_LogRingGet(vlc_logger_t *logger)
+{
+    vlc_log_ring_t *ring = vlc_threadvar_get(logger->ring_key);
+    if (likely(ring != NULL))
+        return ring;
+
+    ring = malloc(sizeof (*ring));
+    if (unlikely(ring == NULL))
+        return NULL;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->orphan, false);
+
+    vlc_mutex_lock(&logger->rings_lock);
+    TAB_APPEND(logger->ring_count, logger->rings, ring);
+    vlc_mutex_unlock(&logger->rings_lock);
+
+    if (vlc_threadvar_set(logger->ring_key, ring))
+    {   /* The logging thread will free it */
+        atomic_store(&ring->orphan, true);
+        return NULL;
+    }
+    return ring;
+}
+
+/**
+ * Records a message in the ring of the calling thread.
+ * \return false if the message could not be recorded nor dropped
+ * (it should then be passed synchronously to the callback).
+ */
+static bool vlc_LogAsync(vlc_logger_t *logger, int type,
+                         const vlc_log_t *meta, const char *format,
+                         va_list args)
+{
+    vlc_log_ring_t *ring = vlc_LogRingGet(logger);
+    if (unlikely(ring == NULL))
+        return false;
+
+    union
+    {
+        vlc_log_record_t rec;
+        uint8_t bytes[LOG_RECORD_MAX];
+    } buf;
+    vlc_log_record_t *rec = &buf.rec;
+    vlc_log_writer_t w = { buf.bytes + sizeof (*rec), buf.bytes + sizeof (buf) };
+
+    rec->type = type;
+    rec->date = mdate();
+    rec->object_id = meta->i_object_id;
+    rec->object_type = meta->psz_object_type;
+    rec->file = meta->file;
+    rec->line = meta->line;
+    rec->func = meta->func;
+    rec->formatted = false;
+    rec->has_header = meta->psz_header != NULL;
+
+    /* Object headers and module names are not static: copy them. */
+    if (!vlc_LogPut(&w, meta->psz_module, strlen(meta->psz_module) + 1)
+     || (rec->has_header
+      && !vlc_LogPut(&w, meta->psz_header, strlen(meta->psz_header) + 1)))
+        return false;
+
+    /* The format string need not outlive the call either: copy it. */
+    uint8_t *format_start = w.p;
+    va_list ap;
+    bool ok = vlc_LogPut(&w, format, strlen(format) + 1);
+
+    if (ok)
+    {
+        va_copy(ap, args);
+        ok = vlc_LogPutArgs(&w, format, ap);
+        va_end(ap);
+    }
+
+    if (!ok)
+    {   /* Unsupported or too long format: format it here, keeping the
+         * message order */
+        char *msg;
+
+        w.p = format_start;
+        rec->formatted = true;
+        va_copy(ap, args);
+        if (vasprintf(&msg, format, ap) == -1)
+            msg = NULL;
+        va_end(ap);
+        vlc_LogPutString(&w, (msg != NULL) ? msg : "message lost",
+                         (msg != NULL) ? strlen(msg) : 12);
+        free(msg);
+    }
+
+    size_t size = ((w.p - buf.bytes) + 7) & ~(size_t)7;
+    rec->size = size;
+
+    /* Single producer: only this thread writes the head. */
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t offset = head % LOG_RING_SIZE;
+    size_t pad = (LOG_RING_SIZE - offset < size) ? LOG_RING_SIZE - offset : 0;
+
+    if (LOG_RING_SIZE - (head - tail) < pad + size)
+    {
+        atomic_fetch_add(&ring->dropped, 1);
+        return true;
+    }
+
+    if (pad > 0)
+    {   /* The record does not fit before the end: wrap */
+        ((vlc_log_record_t *)(ring->buf.bytes + offset))->size = 0;
+        offset = 0;
+    }
+    memcpy(ring->buf.bytes + offset, buf.bytes, size);
+    atomic_store(&ring->head, head + pad + size);
+
+    if (atomic_load(&logger->sleeping)
+     && atomic_exchange(&logger->sleeping, false))
+        vlc_sem_post(&logger->wait);
+    return true;
+}
+
+/* Returns the oldest record of a ring, up to the given head, or NULL. */
+static vlc_log_record_t *vlc_LogRingPeek(vlc_log_ring_t *ring, size_t head)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (tail == head)
+        return NULL;
+
+    vlc_log_record_t *rec =
+        (vlc_log_record_t *)(ring->buf.bytes + tail % LOG_RING_SIZE);
+    if (rec->size == 0)
+    {   /* Skip the end of the ring */
+        tail += LOG_RING_SIZE - tail % LOG_RING_SIZE;
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        if (tail == head)
+            return NULL;
+        rec = &ring->buf.align;
+    }
+    return rec;
+}
+
+static void vlc_LogRingPop(vlc_log_ring_t *ring, const vlc_log_record_t *rec)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->tail, tail + rec->size,
+                          memory_order_release);
+}
+
+static void vlc_LogRecordCallback(vlc_logger_t *logger,
+                                  const vlc_log_record_t *rec)
+{
+    vlc_log_reader_t r = { (const uint8_t *)(rec + 1) };
+    vlc_log_t meta;
+    char text[LOG_TEXT_MAX];
+
+    meta.i_object_id = rec->object_id;
+    meta.psz_object_type = rec->object_type;
+    meta.psz_module = (const char *)r.p;
+    r.p += strlen(meta.psz_module) + 1;
+    meta.psz_header = NULL;
+    if (rec->has_header)
+    {
+        meta.psz_header = (const char *)r.p;
+        r.p += strlen(meta.psz_header) + 1;
+    }
+    meta.file = rec->file;
+    meta.line = rec->line;
+    meta.func = rec->func;
+
+    if (!rec->formatted)
+    {
+        const char *format = (const char *)r.p;
+
+        r.p += strlen(format) + 1;
+        vlc_LogFormat(text, sizeof (text), format, &r);
+    }
+    else
+    {
+        const char *msg = vlc_LogGetString(&r);
+
+        strlcpy(text, msg, sizeof (text));
+    }
+    vlc_LogCallback(logger->p_libvlc, rec->type, &meta, "%s", text);
+}
+
+/**
+ * Passes the recorded messages to the callback, in emission order.
+ * The drain lock must be held.
+ */
+static void vlc_LogDrain(vlc_logger_t *logger)
+{
+    vlc_log_ring_t **rings;
+    int count;
+
+    vlc_mutex_lock(&logger->rings_lock);
+    count = logger->ring_count;
+    rings = (count > 0) ? malloc(count * sizeof (*rings)) : NULL;
+    if (likely(rings != NULL))
+        memcpy(rings, logger->rings, count * sizeof (*rings));
+    vlc_mutex_unlock(&logger->rings_lock);
+    if (rings == NULL)
+        return;
+
+    /* Only the messages recorded so far are drained, lest emitters keep the
+     * consumer busy forever. Orphan rings are checked before their head, so
+     * that they are known to be complete once drained. */
+    bool orphans[count];
+    size_t heads[count];
+
+    for (int i = 0; i < count; i++)
+    {
+        orphans[i] = atomic_load(&rings[i]->orphan);
+        heads[i] = atomic_load_explicit(&rings[i]->head,
+                                        memory_order_acquire);
+    }
+
+    for (;;)
+    {
+        vlc_log_record_t *oldest = NULL;
+        int index = -1;
+
+        for (int i = 0; i < count; i++)
+        {
+            vlc_log_record_t *rec = vlc_LogRingPeek(rings[i], heads[i]);
+
+            if (rec != NULL && (oldest == NULL || rec->date < oldest->date))
+            {
+                oldest = rec;
+                index = i;
+            }
+        }
+        if (oldest == NULL)
+            break;
+
+        vlc_LogRecordCallback(logger, oldest);
+        vlc_LogRingPop(rings[index], oldest);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        vlc_log_ring_t *ring = rings[i];
+        unsigned dropped = atomic_exchange(&ring->dropped, 0);
+
+        if (dropped > 0)
+        {
+            vlc_log_t meta = {
+                (uintptr_t)logger, "logger", "core", NULL, __FILE__,
+                __LINE__, __func__,
+            };
+            vlc_LogCallback(logger->p_libvlc, VLC_MSG_WARN, &meta,
+                            "%u log messages dropped", dropped);
+        }
+
+        if (orphans[i] && atomic_load(&ring->tail) == heads[i])
+        {
+            vlc_mutex_lock(&logger->rings_lock);
+            TAB_REMOVE(logger->ring_count, logger->rings, ring);
+            vlc_mutex_unlock(&logger->rings_lock);
+            free(ring);
+        }
+    }
+    free(rings);
+}
+
+static bool vlc_LogPending(vlc_logger_t *logger)
+{
+    bool pending = false;
+
+    vlc_mutex_lock(&logger->rings_lock);
+    for (int i = 0; i < logger->ring_count && !pending; i++)
+    {
+        vlc_log_ring_t *ring = logger->rings[i];
+
+        pending = atomic_load(&ring->head) != atomic_load(&ring->tail)
+               || atomic_load(&ring->dropped) > 0
+               || atomic_load(&ring->orphan);
+    }
+    vlc_mutex_unlock(&logger->rings_lock);
+    return pending;
+}
+
+static void *vlc_LogThread(void *data)
+{
+    vlc_logger_t *logger = data;
+
+    for (;;)
+    {
+        vlc_mutex_lock(&logger->drain_lock);
+        vlc_LogDrain(logger);
+        vlc_mutex_unlock(&logger->drain_lock);
+
+        if (atomic_load(&logger->stop))
+            break;
+
+        /* Emitters wake the thread up only if it is about to sleep */
+        atomic_store(&logger->sleeping, true);
+        if (!vlc_LogPending(logger))
+            vlc_sem_wait(&logger->wait);
+    }
+    return NULL;
+}
+
+static void vlc_LogAsyncStart(vlc_logger_t *logger)
+{
+    if (vlc_threadvar_create(&logger->ring_key, vlc_LogRingOrphan))
+        return;
+
+    vlc_mutex_init(&logger->rings_lock);
+    logger->rings = NULL;
+    logger->ring_count = 0;
+    vlc_mutex_init(&logger->drain_lock);
+    vlc_sem_init(&logger->wait, 0);
+    atomic_init(&logger->sleeping, false);
+    atomic_init(&logger->stop, false);
+
+    if (vlc_clone(&logger->thread, vlc_LogThread, logger,
+                  VLC_THREAD_PRIORITY_LOW))
+    {
+        vlc_sem_destroy(&logger->wait);
+        vlc_mutex_destroy(&logger->drain_lock);
+        vlc_mutex_destroy(&logger->rings_lock);
+        vlc_threadvar_delete(&logger->ring_key);
+        return;
+    }
+    atomic_store(&logger->async, true);
+}
+
+static void vlc_LogAsyncStop(vlc_logger_t *logger)
+{
+    if (!atomic_load(&logger->async))
+        return;
+
+    atomic_store(&logger->stop, true);
+    vlc_sem_post(&logger->wait);
+    vlc_join(logger->thread, NULL);
+
+    /* Messages are emitted synchronously from now on */
+    atomic_store(&logger->async, false);
+    vlc_threadvar_delete(&logger->ring_key);
+
+    vlc_mutex_lock(&logger->drain_lock);
+    vlc_LogDrain(logger);
+    vlc_mutex_unlock(&logger->drain_lock);
+
+    for (int i = 0; i < logger->ring_count; i++)
+        free(logger->rings[i]);
+    TAB_CLEAN(logger->ring_count, logger->rings);
+
+    vlc_sem_destroy(&logger->wait);
+    vlc_mutex_destroy(&logger->drain_lock);
+    vlc_mutex_destroy(&logger->rings_lock);
+}
+
 static void vlc_vaLogDiscard(void *d, int type, const vlc_log_t *item,
                              const char *format, va_list ap)
 {
@@ -329,6 +1170,7 @@ int vlc_LogPreinit(libvlc_int_t *vlc)
         return -1;
 
     vlc_rwlock_init(&logger->lock);
+    atomic_init(&logger->async, false);
 
     if (vlc_LogEarlyOpen(logger))
     {
@@ -378,6 +1220,8 @@ int vlc_LogInit(libvlc_int_t *vlc)
     if (early_sys != NULL)
         vlc_LogEarlyClose(logger, early_sys);
 
+    if (var_InheritBool(vlc, "log-async"))
+        vlc_LogAsyncStart(logger);
     return 0;
 }
 
@@ -399,6 +1243,14 @@ void vlc_LogSet(libvlc_int_t *vlc, vlc_log_cb cb, void *opaque)
     if (cb == NULL)
         cb = vlc_vaLogDiscard;
 
+    /* Pending messages go to the previous callback */
+    bool async = atomic_load(&logger->async);
+    if (async)
+    {
+        vlc_mutex_lock(&logger->drain_lock);
+        vlc_LogDrain(logger);
+    }
+
     vlc_rwlock_wrlock(&logger->lock);
     sys = logger->sys;
     module = logger->module;
@@ -408,6 +1260,9 @@ void vlc_LogSet(libvlc_int_t *vlc, vlc_log_cb cb, void *opaque)
     logger->module = NULL;
     vlc_rwlock_unlock(&logger->lock);
 
+    if (async)
+        vlc_mutex_unlock(&logger->drain_lock);
+
     if (module != NULL)
         vlc_module_unload(module, vlc_logger_unload, sys);
 
@@ -425,6 +1280,8 @@ void vlc_LogDeinit(libvlc_int_t *vlc)
     if (unlikely(logger == NULL))
         return;
 
+    vlc_LogAsyncStop(logger);
+
     if (logger->module != NULL)
         vlc_module_unload(logger->module, vlc_logger_unload, logger->sys);
     else
@@ -0,0 +1,252 @@
+/*****************************************************************************
+ * slice.c: worker threads for slice-parallel video filters
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include "libvlc.h"
+
+#define SLICE_MAX_THREADS 64
+
+/* A call to filter_Slice(). It lives on the stack of the calling thread,
+ * which also processes bands, until all bands are done. */
+struct slice_job
+{
+    struct slice_job *next;
+    void (*cb)(void *, unsigned, unsigned);
+    void *opaque;
+    unsigned lines;
+    unsigned band; /* lines per band */
+    unsigned count; /* bands */
+    unsigned taken; /* bands handed out */
+    unsigned done; /* bands completed */
+    vlc_cond_t wait;
+};
+
+/* Serializes instances creation and destruction, so that workers are joined
+ * before new ones may be started. */
+static vlc_mutex_t slice_init_lock = VLC_STATIC_MUTEX;
+
+static struct
+{
+    vlc_mutex_t lock;
+    vlc_cond_t wait; /* signaled when a job is queued or on exit */
+    struct slice_job *first, **lastp; /* jobs with bands left to take */
+
+    unsigned refs; /* libvlc instances */
+    unsigned threads; /* including the calling thread */
+    unsigned running; /* worker threads started */
+    bool exit;
+    vlc_thread_t workers[SLICE_MAX_THREADS - 1];
+} slice_pool = {
+    .lock = VLC_STATIC_MUTEX,
+    .wait = VLC_STATIC_COND,
+    .first = NULL,
+    .lastp = &slice_pool.first,
+    .refs = 0,
+    .threads = 1,
+    .running = 0,
+    .exit = false,
+};
+
+/* Hands the next band out. Lock must be held. */
+static unsigned slice_Take(struct slice_job *job)
+{
+    unsigned band = job->taken++;
+
+    assert(band < job->count);
+    if (job->taken == job->count)
+    {   /* Last band: nothing left to share, dequeue the job */
+        struct slice_job **pp = &slice_pool.first;
+
+        while (*pp != job)
+            pp = &(*pp)->next;
+        *pp = job->next;
+        if (slice_pool.lastp == &job->next)
+            slice_pool.lastp = pp;
+    }
+    return band;
+}
+
+/* Processes a band. Lock must be held, it is released meanwhile. */
+static void slice_Run(struct slice_job *job, unsigned band)
+{
+    unsigned first = band * job->band;
+    unsigned last = first + job->band;
+
+    if (last > job->lines || band == job->count - 1)
+        last = job->lines;
+
+    vlc_mutex_unlock(&slice_pool.lock);
+    job->cb(job->opaque, first, last);
+    vlc_mutex_lock(&slice_pool.lock);
+
+    if (++job->done == job->count)
+        vlc_cond_signal(&job->wait);
+}
+
+static void *slice_Thread(void *data)
+{
+    VLC_UNUSED(data);
+
+    vlc_mutex_lock(&slice_pool.lock);
+    for (;;)
+    {
+        while (slice_pool.first == NULL && !slice_pool.exit)
+            vlc_cond_wait(&slice_pool.wait, &slice_pool.lock);
+        if (slice_pool.exit)
+            break;
+
+        struct slice_job *job = slice_pool.first;
+        slice_Run(job, slice_Take(job));
+    }
+    vlc_mutex_unlock(&slice_pool.lock);
+    return NULL;
+}
+
+/**
+ * Starts the worker threads on first use. Lock must be held.
+ */
+static void slice_Start(vlc_object_t *obj)
+{
+    while (slice_pool.running < slice_pool.threads - 1)
+    {
+        vlc_thread_t *th = &slice_pool.workers[slice_pool.running];
+
+        if (vlc_clone(th, slice_Thread, NULL, VLC_THREAD_PRIORITY_VIDEO))
+        {
+            msg_Warn(obj, "cannot start slice worker thread");
+            slice_pool.threads = slice_pool.running + 1;
+            break;
+        }
+        slice_pool.running++;
+    }
+}
+
+void filter_Slice(filter_t *filter, unsigned lines, unsigned grain,
+                  void (*cb)(void *, unsigned, unsigned), void *opaque)
+{
+    if (lines == 0)
+        return;
+    if (grain == 0)
+        grain = 1;
+
+    unsigned bands = (lines + grain - 1) / grain;
+
+    vlc_mutex_lock(&slice_pool.lock);
+    if (bands > slice_pool.threads)
+        bands = slice_pool.threads;
+    if (bands > 1 && slice_pool.running < slice_pool.threads - 1)
+        slice_Start(VLC_OBJECT(filter));
+    if (bands > slice_pool.running + 1)
+        bands = slice_pool.running + 1;
+
+    if (bands <= 1)
+    {
+        vlc_mutex_unlock(&slice_pool.lock);
+        cb(opaque, 0, lines);
+        return;
+    }
+
+    /* Band heights are multiple of the grain, the last one is shorter */
+    unsigned band = (lines + bands - 1) / bands;
+    band += grain - 1;
+    band -= band % grain;
+
+    struct slice_job job = {
+        .next = NULL,
+        .cb = cb,
+        .opaque = opaque,
+        .lines = lines,
+        .band = band,
+        .count = (lines + band - 1) / band,
+        .taken = 0,
+        .done = 0,
+    };
+
+    vlc_cond_init(&job.wait);
+    *slice_pool.lastp = &job;
+    slice_pool.lastp = &job.next;
+    if (job.count > 2)
+        vlc_cond_broadcast(&slice_pool.wait);
+    else
+        vlc_cond_signal(&slice_pool.wait);
+
+    /* Contribute to our own job until all bands are handed out */
+    while (job.taken < job.count)
+        slice_Run(&job, slice_Take(&job));
+
+    int canc = vlc_savecancel();
+    while (job.done < job.count)
+        vlc_cond_wait(&job.wait, &slice_pool.lock);
+    vlc_restorecancel(canc);
+    vlc_mutex_unlock(&slice_pool.lock);
+    vlc_cond_destroy(&job.wait);
+}
+
+void vlc_slice_Init(unsigned threads)
+{
+    if (threads == 0)
+        threads = vlc_GetCPUCount();
+    if (threads > SLICE_MAX_THREADS)
+        threads = SLICE_MAX_THREADS;
+
+    vlc_mutex_lock(&slice_init_lock);
+    vlc_mutex_lock(&slice_pool.lock);
+    if (slice_pool.refs++ == 0)
+    {
+        slice_pool.threads = threads ? threads : 1;
+        slice_pool.exit = false;
+    }
+    vlc_mutex_unlock(&slice_pool.lock);
+    vlc_mutex_unlock(&slice_init_lock);
+}
+
+void vlc_slice_Deinit(void)
+{
+    vlc_mutex_lock(&slice_init_lock);
+    vlc_mutex_lock(&slice_pool.lock);
+    assert(slice_pool.refs > 0);
+    if (--slice_pool.refs > 0)
+    {
+        vlc_mutex_unlock(&slice_pool.lock);
+        vlc_mutex_unlock(&slice_init_lock);
+        return;
+    }
+
+    assert(slice_pool.first == NULL);
+    slice_pool.exit = true;
+    slice_pool.threads = 1; /* no new workers */
+    vlc_cond_broadcast(&slice_pool.wait);
+    vlc_mutex_unlock(&slice_pool.lock);
+
+    for (unsigned i = 0; i < slice_pool.running; i++)
+        vlc_join(slice_pool.workers[i], NULL);
+
+    vlc_mutex_lock(&slice_pool.lock);
+    slice_pool.running = 0;
+    vlc_mutex_unlock(&slice_pool.lock);
+    vlc_mutex_unlock(&slice_init_lock);
+}
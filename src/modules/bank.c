@@ -41,6 +41,7 @@
 #include <vlc_plugin.h>
 #include <vlc_modules.h>
 #include <vlc_fs.h>
+#include <vlc_block.h>
 #include "libvlc.h"
 #include "config/configuration.h"
 #include "modules/modules.h"
@@ -49,8 +50,22 @@ static struct
 {
     vlc_mutex_t lock;
     module_t *head;
+    block_t *caches; /* Plugins caches the modules refer to */
     unsigned usage;
-} modules = { VLC_STATIC_MUTEX, NULL, 0 };
+    /* Lookup tables, rebuilt whenever the bank changes */
+    vlc_modcap_t *caps; /* sorted by capability */
+    size_t cap_count;
+    module_t **by_cap; /* modules of all capabilities, see caps */
+    struct module_shortcut *shortcuts; /* open addressing hash table */
+    size_t shortcut_mask;
+} modules = { VLC_STATIC_MUTEX, NULL, NULL, 0, NULL, 0, NULL, NULL, 0 };
+
+struct module_shortcut
+{
+    const char *name;
+    module_t *module;
+    bool primary; /* first shortcut, i.e. name of the module */
+};
 
 /*****************************************************************************
  * Local prototypes
@@ -67,6 +82,135 @@ static void module_StoreBank (module_t *module)
     modules.head = module;
 }
 
+static size_t module_HashName (const char *name)
+{
+    size_t h = 2166136261u; /* FNV-1a */
+
+    while (*name)
+        h = (h ^ (unsigned char)*(name++)) * 16777619u;
+    return h;
+}
+
+struct module_rank
+{
+    module_t *module;
+    size_t seq; /* position in the bank, to keep the sort stable */
+};
+
+static int module_RankCmp (const void *a, const void *b)
+{
+    const struct module_rank *ra = a, *rb = b;
+    int ret = strcmp (module_get_capability (ra->module),
+                      module_get_capability (rb->module));
+    if (ret)
+        return ret;
+    /* Highest score first */
+    if (ra->module->i_score != rb->module->i_score)
+        return (ra->module->i_score > rb->module->i_score) ? -1 : 1;
+    return (ra->seq > rb->seq) - (ra->seq < rb->seq);
+}
+
+static void module_FreeIndex (vlc_modcap_t *caps, module_t **by_cap,
+                              struct module_shortcut *shortcuts)
+{
+    free (shortcuts);
+    free (by_cap);
+    free (caps);
+}
+
+/**
+ * Builds the lookup tables of the bank: the modules of each capability
+ * sorted by decreasing score, and the hash table of the shortcuts.
+ * The bank lock must be held, and the bank must not be in use.
+ */
+static void module_BuildIndex (void)
+{
+    /*vlc_assert_locked (&modules.lock);*/
+    module_FreeIndex (modules.caps, modules.by_cap, modules.shortcuts);
+    modules.caps = NULL;
+    modules.cap_count = 0;
+    modules.by_cap = NULL;
+    modules.shortcuts = NULL;
+    modules.shortcut_mask = 0;
+
+    size_t count;
+    module_t **list = module_list_get (&count);
+    if (count == 0)
+    {
+        module_list_free (list);
+        return;
+    }
+
+    size_t nshortcuts = 0, size = 16;
+    for (size_t i = 0; i < count; i++)
+        nshortcuts += list[i]->i_shortcuts;
+    while (size < 2 * nshortcuts)
+        size *= 2;
+
+    struct module_rank *ranks = malloc (count * sizeof (*ranks));
+    vlc_modcap_t *caps = malloc (count * sizeof (*caps));
+    module_t **by_cap = malloc (count * sizeof (*by_cap));
+    struct module_shortcut *shortcuts = calloc (size, sizeof (*shortcuts));
+    if (unlikely(ranks == NULL || caps == NULL || by_cap == NULL
+              || shortcuts == NULL))
+    {
+        module_FreeIndex (caps, by_cap, shortcuts);
+        free (ranks);
+        module_list_free (list);
+        return;
+    }
+
+    /* Shortcuts are inserted in bank order, so that the lookup returns the
+     * first matching module as the linear scan would. */
+    for (size_t i = 0; i < count; i++)
+    {
+        module_t *module = list[i];
+
+        for (unsigned j = 0; j < module->i_shortcuts; j++)
+        {
+            const char *name = module->pp_shortcuts[j];
+            size_t h = module_HashName (name) & (size - 1);
+
+            while (shortcuts[h].name != NULL)
+                h = (h + 1) & (size - 1);
+            shortcuts[h].name = name;
+            shortcuts[h].module = module;
+            shortcuts[h].primary = j == 0;
+        }
+        ranks[i].module = module;
+        ranks[i].seq = i;
+    }
+    module_list_free (list);
+
+    qsort (ranks, count, sizeof (*ranks), module_RankCmp);
+
+    size_t ncaps = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const char *cap = module_get_capability (ranks[i].module);
+
+        by_cap[i] = ranks[i].module;
+        if (ncaps == 0 || strcmp (caps[ncaps - 1].name, cap))
+        {
+            vlc_modcap_t *c = &caps[ncaps++];
+
+            c->name = cap;
+            c->modules = by_cap + i;
+            c->count = 0;
+            atomic_init (&c->failures, 0);
+            atomic_init (&c->failed_time, 0);
+        }
+        caps[ncaps - 1].count++;
+    }
+    free (ranks);
+
+    modules.caps = caps;
+    modules.cap_count = ncaps;
+    modules.by_cap = by_cap;
+    modules.shortcuts = shortcuts;
+    modules.shortcut_mask = size - 1;
+}
+
 #if defined(__ELF__) || !HAVE_DYNAMIC_PLUGINS
 # ifdef __GNUC__
 __attribute__((weak))
@@ -111,6 +255,7 @@ void module_InitBank (void)
         if (likely(module != NULL))
             module_StoreBank (module);
         config_SortConfig ();
+        module_BuildIndex ();
     }
     modules.usage++;
 
@@ -131,6 +276,10 @@ void module_InitBank (void)
 void module_EndBank (bool b_plugins)
 {
     module_t *head = NULL;
+    block_t *caches = NULL;
+    vlc_modcap_t *caps = NULL;
+    module_t **by_cap = NULL;
+    struct module_shortcut *shortcuts = NULL;
 
     /* If plugins were _not_ loaded, then the caller still has the bank lock
      * from module_InitBank(). */
@@ -145,9 +294,21 @@ void module_EndBank (bool b_plugins)
         config_UnsortConfig ();
         head = modules.head;
         modules.head = NULL;
+        caches = modules.caches;
+        modules.caches = NULL;
+        caps = modules.caps;
+        modules.caps = NULL;
+        modules.cap_count = 0;
+        by_cap = modules.by_cap;
+        modules.by_cap = NULL;
+        shortcuts = modules.shortcuts;
+        modules.shortcuts = NULL;
+        modules.shortcut_mask = 0;
     }
     vlc_mutex_unlock (&modules.lock);
 
+    module_FreeIndex (caps, by_cap, shortcuts);
+
     while (head != NULL)
     {
         module_t *module = head;
@@ -162,6 +323,7 @@ void module_EndBank (bool b_plugins)
 #endif
         vlc_module_destroy (module);
     }
+    block_ChainRelease (caches);
 }
 
 #undef module_LoadPlugins
@@ -185,6 +347,7 @@ size_t module_LoadPlugins (vlc_object_t *obj)
 #endif
         config_UnsortConfig ();
         config_SortConfig ();
+        module_BuildIndex ();
     }
     vlc_mutex_unlock (&modules.lock);
 
@@ -239,12 +402,23 @@ module_t **module_list_get (size_t *n)
     return tab;
 }
 
-static int modulecmp (const void *a, const void *b)
+static int modcapcmp (const void *key, const void *elem)
 {
-    const module_t *const *ma = a, *const *mb = b;
-    /* Note that qsort() uses _ascending_ order,
-     * so the smallest module is the one with the biggest score. */
-    return (*mb)->i_score - (*ma)->i_score;
+    const vlc_modcap_t *cap = elem;
+    return strcmp (key, cap->name);
+}
+
+/**
+ * Finds the modules with a given capability in the bank index.
+ * @param cap capability of modules to look for
+ * @return the capability entry, or NULL if no modules provide it.
+ */
+vlc_modcap_t *module_cap_find (const char *cap)
+{
+    if (modules.cap_count == 0)
+        return NULL;
+    return bsearch (cap, modules.caps, modules.cap_count,
+                    sizeof (*modules.caps), modcapcmp);
 }
 
 /**
@@ -257,37 +431,42 @@ static int modulecmp (const void *a, const void *b)
  */
 ssize_t module_list_cap (module_t ***restrict list, const char *cap)
 {
-    /* TODO: This is quite inefficient. List should be sorted by capability. */
-    ssize_t n = 0;
-
     assert (list != NULL);
 
-    for (module_t *mod = modules.head; mod != NULL; mod = mod->next)
-    {
-         if (module_provides (mod, cap))
-             n++;
-         for (module_t *subm = mod->submodule; subm != NULL; subm = subm->next)
-             if (module_provides (subm, cap))
-                 n++;
-    }
-
+    const vlc_modcap_t *c = module_cap_find (cap);
+    size_t n = (c != NULL) ? c->count : 0;
     module_t **tab = malloc (sizeof (*tab) * n);
+
     *list = tab;
-    if (unlikely(tab == NULL))
+    if (unlikely(tab == NULL && n > 0))
         return -1;
+    if (n > 0)
+        memcpy (tab, c->modules, sizeof (*tab) * n);
+    return n;
+}
+
+/**
+ * Looks a module up by shortcut in the bank index.
+ * @param name shortcut to look for (case-sensitive)
+ * @param primary whether only the first shortcut of modules is matched
+ * @return the first matching module in the bank, or NULL if none.
+ */
+module_t *module_lookup (const char *name, bool primary)
+{
+    if (modules.shortcuts == NULL)
+        return NULL;
+
+    const size_t mask = modules.shortcut_mask;
 
-    for (module_t *mod = modules.head; mod != NULL; mod = mod->next)
+    for (size_t h = module_HashName (name) & mask;
+         modules.shortcuts[h].name != NULL; h = (h + 1) & mask)
     {
-         if (module_provides (mod, cap))
-             *(tab++)= mod;
-         for (module_t *subm = mod->submodule; subm != NULL; subm = subm->next)
-             if (module_provides (subm, cap))
-                 *(tab++) = subm;
-    }
+        const struct module_shortcut *s = &modules.shortcuts[h];
 
-    assert (tab == *list + n);
-    qsort (*list, n, sizeof (*tab), modulecmp);
-    return n;
+        if ((s->primary || !primary) && !strcmp (s->name, name))
+            return s->module;
+    }
+    return NULL;
 }
 
 #ifdef HAVE_DYNAMIC_PLUGINS
@@ -359,6 +538,7 @@ typedef struct module_bank
 
     int            i_loaded_cache;
     module_cache_t *loaded_cache;
+    block_t        *loaded_map;
 } module_bank_t;
 
 static void AllocatePluginDir (module_bank_t *, unsigned,
@@ -373,12 +553,13 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
 {
     module_bank_t bank;
     module_cache_t *cache = NULL;
+    block_t *map = NULL;
     size_t count = 0;
 
     switch( mode )
     {
         case CACHE_USE:
-            count = CacheLoad( p_this, path, &cache );
+            count = CacheLoad( p_this, path, &cache, &map );
             break;
         case CACHE_RESET:
             CacheDelete( p_this, path );
@@ -396,6 +577,7 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
     bank.i_cache = 0;
     bank.loaded_cache = cache;
     bank.i_loaded_cache = count;
+    bank.loaded_map = map;
 
     /* Don't go deeper than 5 subdirectories */
     AllocatePluginDir (&bank, 5, path, NULL);
@@ -403,14 +585,11 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
     switch( mode )
     {
         case CACHE_USE:
-            /* Discard unmatched cache entries */
-            for( size_t i = 0; i < count; i++ )
-            {
-                if (cache[i].p_module != NULL)
-                   vlc_module_destroy (cache[i].p_module);
-                free (cache[i].path);
-            }
+            /* Unmatched cache entries were never turned into modules, but
+             * the matched ones refer to the cache until the bank ends */
             free( cache );
+            if( map != NULL )
+                block_ChainAppend( &modules.caches, map );
             break;
         case CACHE_RESET:
             CacheSave (p_this, path, bank.cache, bank.i_cache);
@@ -511,8 +690,8 @@ static int AllocatePluginFile (module_bank_t *bank, const char *abspath,
     /* Check our plugins cache first then load plugin if needed */
     if (bank->mode == CACHE_USE)
     {
-        module = CacheFind (bank->loaded_cache, bank->i_loaded_cache,
-                            relpath, st);
+        module = CacheFind (bank->loaded_map, bank->loaded_cache,
+                            bank->i_loaded_cache, relpath, st);
         if (module != NULL)
         {
             module->psz_filename = strdup (abspath);
@@ -45,6 +45,7 @@
 #include "config/configuration.h"
 
 #include <vlc_fs.h>
+#include <vlc_block.h>
 
 #include "modules/modules.h"
 
@@ -55,7 +56,7 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 23
+#define CACHE_SUBVERSION_NUM 24
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
@@ -76,208 +77,305 @@ void CacheDelete( vlc_object_t *obj, const char *dir )
     free( path );
 }
 
-#define LOAD_IMMEDIATE(a) \
-    if (fread (&(a), sizeof (char), sizeof (a), file) != sizeof (a)) \
-        goto error
-#define LOAD_FLAG(a) \
-    do { \
-        unsigned char b; \
-        LOAD_IMMEDIATE(b); \
-        if (b > 1) \
-            goto error; \
-        (a) = b; \
-    } while (0)
-
-static int CacheLoadString (char **p, FILE *file)
+/*
+ * The cache is used in place, from a private file mapping where possible
+ * (see block_File()): strings and integer tables are referenced directly,
+ * and all references are offsets from the start of the file. A plugin is
+ * only turned into a module_t once its file is found, by CacheFind().
+ *
+ * This is not lazy loading: every plugin still present is turned into a
+ * module_t at startup, since the module lists, the capability index and the
+ * configuration all need them. What the in-place format saves is the
+ * parsing and the per-string allocations.
+ *
+ * The file starts with the version strings and the sub-version number,
+ * followed by the header, then by 8-bytes aligned records. The last byte of
+ * the file is nul, so that any string offset is properly terminated.
+ */
+typedef struct
+{
+    uint32_t size;         /* Size of the whole file */
+    uint32_t plugins;      /* Offset of the plugin records */
+    uint32_t plugin_count;
+    uint32_t padding;
+} cache_header_t;
+
+typedef struct
+{
+    uint32_t path;         /* Path relative to the plugins directory */
+    uint32_t domain;
+    int64_t  mtime;
+    int64_t  size;
+    uint32_t modules;      /* The plugin module, then the submodules */
+    uint32_t module_count;
+    uint32_t config;
+    uint32_t confsize;
+    uint32_t config_items;
+    uint32_t bool_items;
+    uint32_t pointers;     /* Size of the shortcuts and choices tables */
+    uint8_t  unloadable;
+    uint8_t  padding[3];
+} cache_plugin_t;
+
+typedef struct
+{
+    uint32_t shortname;
+    uint32_t longname;
+    uint32_t help;
+    uint32_t capability;
+    int32_t  score;
+    uint32_t shortcuts;    /* Table of string offsets */
+    uint32_t shortcut_count;
+    uint32_t padding;
+} cache_module_t;
+
+typedef union
+{
+    int64_t  i;
+    float    f;
+    uint32_t psz;
+} cache_value_t;
+
+#define CACHE_CONFIG_ADVANCED   0x01
+#define CACHE_CONFIG_INTERNAL   0x02
+#define CACHE_CONFIG_UNSAVEABLE 0x04
+#define CACHE_CONFIG_SAFE       0x08
+#define CACHE_CONFIG_REMOVED    0x10
+
+typedef struct
+{
+    uint8_t  type;
+    char     i_short;
+    uint8_t  flags;
+    uint8_t  padding;
+    uint32_t psz_type;
+    uint32_t name;
+    uint32_t text;
+    uint32_t longtext;
+    uint32_t list_count;
+    uint32_t list;         /* Table of int values or of string offsets */
+    uint32_t list_text;    /* Table of string offsets */
+    cache_value_t orig;
+    cache_value_t min;
+    cache_value_t max;
+    uint64_t list_cb;      /* XXX: see CacheLoadConfig() */
+} cache_config_t;
+
+static size_t CachePrefixSize (void)
+{
+    size_t size = sizeof (CACHE_STRING) - 1 + 2 * sizeof (uint32_t);
+#ifdef DISTRO_VERSION
+    size += sizeof (DISTRO_VERSION) - 1;
+#endif
+    return (size + 7) & ~(size_t)7;
+}
+
+typedef struct
 {
-    char *psz = NULL;
-    uint16_t size;
+    const block_t *map;
+    char         **pointers; /* Free entries of the pointers table */
+    size_t         pointer_count;
+    bool           error;
+} cache_loader_t;
 
-    LOAD_IMMEDIATE (size);
-    if (size > 16384)
+static char *CacheString (cache_loader_t *loader, uint32_t offset)
+{
+    if (offset == 0)
+        return NULL;
+    if (offset >= loader->map->i_buffer)
     {
-error:
-        return -1;
+        loader->error = true;
+        return NULL;
     }
+    /* The file ends with a nul byte */
+    return (char *)loader->map->p_buffer + offset;
+}
 
-    if (size > 0)
+static const void *CacheTable (cache_loader_t *loader, uint32_t offset,
+                               size_t count, size_t size)
+{
+    if (count == 0)
+        return NULL;
+    if ((offset & 7) || offset >= loader->map->i_buffer
+     || count > (loader->map->i_buffer - offset) / size)
     {
-        psz = malloc (size+1);
-        if (unlikely(psz == NULL))
-            goto error;
-        if (fread (psz, 1, size, file) != size)
-        {
-            free (psz);
-            goto error;
-        }
-        psz[size] = '\0';
+        loader->error = true;
+        return NULL;
     }
-    *p = psz;
-    return 0;
+    return loader->map->p_buffer + offset;
 }
 
-#define LOAD_STRING(a) \
-    if (CacheLoadString (&(a), file)) goto error
+static char **CacheStrings (cache_loader_t *loader, uint32_t offset,
+                            size_t count)
+{
+    if (count == 0)
+        return NULL;
+
+    const uint32_t *offsets = CacheTable (loader, offset, count,
+                                          sizeof (*offsets));
+    if (offsets == NULL || count > loader->pointer_count)
+    {
+        loader->error = true;
+        return NULL;
+    }
+
+    char **tab = loader->pointers;
+    for (size_t i = 0; i < count; i++)
+        tab[i] = CacheString (loader, offsets[i]);
+    loader->pointers += count;
+    loader->pointer_count -= count;
+    return tab;
+}
 
-static int CacheLoadConfig (module_config_t *cfg, FILE *file)
+static void CacheLoadConfig (cache_loader_t *loader, module_config_t *cfg,
+                             const cache_config_t *rec)
 {
-    LOAD_IMMEDIATE (cfg->i_type);
-    LOAD_IMMEDIATE (cfg->i_short);
-    LOAD_FLAG (cfg->b_advanced);
-    LOAD_FLAG (cfg->b_internal);
-    LOAD_FLAG (cfg->b_unsaveable);
-    LOAD_FLAG (cfg->b_safe);
-    LOAD_FLAG (cfg->b_removed);
-    LOAD_STRING (cfg->psz_type);
-    LOAD_STRING (cfg->psz_name);
-    LOAD_STRING (cfg->psz_text);
-    LOAD_STRING (cfg->psz_longtext);
-    LOAD_IMMEDIATE (cfg->list_count);
+    cfg->i_type = rec->type;
+    cfg->i_short = rec->i_short;
+    cfg->b_advanced = (rec->flags & CACHE_CONFIG_ADVANCED) != 0;
+    cfg->b_internal = (rec->flags & CACHE_CONFIG_INTERNAL) != 0;
+    cfg->b_unsaveable = (rec->flags & CACHE_CONFIG_UNSAVEABLE) != 0;
+    cfg->b_safe = (rec->flags & CACHE_CONFIG_SAFE) != 0;
+    cfg->b_removed = (rec->flags & CACHE_CONFIG_REMOVED) != 0;
+    cfg->psz_type = CacheString (loader, rec->psz_type);
+    cfg->psz_name = CacheString (loader, rec->name);
+    cfg->psz_text = CacheString (loader, rec->text);
+    cfg->psz_longtext = CacheString (loader, rec->longtext);
+    cfg->list_count = rec->list_count;
 
     if (IsConfigStringType (cfg->i_type))
     {
-        LOAD_STRING (cfg->orig.psz);
+        /* Only the current value is ever changed */
+        cfg->orig.psz = CacheString (loader, rec->orig.psz);
         if (cfg->orig.psz != NULL)
+        {
             cfg->value.psz = strdup (cfg->orig.psz);
+            if (unlikely(cfg->value.psz == NULL))
+                loader->error = true;
+        }
         else
             cfg->value.psz = NULL;
 
         if (cfg->list_count)
-            cfg->list.psz = xmalloc (cfg->list_count * sizeof (char *));
+            cfg->list.psz = CacheStrings (loader, rec->list, cfg->list_count);
         else /* TODO: fix config_GetPszChoices() instead of this hack: */
-            LOAD_IMMEDIATE(cfg->list.psz_cb);
-        for (unsigned i = 0; i < cfg->list_count; i++)
-        {
-            LOAD_STRING (cfg->list.psz[i]);
-            if (cfg->list.psz[i] == NULL /* NULL -> empty string */
-             && (cfg->list.psz[i] = calloc (1, 1)) == NULL)
-                goto error;
-        }
+            cfg->list.psz_cb = (vlc_string_list_cb)(uintptr_t)rec->list_cb;
     }
     else
     {
-        LOAD_IMMEDIATE (cfg->orig);
-        LOAD_IMMEDIATE (cfg->min);
-        LOAD_IMMEDIATE (cfg->max);
+        if (IsConfigFloatType (cfg->i_type))
+        {
+            cfg->orig.f = rec->orig.f;
+            cfg->min.f = rec->min.f;
+            cfg->max.f = rec->max.f;
+        }
+        else
+        {
+            cfg->orig.i = rec->orig.i;
+            cfg->min.i = rec->min.i;
+            cfg->max.i = rec->max.i;
+        }
         cfg->value = cfg->orig;
 
         if (cfg->list_count)
-            cfg->list.i = xmalloc (cfg->list_count * sizeof (int));
+            cfg->list.i = (int *)CacheTable (loader, rec->list,
+                                             cfg->list_count, sizeof (int));
         else /* TODO: fix config_GetPszChoices() instead of this hack: */
-            LOAD_IMMEDIATE(cfg->list.i_cb);
-        for (unsigned i = 0; i < cfg->list_count; i++)
-             LOAD_IMMEDIATE (cfg->list.i[i]);
-    }
-    cfg->list_text = xmalloc (cfg->list_count * sizeof (char *));
-    for (unsigned i = 0; i < cfg->list_count; i++)
-    {
-        LOAD_STRING (cfg->list_text[i]);
-        if (cfg->list_text[i] == NULL /* NULL -> empty string */
-         && (cfg->list_text[i] = calloc (1, 1)) == NULL)
-            goto error;
+            cfg->list.i_cb = (vlc_integer_list_cb)(uintptr_t)rec->list_cb;
     }
 
-    return 0;
-error:
-    return -1; /* FIXME: leaks */
+    if (cfg->list_count)
+        cfg->list_text = CacheStrings (loader, rec->list_text, cfg->list_count);
+    else
+        cfg->list_text = NULL;
 }
 
-static int CacheLoadModuleConfig (module_t *module, FILE *file)
+static void CacheLoadModule (cache_loader_t *loader, module_t *module,
+                             const cache_module_t *rec)
 {
-    uint16_t lines;
-
-    /* Calculate the structure length */
-    LOAD_IMMEDIATE (module->i_config_items);
-    LOAD_IMMEDIATE (module->i_bool_items);
-    LOAD_IMMEDIATE (lines);
+    module->psz_shortname = CacheString (loader, rec->shortname);
+    module->psz_longname = CacheString (loader, rec->longname);
+    module->psz_help = CacheString (loader, rec->help);
 
-    /* Allocate memory */
-    if (lines)
+    if (rec->shortcut_count > MODULE_SHORTCUT_MAX)
     {
-        module->p_config = malloc (lines * sizeof (module_config_t));
-        if (unlikely(module->p_config == NULL))
-        {
-            module->confsize = 0;
-            return -1;
-        }
+        loader->error = true;
+        return;
     }
-    else
-        module->p_config = NULL;
-    module->confsize = lines;
+    module->i_shortcuts = rec->shortcut_count;
+    module->pp_shortcuts = CacheStrings (loader, rec->shortcuts,
+                                         rec->shortcut_count);
 
-    /* Do the duplication job */
-    for (size_t i = 0; i < lines; i++)
-        if (CacheLoadConfig (module->p_config + i, file))
-            return -1;
-    return 0;
-error:
-    return -1; /* FIXME: leaks */
+    module->psz_capability = CacheString (loader, rec->capability);
+    module->i_score = rec->score;
 }
 
-static module_t *CacheLoadModule (FILE *file)
+/**
+ * Creates the module descriptor of a cached plugin. Strings and integer
+ * tables point to the cache, the configuration and the pointer tables are
+ * allocated at once (see vlc_module_destroy()).
+ */
+static module_t *CacheLoadPlugin (const block_t *map,
+                                  const cache_plugin_t *plugin)
 {
-    module_t *module = vlc_module_create (NULL);
-    if (unlikely(module == NULL))
+    cache_loader_t loader = { .map = map, .error = false };
+    const cache_module_t *modules =
+        CacheTable (&loader, plugin->modules, plugin->module_count,
+                    sizeof (*modules));
+    const cache_config_t *config =
+        CacheTable (&loader, plugin->config, plugin->confsize,
+                    sizeof (*config));
+
+    if (loader.error || modules == NULL || plugin->confsize > UINT16_MAX
+     || plugin->pointers > 65536)
         return NULL;
 
-    /* Load additional infos */
-    LOAD_STRING(module->psz_shortname);
-    LOAD_STRING(module->psz_longname);
-    LOAD_STRING(module->psz_help);
+    void *data = calloc (1, plugin->confsize * sizeof (module_config_t)
+                            + plugin->pointers * sizeof (char *));
+    if (unlikely(data == NULL))
+        return NULL;
 
-    LOAD_IMMEDIATE(module->i_shortcuts);
-    if (module->i_shortcuts > MODULE_SHORTCUT_MAX)
-        goto error;
-    else
+    module_t *module = vlc_module_create (NULL);
+    if (unlikely(module == NULL))
     {
-        module->pp_shortcuts =
-            xmalloc (sizeof (*module->pp_shortcuts) * module->i_shortcuts);
-        for (unsigned j = 0; j < module->i_shortcuts; j++)
-            LOAD_STRING(module->pp_shortcuts[j]);
+        free (data);
+        return NULL;
     }
-
-    LOAD_STRING(module->psz_capability);
-    LOAD_IMMEDIATE(module->i_score);
-    LOAD_IMMEDIATE(module->b_unloadable);
-
-    /* Config stuff */
-    if (CacheLoadModuleConfig (module, file) != VLC_SUCCESS)
-        goto error;
-
-    LOAD_STRING(module->domain);
+    module->cache_data = data;
+    module->p_config = data;
+    module->confsize = plugin->confsize;
+    loader.pointers = (char **)(module->p_config + plugin->confsize);
+    loader.pointer_count = plugin->pointers;
+
+    CacheLoadModule (&loader, module, &modules[0]);
+    module->b_unloadable = plugin->unloadable;
+    module->i_config_items = plugin->config_items;
+    module->i_bool_items = plugin->bool_items;
+    for (size_t i = 0; i < plugin->confsize; i++)
+        CacheLoadConfig (&loader, module->p_config + i, config + i);
+
+    module->domain = CacheString (&loader, plugin->domain);
     if (module->domain != NULL)
         vlc_bindtextdomain (module->domain);
 
-    uint32_t submodules;
-    LOAD_IMMEDIATE(submodules);
-
-    for (; submodules > 0; submodules--)
+    for (uint32_t i = 1; i < plugin->module_count; i++)
     {
         module_t *submodule = vlc_module_create (module);
-
-        free (submodule->pp_shortcuts);
-        LOAD_STRING(submodule->psz_shortname);
-        LOAD_STRING(submodule->psz_longname);
-
-        LOAD_IMMEDIATE(submodule->i_shortcuts);
-        if (submodule->i_shortcuts > MODULE_SHORTCUT_MAX)
-            goto error;
-        else
+        if (unlikely(submodule == NULL))
         {
-            submodule->pp_shortcuts =
-                xmalloc (sizeof (*submodule->pp_shortcuts) * submodule->i_shortcuts);
-            for (unsigned j = 0; j < submodule->i_shortcuts; j++)
-                LOAD_STRING(submodule->pp_shortcuts[j]);
+            loader.error = true;
+            break;
         }
-
-        LOAD_STRING(submodule->psz_capability);
-        LOAD_IMMEDIATE(submodule->i_score);
+        submodule->cache_data = data;
+        CacheLoadModule (&loader, submodule, &modules[i]);
     }
 
+    if (loader.error)
+    {
+        vlc_module_destroy (module);
+        return NULL;
+    }
     return module;
-error:
-    vlc_module_destroy(module);
-    return NULL;
 }
 
 /**
@@ -287,25 +385,26 @@ error:
  * will in turn be queried by AllocateAllPlugins() to see if it needs to
  * actually load the dynamically loadable module.
  * This allows us to only fully load plugins when they are actually used.
+ *
+ * The returned entries only refer to the cache content: it must be kept
+ * (*mapp) as long as they, and the modules found from them, are used.
  */
-size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
+size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r,
+                  block_t **mapp )
 {
     char *psz_filename;
-    FILE *file;
-    int i_size, i_read;
-    char p_cachestring[sizeof(CACHE_STRING)];
-    int32_t i_marker;
 
     assert( dir != NULL );
 
     *r = NULL;
+    *mapp = NULL;
     if( asprintf( &psz_filename, "%s"DIR_SEP CACHE_NAME, dir ) == -1 )
         return 0;
 
     msg_Dbg( p_this, "loading plugins cache file %s", psz_filename );
 
-    file = vlc_fopen( psz_filename, "rb" );
-    if( !file )
+    block_t *map = block_FilePath( psz_filename );
+    if( map == NULL )
     {
         msg_Warn( p_this, "cannot read %s: %s", psz_filename,
                   vlc_strerror_c(errno) );
@@ -315,180 +414,333 @@ size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
     free( psz_filename );
 
     /* Check the file is a plugins cache */
-    i_size = sizeof(CACHE_STRING) - 1;
-    i_read = fread( p_cachestring, 1, i_size, file );
-    if( i_read != i_size ||
-        memcmp( p_cachestring, CACHE_STRING, i_size ) )
+    const uint8_t *p = map->p_buffer;
+    const size_t prefix = CachePrefixSize();
+    uint32_t i_marker;
+
+    if( map->i_buffer < prefix + sizeof(cache_header_t) ||
+        memcmp( p, CACHE_STRING, sizeof(CACHE_STRING) - 1 ) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
-        return 0;
+        goto error;
     }
+    p += sizeof(CACHE_STRING) - 1;
 
 #ifdef DISTRO_VERSION
     /* Check for distribution specific version */
-    char p_distrostring[sizeof( DISTRO_VERSION )];
-    i_size = sizeof( DISTRO_VERSION ) - 1;
-    i_read = fread( p_distrostring, 1, i_size, file );
-    if( i_read != i_size ||
-        memcmp( p_distrostring, DISTRO_VERSION, i_size ) )
+    if( memcmp( p, DISTRO_VERSION, sizeof(DISTRO_VERSION) - 1 ) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
-        return 0;
+        goto error;
     }
+    p += sizeof(DISTRO_VERSION) - 1;
 #endif
 
     /* Check sub-version number */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) || i_marker != CACHE_SUBVERSION_NUM )
+    memcpy( &i_marker, p, sizeof(i_marker) );
+    p += sizeof(i_marker);
+    if( i_marker != CACHE_SUBVERSION_NUM )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
-        fclose( file );
-        return 0;
+        goto error;
     }
 
     /* Check header marker */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) ||
-        i_marker != ftell( file ) - (int)sizeof(i_marker) )
+    memcpy( &i_marker, p, sizeof(i_marker) );
+    if( i_marker != p - map->p_buffer )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
-        fclose( file );
-        return 0;
+        goto error;
     }
 
-    module_cache_t *cache = NULL;
-    size_t count = 0;
+    cache_header_t hdr;
+    memcpy( &hdr, map->p_buffer + prefix, sizeof(hdr) );
 
-    for (;;)
-    {
-        module_t *module = CacheLoadModule (file);
-        if (module == NULL)
-        {
-            if (feof (file))
-                break;
-            goto error;
-        }
+    cache_loader_t loader = { .map = map, .error = false };
+    const cache_plugin_t *plugins =
+        CacheTable( &loader, hdr.plugins, hdr.plugin_count, sizeof(*plugins) );
 
-        char *path;
-        struct stat st;
+    if( hdr.size != map->i_buffer || map->p_buffer[map->i_buffer - 1] != '\0'
+     || loader.error )
+    {
+        msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
+        goto error;
+    }
 
-        /* Load common info */
-        LOAD_STRING(path);
-        if (path == NULL)
-            goto error;
-        LOAD_IMMEDIATE(st.st_mtime);
-        LOAD_IMMEDIATE(st.st_size);
+    module_cache_t *cache = malloc( hdr.plugin_count * sizeof(*cache) );
+    if( unlikely(cache == NULL) && hdr.plugin_count > 0 )
+        goto error;
 
-        CacheAdd (&cache, &count, path, &st, module);
-        free (path);
-        /* TODO: deal with errors */
+    for( size_t i = 0; i < hdr.plugin_count; i++ )
+    {
+        cache[i].path = CacheString( &loader, plugins[i].path );
+        cache[i].mtime = plugins[i].mtime;
+        cache[i].size = plugins[i].size;
+        cache[i].p_module = NULL;
+        cache[i].plugin = &plugins[i];
     }
 
-    fclose( file );
-
     *r = cache;
-    return count;
+    *mapp = map;
+    return hdr.plugin_count;
 
 error:
-    if (ferror (file))
-        msg_Err(p_this, "plugins cache read error: %s", vlc_strerror_c(errno));
-    msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
-
-    /* TODO: cleanup */
-    fclose( file );
+    block_Release( map );
     return 0;
 }
 
-#define SAVE_IMMEDIATE( a ) \
-    if (fwrite (&(a), sizeof(a), 1, file) != 1) \
-        goto error
-#define SAVE_FLAG(a) \
-    do { \
-        char b = (a); \
-        SAVE_IMMEDIATE(b); \
-    } while (0)
-
-static int CacheSaveString (FILE *file, const char *str)
+typedef struct
 {
-    uint16_t size = (str != NULL) ? strlen (str) : 0;
+    uint8_t *data;
+    size_t   size;
+    size_t   max;
+    bool     error;
+} cache_writer_t;
+
+/* Appends zeroes, returns their offset or 0 on error */
+static uint32_t CacheReserve (cache_writer_t *w, size_t len, size_t align)
+{
+    size_t offset = (w->size + align - 1) & ~(align - 1);
+
+    if (w->error || offset + len > UINT32_MAX)
+        goto error;
 
-    SAVE_IMMEDIATE (size);
-    if (size != 0 && fwrite (str, 1, size, file) != size)
+    if (offset + len > w->max)
     {
-error:
-        return -1;
+        size_t max = __MAX(2 * w->max, offset + len);
+        uint8_t *data = realloc (w->data, max);
+
+        if (unlikely(data == NULL))
+            goto error;
+        w->data = data;
+        w->max = max;
     }
+    memset (w->data + w->size, 0, offset + len - w->size);
+    w->size = offset + len;
+    return offset;
+error:
+    w->error = true;
     return 0;
 }
 
-#define SAVE_STRING( a ) \
-    if (CacheSaveString (file, (a))) \
-        goto error
+static uint32_t CacheSaveString (cache_writer_t *w, const char *str)
+{
+    if (str == NULL)
+        return 0;
+
+    size_t len = strlen (str) + 1;
+    uint32_t offset = CacheReserve (w, len, 1);
+    if (offset != 0)
+        memcpy (w->data + offset, str, len);
+    return offset;
+}
+
+static uint32_t CacheSaveStrings (cache_writer_t *w, char *const *tab,
+                                  size_t count)
+{
+    uint32_t table = CacheReserve (w, count * sizeof (uint32_t), 8);
+
+    for (size_t i = 0; i < count; i++)
+    {   /* NULL -> empty string */
+        uint32_t offset = CacheSaveString (w, (tab[i] != NULL) ? tab[i] : "");
+
+        if (!w->error)
+            memcpy (w->data + table + i * sizeof (offset), &offset,
+                    sizeof (offset));
+    }
+    return table;
+}
 
-static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
+static void CacheSaveConfig (cache_writer_t *w, cache_config_t *rec,
+                             const module_config_t *cfg)
 {
-    SAVE_IMMEDIATE (cfg->i_type);
-    SAVE_IMMEDIATE (cfg->i_short);
-    SAVE_FLAG (cfg->b_advanced);
-    SAVE_FLAG (cfg->b_internal);
-    SAVE_FLAG (cfg->b_unsaveable);
-    SAVE_FLAG (cfg->b_safe);
-    SAVE_FLAG (cfg->b_removed);
-    SAVE_STRING (cfg->psz_type);
-    SAVE_STRING (cfg->psz_name);
-    SAVE_STRING (cfg->psz_text);
-    SAVE_STRING (cfg->psz_longtext);
-    SAVE_IMMEDIATE (cfg->list_count);
+    rec->type = cfg->i_type;
+    rec->i_short = cfg->i_short;
+    rec->flags = (cfg->b_advanced ? CACHE_CONFIG_ADVANCED : 0)
+               | (cfg->b_internal ? CACHE_CONFIG_INTERNAL : 0)
+               | (cfg->b_unsaveable ? CACHE_CONFIG_UNSAVEABLE : 0)
+               | (cfg->b_safe ? CACHE_CONFIG_SAFE : 0)
+               | (cfg->b_removed ? CACHE_CONFIG_REMOVED : 0);
+    rec->psz_type = CacheSaveString (w, cfg->psz_type);
+    rec->name = CacheSaveString (w, cfg->psz_name);
+    rec->text = CacheSaveString (w, cfg->psz_text);
+    rec->longtext = CacheSaveString (w, cfg->psz_longtext);
+    rec->list_count = cfg->list_count;
 
     if (IsConfigStringType (cfg->i_type))
     {
-        SAVE_STRING (cfg->orig.psz);
+        rec->orig.psz = CacheSaveString (w, cfg->orig.psz);
         if (cfg->list_count == 0)
-            SAVE_IMMEDIATE (cfg->list.psz_cb); /* XXX: see CacheLoadConfig() */
-        for (unsigned i = 0; i < cfg->list_count; i++)
-            SAVE_STRING (cfg->list.psz[i]);
+            rec->list_cb = (uintptr_t)cfg->list.psz_cb; /* XXX: see CacheLoadConfig() */
+        else
+            rec->list = CacheSaveStrings (w, cfg->list.psz, cfg->list_count);
     }
     else
     {
-        SAVE_IMMEDIATE (cfg->orig);
-        SAVE_IMMEDIATE (cfg->min);
-        SAVE_IMMEDIATE (cfg->max);
+        if (IsConfigFloatType (cfg->i_type))
+        {
+            rec->orig.f = cfg->orig.f;
+            rec->min.f = cfg->min.f;
+            rec->max.f = cfg->max.f;
+        }
+        else
+        {
+            rec->orig.i = cfg->orig.i;
+            rec->min.i = cfg->min.i;
+            rec->max.i = cfg->max.i;
+        }
+
         if (cfg->list_count == 0)
-            SAVE_IMMEDIATE (cfg->list.i_cb); /* XXX: see CacheLoadConfig() */
-        for (unsigned i = 0; i < cfg->list_count; i++)
-             SAVE_IMMEDIATE (cfg->list.i[i]);
+            rec->list_cb = (uintptr_t)cfg->list.i_cb; /* XXX: see CacheLoadConfig() */
+        else
+        {
+            size_t len = cfg->list_count * sizeof (int);
+
+            rec->list = CacheReserve (w, len, 8);
+            if (rec->list != 0)
+                memcpy (w->data + rec->list, cfg->list.i, len);
+        }
     }
-    for (unsigned i = 0; i < cfg->list_count; i++)
-        SAVE_STRING (cfg->list_text[i]);
+    if (cfg->list_count > 0)
+        rec->list_text = CacheSaveStrings (w, cfg->list_text, cfg->list_count);
+}
 
-    return 0;
-error:
-    return -1;
+static void CacheSaveModule (cache_writer_t *w, cache_module_t *rec,
+                             const module_t *module)
+{
+    rec->shortname = CacheSaveString (w, module->psz_shortname);
+    rec->longname = CacheSaveString (w, module->psz_longname);
+    rec->help = CacheSaveString (w, module->psz_help);
+    rec->capability = CacheSaveString (w, module->psz_capability);
+    rec->score = module->i_score;
+    rec->shortcut_count = module->i_shortcuts;
+    rec->shortcuts = CacheSaveStrings (w, module->pp_shortcuts,
+                                       module->i_shortcuts);
 }
 
-static int CacheSaveModuleConfig (FILE *file, const module_t *module)
+static void CacheSavePlugin (cache_writer_t *w, uint32_t offset,
+                             const module_cache_t *entry)
 {
-    uint16_t lines = module->confsize;
+    const module_t *module = entry->p_module;
+    cache_plugin_t plugin;
+    uint32_t pointers = module->i_shortcuts;
+
+    memset (&plugin, 0, sizeof (plugin));
+    plugin.path = CacheSaveString (w, entry->path);
+    plugin.domain = CacheSaveString (w, module->domain);
+    plugin.mtime = entry->mtime;
+    plugin.size = entry->size;
+    plugin.unloadable = module->b_unloadable;
+    plugin.config_items = module->i_config_items;
+    plugin.bool_items = module->i_bool_items;
+
+    /* Submodules are stored in creation order, the reverse of the list */
+    plugin.module_count = 1 + module->submodule_count;
+    plugin.modules = CacheReserve (w, plugin.module_count
+                                      * sizeof (cache_module_t), 8);
+
+    cache_module_t rec;
+    unsigned i = plugin.module_count;
+
+    for (const module_t *sub = module->submodule; sub != NULL; sub = sub->next)
+    {
+        memset (&rec, 0, sizeof (rec));
+        CacheSaveModule (w, &rec, sub);
+        pointers += sub->i_shortcuts;
+        if (!w->error && --i > 0)
+            memcpy (w->data + plugin.modules + i * sizeof (rec), &rec,
+                    sizeof (rec));
+    }
+    memset (&rec, 0, sizeof (rec));
+    CacheSaveModule (w, &rec, module);
+    if (!w->error)
+        memcpy (w->data + plugin.modules, &rec, sizeof (rec));
+
+    /* Config stuff */
+    plugin.confsize = module->confsize;
+    plugin.config = CacheReserve (w, plugin.confsize
+                                     * sizeof (cache_config_t), 8);
+    for (size_t j = 0; j < module->confsize; j++)
+    {
+        const module_config_t *cfg = module->p_config + j;
+        cache_config_t crec;
+
+        memset (&crec, 0, sizeof (crec));
+        CacheSaveConfig (w, &crec, cfg);
+        pointers += cfg->list_count;
+        if (IsConfigStringType (cfg->i_type))
+            pointers += cfg->list_count;
+        if (!w->error)
+            memcpy (w->data + plugin.config + j * sizeof (crec), &crec,
+                    sizeof (crec));
+    }
+    plugin.pointers = pointers;
 
-    SAVE_IMMEDIATE (module->i_config_items);
-    SAVE_IMMEDIATE (module->i_bool_items);
-    SAVE_IMMEDIATE (lines);
+    if (!w->error)
+        memcpy (w->data + offset, &plugin, sizeof (plugin));
+}
 
-    for (size_t i = 0; i < lines; i++)
-        if (CacheSaveConfig (file, module->p_config + i))
-           goto error;
+static int CacheSaveBank (FILE *file, const module_cache_t *cache,
+                          size_t i_cache)
+{
+    cache_writer_t w = { .data = NULL, .size = 0, .max = 0, .error = false };
+    cache_header_t hdr;
+    uint32_t i_marker;
+
+    /* Contains version number */
+    size_t i_prefix = CachePrefixSize ();
+    CacheReserve (&w, i_prefix + sizeof (hdr), 8);
+    if (w.error)
+        goto error;
+
+    uint8_t *p = w.data;
+    memcpy (p, CACHE_STRING, sizeof (CACHE_STRING) - 1);
+    p += sizeof (CACHE_STRING) - 1;
+#ifdef DISTRO_VERSION
+    /* Allow binary maintaner to pass a string to detect new binary version*/
+    memcpy (p, DISTRO_VERSION, sizeof (DISTRO_VERSION) - 1);
+    p += sizeof (DISTRO_VERSION) - 1;
+#endif
+    /* Sub-version number (to avoid breakage in the dev version when cache
+     * structure changes) */
+    i_marker = CACHE_SUBVERSION_NUM;
+    memcpy (p, &i_marker, sizeof (i_marker));
+    p += sizeof (i_marker);
+
+    /* Header marker */
+    i_marker = p - w.data;
+    memcpy (p, &i_marker, sizeof (i_marker));
+
+    memset (&hdr, 0, sizeof (hdr));
+    hdr.plugin_count = i_cache;
+    hdr.plugins = CacheReserve (&w, i_cache * sizeof (cache_plugin_t), 8);
+
+    for (size_t i = 0; i < i_cache; i++)
+        CacheSavePlugin (&w, hdr.plugins + i * sizeof (cache_plugin_t),
+                         cache + i);
+
+    /* Terminates the strings of a truncated file */
+    CacheReserve (&w, 1, 1);
+    if (w.error)
+        goto error;
+
+    hdr.size = w.size;
+    memcpy (w.data + i_prefix, &hdr, sizeof (hdr));
+
+    if (fwrite (w.data, w.size, 1, file) != 1)
+        goto error;
+    if (fflush (file)) /* flush libc buffers */
+        goto error;
+    free (w.data);
+    return 0; /* success! */
 
-    return 0;
 error:
+    free (w.data);
     return -1;
 }
 
-static int CacheSaveBank( FILE *file, const module_cache_t *, size_t );
-
 /**
  * Saves a module cache to disk, and release cache data from memory.
  */
@@ -540,95 +792,6 @@ out:
     free (entries);
 }
 
-static int CacheSaveSubmodule (FILE *, const module_t *);
-
-static int CacheSaveBank (FILE *file, const module_cache_t *cache,
-                          size_t i_cache)
-{
-    uint32_t i_file_size = 0;
-
-    /* Contains version number */
-    if (fputs (CACHE_STRING, file) == EOF)
-        goto error;
-#ifdef DISTRO_VERSION
-    /* Allow binary maintaner to pass a string to detect new binary version*/
-    if (fputs( DISTRO_VERSION, file ) == EOF)
-        goto error;
-#endif
-    /* Sub-version number (to avoid breakage in the dev version when cache
-     * structure changes) */
-    i_file_size = CACHE_SUBVERSION_NUM;
-    if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1 )
-        goto error;
-
-    /* Header marker */
-    i_file_size = ftell( file );
-    if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1)
-        goto error;
-
-    for (unsigned i = 0; i < i_cache; i++)
-    {
-        module_t *module = cache[i].p_module;
-        uint32_t i_submodule;
-
-        /* Save additional infos */
-        SAVE_STRING(module->psz_shortname);
-        SAVE_STRING(module->psz_longname);
-        SAVE_STRING(module->psz_help);
-        SAVE_IMMEDIATE(module->i_shortcuts);
-        for (unsigned j = 0; j < module->i_shortcuts; j++)
-            SAVE_STRING(module->pp_shortcuts[j]);
-
-        SAVE_STRING(module->psz_capability);
-        SAVE_IMMEDIATE(module->i_score);
-        SAVE_IMMEDIATE(module->b_unloadable);
-
-        /* Config stuff */
-        if (CacheSaveModuleConfig (file, module))
-            goto error;
-
-        SAVE_STRING(module->domain);
-
-        i_submodule = module->submodule_count;
-        SAVE_IMMEDIATE( i_submodule );
-        if (CacheSaveSubmodule (file, module->submodule))
-            goto error;
-
-        /* Save common info */
-        SAVE_STRING(cache[i].path);
-        SAVE_IMMEDIATE(cache[i].mtime);
-        SAVE_IMMEDIATE(cache[i].size);
-    }
-
-    if (fflush (file)) /* flush libc buffers */
-        goto error;
-    return 0; /* success! */
-
-error:
-    return -1;
-}
-
-static int CacheSaveSubmodule( FILE *file, const module_t *p_module )
-{
-    if( !p_module )
-        return 0;
-    if( CacheSaveSubmodule( file, p_module->next ) )
-        goto error;
-
-    SAVE_STRING( p_module->psz_shortname );
-    SAVE_STRING( p_module->psz_longname );
-    SAVE_IMMEDIATE( p_module->i_shortcuts );
-    for( unsigned j = 0; j < p_module->i_shortcuts; j++ )
-         SAVE_STRING( p_module->pp_shortcuts[j] );
-
-    SAVE_STRING( p_module->psz_capability );
-    SAVE_IMMEDIATE( p_module->i_score );
-    return 0;
-
-error:
-    return -1;
-}
-
 /*****************************************************************************
  * CacheMerge: Merge a cache module descriptor with a full module descriptor.
  *****************************************************************************/
@@ -658,9 +821,10 @@ void CacheMerge( vlc_object_t *p_this, module_t *p_cache, module_t *p_module )
 }
 
 /**
- * Looks up a plugin file in a table of cached plugins.
+ * Looks up a plugin file in a table of cached plugins, and creates its
+ * module descriptor from the cache.
  */
-module_t *CacheFind (module_cache_t *cache, size_t count,
+module_t *CacheFind (const block_t *map, module_cache_t *cache, size_t count,
                      const char *path, const struct stat *st)
 {
     while (count > 0)
@@ -670,9 +834,8 @@ module_t *CacheFind (module_cache_t *cache, size_t count,
          && cache->mtime == st->st_mtime
          && cache->size == st->st_size)
        {
-            module_t *module = cache->p_module;
-            cache->p_module = NULL;
-            return module;
+            cache->path = NULL;
+            return CacheLoadPlugin (map, cache->plugin);
        }
        cache++;
        count--;
@@ -699,6 +862,7 @@ int CacheAdd (module_cache_t **cachep, size_t *countp,
     cache->mtime = st->st_mtime;
     cache->size = st->st_size;
     cache->p_module = module;
+    cache->plugin = NULL;
     *countp = count + 1;
     return 0;
 }
@@ -80,6 +80,7 @@ module_t *vlc_module_create (module_t *parent)
     /*module->handle = garbage */
     module->psz_filename = NULL;
     module->domain = NULL;
+    module->cache_data = NULL;
     return module;
 }
 
@@ -97,6 +98,18 @@ void vlc_module_destroy (module_t *module)
         vlc_module_destroy (m);
     }
 
+    if (module->cache_data != NULL)
+    {   /* Only the string values were allocated, see CacheLoadPlugin() */
+        for (size_t i = 0; i < module->confsize; i++)
+            if (IsConfigStringType (module->p_config[i].i_type))
+                free (module->p_config[i].value.psz);
+        if (module->parent == NULL)
+            free (module->cache_data);
+        free (module->psz_filename);
+        free (module);
+        return;
+    }
+
     config_Free (module->p_config, module->confsize);
 
     free (module->domain);
@@ -188,6 +188,31 @@ static int module_load (vlc_object_t *obj, module_t *m,
     return ret;
 }
 
+/**
+ * Probes a candidate module, and accounts the time of failed probes to the
+ * capability, so that the costly ones show up in the debug log.
+ */
+static int module_probe (vlc_object_t *obj, vlc_modcap_t *cap, module_t *m,
+                         vlc_activate_t init, va_list args,
+                         unsigned *failures, mtime_t *failed_time)
+{
+    mtime_t start = mdate ();
+    int ret = module_load (obj, m, init, args);
+
+    if (ret != VLC_SUCCESS)
+    {
+        mtime_t duration = mdate () - start;
+
+        msg_Dbg (obj, "%s module \"%s\" probe failed in %"PRId64" us",
+                 cap->name, module_get_object (m), duration);
+        atomic_fetch_add (&cap->failures, 1);
+        atomic_fetch_add (&cap->failed_time, duration);
+        (*failures)++;
+        *failed_time += duration;
+    }
+    return ret;
+}
+
 #undef vlc_module_load
 /**
  * Finds and instantiates the best module of a certain type.
@@ -226,19 +251,30 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
     }
 
     /* Find matching modules */
-    module_t **mods;
-    ssize_t total = module_list_cap (&mods, capability);
+    vlc_modcap_t *cap = module_cap_find (capability);
+    ssize_t total = (cap != NULL) ? (ssize_t)cap->count : 0;
 
     msg_Dbg (obj, "looking for %s module matching \"%s\": %zd candidates",
              capability, name, total);
     if (total <= 0)
     {
-        module_list_free (mods);
         msg_Dbg (obj, "no %s modules", capability);
+        free (var);
         return NULL;
     }
 
+    /* Copy of the prebuilt candidates, as tried modules are removed */
+    module_t **mods = malloc (total * sizeof (*mods));
+    if (unlikely(mods == NULL))
+    {
+        free (var);
+        return NULL;
+    }
+    memcpy (mods, cap->modules, total * sizeof (*mods));
+
     module_t *module = NULL;
+    unsigned failures = 0;
+    mtime_t failed_time = 0;
     const bool b_force_backup = obj->b_force; /* FIXME: remove this */
     va_list args;
 
@@ -274,7 +310,8 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
                 continue;
             mods[i] = NULL; // only try each module once at most...
 
-            int ret = module_load (obj, cand, probe, args);
+            int ret = module_probe (obj, cap, cand, probe, args,
+                                    &failures, &failed_time);
             switch (ret)
             {
                 case VLC_SUCCESS:
@@ -296,7 +333,8 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
             if (cand == NULL || module_get_score (cand) <= 0)
                 continue;
 
-            int ret = module_load (obj, cand, probe, args);
+            int ret = module_probe (obj, cap, cand, probe, args,
+                                    &failures, &failed_time);
             switch (ret)
             {
                 case VLC_SUCCESS:
@@ -310,9 +348,15 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
 done:
     va_end (args);
     obj->b_force = b_force_backup;
-    module_list_free (mods);
+    free (mods);
     free (var);
 
+    if (failures > 0)
+        msg_Dbg (obj, "%u %s probes failed in %"PRId64" us "
+                 "(%u in %"PRIu64" us overall)", failures, capability,
+                 failed_time, atomic_load (&cap->failures),
+                 (uint64_t)atomic_load (&cap->failed_time));
+
     if (module != NULL)
     {
         msg_Dbg (obj, "using %s module \"%s\"", capability,
@@ -381,25 +425,8 @@ void module_unneed(vlc_object_t *obj, module_t *module)
  */
 module_t *module_find (const char *name)
 {
-    size_t count;
-    module_t **list = module_list_get (&count);
-
     assert (name != NULL);
-
-    for (size_t i = 0; i < count; i++)
-    {
-        module_t *module = list[i];
-
-        if (unlikely(module->i_shortcuts == 0))
-            continue;
-        if (!strcmp (module->pp_shortcuts[0], name))
-        {
-            module_list_free (list);
-            return module;
-        }
-    }
-    module_list_free (list);
-    return NULL;
+    return module_lookup (name, true);
 }
 
 /**
@@ -424,22 +451,7 @@ bool module_exists (const char * psz_name)
  */
 module_t *module_find_by_shortcut (const char *psz_shortcut)
 {
-    size_t count;
-    module_t **list = module_list_get (&count);
-
-    for (size_t i = 0; i < count; i++)
-    {
-        module_t *module = list[count];
-
-        for (size_t j = 0; j < module->i_shortcuts; j++)
-            if (!strcmp (module->pp_shortcuts[j], psz_shortcut))
-            {
-                module_list_free (list);
-                return module;
-            }
-    }
-    module_list_free (list);
-    return NULL;
+    return module_lookup (psz_shortcut, false);
 }
 
 /**
@@ -24,6 +24,8 @@
 #ifndef LIBVLC_MODULES_H
 # define LIBVLC_MODULES_H 1
 
+# include <vlc_atomic.h>
+
 typedef struct module_cache_t module_cache_t;
 
 /*****************************************************************************
@@ -38,6 +40,7 @@ struct module_cache_t
 
     /* Optional extra data */
     module_t *p_module;
+    const void *plugin; /* Record in the loaded cache, see CacheFind() */
 };
 
 
@@ -98,6 +101,10 @@ struct module_t
     module_handle_t     handle;                             /* Unique handle */
     char *              psz_filename;                     /* Module filename */
     char *              domain;                            /* gettext domain */
+
+    /* Configuration and tables of a module created from the plugins cache,
+     * its strings are in the cache itself. NULL if not from the cache. */
+    void *              cache_data;
 };
 
 module_t *vlc_plugin_describe (vlc_plugin_cb);
@@ -110,7 +117,20 @@ size_t module_LoadPlugins( vlc_object_t * );
 void module_EndBank (bool);
 int module_Map (vlc_object_t *, module_t *);
 
+/** Modules of a capability in the bank index */
+typedef struct vlc_modcap
+{
+    const char *name;
+    module_t **modules; /**< sorted by decreasing score */
+    size_t count;
+    /* Failed probes statistics */
+    atomic_uint failures;
+    atomic_uint_least64_t failed_time;
+} vlc_modcap_t;
+
 ssize_t module_list_cap (module_t ***, const char *);
+vlc_modcap_t *module_cap_find (const char *);
+module_t *module_lookup (const char *, bool);
 
 int vlc_bindtextdomain (const char *);
 
@@ -122,14 +142,14 @@ void module_Unload (module_handle_t);
 /* Plugins cache */
 void   CacheMerge (vlc_object_t *, module_t *, module_t *);
 void   CacheDelete(vlc_object_t *, const char *);
-size_t CacheLoad  (vlc_object_t *, const char *, module_cache_t **);
+size_t CacheLoad  (vlc_object_t *, const char *, module_cache_t **, block_t **);
 
 struct stat;
 
 int CacheAdd (module_cache_t **, size_t *,
               const char *, const struct stat *, module_t *);
 void CacheSave  (vlc_object_t *, const char *, module_cache_t *, size_t);
-module_t *CacheFind (module_cache_t *, size_t,
+module_t *CacheFind (const block_t *, module_cache_t *, size_t,
                      const char *, const struct stat *);
 
 #endif /* !LIBVLC_MODULES_H */
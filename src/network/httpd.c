@@ -40,15 +40,20 @@
 #include <vlc_url.h>
 #include <vlc_mime.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 
 #if defined(_WIN32)
 #   include <winsock2.h>
@@ -63,10 +68,45 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* stream segments a client sends at once */
+#define HTTPD_CL_SEGMENTS 16
+/* whatever the duration, as the input may not be paced */
+#define HTTPD_STREAM_MAX_BUFFER (64 << 20)
+
 static void httpd_ClientClean(httpd_client_t *cl);
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
 
-/* each host run in his own thread */
+/* stream data, referenced by the stream and the clients sending it */
+typedef struct
+{
+    atomic_uint refs;
+    int64_t     i_pos;      /* absolute position of the first byte */
+    mtime_t     i_date;     /* when it was queued */
+    size_t      i_size;
+    uint8_t     p_data[];
+} httpd_segment_t;
+
+static void httpd_SegmentRelease(httpd_segment_t *seg)
+{
+    if (atomic_fetch_sub(&seg->refs, 1) == 1)
+        free(seg);
+}
+
+/* each worker thread serves its own share of the host clients */
+typedef struct
+{
+    httpd_host_t    *host;
+    vlc_thread_t     thread;
+    vlc_mutex_t      lock;
+
+    int              i_client;
+    httpd_client_t **client;
+
+#ifdef HAVE_SYS_EPOLL_H
+    int              epfd;
+#endif
+} httpd_worker_t;
+
+/* each host runs one or more worker threads */
 struct httpd_host_t
 {
     VLC_COMMON_MEMBERS
@@ -79,7 +119,6 @@ struct httpd_host_t
     unsigned     nfd;
     unsigned     port;
 
-    vlc_thread_t thread;
     vlc_mutex_t lock;
     vlc_cond_t  wait;
 
@@ -90,8 +129,9 @@ struct httpd_host_t
     int         i_url;
     httpd_url_t **url;
 
-    int            i_client;
-    httpd_client_t **client;
+    /* the first worker also accepts the new connections */
+    unsigned        i_worker;
+    httpd_worker_t *worker;
 
     /* TLS data */
     vlc_tls_creds_t *p_tls;
@@ -149,6 +189,7 @@ struct httpd_client_t
 
     bool    b_stream_mode;
     uint8_t i_state;
+    short   i_events; /* poll events the worker is waiting for */
 
     mtime_t i_activity_date;
     mtime_t i_activity_timeout;
@@ -169,10 +210,26 @@ struct httpd_client_t
     httpd_message_t query;  /* client -> httpd */
     httpd_message_t answer; /* httpd -> client */
 
+    /* stream data being sent, straight from the shared segments */
+    unsigned i_segment;
+    struct
+    {
+        httpd_segment_t *seg;
+        size_t           i_offset;
+        size_t           i_length;
+    } segment[HTTPD_CL_SEGMENTS];
+
     /* TLS data */
     vlc_tls_t *p_tls;
 };
 
+static void httpd_ClientReleaseSegments(httpd_client_t *cl)
+{
+    for (unsigned i = 0; i < cl->i_segment; i++)
+        httpd_SegmentRelease(cl->segment[i].seg);
+    cl->i_segment = 0;
+}
+
 
 /*****************************************************************************
  * Various functions
@@ -611,9 +668,13 @@ struct httpd_stream_t
     bool        b_has_keyframes;
     int64_t     i_last_keyframe_seen_pos;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    /* queued data, oldest first, in a ring of segments */
+    httpd_segment_t **pp_segment;
+    unsigned    i_segment_alloc;    /* power of 2 */
+    unsigned    i_segment_first;
+    unsigned    i_segment;
+    size_t      i_segment_bytes;
+    mtime_t     i_buffer_duration;  /* clients lagging more skip data */
     int64_t     i_buffer_pos;       /* absolute position from begining */
     int64_t     i_buffer_last_pos;  /* a new connection will start with that */
 
@@ -622,6 +683,14 @@ struct httpd_stream_t
     httpd_header * p_http_headers;
 };
 
+static httpd_segment_t *httpd_StreamSegment(const httpd_stream_t *stream,
+                                            unsigned i)
+{
+    assert(i < stream->i_segment);
+    return stream->pp_segment[(stream->i_segment_first + i)
+                              & (stream->i_segment_alloc - 1)];
+}
+
 static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
                                  httpd_client_t *cl, httpd_message_t *answer,
                                  const httpd_message_t *query)
@@ -632,43 +701,58 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
         return VLC_SUCCESS;
 
     if (answer->i_body_offset > 0) {
-        int     i_pos;
+        httpd_ClientReleaseSegments(cl);
 
-        if (answer->i_body_offset >= stream->i_buffer_pos)
+        /* clients of different workers read concurrently */
+        vlc_mutex_lock(&stream->lock);
+        if (answer->i_body_offset >= stream->i_buffer_pos) {
+            vlc_mutex_unlock(&stream->lock);
             return VLC_EGENERIC;    /* wait, no data available */
+        }
 
         if (cl->i_keyframe_wait_to_pass >= 0) {
-            if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
+            if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass) {
                 /* still waiting for the next keyframe */
+                vlc_mutex_unlock(&stream->lock);
                 return VLC_EGENERIC;
+            }
 
             /* seek to the new keyframe */
             answer->i_body_offset = stream->i_last_keyframe_seen_pos;
             cl->i_keyframe_wait_to_pass = -1;
         }
 
-        if (answer->i_body_offset + stream->i_buffer_size < stream->i_buffer_pos)
+        if (answer->i_body_offset < httpd_StreamSegment(stream, 0)->i_pos)
             answer->i_body_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
 
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        int64_t i_write = stream->i_buffer_pos - answer->i_body_offset;
-
-        if (i_write > HTTPD_CL_BUFSIZE)
-            i_write = HTTPD_CL_BUFSIZE;
-        else if (i_write <= 0)
-            return VLC_EGENERIC;    /* wait, no data available */
-
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN(i_write, stream->i_buffer_size - i_pos);
+        /* clients are usually close to the live position */
+        unsigned i = stream->i_segment - 1;
+        while (httpd_StreamSegment(stream, i)->i_pos > answer->i_body_offset)
+            i--;
+
+        /* reference the segments rather than copying them */
+        int64_t i_write = 0;
+        for (; i < stream->i_segment && cl->i_segment < HTTPD_CL_SEGMENTS; i++) {
+            httpd_segment_t *seg = httpd_StreamSegment(stream, i);
+            size_t i_offset = answer->i_body_offset + i_write - seg->i_pos;
+
+            atomic_fetch_add(&seg->refs, 1);
+            cl->segment[cl->i_segment].seg = seg;
+            cl->segment[cl->i_segment].i_offset = i_offset;
+            cl->segment[cl->i_segment].i_length = seg->i_size - i_offset;
+            i_write += seg->i_size - i_offset;
+            cl->i_segment++;
+        }
+        vlc_mutex_unlock(&stream->lock);
 
         /* using HTTPD_MSG_ANSWER -> data available */
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
         answer->i_type   = HTTPD_MSG_ANSWER;
 
+        /* the body is sent from the client segments */
         answer->i_body = i_write;
-        answer->p_body = xmalloc(i_write);
-        memcpy(answer->p_body, &stream->p_buffer[i_pos], i_write);
+        answer->p_body = NULL;
 
         answer->i_body_offset += i_write;
 
@@ -765,8 +849,13 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
 
     stream->i_header = 0;
     stream->p_header = NULL;
-    stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc(stream->i_buffer_size);
+    stream->pp_segment = NULL;
+    stream->i_segment_alloc = 0;
+    stream->i_segment_first = 0;
+    stream->i_segment = 0;
+    stream->i_segment_bytes = 0;
+    stream->i_buffer_duration = CLOCK_FREQ
+        * var_InheritInteger(host, "http-stream-buffer");
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
@@ -802,27 +891,61 @@ int httpd_StreamHeader(httpd_stream_t *stream, uint8_t *p_data, int i_data)
     return VLC_SUCCESS;
 }
 
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data)
+static int httpd_AppendData(httpd_stream_t *stream, const uint8_t *p_data,
+                            size_t i_data)
 {
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while (i_count > 0) {
-        int i_copy = __MIN(i_count, stream->i_buffer_size - i_pos);
-
-        /* Ok, we can't go past the end of our buffer */
-        memcpy(&stream->p_buffer[i_pos], p_data, i_copy);
+    httpd_segment_t *seg = malloc(sizeof (*seg) + i_data);
+    if (!seg)
+        return VLC_ENOMEM;
 
-        i_pos = (i_pos + i_copy) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
+    if (stream->i_segment == stream->i_segment_alloc) {
+        unsigned i_alloc = stream->i_segment_alloc ? 2 * stream->i_segment_alloc
+                                                   : 64;
+        httpd_segment_t **pp = malloc(i_alloc * sizeof (*pp));
+        if (!pp) {
+            free(seg);
+            return VLC_ENOMEM;
+        }
+        for (unsigned i = 0; i < stream->i_segment; i++)
+            pp[i] = httpd_StreamSegment(stream, i);
+        free(stream->pp_segment);
+        stream->pp_segment = pp;
+        stream->i_segment_alloc = i_alloc;
+        stream->i_segment_first = 0;
     }
 
+    atomic_init(&seg->refs, 1);
+    seg->i_pos = stream->i_buffer_pos;
+    seg->i_date = mdate();
+    seg->i_size = i_data;
+    memcpy(seg->p_data, p_data, i_data);
+
+    stream->pp_segment[(stream->i_segment_first + stream->i_segment)
+                       & (stream->i_segment_alloc - 1)] = seg;
+    stream->i_segment++;
+    stream->i_segment_bytes += i_data;
     stream->i_buffer_pos += i_data;
+
+    /* Drop what is too old. Clients still sending it keep a reference. */
+    while (stream->i_segment > 1) {
+        httpd_segment_t *first = httpd_StreamSegment(stream, 0);
+
+        if (seg->i_date - first->i_date <= stream->i_buffer_duration
+         && stream->i_segment_bytes <= HTTPD_STREAM_MAX_BUFFER)
+            break;
+
+        stream->i_segment_first = (stream->i_segment_first + 1)
+                                & (stream->i_segment_alloc - 1);
+        stream->i_segment--;
+        stream->i_segment_bytes -= first->i_size;
+        httpd_SegmentRelease(first);
+    }
+    return VLC_SUCCESS;
 }
 
 int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
 {
-    if (!p_block || !p_block->p_buffer)
+    if (!p_block || !p_block->p_buffer || !p_block->i_buffer)
         return VLC_SUCCESS;
 
     vlc_mutex_lock(&stream->lock);
@@ -835,10 +958,10 @@ int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
         stream->i_last_keyframe_seen_pos = stream->i_buffer_pos;
     }
 
-    httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
+    int i_ret = httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
 
     vlc_mutex_unlock(&stream->lock);
-    return VLC_SUCCESS;
+    return i_ret;
 }
 
 void httpd_StreamDelete(httpd_stream_t *stream)
@@ -852,14 +975,16 @@ void httpd_StreamDelete(httpd_stream_t *stream)
     vlc_mutex_destroy(&stream->lock);
     free(stream->psz_mime);
     free(stream->p_header);
-    free(stream->p_buffer);
+    for (unsigned i = 0; i < stream->i_segment; i++)
+        httpd_SegmentRelease(httpd_StreamSegment(stream, i));
+    free(stream->pp_segment);
     free(stream);
 }
 
 /*****************************************************************************
  * Low level
  *****************************************************************************/
-static void* httpd_HostThread(void *);
+static void* httpd_WorkerThread(void *);
 static httpd_host_t *httpd_HostCreate(vlc_object_t *, const char *,
                                        const char *, vlc_tls_creds_t *);
 
@@ -906,6 +1031,69 @@ static struct httpd
     int          i_host;
 } httpd = { VLC_STATIC_MUTEX, NULL, 0 };
 
+static int httpd_WorkerStart(httpd_host_t *host, httpd_worker_t *w)
+{
+    w->host     = host;
+    w->i_client = 0;
+    w->client   = NULL;
+
+#ifdef HAVE_SYS_EPOLL_H
+    w->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (w->epfd == -1)
+        return VLC_EGENERIC;
+
+    /* listening sockets are only watched by the first worker */
+    if (w == host->worker)
+        for (unsigned i = 0; i < host->nfd; i++) {
+            struct epoll_event ev = { .events = EPOLLIN, .data.ptr = host };
+
+            if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, host->fds[i], &ev)) {
+                close(w->epfd);
+                return VLC_EGENERIC;
+            }
+        }
+#endif
+
+    vlc_mutex_init(&w->lock);
+    if (vlc_clone(&w->thread, httpd_WorkerThread, w,
+                   VLC_THREAD_PRIORITY_LOW)) {
+        vlc_mutex_destroy(&w->lock);
+#ifdef HAVE_SYS_EPOLL_H
+        close(w->epfd);
+#endif
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+/* stop all the worker threads, and close their remaining connections */
+static void httpd_WorkersStop(httpd_host_t *host)
+{
+    for (unsigned i = 0; i < host->i_worker; i++)
+        vlc_cancel(host->worker[i].thread);
+
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *w = &host->worker[i];
+
+        vlc_join(w->thread, NULL);
+
+        for (int j = 0; j < w->i_client; j++) {
+            msg_Warn(host, "client still connected");
+            httpd_ClientClean(w->client[j]);
+            free(w->client[j]);
+        }
+        free(w->client);
+#ifdef HAVE_SYS_EPOLL_H
+        close(w->epfd);
+#endif
+        vlc_mutex_destroy(&w->lock);
+    }
+
+    free(host->worker);
+    host->worker = NULL;
+    host->i_worker = 0;
+}
+
 static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
                                        const char *hostvar,
                                        const char *portvar,
@@ -959,6 +1147,8 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     vlc_mutex_init(&host->lock);
     vlc_cond_init(&host->wait);
     host->i_ref = 1;
+    host->i_worker = 0;
+    host->worker = NULL;
 
     host->fds = net_ListenTCP(p_this, url.psz_host, port);
     if (!host->fds) {
@@ -970,16 +1160,33 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     host->port     = port;
     host->i_url    = 0;
     host->url      = NULL;
-    host->i_client = 0;
-    host->client   = NULL;
     host->p_tls    = p_tls;
 
-    /* create the thread */
-    if (vlc_clone(&host->thread, httpd_HostThread, host,
-                   VLC_THREAD_PRIORITY_LOW)) {
+#ifdef HAVE_SYS_EPOLL_H
+    unsigned i_worker = var_InheritInteger(p_this, "http-threads");
+    if (i_worker < 1)
+        i_worker = 1;
+#else
+    /* without epoll, only the accepting thread learns of new clients */
+    unsigned i_worker = 1;
+#endif
+
+    /* create the threads */
+    host->worker = malloc(i_worker * sizeof (*host->worker));
+    if (!host->worker)
+        goto error;
+
+    while (host->i_worker < i_worker
+        && httpd_WorkerStart(host, &host->worker[host->i_worker]) == VLC_SUCCESS)
+        host->i_worker++;
+
+    if (host->i_worker == 0) {
         msg_Err(p_this, "cannot spawn http host thread");
         goto error;
     }
+    if (host->i_worker < i_worker)
+        msg_Warn(p_this, "only %u of %u http host threads started",
+                 host->i_worker, i_worker);
 
     /* now add it to httpd */
     TAB_APPEND(httpd.i_host, httpd.host, host);
@@ -993,6 +1200,7 @@ error:
     vlc_mutex_unlock(&httpd.mutex);
 
     if (host) {
+        httpd_WorkersStop(host);
         net_ListenClose(host->fds);
         vlc_cond_destroy(&host->wait);
         vlc_mutex_destroy(&host->lock);
@@ -1024,24 +1232,13 @@ void httpd_HostDelete(httpd_host_t *host)
     }
     TAB_REMOVE(httpd.i_host, httpd.host, host);
 
-    vlc_cancel(host->thread);
-    vlc_join(host->thread, NULL);
+    httpd_WorkersStop(host);
 
     msg_Dbg(host, "HTTP host removed");
 
     for (int i = 0; i < host->i_url; i++)
         msg_Err(host, "url still registered: %s", host->url[i]->psz_url);
 
-    for (int i = 0; i < host->i_client; i++) {
-        httpd_client_t *cl = host->client[i];
-        msg_Warn(host, "client still connected");
-        httpd_ClientClean(cl);
-        TAB_REMOVE(host->i_client, host->client, cl);
-        free(cl);
-        i--;
-        /* TODO */
-    }
-
     vlc_tls_Delete(host->p_tls);
     net_ListenClose(host->fds);
     vlc_cond_destroy(&host->wait);
@@ -1079,7 +1276,7 @@ httpd_url_t *httpd_UrlNew(httpd_host_t *host, const char *psz_url,
     }
 
     TAB_APPEND(host->i_url, host->url, url);
-    vlc_cond_signal(&host->wait);
+    vlc_cond_broadcast(&host->wait);
     vlc_mutex_unlock(&host->lock);
 
     return url;
@@ -1104,27 +1301,33 @@ void httpd_UrlDelete(httpd_url_t *url)
 
     vlc_mutex_lock(&host->lock);
     TAB_REMOVE(host->i_url, host->url, url);
+    vlc_mutex_unlock(&host->lock);
 
-    vlc_mutex_destroy(&url->lock);
-    free(url->psz_url);
-    free(url->psz_user);
-    free(url->psz_password);
+    /* The workers cannot find the url anymore. Connections still using it
+     * are shut down, and freed by their worker which may hold events. */
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *w = &host->worker[i];
 
-    for (int i = 0; i < host->i_client; i++) {
-        httpd_client_t *client = host->client[i];
+        vlc_mutex_lock(&w->lock);
+        for (int j = 0; j < w->i_client; j++) {
+            httpd_client_t *client = w->client[j];
 
-        if (client->url != url)
-            continue;
+            if (client->url != url)
+                continue;
 
-        /* TODO complete it */
-        msg_Warn(host, "force closing connections");
-        httpd_ClientClean(client);
-        TAB_REMOVE(host->i_client, host->client, client);
-        free(client);
-        i--;
+            msg_Warn(host, "force closing connections");
+            client->url = NULL;
+            client->i_state = HTTPD_CLIENT_DEAD;
+            shutdown(client->fd, SHUT_RDWR);
+        }
+        vlc_mutex_unlock(&w->lock);
     }
+
+    vlc_mutex_destroy(&url->lock);
+    free(url->psz_url);
+    free(url->psz_user);
+    free(url->psz_password);
     free(url);
-    vlc_mutex_unlock(&host->lock);
 }
 
 static void httpd_MsgInit(httpd_message_t *msg)
@@ -1206,6 +1409,7 @@ static void httpd_ClientInit(httpd_client_t *cl, mtime_t now)
     cl->p_buffer = xmalloc(cl->i_buffer_size);
     cl->i_keyframe_wait_to_pass = -1;
     cl->b_stream_mode = false;
+    cl->i_segment = 0;
 
     httpd_MsgInit(&cl->query);
     httpd_MsgInit(&cl->answer);
@@ -1232,6 +1436,7 @@ static void httpd_ClientClean(httpd_client_t *cl)
 
     httpd_MsgClean(&cl->answer);
     httpd_MsgClean(&cl->query);
+    httpd_ClientReleaseSegments(cl);
 
     free(cl->p_buffer);
     cl->p_buffer = NULL;
@@ -1245,6 +1450,7 @@ static httpd_client_t *httpd_ClientNew(int fd, vlc_tls_t *p_tls, mtime_t now)
 
     cl->i_ref   = 0;
     cl->fd      = fd;
+    cl->i_events = 0;
     cl->url     = NULL;
     cl->p_tls = p_tls;
 
@@ -1283,6 +1489,44 @@ ssize_t httpd_NetSend (httpd_client_t *cl, const uint8_t *p, size_t i_len)
     return val;
 }
 
+/* send the pending data, gathered from the stream segments if any */
+static ssize_t httpd_ClientSendBuffer(httpd_client_t *cl)
+{
+    if (cl->i_segment == 0)
+        return httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
+                             cl->i_buffer_size - cl->i_buffer);
+
+    struct iovec iov[HTTPD_CL_SEGMENTS];
+    size_t i_skip = cl->i_buffer;
+    int i_iov = 0;
+
+    for (unsigned i = 0; i < cl->i_segment; i++) {
+        if (i_skip >= cl->segment[i].i_length) {
+            i_skip -= cl->segment[i].i_length;
+            continue;
+        }
+        iov[i_iov].iov_base = cl->segment[i].seg->p_data
+                            + cl->segment[i].i_offset + i_skip;
+        iov[i_iov].iov_len = cl->segment[i].i_length - i_skip;
+        i_skip = 0;
+        i_iov++;
+    }
+    assert(i_iov > 0);
+
+#ifndef _WIN32
+    if (cl->p_tls == NULL) {
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = i_iov };
+        ssize_t val;
+
+        do
+            val = sendmsg(cl->fd, &msg, MSG_NOSIGNAL);
+        while (val == -1 && errno == EINTR);
+        return val;
+    }
+#endif
+    return httpd_NetSend(cl, iov[0].iov_base, iov[0].iov_len);
+}
+
 
 static const struct
 {
@@ -1622,12 +1866,12 @@ static void httpd_ClientSend(httpd_client_t *cl)
         cl->i_buffer_size = (uint8_t*)p - cl->p_buffer;
     }
 
-    i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
-                           cl->i_buffer_size - cl->i_buffer);
+    i_len = httpd_ClientSendBuffer(cl);
     if (i_len >= 0) {
         cl->i_buffer += i_len;
 
         if (cl->i_buffer >= cl->i_buffer_size) {
+            httpd_ClientReleaseSegments(cl);
             if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
                 /* catch more body data */
                 int     i_msg = cl->query.i_type;
@@ -1716,56 +1960,121 @@ auth_failed:
     return false;
 }
 
-static void httpdLoop(httpd_host_t *host)
+/* accept the pending connections, and hand them to the least busy worker */
+static void httpd_HostAccept(httpd_host_t *host, int lfd, mtime_t now)
 {
-    struct pollfd ufd[host->nfd + host->i_client];
-    unsigned nfd;
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        ufd[nfd].fd = host->fds[nfd];
-        ufd[nfd].events = POLLIN;
-        ufd[nfd].revents = 0;
+    int fd;
+
+    while ((fd = vlc_accept (lfd, NULL, NULL, true)) != -1) {
+        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+                &(int){ 1 }, sizeof(int));
+
+        vlc_tls_t *p_tls;
+
+        if (host->p_tls != NULL)
+        {
+            const char *alpn[] = { "http/1.1", NULL };
+
+            p_tls = vlc_tls_SessionCreate(host->p_tls, fd, NULL, alpn);
+        }
+        else
+            p_tls = NULL;
+
+        httpd_client_t *cl = httpd_ClientNew(fd, p_tls, now);
+        if (!cl) {
+            if (p_tls)
+                vlc_tls_SessionDelete(p_tls);
+            net_Close(fd);
+            continue;
+        }
+
+        httpd_worker_t *w = host->worker;
+        int i_min = INT_MAX;
+        for (unsigned i = 0; i < host->i_worker; i++) {
+            vlc_mutex_lock(&host->worker[i].lock);
+            if (host->worker[i].i_client < i_min) {
+                i_min = host->worker[i].i_client;
+                w = &host->worker[i];
+            }
+            vlc_mutex_unlock(&host->worker[i].lock);
+        }
+
+        vlc_mutex_lock(&w->lock);
+#ifdef HAVE_SYS_EPOLL_H
+        /* the worker gets the events even if it is already waiting */
+        cl->i_events = (cl->i_state == HTTPD_CLIENT_TLS_HS_OUT) ? POLLOUT
+                                                                : POLLIN;
+        struct epoll_event ev = {
+            .events = (cl->i_events == POLLOUT) ? EPOLLOUT : EPOLLIN,
+            .data.ptr = cl,
+        };
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, fd, &ev)) {
+            vlc_mutex_unlock(&w->lock);
+            msg_Err(host, "cannot watch client: %s", vlc_strerror_c(errno));
+            httpd_ClientClean(cl);
+            free(cl);
+            continue;
+        }
+#endif
+        TAB_APPEND(w->i_client, w->client, cl);
+        vlc_mutex_unlock(&w->lock);
     }
+}
 
-    /* add all socket that should be read/write and close dead connection */
-    while (host->i_url <= 0) {
-        mutex_cleanup_push(&host->lock);
+static void httpdLoop(httpd_worker_t *w)
+{
+    httpd_host_t *host = w->host;
+
+    vlc_mutex_lock(&host->lock);
+    mutex_cleanup_push(&host->lock);
+    while (host->i_url <= 0)
         vlc_cond_wait(&host->wait, &host->lock);
-        vlc_cleanup_pop();
-    }
+    vlc_cleanup_pop();
+    vlc_mutex_unlock(&host->lock);
 
     mtime_t now = mdate();
     bool b_low_delay = false;
 
     int canc = vlc_savecancel();
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
+    vlc_mutex_lock(&w->lock);
+
+#ifndef HAVE_SYS_EPOLL_H
+    struct pollfd ufd[host->nfd + w->i_client];
+    unsigned nfd;
+    for (nfd = 0; nfd < host->nfd; nfd++) {
+        ufd[nfd].fd = host->fds[nfd];
+        ufd[nfd].events = POLLIN;
+        ufd[nfd].revents = 0;
+    }
+#endif
+
+    /* add all socket that should be read/write and close dead connection */
+    int i_alive = 0;
+    for (int i_client = 0; i_client < w->i_client; i_client++) {
         int64_t i_offset;
-        httpd_client_t *cl = host->client[i_client];
+        httpd_client_t *cl = w->client[i_client];
         if (cl->i_ref < 0 || (cl->i_ref == 0 &&
                     (cl->i_state == HTTPD_CLIENT_DEAD ||
                       (cl->i_activity_timeout > 0 &&
                         cl->i_activity_date+cl->i_activity_timeout < now)))) {
+            /* closing the socket also removes it from the epoll set */
             httpd_ClientClean(cl);
-            TAB_REMOVE(host->i_client, host->client, cl);
             free(cl);
-            i_client--;
             continue;
         }
+        w->client[i_alive++] = cl;
 
-        struct pollfd *pufd = ufd + nfd;
-        assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
-
-        pufd->fd = cl->fd;
-        pufd->events = pufd->revents = 0;
+        short events = 0;
 
         switch (cl->i_state) {
             case HTTPD_CLIENT_RECEIVING:
             case HTTPD_CLIENT_TLS_HS_IN:
-                pufd->events = POLLIN;
+                events = POLLIN;
                 break;
 
             case HTTPD_CLIENT_SENDING:
             case HTTPD_CLIENT_TLS_HS_OUT:
-                pufd->events = POLLOUT;
+                events = POLLOUT;
                 break;
 
             case HTTPD_CLIENT_RECEIVE_DONE: {
@@ -1849,6 +2158,7 @@ static void httpdLoop(httpd_host_t *host)
                         bool b_auth_failed = false;
 
                         /* Search the url and trigger callbacks */
+                        vlc_mutex_lock(&host->lock);
                         for (int i = 0; i < host->i_url; i++) {
                             httpd_url_t *url = host->url[i];
 
@@ -1878,6 +2188,7 @@ static void httpdLoop(httpd_host_t *host)
                             if (!cl->url)
                                 cl->url = url;
                         }
+                        vlc_mutex_unlock(&host->lock);
 
                         if (answer) {
                             answer->i_proto  = query->i_proto;
@@ -1974,19 +2285,43 @@ static void httpdLoop(httpd_host_t *host)
                 }
         }
 
-        if (pufd->events != 0)
-            nfd++;
-        else
+        if (events == 0)
             b_low_delay = true;
+#ifdef HAVE_SYS_EPOLL_H
+        if (events != cl->i_events) {
+            /* update the interest list in place, only on state changes */
+            struct epoll_event ev = {
+                .events = (events & POLLIN ? EPOLLIN : 0)
+                        | (events & POLLOUT ? EPOLLOUT : 0),
+                .data.ptr = cl,
+            };
+            if (epoll_ctl(w->epfd, EPOLL_CTL_MOD, cl->fd, &ev) == 0)
+                cl->i_events = events;
+            else
+                cl->i_state = HTTPD_CLIENT_DEAD;
+        }
+#else
+        if (events != 0) {
+            ufd[nfd].fd = cl->fd;
+            ufd[nfd].events = events;
+            ufd[nfd].revents = 0;
+            nfd++;
+        }
+#endif
     }
-    vlc_mutex_unlock(&host->lock);
+    w->i_client = i_alive;
+    vlc_mutex_unlock(&w->lock);
     vlc_restorecancel(canc);
 
     /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event ev[64];
+    int ret = epoll_wait(w->epfd, ev, ARRAY_SIZE(ev), b_low_delay ? 20 : -1);
+#else
     int ret = poll(ufd, nfd, b_low_delay ? 20 : -1);
+#endif
 
     canc = vlc_savecancel();
-    vlc_mutex_lock(&host->lock);
     switch(ret) {
         case -1:
             if (errno != EINTR) {
@@ -2001,10 +2336,25 @@ static void httpdLoop(httpd_host_t *host)
 
     /* Handle client sockets */
     now = mdate();
+    vlc_mutex_lock(&w->lock);
+
+#ifdef HAVE_SYS_EPOLL_H
+    bool b_accept = false;
+
+    for (int i = 0; i < ret; i++) {
+        if (ev[i].data.ptr == host) {
+            b_accept = true;
+            continue;
+        }
+
+        /* only this worker frees its clients, so the pointer is valid */
+        httpd_client_t *cl = ev[i].data.ptr;
+        uint32_t revents = ev[i].events;
+#else
     nfd = host->nfd;
 
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
-        httpd_client_t *cl = host->client[i_client];
+    for (int i_client = 0; i_client < w->i_client; i_client++) {
+        httpd_client_t *cl = w->client[i_client];
         const struct pollfd *pufd = &ufd[nfd];
 
         assert(pufd < &ufd[sizeof(ufd) / sizeof(ufd[0])]);
@@ -2014,6 +2364,7 @@ static void httpdLoop(httpd_host_t *host)
         ++nfd;
         if (pufd->revents == 0)
             continue; // no event received
+#endif
 
         cl->i_activity_date = now;
 
@@ -2022,54 +2373,40 @@ static void httpdLoop(httpd_host_t *host)
             case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
             case HTTPD_CLIENT_TLS_HS_IN:
             case HTTPD_CLIENT_TLS_HS_OUT: httpd_ClientTlsHandshake(cl); break;
+#ifdef HAVE_SYS_EPOLL_H
+            default:
+                /* errors are reported whatever the interest list */
+                if (revents & (EPOLLERR | EPOLLHUP))
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+#endif
         }
     }
+    vlc_mutex_unlock(&w->lock);
 
     /* Handle server sockets (accept new connections) */
+#ifdef HAVE_SYS_EPOLL_H
+    if (b_accept)
+        for (unsigned i = 0; i < host->nfd; i++)
+            httpd_HostAccept(host, host->fds[i], now);
+#else
     for (nfd = 0; nfd < host->nfd; nfd++) {
-        httpd_client_t *cl;
-        int fd = ufd[nfd].fd;
-
-        assert (fd == host->fds[nfd]);
-
-        if (ufd[nfd].revents == 0)
-            continue;
-
-        /* */
-        fd = vlc_accept (fd, NULL, NULL, true);
-        if (fd == -1)
-            continue;
-        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                &(int){ 1 }, sizeof(int));
-
-        vlc_tls_t *p_tls;
-
-        if (host->p_tls != NULL)
-        {
-            const char *alpn[] = { "http/1.1", NULL };
-
-            p_tls = vlc_tls_SessionCreate(host->p_tls, fd, NULL, alpn);
-        }
-        else
-            p_tls = NULL;
-
-        cl = httpd_ClientNew(fd, p_tls, now);
+        assert (ufd[nfd].fd == host->fds[nfd]);
 
-        TAB_APPEND(host->i_client, host->client, cl);
+        if (ufd[nfd].revents != 0)
+            httpd_HostAccept(host, ufd[nfd].fd, now);
     }
+#endif
 
     vlc_restorecancel(canc);
 }
 
-static void* httpd_HostThread(void *data)
+static void* httpd_WorkerThread(void *data)
 {
-    httpd_host_t *host = data;
+    httpd_worker_t *w = data;
 
-    vlc_mutex_lock(&host->lock);
-    while (host->i_ref > 0)
-        httpdLoop(host);
-    vlc_mutex_unlock(&host->lock);
-    return NULL;
+    for (;;)
+        httpdLoop(w);
+    vlc_assert_unreachable();
 }
 
 int httpd_StreamSetHTTPHeaders(httpd_stream_t * p_stream, httpd_header * p_headers, size_t i_headers)
@@ -56,6 +56,9 @@ static void vlc_CPU_init (void)
     {
         char *p = line, *cap;
         uint_fast32_t core_caps = 0;
+#if defined (__i386__) || defined (__x86_64__)
+        bool avx512f = false, avx512bw = false;
+#endif
 
 #if defined (__arm__)
         unsigned ver;
@@ -94,6 +97,10 @@ static void vlc_CPU_init (void)
                 core_caps |= VLC_CPU_AVX;
             if (!strcmp (cap, "avx2"))
                 core_caps |= VLC_CPU_AVX2;
+            if (!strcmp (cap, "avx512f"))
+                avx512f = true;
+            if (!strcmp (cap, "avx512bw"))
+                avx512bw = true;
             if (!strcmp (cap, "3dnow"))
                 core_caps |= VLC_CPU_3dNOW;
             if (!strcmp (cap, "xop"))
@@ -106,6 +113,11 @@ static void vlc_CPU_init (void)
                 core_caps |= VLC_CPU_ALTIVEC;
 #endif
         }
+#if defined (__i386__) || defined (__x86_64__)
+        /* The kernel hides the flags if it does not save the AVX state */
+        if (avx512f && avx512bw)
+            core_caps |= VLC_CPU_AVX512;
+#endif
 
         /* Take the intersection of capabilities of each processor */
         all_caps &= core_caps;
@@ -115,6 +115,9 @@ sout_instance_t *sout_NewInstance( vlc_object_t *p_parent, const char *psz_dest
 
     vlc_mutex_init( &p_sout->lock );
     p_sout->p_stream = NULL;
+    vlc_mutex_init( &p_sout->stats_lock );
+    for( int i = 0; i < SOUT_STATISTIC_MAX; i++ )
+        p_sout->pi_stats[i] = 0;
 
     var_Create( p_sout, "sout-mux-caching", VLC_VAR_INTEGER | VLC_VAR_DOINHERIT );
 
@@ -130,6 +133,7 @@ sout_instance_t *sout_NewInstance( vlc_object_t *p_parent, const char *psz_dest
 
     FREENULL( p_sout->psz_sout );
 
+    vlc_mutex_destroy( &p_sout->stats_lock );
     vlc_mutex_destroy( &p_sout->lock );
     vlc_object_release( p_sout );
     return NULL;
@@ -146,12 +150,36 @@ void sout_DeleteInstance( sout_instance_t * p_sout )
     /* *** free all string *** */
     FREENULL( p_sout->psz_sout );
 
+    vlc_mutex_destroy( &p_sout->stats_lock );
     vlc_mutex_destroy( &p_sout->lock );
 
     /* *** free structure *** */
     vlc_object_release( p_sout );
 }
 
+/*****************************************************************************
+ * Statistics
+ *****************************************************************************/
+void sout_UpdateStatistic( sout_instance_t *p_sout, sout_statistic_t i_type,
+                           int64_t i_value )
+{
+    assert( i_type < SOUT_STATISTIC_MAX );
+
+    vlc_mutex_lock( &p_sout->stats_lock );
+    if( i_type == SOUT_STATISTIC_PIPELINE_DEPTH )
+        p_sout->pi_stats[i_type] = i_value;
+    else
+        p_sout->pi_stats[i_type] += i_value;
+    vlc_mutex_unlock( &p_sout->stats_lock );
+}
+
+void sout_GetStatistics( sout_instance_t *p_sout, int64_t *pi_stats )
+{
+    vlc_mutex_lock( &p_sout->stats_lock );
+    memcpy( pi_stats, p_sout->pi_stats, sizeof (p_sout->pi_stats) );
+    vlc_mutex_unlock( &p_sout->stats_lock );
+}
+
 /*****************************************************************************
  * Packetizer/Input
  *****************************************************************************/
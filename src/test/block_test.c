@@ -53,7 +53,35 @@ static void test_block_File (void)
     assert (block != NULL);
     assert (block->i_buffer == strlen (text));
     assert (!memcmp (block->p_buffer, text, block->i_buffer));
-    block_Release (block);
+
+    /* Blocks sharing the file mapping outlive the original block */
+    block_t *share = block_mmap_Share (block, 5, 2);
+    if (share != NULL)
+    {
+        /* Shared data are copied before being written */
+        block_t *copy = block_MakeWritable (block_mmap_Share (block, 5, 2));
+        assert (copy != NULL);
+        assert (copy->i_buffer == 2 && !memcmp (copy->p_buffer, "is", 2));
+        copy->p_buffer[0] = 'X';
+        assert (share->p_buffer[0] == 'i');
+        block_Release (copy);
+
+        copy = block_Realloc (block_mmap_Share (block, 5, 2), 1, 3);
+        assert (copy != NULL);
+        copy->p_buffer[0] = 'X';
+        assert (block->p_buffer[4] == ' ' && share->p_buffer[0] == 'i');
+        block_Release (copy);
+
+        block_t *subshare = block_mmap_Share (share, 1, 1);
+        assert (subshare != NULL);
+        block_Release (block);
+        assert (share->i_buffer == 2 && !memcmp (share->p_buffer, "is", 2));
+        block_Release (share);
+        assert (subshare->p_buffer[0] == 's');
+        block_Release (subshare);
+    }
+    else
+        block_Release (block);
 
     remove ("testfile.txt");
 }
@@ -84,10 +112,62 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+#define POOL_BLOCKS 20000
+
+static void *test_block_PoolConsume (void *data)
+{
+    block_fifo_t *fifo = data;
+
+    for (unsigned i = 0; i < POOL_BLOCKS; i++)
+    {
+        block_t *block = block_FifoGet (fifo);
+
+        assert (block->i_buffer == 1 + (i * 97) % 70000);
+        assert (block->p_buffer[0] == (uint8_t)i);
+        assert (block->p_buffer[block->i_buffer - 1] == (uint8_t)i);
+        block_Release (block);
+    }
+    return NULL;
+}
+
+static void test_block_Pool (void)
+{
+    /* Released blocks are reused */
+    block_t *block = block_Alloc (1000);
+    assert (block != NULL);
+    void *prev = block;
+    block_Release (block);
+    block = block_Alloc (900);
+    assert (block == prev);
+    assert (block->i_buffer == 900);
+    assert (((uintptr_t)block->p_buffer % 32) == 0);
+    block_Release (block);
+
+    /* Blocks allocated and released by different threads */
+    block_fifo_t *fifo = block_FifoNew ();
+    vlc_thread_t th;
+
+    assert (fifo != NULL);
+    assert (vlc_clone (&th, test_block_PoolConsume, fifo,
+                       VLC_THREAD_PRIORITY_LOW) == 0);
+    for (unsigned i = 0; i < POOL_BLOCKS; i++)
+    {
+        size_t size = 1 + (i * 97) % 70000;
+
+        block = block_Alloc (size);
+        assert (block != NULL);
+        memset (block->p_buffer, i, size);
+        block_FifoPut (fifo, block);
+    }
+    vlc_join (th, NULL);
+    block_FifoRelease (fifo);
+}
+
 int main (void)
 {
     test_block_File ();
     test_block ();
+    test_block_Pool ();
     return 0;
 }
 
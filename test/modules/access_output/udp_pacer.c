@@ -0,0 +1,216 @@
+/*****************************************************************************
+ * udp_pacer.c: test for the batched datagram transmission
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../../modules/access_output/udp_pacer.c"
+
+#define COUNT 10
+#define SIZE  1316
+
+static void queue( block_fifo_t *fifo, mtime_t dts, size_t size, bool clock )
+{
+    block_t *pkt = block_Alloc( size );
+    assert( pkt != NULL );
+    pkt->i_dts = dts;
+    if( clock )
+        pkt->i_flags |= BLOCK_FLAG_CLOCK;
+    block_FifoPut( fifo, pkt );
+}
+
+static unsigned collect( udp_pacer_t *p, block_fifo_t *fifo )
+{
+    unsigned count;
+
+    udp_pacer_Collect( p, fifo, 0 );
+    count = p->count;
+    udp_pacer_Flush( p, 0, NULL );
+    return count;
+}
+
+static void test_collect( vlc_object_t *obj )
+{
+    block_fifo_t *fifo = block_FifoNew();
+    udp_pacer_t p;
+
+    assert( fifo != NULL );
+
+    /* Without window, only packets of a same date are grouped */
+    udp_pacer_Init( &p, obj, 0, 1 );
+    queue( fifo, 0, SIZE, false );
+    queue( fifo, 0, SIZE, false );
+    queue( fifo, 500, SIZE, false );
+    queue( fifo, 2000, SIZE, false );
+    assert( collect( &p, fifo ) == 2 );
+    assert( collect( &p, fifo ) == 1 );
+    assert( collect( &p, fifo ) == 1 );
+    udp_pacer_Clean( &p );
+
+    /* Packets due within the window go together */
+    udp_pacer_Init( &p, obj, 1000, 1 );
+    queue( fifo, 0, SIZE, false );
+    queue( fifo, 0, SIZE, false );
+    queue( fifo, 500, SIZE, false );
+    queue( fifo, 2000, SIZE, false );
+    assert( collect( &p, fifo ) == 3 );
+    assert( collect( &p, fifo ) == 1 );
+
+    /* Clock references start a batch */
+    queue( fifo, 0, SIZE, false );
+    queue( fifo, 0, SIZE, true );
+    queue( fifo, 0, SIZE, false );
+    assert( collect( &p, fifo ) == 1 );
+    assert( collect( &p, fifo ) == 2 );
+
+    /* Batches are bounded */
+    for( unsigned i = 0; i < UDP_PACER_BATCH + 1; i++ )
+        queue( fifo, 0, SIZE, false );
+    assert( collect( &p, fifo ) == UDP_PACER_BATCH );
+    assert( collect( &p, fifo ) == 1 );
+    udp_pacer_Clean( &p );
+
+    /* Groups are sent regardless of the dates */
+    udp_pacer_Init( &p, obj, 0, 3 );
+    for( unsigned i = 0; i < 4; i++ )
+        queue( fifo, i * CLOCK_FREQ, SIZE, false );
+    assert( collect( &p, fifo ) == 3 );
+    assert( collect( &p, fifo ) == 1 );
+
+    /* Packets held back are released with the pacer */
+    queue( fifo, 0, SIZE, false );
+    queue( fifo, CLOCK_FREQ, SIZE, false );
+    queue( fifo, 2 * CLOCK_FREQ, SIZE, false );
+    queue( fifo, 3 * CLOCK_FREQ, SIZE, false );
+    udp_pacer_Collect( &p, fifo, 0 );
+    assert( p.count == 3 && p.next != NULL );
+    udp_pacer_Clean( &p );
+
+    block_FifoRelease( fifo );
+}
+
+/* Sends a batch of equal packets but the last, returns the datagrams count */
+static uint64_t send_batch( udp_pacer_t *p, int tx, int rx )
+{
+    uint64_t datagrams = p->stats.datagrams;
+
+    for( unsigned i = 0; i < COUNT; i++ )
+    {
+        size_t size = (i < COUNT - 1) ? SIZE : SIZE / 3;
+        block_t *pkt = block_Alloc( size );
+
+        assert( pkt != NULL );
+        memset( pkt->p_buffer, i, size );
+        pkt->i_dts = 0;
+        p->pkts[p->count++] = pkt;
+    }
+    assert( udp_pacer_Send( p, tx, true ) == 0 );
+    udp_pacer_Flush( p, mdate(), NULL );
+    assert( p->stats.errors == 0 );
+
+    /* Segmented or not, the receiver gets each packet separately */
+    for( unsigned i = 0; i < COUNT; i++ )
+    {
+        uint8_t buf[SIZE + 1];
+        size_t size = (i < COUNT - 1) ? SIZE : SIZE / 3;
+
+        ssize_t val = recv( rx, buf, sizeof (buf), 0 );
+        assert( val == (ssize_t)size );
+        assert( buf[0] == i && buf[size - 1] == i );
+    }
+    return p->stats.datagrams - datagrams;
+}
+
+static void test_send( vlc_object_t *obj )
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl( INADDR_LOOPBACK ),
+    };
+    socklen_t addrlen = sizeof (addr);
+    udp_pacer_t p;
+
+    int rx = socket( AF_INET, SOCK_DGRAM, 0 );
+    int tx = socket( AF_INET, SOCK_DGRAM, 0 );
+    assert( rx != -1 && tx != -1 );
+
+    if( bind( rx, (struct sockaddr *)&addr, sizeof (addr) ) )
+    {
+        log( "cannot bind to the loopback: %s\n", strerror( errno ) );
+        close( tx );
+        close( rx );
+        return;
+    }
+    assert( getsockname( rx, (struct sockaddr *)&addr, &addrlen ) == 0 );
+    assert( connect( tx, (struct sockaddr *)&addr, addrlen ) == 0 );
+
+    udp_pacer_Init( &p, obj, 0, 1 );
+
+    uint64_t datagrams = send_batch( &p, tx, rx );
+    log( "%u packets sent as %"PRIu64" datagrams\n", COUNT, datagrams );
+    if( p.gso )
+        assert( datagrams < COUNT );
+    else
+        assert( datagrams == COUNT );
+
+#if defined (HAVE_GSO) && defined (SO_NO_CHECK)
+    /* Segmentation offload requires checksums: it fails without them and
+     * the pacer must fall back to one datagram per packet. */
+    if( p.gso
+     && setsockopt( tx, SOL_SOCKET, SO_NO_CHECK, &(int){ 1 },
+                    sizeof (int) ) == 0 )
+    {
+        datagrams = send_batch( &p, tx, rx );
+        log( "fallback: %u packets sent as %"PRIu64" datagrams\n", COUNT,
+             datagrams );
+        assert( !p.gso );
+        assert( datagrams == COUNT );
+    }
+#endif
+
+    udp_pacer_Clean( &p );
+    close( tx );
+    close( rx );
+}
+
+int main( void )
+{
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new( test_defaults_nargs,
+                                         test_defaults_args );
+    assert( vlc != NULL );
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    test_collect( obj );
+    test_send( obj );
+
+    libvlc_release( vlc );
+    return 0;
+}
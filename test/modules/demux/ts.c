@@ -0,0 +1,396 @@
+/*****************************************************************************
+ * ts.c: MPEG transport stream demuxer throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Set VLC_TEST_TS to the path of a transport stream to benchmark it instead
+ * of the generated one. */
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_stream.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_modules.h>
+
+#define STREAM_SIZE (32 << 20)
+#define LOOPS 5
+
+#define TS_SIZE   188
+#define PMT_PID   0x100
+#define VIDEO_PID 0x101
+#define AUDIO_PID 0x102
+#define NULL_PID  0x1FFF
+
+#define VIDEO_PACKETS 40 /* per frame */
+#define AUDIO_PACKETS 8
+#define NULL_PACKETS  5
+#define PES_HEADER    14 /* with a PTS */
+
+/*****************************************************************************
+ * Stream generation
+ *****************************************************************************/
+static uint32_t crc32( const uint8_t *p, size_t i_len )
+{
+    uint32_t crc = 0xffffffff;
+
+    while( i_len-- > 0 )
+    {
+        crc ^= (uint32_t)*p++ << 24;
+        for( unsigned i = 0; i < 8; i++ )
+            crc = (crc << 1) ^ ((crc & 0x80000000) ? 0x04c11db7 : 0);
+    }
+    return crc;
+}
+
+static uint8_t *header( uint8_t *p, unsigned pid, bool b_start,
+                        unsigned afc, unsigned *cc )
+{
+    p[0] = 0x47;
+    p[1] = (b_start ? 0x40 : 0) | (pid >> 8);
+    p[2] = pid;
+    p[3] = (afc << 4) | (*cc & 0xf);
+    if( afc & 1 )
+        (*cc)++;
+    return p + 4;
+}
+
+static uint8_t *section( uint8_t *p, unsigned pid, const uint8_t *data,
+                         size_t i_data, unsigned *cc )
+{
+    uint8_t *payload = header( p, pid, true, 1, cc );
+    uint32_t crc = crc32( data, i_data );
+
+    *payload++ = 0; /* pointer field */
+    memcpy( payload, data, i_data );
+    payload += i_data;
+    SetDWBE( payload, crc );
+    payload += 4;
+    memset( payload, 0xff, p + TS_SIZE - payload );
+    return p + TS_SIZE;
+}
+
+static uint8_t *pcr( uint8_t *p, uint64_t i_pcr, unsigned *cc )
+{
+    uint8_t *af = header( p, VIDEO_PID, false, 2, cc );
+
+    af[0] = TS_SIZE - 5;
+    af[1] = 0x10;
+    af[2] = i_pcr >> 25;
+    af[3] = i_pcr >> 17;
+    af[4] = i_pcr >> 9;
+    af[5] = i_pcr >> 1;
+    af[6] = ((i_pcr & 1) << 7) | 0x7e;
+    af[7] = 0;
+    memset( af + 8, 0xff, p + TS_SIZE - (af + 8) );
+    return p + TS_SIZE;
+}
+
+/* Writes a PES filling exactly the payload of i_packets packets */
+static uint8_t *pes( uint8_t *p, unsigned pid, uint8_t i_id,
+                     unsigned i_packets, uint64_t i_pts, unsigned *cc )
+{
+    const size_t i_size = i_packets * (TS_SIZE - 4);
+
+    for( unsigned i = 0; i < i_packets; i++ )
+    {
+        uint8_t *payload = header( p, pid, i == 0, 1, cc );
+
+        if( i == 0 )
+        {
+            /* Video PES may be unbounded */
+            size_t i_len = (i_id >= 0xe0) ? 0 : i_size - 6;
+
+            payload[0] = 0; payload[1] = 0; payload[2] = 1;
+            payload[3] = i_id;
+            SetWBE( &payload[4], i_len );
+            payload[6] = 0x80;
+            payload[7] = 0x80;
+            payload[8] = 5;
+            payload[9]  = 0x21 | ((i_pts >> 29) & 0x0e);
+            payload[10] = i_pts >> 22;
+            payload[11] = ((i_pts >> 14) & 0xfe) | 1;
+            payload[12] = i_pts >> 7;
+            payload[13] = ((i_pts << 1) & 0xfe) | 1;
+            memset( payload + PES_HEADER, i_id, TS_SIZE - 4 - PES_HEADER );
+        }
+        else
+            memset( payload, i_id, TS_SIZE - 4 );
+        p += TS_SIZE;
+    }
+    return p;
+}
+
+/* Generates a single program with a video and an audio ES, a PCR and some
+ * null packets per video frame. Returns the number of frames. */
+static unsigned generate( uint8_t *p, size_t i_size )
+{
+    static const uint8_t pat[] = {
+        0x00, 0xb0, 13, 0x00, 0x01, 0xc1, 0x00, 0x00,
+        0x00, 0x01, 0xe0 | (PMT_PID >> 8), PMT_PID & 0xff,
+    };
+    static const uint8_t pmt[] = {
+        0x02, 0xb0, 23, 0x00, 0x01, 0xc1, 0x00, 0x00,
+        0xe0 | (VIDEO_PID >> 8), VIDEO_PID & 0xff, 0xf0, 0x00,
+        0x02, 0xe0 | (VIDEO_PID >> 8), VIDEO_PID & 0xff, 0xf0, 0x00,
+        0x04, 0xe0 | (AUDIO_PID >> 8), AUDIO_PID & 0xff, 0xf0, 0x00,
+    };
+    const size_t i_frame = TS_SIZE * (2 + 1 + VIDEO_PACKETS + AUDIO_PACKETS
+                                      + NULL_PACKETS);
+    unsigned cc[4] = { 0, 0, 0, 0 };
+    unsigned i_frames = 0;
+    uint64_t i_pts = 90000;
+    uint8_t *end = p + i_size;
+
+    for( ; p + i_frame <= end; i_frames++, i_pts += 3600 )
+    {
+        p = section( p, 0, pat, sizeof (pat), &cc[0] );
+        p = section( p, PMT_PID, pmt, sizeof (pmt), &cc[1] );
+        p = pcr( p, i_pts - 45000, &cc[2] );
+        p = pes( p, VIDEO_PID, 0xe0, VIDEO_PACKETS, i_pts, &cc[2] );
+        p = pes( p, AUDIO_PID, 0xc0, AUDIO_PACKETS, i_pts, &cc[3] );
+        for( unsigned i = 0; i < NULL_PACKETS; i++ )
+        {
+            unsigned null_cc = 0;
+            uint8_t *payload = header( p, NULL_PID, false, 1, &null_cc );
+            memset( payload, 0xff, TS_SIZE - 4 );
+            p += TS_SIZE;
+        }
+    }
+    return i_frames;
+}
+
+/*****************************************************************************
+ * Elementary stream output
+ *****************************************************************************/
+struct es_out_sys_t
+{
+    bool     b_selected;
+    unsigned i_es;
+    uint64_t i_blocks;
+    uint64_t i_bytes;
+
+    demux_packet_stats_t *p_stats; /* packets per PID */
+    size_t i_stats;
+};
+
+static es_out_id_t *EsOutAdd( es_out_t *out, const es_format_t *fmt )
+{
+    (void) fmt;
+    out->p_sys->i_es++;
+    return (es_out_id_t *)out->p_sys; /* any non-NULL handle */
+}
+
+static int EsOutSend( es_out_t *out, es_out_id_t *id, block_t *block )
+{
+    (void) id;
+    for( block_t *b = block; b != NULL; b = b->p_next )
+    {
+        out->p_sys->i_blocks++;
+        out->p_sys->i_bytes += b->i_buffer;
+    }
+    block_ChainRelease( block );
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel( es_out_t *out, es_out_id_t *id )
+{
+    (void) out; (void) id;
+}
+
+static int EsOutControl( es_out_t *out, int query, va_list args )
+{
+    switch( query )
+    {
+        case ES_OUT_GET_ES_STATE:
+            (void) va_arg( args, es_out_id_t * );
+            *va_arg( args, bool * ) = out->p_sys->b_selected;
+            return VLC_SUCCESS;
+    }
+    return VLC_EGENERIC;
+}
+
+/*****************************************************************************
+ * Benchmark
+ *****************************************************************************/
+static int control( demux_t *p_demux, int i_query, ... )
+{
+    va_list args;
+    int i_ret;
+
+    va_start( args, i_query );
+    i_ret = p_demux->pf_control( p_demux, i_query, args );
+    va_end( args );
+    return i_ret;
+}
+
+static uint64_t packets( const struct es_out_sys_t *sys, unsigned pid )
+{
+    for( size_t i = 0; i < sys->i_stats; i++ )
+        if( sys->p_stats[i].i_id == pid )
+            return sys->p_stats[i].i_packets;
+    return 0;
+}
+
+/* Demuxes the whole stream, returns the duration or -1 without demuxer */
+static mtime_t demux( vlc_object_t *obj, uint8_t *p_data, size_t i_data,
+                      struct es_out_sys_t *sys )
+{
+    es_out_t out = {
+        .pf_add = EsOutAdd,
+        .pf_send = EsOutSend,
+        .pf_del = EsOutDel,
+        .pf_control = EsOutControl,
+        .p_sys = sys,
+    };
+
+    stream_t *s = stream_MemoryNew( obj, p_data, i_data, true );
+    assert( s != NULL );
+
+    demux_t *p_demux = vlc_object_create( obj, sizeof (*p_demux) );
+    assert( p_demux != NULL );
+    p_demux->psz_access = (char *)"";
+    p_demux->psz_demux = (char *)"ts";
+    p_demux->psz_location = (char *)"";
+    p_demux->s = s;
+    p_demux->out = &out;
+
+    mtime_t start = mdate();
+    p_demux->p_module = module_need( p_demux, "demux", "ts", true );
+    if( p_demux->p_module == NULL )
+    {
+        vlc_object_release( p_demux );
+        stream_Delete( s );
+        return -1;
+    }
+
+    while( p_demux->pf_demux( p_demux ) == VLC_DEMUXER_SUCCESS );
+    mtime_t duration = mdate() - start;
+
+    if( control( p_demux, DEMUX_GET_PACKET_STATS, &sys->p_stats,
+                 &sys->i_stats ) )
+    {
+        sys->p_stats = NULL;
+        sys->i_stats = 0;
+    }
+    module_unneed( p_demux, p_demux->p_module );
+
+    vlc_object_release( p_demux );
+    stream_Delete( s );
+    return duration;
+}
+
+static bool bench( vlc_object_t *obj, uint8_t *p_data, size_t i_data,
+                   unsigned i_frames )
+{
+    log( "demuxing %zu bytes:\n", i_data );
+    for( int selected = 1; selected >= 0; selected-- )
+    {
+        struct es_out_sys_t sys;
+        mtime_t duration = 0;
+
+        for( unsigned loop = 0; loop < LOOPS; loop++ )
+        {
+            if( loop > 0 )
+                free( sys.p_stats );
+            memset( &sys, 0, sizeof (sys) );
+            sys.b_selected = selected;
+
+            mtime_t val = demux( obj, p_data, i_data, &sys );
+            if( val < 0 )
+                return false;
+            duration += val;
+        }
+
+        log( "  %-10s %7.1f MB/s, %"PRIu64" blocks, %"PRIu64" bytes\n",
+             selected ? "selected" : "unselected",
+             duration ? (double)i_data * LOOPS / duration : 0.,
+             sys.i_blocks, sys.i_bytes );
+
+        if( i_frames > 0 && selected )
+        {   /* The last unbounded video PES may be held back */
+            const uint64_t i_frame =
+                (VIDEO_PACKETS + AUDIO_PACKETS) * (TS_SIZE - 4)
+                - 2 * PES_HEADER;
+
+            assert( sys.i_es == 2 );
+            assert( sys.i_bytes >= (i_frames - 1) * i_frame );
+            assert( sys.i_bytes <= i_frames * i_frame );
+        }
+
+        for( size_t i = 0; i < sys.i_stats; i++ )
+            log( "    pid %4u: %"PRIu64" packets\n", sys.p_stats[i].i_id,
+                 sys.p_stats[i].i_packets );
+        if( i_frames > 0 )
+        {
+            assert( packets( &sys, 0 ) == i_frames );
+            assert( packets( &sys, PMT_PID ) == i_frames );
+            assert( packets( &sys, VIDEO_PID ) == i_frames * (1 + VIDEO_PACKETS) );
+            assert( packets( &sys, AUDIO_PID ) == i_frames * AUDIO_PACKETS );
+        }
+        free( sys.p_stats );
+    }
+    return true;
+}
+
+int main( void )
+{
+    test_init();
+    alarm( 120 );
+
+    libvlc_instance_t *vlc = libvlc_new( test_defaults_nargs,
+                                         test_defaults_args );
+    assert( vlc != NULL );
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    const char *path = getenv( "VLC_TEST_TS" );
+    unsigned i_frames = 0;
+    block_t *p_stream;
+
+    if( path != NULL )
+    {
+        p_stream = block_FilePath( path );
+        assert( p_stream != NULL );
+    }
+    else
+    {
+        p_stream = block_Alloc( STREAM_SIZE );
+        assert( p_stream != NULL );
+        i_frames = generate( p_stream->p_buffer, p_stream->i_buffer );
+        p_stream->i_buffer = i_frames * TS_SIZE
+            * (2 + 1 + VIDEO_PACKETS + AUDIO_PACKETS + NULL_PACKETS);
+    }
+
+    bool ok = bench( obj, p_stream->p_buffer, p_stream->i_buffer, i_frames );
+    block_Release( p_stream );
+    libvlc_release( vlc );
+
+    if( !ok )
+    {
+        log( "TS demuxer not available, skipping\n" );
+        return 77;
+    }
+    return 0;
+}
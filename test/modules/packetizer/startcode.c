@@ -0,0 +1,217 @@
+/*****************************************************************************
+ * startcode.c: test and benchmark of the Annex B start code lookup
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Set VLC_TEST_ANNEXB to the path of a raw H.264 or HEVC elementary stream
+ * to benchmark it instead of the generated one. */
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include <vlc_block.h>
+#include <vlc_block_helper.h>
+
+#include "../../../modules/packetizer/startcode_helper.h"
+
+#define STREAM_SIZE (32 << 20)
+#define LOOPS 10
+
+typedef const uint8_t *(*finder_t)( const uint8_t *, const uint8_t * );
+
+static const struct
+{
+    const char *name;
+    finder_t find;
+    unsigned cpu;
+} finders[] = {
+    { "bits", startcode_FindAnnexB_Bits, 0 },
+#if defined(HAVE_SSE2_INTRINSICS) && (defined(__i386__) || defined(__x86_64__))
+    { "sse2", startcode_FindAnnexB_SSE2, VLC_CPU_SSE2 },
+#endif
+#if defined(HAVE_AVX2_INTRINSICS)
+    { "avx2", startcode_FindAnnexB_AVX2, VLC_CPU_AVX2 },
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    { "neon", startcode_FindAnnexB_NEON, 0 },
+#endif
+};
+
+static bool usable( unsigned i )
+{
+    return (vlc_CPU() & finders[i].cpu) == finders[i].cpu;
+}
+
+/* Short runs of 0 and 1 bytes, to exercise every near miss */
+static void test_exhaustive( void )
+{
+    uint8_t buf[200];
+
+    for( unsigned seed = 0; seed < 2000; seed++ )
+    {
+        srand( seed );
+        for( unsigned i = 0; i < sizeof( buf ); i++ )
+            buf[i] = (rand() % 4) ? (rand() & 1) : rand();
+
+        for( unsigned start = 0; start < 40; start++ )
+            for( unsigned end = start; end <= sizeof( buf ); end += 7 )
+            {
+                const uint8_t *ref =
+                    startcode_FindAnnexB_Bytes( buf + start, buf + end );
+
+                for( unsigned i = 0; i < ARRAY_SIZE(finders); i++ )
+                    if( usable( i ) )
+                        assert( finders[i].find( buf + start,
+                                                 buf + end ) == ref );
+            }
+    }
+}
+
+/* Generates NAL units of random sizes, with emulation prevention */
+static block_t *generate_stream( void )
+{
+    block_t *p_block = block_Alloc( STREAM_SIZE );
+    assert( p_block != NULL );
+
+    uint8_t *p = p_block->p_buffer;
+    uint8_t *end = p + STREAM_SIZE - 8;
+    unsigned zeros = 0;
+
+    srand( 42 );
+    while( p < end )
+    {
+        unsigned i_nal = 1 + rand() % 20000;
+
+        *p++ = 0; *p++ = 0; *p++ = 1;
+        zeros = 0;
+        while( i_nal-- > 0 && p < end )
+        {
+            uint8_t v = rand();
+
+            if( zeros >= 2 && v <= 3 )
+            {
+                *p++ = 3;
+                zeros = 0;
+            }
+            *p++ = v;
+            zeros = v ? 0 : zeros + 1;
+        }
+    }
+    p_block->i_buffer = p - p_block->p_buffer;
+    return p_block;
+}
+
+/* Splits the stream in blocks of random sizes, and checks the offsets found
+ * through the helper against the bytewise search. */
+static void test_bytestream( const block_t *p_stream )
+{
+    const size_t i_size = __MIN( p_stream->i_buffer, 1 << 20 );
+    static const uint8_t startcode[3] = { 0, 0, 1 };
+    block_bytestream_t bs[2];
+
+    for( unsigned i = 0; i < 2; i++ )
+        block_BytestreamInit( &bs[i] );
+
+    srand( 7 );
+    for( size_t i_pos = 0; i_pos < i_size; )
+    {
+        size_t i_len = __MIN( (size_t)(1 + rand() % 5000), i_size - i_pos );
+
+        for( unsigned i = 0; i < 2; i++ )
+        {
+            block_t *p_block = block_Alloc( i_len );
+            assert( p_block != NULL );
+            memcpy( p_block->p_buffer, p_stream->p_buffer + i_pos, i_len );
+            block_BytestreamPush( &bs[i], p_block );
+        }
+        i_pos += i_len;
+    }
+
+    size_t i_offset[2] = { 0, 0 };
+    unsigned i_count = 0;
+    for( ;; )
+    {
+        int ret = block_FindStartcodeFromOffset( &bs[0], &i_offset[0],
+                                                 startcode, 3, NULL );
+        assert( block_FindStartcodeFromOffset( &bs[1], &i_offset[1],
+                                               startcode, 3,
+                                               startcode_FindAnnexB ) == ret );
+        assert( i_offset[0] == i_offset[1] );
+        if( ret != VLC_SUCCESS )
+            break;
+        i_offset[0]++;
+        i_offset[1]++;
+        i_count++;
+    }
+    assert( i_count > 0 );
+
+    for( unsigned i = 0; i < 2; i++ )
+        block_BytestreamRelease( &bs[i] );
+}
+
+static void bench( const block_t *p_stream )
+{
+    const uint8_t *end = p_stream->p_buffer + p_stream->i_buffer;
+
+    log( "scanning %zu bytes:\n", p_stream->i_buffer );
+    for( int i = -1; i < (int)ARRAY_SIZE(finders); i++ )
+    {
+        finder_t find = i < 0 ? startcode_FindAnnexB_Bytes : finders[i].find;
+        unsigned i_count = 0;
+
+        if( i >= 0 && !usable( i ) )
+            continue;
+
+        mtime_t start = mdate();
+        for( unsigned loop = 0; loop < LOOPS; loop++ )
+            for( const uint8_t *p = p_stream->p_buffer;
+                 (p = find( p, end )) != NULL; p += 3 )
+                i_count++;
+        mtime_t duration = mdate() - start;
+
+        log( "  %-5s %7.1f MB/s, %u start codes\n",
+             i < 0 ? "bytes" : finders[i].name,
+             duration ? (double)p_stream->i_buffer * LOOPS / duration : 0.,
+             i_count / LOOPS );
+    }
+}
+
+int main( void )
+{
+    test_init();
+    alarm( 120 );
+
+    test_exhaustive();
+
+    block_t *p_stream;
+    const char *psz_sample = getenv( "VLC_TEST_ANNEXB" );
+    if( psz_sample != NULL )
+    {
+        p_stream = block_FilePath( psz_sample );
+        assert( p_stream != NULL );
+    }
+    else
+        p_stream = generate_stream();
+
+    test_bytestream( p_stream );
+    bench( p_stream );
+
+    block_Release( p_stream );
+    return 0;
+}
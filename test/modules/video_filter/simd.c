@@ -0,0 +1,336 @@
+/*****************************************************************************
+ * simd.c: test and benchmark of the SIMD video kernels at each ISA level
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include <vlc_picture.h>
+
+/* The kernels are static or not exported: build them in */
+#include "../../../modules/video_filter/deinterlace/common.h"
+#include "../../../modules/video_filter/deinterlace/merge.c"
+#include "../../../modules/video_filter/deinterlace/yadif.h"
+#if defined (__i386__) || defined (__x86_64__)
+# include "../../../modules/video_chroma/i420_rgb_sse2.h"
+# include "../../../modules/video_chroma/i420_rgb_avx2.h"
+#endif
+/* Last, as it overrides the vlc_CPU_*() macros */
+#include "../../../modules/video_chroma/copy.c"
+
+#define WIDTH  1918 /* not a multiple of the vector sizes */
+#define PITCH  2048
+#define HEIGHT 1080
+#define FRAMES 10
+
+static unsigned cpu;
+
+static bool has( unsigned flags )
+{
+    return (cpu & flags) == flags;
+}
+
+#define BENCH(name, call) \
+    do { \
+        mtime_t start = mdate(); \
+        for( unsigned frame = 0; frame < FRAMES; frame++ ) \
+            call; \
+        log( "  %-7s %6"PRId64" us/frame\n", name, \
+             (mdate() - start) / FRAMES ); \
+    } while( 0 )
+
+static uint8_t *alloc_plane( unsigned seed )
+{
+    /* Margins for the kernels reading and writing past the edges */
+    uint8_t *p = malloc( PITCH * (HEIGHT + 8) );
+    assert( p != NULL );
+    for( unsigned i = 0; i < PITCH * (HEIGHT + 8); i++ )
+        p[i] = (i * seed) ^ (i >> 7);
+    return p;
+}
+
+static void check_plane( const uint8_t *ref, const uint8_t *out,
+                         size_t pitch, unsigned width, unsigned lines )
+{
+    for( unsigned y = 0; y < lines; y++ )
+        assert( !memcmp( ref + y * pitch, out + y * pitch, width ) );
+}
+
+/* The SIMD merges round up, the C ones down */
+static void check_merge( const uint8_t *ref, const uint8_t *out )
+{
+    for( unsigned y = 0; y < HEIGHT; y++ )
+        for( unsigned x = 0; x < WIDTH; x++ )
+            assert( abs( ref[y * PITCH + x] - out[y * PITCH + x] ) <= 1 );
+}
+
+typedef void (*merge_t)( void *, const void *, const void *, size_t );
+
+static void merge_frame( merge_t merge, uint8_t *dst, const uint8_t *a,
+                         const uint8_t *b, size_t bytes )
+{
+    for( unsigned y = 0; y < HEIGHT; y++ )
+        merge( dst + y * PITCH, a + y * PITCH, b + y * PITCH, bytes );
+}
+
+static void test_merge( uint8_t *a, uint8_t *b, uint8_t *ref, uint8_t *out )
+{
+    log( "Merge 8-bit:\n" );
+    BENCH( "C", merge_frame( Merge8BitGeneric, ref, a + 1, b, WIDTH ) );
+#if defined(CAN_COMPILE_SSE)
+    if( has( VLC_CPU_SSE2 ) )
+    {
+        BENCH( "SSE2", merge_frame( Merge8BitSSE2, out, a + 1, b, WIDTH ) );
+        check_merge( ref, out );
+    }
+#endif
+#if defined(CAN_COMPILE_AVX2)
+    if( has( VLC_CPU_AVX2 ) )
+    {
+        BENCH( "AVX2", merge_frame( Merge8BitAVX2, out, a + 1, b, WIDTH ) );
+        check_merge( ref, out );
+    }
+#endif
+
+    log( "Merge 16-bit:\n" );
+    BENCH( "C", merge_frame( Merge16BitGeneric, ref, a + 2, b, WIDTH ) );
+#if defined(CAN_COMPILE_SSE)
+    if( has( VLC_CPU_SSE2 ) )
+    {
+        BENCH( "SSE2", merge_frame( Merge16BitSSE2, out, a + 2, b, WIDTH ) );
+        check_merge( ref, out );
+    }
+#endif
+#if defined(CAN_COMPILE_AVX2)
+    if( has( VLC_CPU_AVX2 ) )
+    {
+        BENCH( "AVX2", merge_frame( Merge16BitAVX2, out, a + 2, b, WIDTH ) );
+        check_merge( ref, out );
+    }
+#endif
+}
+
+typedef void (*yadif_t)( uint8_t *, uint8_t *, uint8_t *, uint8_t *,
+                         int, int, int, int, int );
+
+static void yadif_frame( yadif_t filter, uint8_t *dst, uint8_t *prev,
+                         uint8_t *cur, uint8_t *next, int parity )
+{
+    for( int y = 3; y < HEIGHT - 3; y += 2 )
+        filter( dst + y * PITCH, prev + y * PITCH, cur + y * PITCH,
+                next + y * PITCH, WIDTH, PITCH, -PITCH, parity, y & 2 );
+}
+
+static void test_yadif( uint8_t *prev, uint8_t *cur, uint8_t *next,
+                        uint8_t *ref, uint8_t *out )
+{
+    static const struct
+    {
+        const char *name;
+        unsigned flags;
+        yadif_t filter;
+    } levels[] = {
+#if defined(HAVE_YADIF_MMX)
+        { "MMX", VLC_CPU_MMX, yadif_filter_line_mmx },
+#endif
+#if defined(HAVE_YADIF_SSE2)
+        { "SSE2", VLC_CPU_SSE2, yadif_filter_line_sse2 },
+#endif
+#if defined(HAVE_YADIF_SSSE3)
+        { "SSSE3", VLC_CPU_SSSE3, yadif_filter_line_ssse3 },
+#endif
+#if defined(HAVE_YADIF_AVX2)
+        { "AVX2", VLC_CPU_AVX2, yadif_filter_line_avx2 },
+#endif
+    };
+
+    for( int parity = 0; parity < 2; parity++ )
+    {
+        log( "Yadif line filter, parity %d:\n", parity );
+        memset( ref, 0, PITCH * HEIGHT );
+        BENCH( "C", yadif_frame( yadif_filter_line_c, ref, prev, cur, next,
+                                 parity ) );
+        for( size_t i = 0; i < ARRAY_SIZE(levels); i++ )
+        {
+            if( !has( levels[i].flags ) )
+                continue;
+            memset( out, 0, PITCH * HEIGHT );
+            BENCH( levels[i].name, yadif_frame( levels[i].filter, out,
+                                                prev, cur, next, parity ) );
+            check_plane( ref, out, PITCH, WIDTH, HEIGHT );
+        }
+    }
+}
+
+#ifdef CAN_COMPILE_SSE2
+static void test_copy( uint8_t *src, uint8_t *ref, uint8_t *out )
+{
+    static const struct
+    {
+        const char *name;
+        unsigned flags;
+    } levels[] = {
+        { "SSE2", VLC_CPU_SSE2 },
+        { "SSSE3", VLC_CPU_SSE2|VLC_CPU_SSSE3 },
+        { "SSE4.1", VLC_CPU_SSE2|VLC_CPU_SSSE3|VLC_CPU_SSE4_1 },
+        { "AVX2", VLC_CPU_SSE2|VLC_CPU_SSSE3|VLC_CPU_SSE4_1|VLC_CPU_AVX2 },
+    };
+    copy_cache_t cache;
+
+    assert( CopyInitCache( &cache, WIDTH ) == VLC_SUCCESS );
+
+    log( "Plane copy:\n" );
+    BENCH( "C", CopyPlane( ref, PITCH, src, PITCH, WIDTH, HEIGHT ) );
+    for( size_t i = 0; i < ARRAY_SIZE(levels); i++ )
+    {
+        if( !has( levels[i].flags ) )
+            continue;
+        memset( out, 0, PITCH * HEIGHT );
+        BENCH( levels[i].name,
+               SSE_CopyPlane( out, PITCH, src, PITCH, cache.buffer,
+                              cache.size, WIDTH, HEIGHT, levels[i].flags ) );
+        check_plane( ref, out, PITCH, WIDTH, HEIGHT );
+    }
+
+    /* Interleaved chroma, into the halves of the output planes */
+    const unsigned half = HEIGHT / 2 * PITCH;
+
+    log( "UV split:\n" );
+    BENCH( "C", SplitPlanes( ref, PITCH, ref + half, PITCH, src, PITCH,
+                             WIDTH / 2, HEIGHT / 2 ) );
+    for( size_t i = 0; i < ARRAY_SIZE(levels); i++ )
+    {
+        if( !has( levels[i].flags ) )
+            continue;
+        memset( out, 0, PITCH * HEIGHT );
+        BENCH( levels[i].name,
+               SSE_SplitPlanes( out, PITCH, out + half, PITCH, src, PITCH,
+                                cache.buffer, cache.size, WIDTH / 2,
+                                HEIGHT / 2, levels[i].flags ) );
+        check_plane( ref, out, PITCH, WIDTH / 2, HEIGHT );
+    }
+
+    CopyCleanCache( &cache );
+}
+
+VLC_SSE
+static void rgb_frame_sse2( uint32_t *p_buffer, const uint8_t *p_y,
+                            const uint8_t *p_u, const uint8_t *p_v )
+{
+    for( unsigned y = 0; y < HEIGHT; y++ )
+    {
+        for( unsigned i_x = WIDTH / 32 * 2; i_x--; )
+        {
+            SSE2_CALL (
+                SSE2_INIT_32_UNALIGNED
+                SSE2_YUV_MUL
+                SSE2_YUV_ADD
+                SSE2_UNPACK_32_ARGB_UNALIGNED
+            );
+            p_y += 16;
+            p_u += 8;
+            p_v += 8;
+            p_buffer += 16;
+        }
+        p_y += PITCH - WIDTH / 32 * 32;
+        p_buffer += PITCH - WIDTH / 32 * 32;
+        if( y & 1 )
+        {
+            p_u += PITCH / 2 - WIDTH / 32 * 16;
+            p_v += PITCH / 2 - WIDTH / 32 * 16;
+        }
+        else
+        {
+            p_u -= WIDTH / 32 * 16;
+            p_v -= WIDTH / 32 * 16;
+        }
+    }
+    SSE2_END;
+}
+
+# if defined(HAVE_AVX2_INTRINSICS)
+static void rgb_frame_avx2( uint32_t *p_buffer, const uint8_t *p_y,
+                            const uint8_t *p_u, const uint8_t *p_v )
+{
+    for( unsigned y = 0; y < HEIGHT; y++ )
+    {
+        AVX2_I420_ARGB( p_buffer, p_y, p_u, p_v, WIDTH / 32, false );
+        p_y += PITCH;
+        p_buffer += PITCH;
+        if( y & 1 )
+        {
+            p_u += PITCH / 2;
+            p_v += PITCH / 2;
+        }
+    }
+}
+# endif
+
+static void test_rgb( const uint8_t *y, const uint8_t *u, const uint8_t *v )
+{
+    uint32_t *ref = malloc( PITCH * HEIGHT * 4 );
+    uint32_t *out = malloc( PITCH * HEIGHT * 4 );
+    assert( ref != NULL && out != NULL );
+
+    log( "I420 to RGB32:\n" );
+    BENCH( "SSE2", rgb_frame_sse2( ref, y, u, v ) );
+# if defined(HAVE_AVX2_INTRINSICS)
+    if( has( VLC_CPU_AVX2 ) )
+    {
+        BENCH( "AVX2", rgb_frame_avx2( out, y, u, v ) );
+        check_plane( (uint8_t *)ref, (uint8_t *)out, PITCH * 4,
+                     WIDTH / 32 * 32 * 4, HEIGHT );
+    }
+# endif
+    free( out );
+    free( ref );
+}
+#endif
+
+int main( void )
+{
+    test_init();
+    alarm( 60 );
+
+    cpu = vlc_CPU();
+
+    uint8_t *prev = alloc_plane( 7 );
+    uint8_t *cur  = alloc_plane( 13 );
+    uint8_t *next = alloc_plane( 29 );
+    uint8_t *ref  = alloc_plane( 1 );
+    uint8_t *out  = alloc_plane( 1 );
+
+    test_merge( prev, cur, ref, out );
+    test_yadif( prev, cur, next, ref, out );
+#ifdef CAN_COMPILE_SSE2
+    if( has( VLC_CPU_SSE2 ) )
+    {
+        test_copy( cur, ref, out );
+        test_rgb( cur, prev, next );
+    }
+#endif
+
+    free( out );
+    free( ref );
+    free( next );
+    free( cur );
+    free( prev );
+    return 0;
+}
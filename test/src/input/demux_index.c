@@ -0,0 +1,181 @@
+/*****************************************************************************
+ * demux_index.c: test for the demuxer seek index cache
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_block.h>
+
+#define COUNT 100000
+
+struct record
+{
+    int64_t pos;
+    int64_t time;
+};
+
+int main( void )
+{
+    test_init();
+
+    char dir[] = "/tmp/vlc-index-XXXXXX";
+    assert( mkdtemp( dir ) != NULL );
+    setenv( "XDG_CACHE_HOME", dir, 1 );
+
+    char *path;
+    assert( asprintf( &path, "%s/media", dir ) != -1 );
+    FILE *media = fopen( path, "wb" );
+    assert( media != NULL );
+    fputs( "media", media );
+    fclose( media );
+
+    const char *argv[test_defaults_nargs + 1];
+    memcpy( argv, test_defaults_args, sizeof (test_defaults_args) );
+    argv[test_defaults_nargs] = "--demux-index-cache";
+
+    libvlc_instance_t *vlc = libvlc_new( test_defaults_nargs + 1, argv );
+    assert( vlc != NULL );
+
+    demux_t *demux = vlc_object_create( vlc->p_libvlc_int,
+                                        sizeof (*demux) );
+    assert( demux != NULL );
+    demux->psz_file = path;
+
+    struct record *records = malloc( COUNT * sizeof (*records) );
+    assert( records != NULL );
+    for( unsigned i = 0; i < COUNT; i++ )
+    {
+        records[i].pos = i * INT64_C(4096);
+        records[i].time = i * INT64_C(40000);
+    }
+
+    /* Nothing cached yet */
+    assert( demux_IndexLoad( demux, "test", sizeof (*records) ) == NULL );
+
+    /* Round trip */
+    assert( demux_IndexStore( demux, "test", records, sizeof (*records),
+                              COUNT ) == VLC_SUCCESS );
+    mtime_t start = mdate();
+    block_t *block = demux_IndexLoad( demux, "test", sizeof (*records) );
+    log( "loaded %u entries in %"PRId64" us\n", COUNT, mdate() - start );
+    assert( block != NULL );
+    assert( block->i_buffer == COUNT * sizeof (*records) );
+    assert( !memcmp( block->p_buffer, records, block->i_buffer ) );
+    block_Release( block );
+
+    /* Empty index */
+    assert( demux_IndexStore( demux, "empty", NULL, sizeof (*records),
+                              0 ) == VLC_SUCCESS );
+    block = demux_IndexLoad( demux, "empty", sizeof (*records) );
+    assert( block != NULL && block->i_buffer == 0 );
+    block_Release( block );
+
+    /* Mismatches */
+    assert( demux_IndexLoad( demux, "other", sizeof (*records) ) == NULL );
+    assert( demux_IndexLoad( demux, "test", sizeof (int64_t) ) == NULL );
+
+    var_Create( demux, "demux-index-cache", VLC_VAR_BOOL );
+    assert( demux_IndexLoad( demux, "test", sizeof (*records) ) == NULL );
+    var_Destroy( demux, "demux-index-cache" );
+
+    /* The cache is bounded, the last index stored is kept */
+    char name[16];
+    for( unsigned i = 0; i < 48; i++ )
+    {
+        snprintf( name, sizeof (name), "prune%u", i );
+        assert( demux_IndexStore( demux, name, records, sizeof (*records),
+                                  COUNT ) == VLC_SUCCESS );
+    }
+    block = demux_IndexLoad( demux, name, sizeof (*records) );
+    assert( block != NULL );
+    block_Release( block );
+
+    char *index;
+    assert( asprintf( &index, "%s/vlc/index", dir ) != -1 );
+    DIR *d = opendir( index );
+    assert( d != NULL );
+
+    uint64_t total = 0;
+    struct dirent *ent;
+    while( (ent = readdir( d )) != NULL )
+    {
+        char *file;
+        struct stat st;
+
+        assert( asprintf( &file, "%s/%s", index, ent->d_name ) != -1 );
+        if( stat( file, &st ) == 0 && S_ISREG( st.st_mode ) )
+            total += st.st_size;
+        free( file );
+    }
+    closedir( d );
+    free( index );
+    log( "%"PRIu64" bytes of indexes in cache\n", total );
+    assert( total <= (64 << 20) );
+
+    /* Indexes of a modified media are stale */
+    struct stat st;
+    assert( demux_IndexStore( demux, "stale", records, sizeof (*records),
+                              COUNT ) == VLC_SUCCESS );
+    block = demux_IndexLoad( demux, "stale", sizeof (*records) );
+    assert( block != NULL );
+    block_Release( block );
+
+    assert( stat( path, &st ) == 0 );
+    struct utimbuf times = {
+        .actime = st.st_atime,
+        .modtime = st.st_mtime - 3600,
+    };
+    assert( utime( path, &times ) == 0 );
+    assert( demux_IndexLoad( demux, "stale", sizeof (*records) ) == NULL );
+
+    assert( demux_IndexStore( demux, "stale", records, sizeof (*records),
+                              COUNT ) == VLC_SUCCESS );
+    block = demux_IndexLoad( demux, "stale", sizeof (*records) );
+    assert( block != NULL );
+    block_Release( block );
+
+    media = fopen( path, "ab" );
+    assert( media != NULL );
+    fputs( "more media", media );
+    fclose( media );
+    assert( utime( path, &times ) == 0 );
+    assert( demux_IndexLoad( demux, "stale", sizeof (*records) ) == NULL );
+
+    free( records );
+    demux->psz_file = NULL;
+    vlc_object_release( demux );
+    libvlc_release( vlc );
+
+    char *cmd;
+    assert( asprintf( &cmd, "rm -rf %s", dir ) != -1 );
+    system( cmd );
+    free( cmd );
+    free( path );
+    return 0;
+}
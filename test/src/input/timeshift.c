@@ -0,0 +1,369 @@
+/*****************************************************************************
+ * timeshift.c: test for the timeshift buffer
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "../../../src/input/es_out_timeshift.c"
+
+#define SIZE  65536 /* 15 blocks per storage of 1 MiB */
+#define COUNT 96
+#define KEY   4     /* Key frame interval */
+#define STEP  40000
+#define DEFAULT_AT 85
+
+#define T(i) ((mtime_t)((i) + 1) * STEP)
+
+/* Only used to reset the rate, which the test does not change */
+void input_ControlPush( input_thread_t *p_input, int i_type, vlc_value_t *p_val )
+{
+    VLC_UNUSED(p_input); VLC_UNUSED(i_type); VLC_UNUSED(p_val);
+    assert( 0 );
+}
+
+static block_t *block( unsigned seq )
+{
+    block_t *p_block = block_Alloc( SIZE );
+    assert( p_block != NULL );
+    memset( p_block->p_buffer, 0, SIZE );
+    memcpy( p_block->p_buffer, &seq, sizeof (seq) );
+    p_block->i_dts = p_block->i_pts = T(seq);
+    if( seq % KEY == 0 )
+        p_block->i_flags |= BLOCK_FLAG_TYPE_I;
+    return p_block;
+}
+
+static unsigned count_files( const char *dir )
+{
+    DIR *d = opendir( dir );
+    struct dirent *ent;
+    unsigned count = 0;
+
+    assert( d != NULL );
+    while( (ent = readdir( d )) != NULL )
+        if( !strncmp( ent->d_name, "vlc-timeshift.", 14 ) )
+            count++;
+    closedir( d );
+    return count;
+}
+
+/*****************************************************************************
+ * Storage reuse
+ *****************************************************************************/
+static void fill( ts_storage_t *p_storage, unsigned first, unsigned count )
+{
+    es_out_id_t es;
+
+    for( unsigned i = first; i < first + count; i++ )
+    {
+        ts_cmd_t cmd;
+
+        CmdInitSend( &cmd, &es, block( i ) );
+        assert( !TsStorageIsFull( p_storage, &cmd ) );
+        TsStoragePushCmd( p_storage, &cmd );
+    }
+
+    /* What the writer thread does */
+    for( int i = p_storage->i_cmd_sync; i < p_storage->i_cmd_w; i++ )
+    {
+        ts_cmd_t *p_cmd = &p_storage->p_cmd[i];
+
+        assert( !TsStorageWriteBlock( p_storage, p_cmd->u.send.p_block,
+                                      p_cmd->u.send.i_offset ) );
+        block_Release( p_cmd->u.send.p_block );
+        p_cmd->u.send.p_block = NULL;
+    }
+    assert( fflush( p_storage->p_filew ) == 0 );
+    p_storage->i_cmd_sync = p_storage->i_cmd_w;
+}
+
+static void check( ts_storage_t *p_storage, unsigned first, unsigned count )
+{
+    for( unsigned i = first; i < first + count; i++ )
+    {
+        ts_cmd_t cmd;
+        unsigned seq;
+
+        assert( !TsStorageIsEmpty( p_storage ) );
+        assert( !TsStoragePopCmd( p_storage, &cmd ) );
+        assert( cmd.i_type == C_SEND && cmd.u.send.p_block != NULL );
+        assert( cmd.u.send.p_block->i_buffer == SIZE );
+        memcpy( &seq, cmd.u.send.p_block->p_buffer, sizeof (seq) );
+        assert( seq == i );
+        assert( cmd.u.send.p_block->i_dts == T(i) );
+        assert( !(cmd.u.send.p_block->i_flags & BLOCK_FLAG_TYPE_I) == !!(i % KEY) );
+        CmdCleanSend( &cmd );
+    }
+    assert( TsStorageIsEmpty( p_storage ) );
+}
+
+static void test_storage( const char *dir )
+{
+    ts_storage_t *p_storage = TsStorageNew( dir, 1 << 20 );
+    assert( p_storage != NULL );
+
+    char *psz_file = strdup( p_storage->psz_file );
+    assert( psz_file != NULL );
+
+    /* Fill it up */
+    fill( p_storage, 0, 15 );
+    ts_cmd_t cmd;
+    CmdInitSend( &cmd, NULL, block( 15 ) );
+    assert( TsStorageIsFull( p_storage, &cmd ) );
+    check( p_storage, 0, 15 );
+
+    /* The reset storage overwrites the same file from the start */
+    assert( !TsStorageReset( p_storage ) );
+    assert( !strcmp( p_storage->psz_file, psz_file ) );
+    assert( p_storage->i_file_size == 0 && p_storage->i_index == 0 );
+    assert( TsStorageIsEmpty( p_storage ) );
+    assert( !TsStorageIsFull( p_storage, &cmd ) );
+    CmdCleanSend( &cmd );
+
+    fill( p_storage, 100, 10 );
+    check( p_storage, 100, 10 );
+
+    TsStorageDelete( p_storage );
+    free( psz_file );
+    assert( count_files( dir ) == 0 );
+}
+
+/*****************************************************************************
+ * Timeshift playback
+ *****************************************************************************/
+static struct
+{
+    vlc_mutex_t lock;
+    vlc_cond_t  wait;
+    unsigned    played[4 * COUNT];
+    unsigned    count;
+    unsigned    resets;
+    unsigned    defaults;
+} sink;
+
+static es_out_id_t *SinkAdd( es_out_t *out, const es_format_t *fmt )
+{
+    static es_out_id_t es;
+
+    VLC_UNUSED(out); VLC_UNUSED(fmt);
+    return &es;
+}
+
+static int SinkSend( es_out_t *out, es_out_id_t *es, block_t *p_block )
+{
+    unsigned seq;
+
+    VLC_UNUSED(out); VLC_UNUSED(es);
+    memcpy( &seq, p_block->p_buffer, sizeof (seq) );
+    assert( !(p_block->i_flags & BLOCK_FLAG_TYPE_I) == !!(seq % KEY) );
+    block_Release( p_block );
+
+    vlc_mutex_lock( &sink.lock );
+    assert( sink.count < ARRAY_SIZE(sink.played) );
+    sink.played[sink.count++] = seq;
+    vlc_cond_signal( &sink.wait );
+    vlc_mutex_unlock( &sink.lock );
+    return VLC_SUCCESS;
+}
+
+static void SinkDel( es_out_t *out, es_out_id_t *es )
+{
+    VLC_UNUSED(out); VLC_UNUSED(es);
+}
+
+static int SinkControl( es_out_t *out, int i_query, va_list args )
+{
+    VLC_UNUSED(out);
+
+    switch( i_query )
+    {
+    case ES_OUT_GET_BUFFERING:
+        *va_arg( args, bool * ) = false;
+        break;
+    case ES_OUT_GET_EMPTY:
+        *va_arg( args, bool * ) = true;
+        break;
+    case ES_OUT_SET_TIME:
+        assert( va_arg( args, mtime_t ) == -1 );
+        vlc_mutex_lock( &sink.lock );
+        sink.resets++;
+        vlc_mutex_unlock( &sink.lock );
+        break;
+    case ES_OUT_SET_ES_DEFAULT:
+        vlc_mutex_lock( &sink.lock );
+        sink.defaults++;
+        vlc_mutex_unlock( &sink.lock );
+        break;
+    default:
+        break;
+    }
+    return VLC_SUCCESS;
+}
+
+static void sink_reset( void )
+{
+    vlc_mutex_lock( &sink.lock );
+    sink.count = 0;
+    sink.resets = 0;
+    vlc_mutex_unlock( &sink.lock );
+}
+
+/* Waits for the given blocks to be played, and nothing else */
+static void sink_check( unsigned first, unsigned count )
+{
+    vlc_mutex_lock( &sink.lock );
+    while( sink.count < count )
+        vlc_cond_wait( &sink.wait, &sink.lock );
+    vlc_mutex_unlock( &sink.lock );
+
+    msleep( CLOCK_FREQ / 20 );
+
+    vlc_mutex_lock( &sink.lock );
+    assert( sink.count == count );
+    for( unsigned i = 0; i < count; i++ )
+        assert( sink.played[i] == first + i );
+    vlc_mutex_unlock( &sink.lock );
+}
+
+static void test_timeshift( vlc_object_t *obj, const char *dir )
+{
+    es_out_t sink_out = {
+        .pf_add = SinkAdd,
+        .pf_send = SinkSend,
+        .pf_del = SinkDel,
+        .pf_control = SinkControl,
+    };
+
+    vlc_mutex_init( &sink.lock );
+    vlc_cond_init( &sink.wait );
+
+    input_thread_t *p_input = vlc_object_create( obj, sizeof (*p_input) );
+    assert( p_input != NULL );
+    p_input->p = calloc( 1, sizeof (*p_input->p) );
+    assert( p_input->p != NULL );
+
+    /* Storages of 1 MiB, and 1 MiB of played data kept */
+    var_Create( p_input, "input-timeshift-path", VLC_VAR_STRING );
+    var_SetString( p_input, "input-timeshift-path", dir );
+    var_Create( p_input, "input-timeshift-granularity", VLC_VAR_INTEGER );
+    var_SetInteger( p_input, "input-timeshift-granularity", 1 << 20 );
+    var_Create( p_input, "input-timeshift-window", VLC_VAR_INTEGER );
+    var_SetInteger( p_input, "input-timeshift-window", 1 );
+
+    es_out_t *out = input_EsOutTimeshiftNew( p_input, &sink_out,
+                                             INPUT_RATE_DEFAULT );
+    assert( out != NULL );
+
+    es_format_t fmt;
+    es_format_Init( &fmt, VIDEO_ES, VLC_CODEC_MP2V );
+    es_out_id_t *es = es_out_Add( out, &fmt );
+    assert( es != NULL );
+
+    /* Live input: the timeshift starts with the data */
+    for( unsigned i = 0; i < COUNT; i++ )
+    {
+        es_out_SetTimes( out, (double)i / COUNT, T(i), 0 );
+        assert( !es_out_Control( out, ES_OUT_SET_PCR, T(i) ) );
+        assert( !es_out_Send( out, es, block( i ) ) );
+        if( i == DEFAULT_AT )
+            assert( !es_out_Control( out, ES_OUT_SET_ES_DEFAULT, es ) );
+    }
+    assert( out->p_sys->b_delayed );
+    ts_thread_t *p_ts = out->p_sys->p_ts;
+
+    sink_check( 0, COUNT );
+    assert( sink.resets == 0 && sink.defaults == 1 );
+
+    /* Once written, only the played storages within the window remain. The
+     * files are those, the spare one and maybe one being prepared. */
+    unsigned storages;
+    for( ;; )
+    {
+        vlc_mutex_lock( &p_ts->lock );
+        bool b_written = TsWriterGetStorageLocked( p_ts ) == NULL;
+        storages = 0;
+        for( ts_storage_t *p = p_ts->p_storage_first; p; p = p->p_next )
+            storages++;
+        vlc_mutex_unlock( &p_ts->lock );
+        if( b_written )
+            break;
+        msleep( CLOCK_FREQ / 100 );
+    }
+    log( "%u storages kept, %u files\n", storages, count_files( dir ) );
+    assert( storages == 2 );
+    assert( count_files( dir ) <= storages + 2 );
+
+    /* Trimmed or not buffered yet */
+    assert( es_out_SetTime( out, T(10) ) );
+    assert( es_out_SetTime( out, T(COUNT) + 2 * TS_SEEK_TOLERANCE ) );
+    assert( sink.resets == 0 );
+
+    /* Seek back: the replay starts at the previous key frame, the ES
+     * controls are not executed again */
+    sink_reset();
+    assert( !es_out_SetTime( out, T(82) ) );
+    sink_check( 80, COUNT - 80 );
+    assert( sink.resets == 1 && sink.defaults == 1 );
+
+    /* Seek back then forward while paused */
+    assert( !es_out_SetPauseState( out, false, true, mdate() ) );
+    sink_reset();
+    assert( !es_out_SetTime( out, T(78) ) );
+    assert( !es_out_SetTime( out, T(93) ) );
+    msleep( CLOCK_FREQ / 20 );
+    vlc_mutex_lock( &sink.lock );
+    assert( sink.count == 0 && sink.resets == 2 );
+    vlc_mutex_unlock( &sink.lock );
+
+    assert( !es_out_SetPauseState( out, false, false, mdate() ) );
+    sink_check( 92, COUNT - 92 );
+    assert( sink.defaults == 1 );
+
+    es_out_Delete( out );
+    assert( count_files( dir ) == 0 );
+
+    free( p_input->p );
+    vlc_object_release( p_input );
+    vlc_cond_destroy( &sink.wait );
+    vlc_mutex_destroy( &sink.lock );
+}
+
+int main( void )
+{
+    test_init();
+
+    char dir[] = "/tmp/vlc-timeshift-XXXXXX";
+    assert( mkdtemp( dir ) != NULL );
+
+    libvlc_instance_t *vlc = libvlc_new( test_defaults_nargs,
+                                         test_defaults_args );
+    assert( vlc != NULL );
+
+    test_storage( dir );
+    test_timeshift( VLC_OBJECT(vlc->p_libvlc_int), dir );
+
+    libvlc_release( vlc );
+    rmdir( dir );
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*****************************************************************************
+ * fifo.c: test and benchmark for block FIFOs
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#define BLOCK_COUNT 200000
+
+/* Consumer side, as done by the decoder thread */
+static void *Consume( void *data )
+{
+    block_fifo_t *fifo = data;
+    size_t bytes = 0;
+
+    for( mtime_t expected = 0; expected < BLOCK_COUNT; expected++ )
+    {
+        block_t *block;
+
+        vlc_fifo_Lock( fifo );
+        while( vlc_fifo_IsEmpty( fifo ) )
+            vlc_fifo_Wait( fifo );
+        block = vlc_fifo_DequeueUnlocked( fifo );
+        vlc_fifo_Unlock( fifo );
+
+        assert( block != NULL );
+        assert( block->i_dts == expected );
+        bytes += block->i_buffer;
+        block_Release( block );
+    }
+
+    return (void *)bytes;
+}
+
+static void test_fifo( const char *psz_name, block_fifo_t *fifo, bool b_push )
+{
+    vlc_thread_t th;
+    size_t expected_bytes = 0;
+
+    /* Accounting */
+    for( int i = 0; i < 3; i++ )
+    {
+        block_t *block = block_Alloc( 100 * (i + 1) );
+        assert( block != NULL );
+        if( b_push )
+            vlc_fifo_Push( fifo, block );
+        else
+            block_FifoPut( fifo, block );
+    }
+    vlc_fifo_Lock( fifo );
+    assert( vlc_fifo_GetCount( fifo ) == 3 );
+    assert( vlc_fifo_GetBytes( fifo ) == 600 );
+    vlc_fifo_Unlock( fifo );
+    block_FifoEmpty( fifo );
+    vlc_fifo_Lock( fifo );
+    assert( vlc_fifo_GetCount( fifo ) == 0 );
+    assert( vlc_fifo_GetBytes( fifo ) == 0 );
+    vlc_fifo_Unlock( fifo );
+
+    /* Throughput with small blocks */
+    mtime_t start = mdate();
+    assert( vlc_clone( &th, Consume, fifo, VLC_THREAD_PRIORITY_LOW ) == 0 );
+
+    for( mtime_t i = 0; i < BLOCK_COUNT; i++ )
+    {
+        block_t *block = block_Alloc( 16 + (i & 255) );
+        assert( block != NULL );
+        block->i_dts = i;
+        expected_bytes += block->i_buffer;
+
+        if( b_push )
+            vlc_fifo_Push( fifo, block );
+        else
+            block_FifoPut( fifo, block );
+    }
+
+    void *bytes;
+    vlc_join( th, &bytes );
+    mtime_t duration = mdate() - start;
+
+    assert( (size_t)bytes == expected_bytes );
+    assert( block_FifoCount( fifo ) == 0 );
+
+    log( "%s: %d blocks in %"PRId64" us (%.1f ns/block)\n", psz_name,
+         BLOCK_COUNT, duration, duration * 1000. / BLOCK_COUNT );
+}
+
+int main( void )
+{
+    block_fifo_t *fifo;
+
+    test_init();
+
+    fifo = block_FifoNew();
+    assert( fifo != NULL );
+    test_fifo( "locked FIFO", fifo, false );
+    block_FifoRelease( fifo );
+
+    fifo = block_FifoNewSPSC( 1024 );
+    assert( fifo != NULL );
+    test_fifo( "SPSC FIFO (locked queueing)", fifo, false );
+    test_fifo( "SPSC FIFO (lock-free queueing)", fifo, true );
+    block_FifoRelease( fifo );
+
+    /* A small ring makes the producer fall back to locking */
+    fifo = block_FifoNewSPSC( 4 );
+    assert( fifo != NULL );
+    test_fifo( "SPSC FIFO (small ring)", fifo, true );
+    block_FifoRelease( fifo );
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*****************************************************************************
+ * messages.c: test and benchmark of the messages logging
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <string.h>
+
+#include <vlc_common.h>
+
+#define THREADS 4
+#define COUNT   20000
+
+struct logs
+{
+    vlc_mutex_t lock;
+    unsigned next[THREADS];
+    unsigned received;
+    unsigned dropped;
+    unsigned heap;
+};
+
+static void expected( char *buf, size_t size, unsigned thread, unsigned seq )
+{
+    snprintf( buf, size, "thread %u message %u: %s %.4s %*d %.2f %"PRIx64,
+              thread, seq, "text", "fourcc", 8, -(int)seq, seq / 7.,
+              UINT64_C(0xdeadbeef) * seq );
+}
+
+static void callback( void *data, int level, const libvlc_log_t *ctx,
+                      const char *fmt, va_list ap )
+{
+    struct logs *logs = data;
+    char msg[256], ref[256];
+    unsigned thread, seq;
+
+    vsnprintf( msg, sizeof (msg), fmt, ap );
+    (void) level; (void) ctx;
+
+    vlc_mutex_lock( &logs->lock );
+    if( sscanf( msg, "%u log messages dropped", &seq ) == 1 )
+        logs->dropped += seq;
+    else
+    if( sscanf( msg, "thread %u message %u:", &thread, &seq ) == 2 )
+    {
+        assert( thread < THREADS );
+        expected( ref, sizeof (ref), thread, seq );
+        assert( !strcmp( msg, ref ) );
+        /* Messages of a thread are in order, even if some are dropped */
+        assert( seq >= logs->next[thread] );
+        logs->next[thread] = seq + 1;
+        logs->received++;
+    }
+    else
+    if( !strncmp( msg, "heap", 4 ) )
+    {
+        assert( !strcmp( msg, "heap format 42" ) );
+        logs->heap++;
+    }
+    vlc_mutex_unlock( &logs->lock );
+}
+
+struct worker
+{
+    vlc_object_t *obj;
+    unsigned thread;
+    mtime_t duration;
+};
+
+/* The format string need not outlive the call (see the MKV demuxer) */
+static void emit_heap( vlc_object_t *obj, const char *format, ... )
+{
+    char *copy = strdup( format );
+    va_list ap;
+
+    assert( copy != NULL );
+    va_start( ap, format );
+    msg_GenericVa( obj, VLC_MSG_DBG, copy, ap );
+    va_end( ap );
+    memset( copy, '%', strlen( copy ) );
+    free( copy );
+}
+
+static void *emit( void *data )
+{
+    struct worker *w = data;
+    mtime_t start = mdate();
+
+    for( unsigned seq = 0; seq < COUNT; seq++ )
+        msg_Dbg( w->obj, "thread %u message %u: %s %.4s %*d %.2f %"PRIx64,
+                 w->thread, seq, "text", "fourcc", 8, -(int)seq, seq / 7.,
+                 UINT64_C(0xdeadbeef) * seq );
+    w->duration = mdate() - start;
+
+    for( unsigned i = 0; i < 100; i++ )
+        emit_heap( w->obj, "heap format %d", 42 );
+    return NULL;
+}
+
+static void test( const char *option )
+{
+    const char *argv[test_defaults_nargs + 1];
+    struct logs logs;
+    struct worker workers[THREADS];
+    vlc_thread_t threads[THREADS];
+
+    memcpy( argv, test_defaults_args, sizeof (test_defaults_args) );
+    argv[test_defaults_nargs] = option;
+
+    libvlc_instance_t *vlc = libvlc_new( test_defaults_nargs + 1, argv );
+    assert( vlc != NULL );
+
+    memset( &logs, 0, sizeof (logs) );
+    vlc_mutex_init( &logs.lock );
+    libvlc_log_set( vlc, callback, &logs );
+
+    for( unsigned i = 0; i < THREADS; i++ )
+    {
+        workers[i].obj = VLC_OBJECT(vlc->p_libvlc_int);
+        workers[i].thread = i;
+        assert( vlc_clone( &threads[i], emit, &workers[i],
+                           VLC_THREAD_PRIORITY_LOW ) == 0 );
+    }
+
+    mtime_t duration = 0;
+    for( unsigned i = 0; i < THREADS; i++ )
+    {
+        vlc_join( threads[i], NULL );
+        duration += workers[i].duration;
+    }
+
+    /* Pending messages are delivered before the callback is unset */
+    libvlc_log_unset( vlc );
+    log( "%s: %.3f us per message, %u received, %u dropped\n", option,
+         (double)duration / (THREADS * COUNT), logs.received, logs.dropped );
+    assert( logs.received > 0 && logs.received <= THREADS * COUNT );
+    assert( logs.received + logs.dropped >= THREADS * COUNT );
+    assert( logs.heap > 0 );
+
+    libvlc_release( vlc );
+    vlc_mutex_destroy( &logs.lock );
+}
+
+int main( void )
+{
+    test_init();
+
+    test( "--no-log-async" );
+    test( "--log-async" );
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*****************************************************************************
+ * slice.c: test and benchmark for slice-parallel video filters
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_arrays.h>
+
+#define WIDTH  1920
+#define HEIGHT 1080
+#define FRAMES 100
+
+struct plane
+{
+    uint8_t *src;
+    uint8_t *dst;
+    unsigned visits[HEIGHT];
+    unsigned grain;
+};
+
+/* Checks that every line is visited once, in bands aligned on the grain */
+static void Visit( void *opaque, unsigned first, unsigned last )
+{
+    struct plane *p = opaque;
+
+    assert( first < last && last <= HEIGHT );
+    assert( (first % p->grain) == 0 );
+    for( unsigned y = first; y < last; y++ )
+        p->visits[y]++;
+}
+
+/* Vertical blur, as a stand-in for a deinterlacer or a denoiser */
+static void Blur( void *opaque, unsigned first, unsigned last )
+{
+    struct plane *p = opaque;
+
+    for( unsigned y = first; y < last; y++ )
+    {
+        const uint8_t *above = p->src + (y ? y - 1 : y) * WIDTH;
+        const uint8_t *cur = p->src + y * WIDTH;
+        const uint8_t *below = p->src + (y < HEIGHT - 1 ? y + 1 : y) * WIDTH;
+        uint8_t *dst = p->dst + y * WIDTH;
+
+        for( unsigned x = 0; x < WIDTH; x++ )
+            dst[x] = (above[x] + 2 * cur[x] + below[x] + 2) >> 2;
+    }
+}
+
+static void test_slice( const char *threads )
+{
+    const char *args[test_defaults_nargs + 1];
+
+    for( int i = 0; i < test_defaults_nargs; i++ )
+        args[i] = test_defaults_args[i];
+    args[test_defaults_nargs] = threads;
+
+    libvlc_instance_t *vlc = libvlc_new( test_defaults_nargs + 1, args );
+    assert( vlc != NULL );
+
+    filter_t *filter = vlc_object_create( vlc->p_libvlc_int,
+                                          sizeof (*filter) );
+    assert( filter != NULL );
+
+    struct plane *p = calloc( 1, sizeof (*p) );
+    assert( p != NULL );
+    p->src = malloc( WIDTH * HEIGHT );
+    p->dst = malloc( WIDTH * HEIGHT );
+    assert( p->src != NULL && p->dst != NULL );
+    for( unsigned i = 0; i < WIDTH * HEIGHT; i++ )
+        p->src[i] = i * 7;
+
+    /* Coverage */
+    static const unsigned grains[] = { 1, 2, 4, 16, 1000, 2000 };
+    for( unsigned i = 0; i < ARRAY_SIZE(grains); i++ )
+    {
+        memset( p->visits, 0, sizeof (p->visits) );
+        p->grain = grains[i];
+        filter_Slice( filter, HEIGHT, grains[i], Visit, p );
+        for( unsigned y = 0; y < HEIGHT; y++ )
+            assert( p->visits[y] == 1 );
+    }
+    p->grain = 1;
+    filter_Slice( filter, 0, 1, Visit, p );
+
+    /* Throughput against the single-threaded reference */
+    uint8_t *ref = malloc( WIDTH * HEIGHT );
+    assert( ref != NULL );
+
+    mtime_t start = mdate();
+    for( unsigned i = 0; i < FRAMES; i++ )
+        Blur( p, 0, HEIGHT );
+    mtime_t serial = mdate() - start;
+    memcpy( ref, p->dst, WIDTH * HEIGHT );
+
+    memset( p->dst, 0, WIDTH * HEIGHT );
+    start = mdate();
+    for( unsigned i = 0; i < FRAMES; i++ )
+        filter_Slice( filter, HEIGHT, 2, Blur, p );
+    mtime_t parallel = mdate() - start;
+    assert( !memcmp( ref, p->dst, WIDTH * HEIGHT ) );
+
+    log( "%s: %"PRId64" us/frame single-threaded, %"PRId64" us/frame "
+         "sliced (x%.2f)\n", threads, serial / FRAMES, parallel / FRAMES,
+         parallel ? (double)serial / parallel : 0. );
+
+    free( ref );
+    free( p->dst );
+    free( p->src );
+    free( p );
+    vlc_object_release( filter );
+    libvlc_release( vlc );
+}
+
+int main( void )
+{
+    test_init();
+
+    test_slice( "--filter-threads=1" );
+    test_slice( "--filter-threads=2" );
+    test_slice( "--filter-threads=4" );
+    test_slice( "--filter-threads=0" );
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*****************************************************************************
+ * cache.c: benchmark of the LibVLC startup with the plugins cache
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Run it against an older tree to compare with the previous cache format. */
+
+#include "../../libvlc/test.h"
+
+#include <string.h>
+#include <limits.h>
+
+#include <vlc_common.h>
+
+#define LOOPS 5
+
+/* Returns the average startup time, and the number of video filters */
+static mtime_t bench( const char *psz_cache, unsigned loops, unsigned *count )
+{
+    const char *argv[test_defaults_nargs + 1];
+
+    memcpy( argv, test_defaults_args, sizeof (test_defaults_args) );
+    argv[test_defaults_nargs] = psz_cache;
+
+    mtime_t start = mdate();
+    for( unsigned i = 0; i < loops; i++ )
+    {
+        libvlc_instance_t *vlc = libvlc_new( test_defaults_nargs + 1, argv );
+        assert( vlc != NULL );
+
+        libvlc_module_description_t *list = libvlc_video_filter_list_get( vlc );
+        *count = 0;
+        for( libvlc_module_description_t *p = list; p != NULL; p = p->p_next )
+            (*count)++;
+        libvlc_module_description_list_release( list );
+
+        libvlc_release( vlc );
+    }
+    return (mdate() - start) / loops;
+}
+
+int main( void )
+{
+    unsigned reset, scanned, cached;
+    char dir[] = "/tmp/vlc-test-cache-XXXXXX";
+    char link[sizeof (dir) + 8], cache[sizeof (dir) + 12];
+
+    test_init();
+    alarm( 120 );
+
+    /* Keep the cache of the build tree intact: browse the plugins through
+     * a temporary directory, which gets the cache file instead. */
+    char *plugins = realpath( "../modules", NULL );
+    assert( plugins != NULL );
+    assert( mkdtemp( dir ) != NULL );
+    snprintf( link, sizeof (link), "%s/modules", dir );
+    snprintf( cache, sizeof (cache), "%s/plugins.dat", dir );
+    assert( symlink( plugins, link ) == 0 );
+    free( plugins );
+    setenv( "VLC_PLUGIN_PATH", dir, 1 );
+
+    /* Writes the cache */
+    mtime_t i_reset = bench( "--reset-plugins-cache", 1, &reset );
+    mtime_t i_scanned = bench( "--no-plugins-cache", LOOPS, &scanned );
+    mtime_t i_cached = bench( "--plugins-cache", LOOPS, &cached );
+
+    log( "startup without cache: %"PRId64" us\n", i_scanned );
+    log( "startup writing cache: %"PRId64" us\n", i_reset );
+    log( "startup with cache:    %"PRId64" us\n", i_cached );
+
+    unlink( cache );
+    unlink( link );
+    rmdir( dir );
+
+    /* The cached descriptions are the same as the plugins ones */
+    assert( reset == scanned );
+    assert( cached == scanned );
+    return 0;
+}
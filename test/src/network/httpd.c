@@ -0,0 +1,384 @@
+/*****************************************************************************
+ * httpd.c: HTTP server load test
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Streams to loopback clients, as the HTTP stream output does:
+ *
+ *   test_src_network_httpd [threads [max clients [step [kbit/s]]]]
+ *
+ * Without arguments, a few clients are served for a short while.
+ * Otherwise, the number of clients is increased by steps until the latency
+ * of the delivered data or the number of starving clients gets too high,
+ * and the largest sustained count is reported. */
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_httpd.h>
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define RATE        25                  /* blocks per second */
+#define MAX_LATENCY 200                 /* ms, at the 99th percentile */
+#define HISTOGRAM   10000               /* ms */
+
+static const char magic[8] = "VLCHTTPD";
+
+/* Each record carries the time the block was sent */
+typedef struct
+{
+    char    magic[8];
+    mtime_t date;
+} record_t;
+
+typedef struct
+{
+    int      fd;
+    bool     b_header;   /* the answer header was received */
+    size_t   i_header;   /* end of header characters matched */
+    uint8_t  rec[sizeof (record_t)];
+    size_t   i_rec;
+    bool     b_ready;    /* a first record was received */
+    uint64_t i_records;  /* while measuring */
+} client_t;
+
+typedef struct
+{
+    httpd_stream_t *stream;
+    size_t          i_size;
+} feeder_t;
+
+static unsigned histogram[HISTOGRAM + 1];
+static uint64_t resyncs;
+
+static void *Feed( void *data )
+{
+    feeder_t *feeder = data;
+    mtime_t deadline = mdate();
+
+    for( ;; )
+    {
+        block_t *block = block_Alloc( feeder->i_size );
+        assert( block != NULL );
+
+        mtime_t now = mdate();
+        for( size_t i = 0; i < feeder->i_size; i += sizeof (record_t) )
+        {
+            record_t *rec = (record_t *)&block->p_buffer[i];
+            memcpy( rec->magic, magic, sizeof (magic) );
+            rec->date = now;
+        }
+
+        int canc = vlc_savecancel();
+        httpd_StreamSend( feeder->stream, block );
+        vlc_restorecancel( canc );
+        block_Release( block );
+
+        deadline += CLOCK_FREQ / RATE;
+        mwait( deadline );
+    }
+    return NULL;
+}
+
+static int ClientConnect( client_t *cl, unsigned port )
+{
+    static const char query[] = "GET /stream HTTP/1.0\r\n\r\n";
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons( port ),
+        .sin_addr.s_addr = htonl( INADDR_LOOPBACK ),
+    };
+
+    memset( cl, 0, sizeof (*cl) );
+    cl->fd = socket( AF_INET, SOCK_STREAM, 0 );
+    if( cl->fd == -1 )
+        return -1;
+
+    if( connect( cl->fd, (struct sockaddr *)&addr, sizeof (addr) )
+     || send( cl->fd, query, strlen( query ), 0 ) != (ssize_t)strlen( query ) )
+    {
+        close( cl->fd );
+        return -1;
+    }
+    fcntl( cl->fd, F_SETFL, fcntl( cl->fd, F_GETFL ) | O_NONBLOCK );
+    return 0;
+}
+
+static void ClientParse( client_t *cl, const uint8_t *p, size_t i_len,
+                         mtime_t now, bool b_measure )
+{
+    static const char eoh[] = "\r\n\r\n";
+
+    for( size_t i = 0; i < i_len; i++ )
+    {
+        if( !cl->b_header )
+        {
+            cl->i_header = (p[i] == eoh[cl->i_header]) ? cl->i_header + 1
+                         : (p[i] == eoh[0]);
+            cl->b_header = cl->i_header == 4;
+            continue;
+        }
+
+        cl->rec[cl->i_rec++] = p[i];
+        if( cl->i_rec < sizeof (record_t) )
+            continue;
+
+        if( memcmp( cl->rec, magic, sizeof (magic) ) )
+        {
+            /* slow clients skip data, not necessarily at record bounds */
+            memmove( cl->rec, cl->rec + 1, sizeof (record_t) - 1 );
+            cl->i_rec--;
+            resyncs++;
+            continue;
+        }
+        cl->i_rec = 0;
+
+        record_t rec;
+        memcpy( &rec, cl->rec, sizeof (rec) );
+        cl->b_ready = true;
+        if( b_measure )
+        {
+            mtime_t ms = (now - rec.date) / 1000;
+            histogram[ms > HISTOGRAM ? HISTOGRAM : ms > 0 ? ms : 0]++;
+            cl->i_records++;
+        }
+    }
+}
+
+static unsigned Percentile( uint64_t total, unsigned percent )
+{
+    uint64_t count = 0;
+
+    for( unsigned ms = 0; ms < HISTOGRAM; ms++ )
+    {
+        count += histogram[ms];
+        if( count * 100 >= total * percent )
+            return ms;
+    }
+    return HISTOGRAM;
+}
+
+/* Returns a free loopback port, or 0 if the loopback cannot be bound */
+static unsigned GetPort( void )
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl( INADDR_LOOPBACK ),
+    };
+    socklen_t len = sizeof (addr);
+    int fd = socket( AF_INET, SOCK_STREAM, 0 );
+
+    if( fd == -1 )
+        return 0;
+    if( bind( fd, (struct sockaddr *)&addr, sizeof (addr) )
+     || getsockname( fd, (struct sockaddr *)&addr, &len ) )
+        addr.sin_port = 0;
+    close( fd );
+    return ntohs( addr.sin_port );
+}
+
+/* Returns whether all the clients were served in time */
+static bool test_httpd( libvlc_int_t *p_libvlc, unsigned threads,
+                        unsigned clients, unsigned kbps, mtime_t duration )
+{
+    unsigned port = GetPort();
+    assert( port != 0 );
+    var_SetInteger( p_libvlc, "http-port", port );
+    var_SetInteger( p_libvlc, "http-threads", threads );
+
+    httpd_host_t *host = vlc_http_HostNew( VLC_OBJECT(p_libvlc) );
+    assert( host != NULL );
+    feeder_t feeder;
+    feeder.stream = httpd_StreamNew( host, "/stream", "application/octet-stream",
+                                     NULL, NULL );
+    assert( feeder.stream != NULL );
+    feeder.i_size = kbps * 1000 / 8 / RATE;
+    feeder.i_size -= feeder.i_size % sizeof (record_t);
+    if( feeder.i_size == 0 )
+        feeder.i_size = sizeof (record_t);
+
+    vlc_thread_t th;
+    assert( vlc_clone( &th, Feed, &feeder, VLC_THREAD_PRIORITY_LOW ) == 0 );
+
+    client_t *cl = malloc( clients * sizeof (*cl) );
+    struct pollfd *ufd = malloc( clients * sizeof (*ufd) );
+    assert( cl != NULL && ufd != NULL );
+
+    /* Connect, and wait for everybody to receive data */
+    unsigned connected = 0;
+    mtime_t start = mdate();
+    while( connected < clients && ClientConnect( &cl[connected], port ) == 0 )
+        connected++;
+    if( connected < clients )
+        log( "cannot connect client %u: %s\n", connected, vlc_strerror_c(errno) );
+    mtime_t connect_time = mdate() - start;
+
+    for( unsigned i = 0; i < connected; i++ )
+    {
+        ufd[i].fd = cl[i].fd;
+        ufd[i].events = POLLIN;
+    }
+
+    memset( histogram, 0, sizeof (histogram) );
+    resyncs = 0;
+
+    uint8_t buf[65536];
+    uint64_t bytes = 0;
+    bool b_measure = false;
+    mtime_t measure_start = 0;
+    unsigned i_ready = 0;
+    mtime_t ready_time = 0;
+
+    for( ;; )
+    {
+        mtime_t now = mdate();
+        if( b_measure && now - measure_start >= duration )
+            break;
+        if( !b_measure && (i_ready == connected
+                        || now - start >= duration + connect_time) )
+        {
+            /* everybody got data, or will not */
+            ready_time = now - start;
+            b_measure = true;
+            measure_start = now;
+            bytes = 0;
+        }
+
+        if( poll( ufd, connected, 100 ) <= 0 )
+            continue;
+
+        for( unsigned i = 0; i < connected; i++ )
+        {
+            if( ufd[i].revents == 0 )
+                continue;
+
+            ssize_t val = recv( cl[i].fd, buf, sizeof (buf), 0 );
+            now = mdate();
+            if( val <= 0 )
+            {
+                if( val == 0 || errno != EAGAIN )
+                    ufd[i].fd = -1; /* dropped by the server */
+                continue;
+            }
+            bytes += val;
+
+            bool b_ready = cl[i].b_ready;
+            ClientParse( &cl[i], buf, val, now, b_measure );
+            if( !b_ready && cl[i].b_ready )
+                i_ready++;
+        }
+    }
+
+    uint64_t records = 0;
+    unsigned served = 0;
+    for( unsigned i = 0; i < connected; i++ )
+    {
+        records += cl[i].i_records;
+        if( ufd[i].fd != -1 && cl[i].i_records > 0 )
+            served++;
+        close( cl[i].fd );
+    }
+
+    vlc_cancel( th );
+    vlc_join( th, NULL );
+    httpd_StreamDelete( feeder.stream );
+    httpd_HostDelete( host );
+    free( ufd );
+    free( cl );
+
+    unsigned p50 = Percentile( records, 50 ), p99 = Percentile( records, 99 );
+    log( "%2u threads %6u clients: %6u served, ready in %5"PRId64" ms, "
+         "%8.1f Mbit/s, latency %4u ms median %4u ms p99, %"PRIu64" resyncs\n",
+         threads, clients, served, ready_time / 1000,
+         bytes * 8. / duration, p50, p99, resyncs );
+
+    return served == clients && p99 <= MAX_LATENCY;
+}
+
+int main( int argc, char **argv )
+{
+    test_init();
+
+    /* Sandboxed builds may have no network at all */
+    if( GetPort() == 0 )
+    {
+        log( "cannot bind to the loopback: %s, skipping\n",
+             vlc_strerror_c(errno) );
+        return 77;
+    }
+
+    libvlc_instance_t *p_vlc = libvlc_new( test_defaults_nargs,
+                                           test_defaults_args );
+    assert( p_vlc != NULL );
+    libvlc_int_t *p_libvlc = p_vlc->p_libvlc_int;
+    var_Create( p_libvlc, "http-host", VLC_VAR_STRING );
+    var_SetString( p_libvlc, "http-host", "127.0.0.1" );
+    var_Create( p_libvlc, "http-port", VLC_VAR_INTEGER );
+    var_Create( p_libvlc, "http-threads", VLC_VAR_INTEGER );
+
+    if( argc < 2 )
+    {
+        /* Smoke test */
+        alarm( 30 );
+        assert( test_httpd( p_libvlc, 1, 16, 256, CLOCK_FREQ ) );
+        assert( test_httpd( p_libvlc, 2, 16, 256, CLOCK_FREQ ) );
+    }
+    else
+    {
+        unsigned threads = atoi( argv[1] );
+        unsigned max = (argc > 2) ? atoi( argv[2] ) : 10000;
+        unsigned step = (argc > 3) ? atoi( argv[3] ) : 500;
+        unsigned kbps = (argc > 4) ? atoi( argv[4] ) : 512;
+        unsigned sustained = 0;
+
+        alarm( 0 );
+
+        /* Each client takes a socket at both ends */
+        struct rlimit lim;
+        if( getrlimit( RLIMIT_NOFILE, &lim ) == 0 )
+        {
+            lim.rlim_cur = lim.rlim_max;
+            setrlimit( RLIMIT_NOFILE, &lim );
+            if( lim.rlim_cur < 2 * max + 64 )
+                log( "only %lu file descriptors\n", (unsigned long)lim.rlim_cur );
+        }
+
+        for( unsigned clients = step; clients <= max; clients += step )
+        {
+            if( !test_httpd( p_libvlc, threads, clients, kbps,
+                             5 * CLOCK_FREQ ) )
+                break;
+            sustained = clients;
+        }
+        log( "%u threads: %u clients sustained at %u kbit/s\n",
+             threads, sustained, kbps );
+    }
+
+    libvlc_release( p_vlc );
+    return 0;
+}